@@ -0,0 +1,524 @@
+#include "AABBTree.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace
+{
+	// Buckets each Build() split considers, along the widest axis
+	const int BuildBins = 16;
+
+	// Past this depth Build() stops looking at costs and halves the
+	// objects, so a degenerate scene can't make the tree too deep
+	const int MaxSAHBuildDepth = 64;
+}
+
+AABBTree::AABBTree(float margin)
+{
+	this->margin = margin;
+	root = NullNode;
+	freeList = NullNode;
+	proxyCount = 0;
+}
+
+void AABBTree::Clear()
+{
+	nodes.clear();
+	root = NullNode;
+	freeList = NullNode;
+	proxyCount = 0;
+}
+
+int AABBTree::AllocateNode()
+{
+	int node;
+	if (freeList != NullNode)
+	{
+		node = freeList;
+		freeList = nodes[node].parent;
+	}
+	else
+	{
+		node = (int)nodes.size();
+		nodes.emplace_back();
+	}
+
+	Node& n = nodes[node];
+	n.userData = -1;
+	n.parent = NullNode;
+	n.child1 = NullNode;
+	n.child2 = NullNode;
+	n.height = 0;
+	return node;
+}
+
+void AABBTree::FreeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+AABB AABBTree::Union(const AABB& a, const AABB& b)
+{
+	AABB box;
+	box.min = XMFLOAT3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z));
+	box.max = XMFLOAT3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z));
+	return box;
+}
+
+float AABBTree::SurfaceArea(const AABB& box)
+{
+	float x = box.max.x - box.min.x;
+	float y = box.max.y - box.min.y;
+	float z = box.max.z - box.min.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+bool AABBTree::Contains(const AABB& outer, const AABB& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+		&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+bool AABBTree::Overlaps(const AABB& a, const AABB& b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x
+		&& a.min.y <= b.max.y && a.max.y >= b.min.y
+		&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+int AABBTree::Insert(const AABB& box, int userData)
+{
+	int leaf = AllocateNode();
+	nodes[leaf].box.min = XMFLOAT3(box.min.x - margin, box.min.y - margin, box.min.z - margin);
+	nodes[leaf].box.max = XMFLOAT3(box.max.x + margin, box.max.y + margin, box.max.z + margin);
+	nodes[leaf].userData = userData;
+	InsertLeaf(leaf);
+	proxyCount++;
+	return leaf;
+}
+
+void AABBTree::Remove(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	proxyCount--;
+}
+
+bool AABBTree::Move(int proxy, const AABB& box)
+{
+	if (Contains(nodes[proxy].box, box))
+		return false;
+
+	RemoveLeaf(proxy);
+	nodes[proxy].box.min = XMFLOAT3(box.min.x - margin, box.min.y - margin, box.min.z - margin);
+	nodes[proxy].box.max = XMFLOAT3(box.max.x + margin, box.max.y + margin, box.max.z + margin);
+	InsertLeaf(proxy);
+	return true;
+}
+
+void AABBTree::InsertLeaf(int leaf)
+{
+	if (root == NullNode)
+	{
+		root = leaf;
+		nodes[root].parent = NullNode;
+		return;
+	}
+
+	// Walk down to the best sibling: stop here if pairing with this node
+	// is cheapest, otherwise follow the child that adds the least area
+	// (what every ancestor grows by counts against both children)
+	AABB leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		const Node& node = nodes[index];
+		float area = SurfaceArea(node.box);
+		float combinedArea = SurfaceArea(Union(node.box, leafBox));
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto childCost = [&](int child)
+		{
+			float unionArea = SurfaceArea(Union(nodes[child].box, leafBox));
+			if (nodes[child].IsLeaf())
+				return unionArea + inheritanceCost;
+			return unionArea - SurfaceArea(nodes[child].box) + inheritanceCost;
+		};
+		float cost1 = childCost(node.child1);
+		float cost2 = childCost(node.child2);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	// A new parent for the sibling and the leaf, in the sibling's place
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = Union(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == NullNode)
+		root = newParent;
+	else if (nodes[oldParent].child1 == sibling)
+		nodes[oldParent].child1 = newParent;
+	else
+		nodes[oldParent].child2 = newParent;
+
+	// Then back up, balancing and refitting every ancestor
+	index = nodes[leaf].parent;
+	while (index != NullNode)
+	{
+		index = Balance(index);
+		Node& node = nodes[index];
+		node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+		node.box = Union(nodes[node.child1].box, nodes[node.child2].box);
+		index = node.parent;
+	}
+}
+
+void AABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = NullNode;
+		return;
+	}
+
+	// The sibling takes the parent's place
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	FreeNode(parent);
+
+	if (grandParent == NullNode)
+	{
+		root = sibling;
+		nodes[sibling].parent = NullNode;
+		return;
+	}
+
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	nodes[sibling].parent = grandParent;
+
+	int index = grandParent;
+	while (index != NullNode)
+	{
+		index = Balance(index);
+		Node& node = nodes[index];
+		node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+		node.box = Union(nodes[node.child1].box, nodes[node.child2].box);
+		index = node.parent;
+	}
+}
+
+int AABBTree::Balance(int iA)
+{
+	// If one child (C) is more than one level taller than the other
+	// (B), C rotates up into A's place: C's children become A and the
+	// taller of its own children (F), and A keeps B and takes the
+	// shorter one (G) where C was
+	Node& A = nodes[iA];
+	if (A.IsLeaf() || A.height < 2)
+		return iA;
+
+	int iB = A.child1;
+	int iC = A.child2;
+	int balance = nodes[iC].height - nodes[iB].height;
+	if (balance >= -1 && balance <= 1)
+		return iA;
+
+	// Name the taller child C and the other B whichever side they're on
+	bool rotateRight = balance < -1;
+	if (rotateRight)
+		std::swap(iB, iC);
+	Node& B = nodes[iB];
+	Node& C = nodes[iC];
+	int iF = C.child1;
+	int iG = C.child2;
+	if (nodes[iF].height < nodes[iG].height)
+		std::swap(iF, iG);
+	Node& F = nodes[iF];
+	Node& G = nodes[iG];
+
+	// C takes A's place under A's parent
+	C.child1 = iA;
+	C.child2 = iF;
+	C.parent = A.parent;
+	A.parent = iC;
+	if (C.parent == NullNode)
+		root = iC;
+	else if (nodes[C.parent].child1 == iA)
+		nodes[C.parent].child1 = iC;
+	else
+		nodes[C.parent].child2 = iC;
+
+	// A keeps B where it was and takes G where C was
+	if (rotateRight)
+		A.child1 = iG;
+	else
+		A.child2 = iG;
+	G.parent = iA;
+
+	A.box = Union(B.box, G.box);
+	A.height = 1 + std::max(B.height, G.height);
+	C.box = Union(A.box, F.box);
+	C.height = 1 + std::max(A.height, F.height);
+	return iC;
+}
+
+// A leaf as Build() sees it, kept together so each split only
+// walks an array
+struct AABBTree::BuildEntry
+{
+	AABB box;
+	XMFLOAT3 center;
+	int leaf;
+};
+
+void AABBTree::Build(const AABB* boxes, const int* userData, int count, int* proxies)
+{
+	Clear();
+
+	// Leaves first, so proxy i is node i
+	nodes.reserve((size_t)count * 2);
+	nodes.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		Node& leaf = nodes[i];
+		leaf.box.min = XMFLOAT3(boxes[i].min.x - margin, boxes[i].min.y - margin, boxes[i].min.z - margin);
+		leaf.box.max = XMFLOAT3(boxes[i].max.x + margin, boxes[i].max.y + margin, boxes[i].max.z + margin);
+		leaf.userData = userData[i];
+		leaf.parent = NullNode;
+		leaf.child1 = NullNode;
+		leaf.child2 = NullNode;
+		leaf.height = 0;
+		proxies[i] = i;
+	}
+	proxyCount = count;
+	Rebuild();
+}
+
+void AABBTree::Rebuild()
+{
+	// Every leaf into the entries, every internal node onto the free
+	// list (lowest first, so the new nodes come out in order)
+	std::vector<BuildEntry> entries;
+	entries.reserve(proxyCount);
+	freeList = NullNode;
+	for (int node = (int)nodes.size() - 1; node >= 0; node--)
+	{
+		const Node& n = nodes[node];
+		if (n.height == 0)
+		{
+			XMFLOAT3 center(
+				(n.box.min.x + n.box.max.x) * 0.5f,
+				(n.box.min.y + n.box.max.y) * 0.5f,
+				(n.box.min.z + n.box.max.z) * 0.5f);
+			entries.push_back({ n.box, center, node });
+		}
+		else
+			FreeNode(node);
+	}
+
+	root = NullNode;
+	if (!entries.empty())
+	{
+		root = BuildRange(entries.data(), 0, (int)entries.size(), 0);
+		nodes[root].parent = NullNode;
+	}
+}
+
+int AABBTree::BuildRange(BuildEntry* entries, int begin, int end, int depth)
+{
+	int count = end - begin;
+	if (count == 1)
+		return entries[begin].leaf;
+
+	// Split along the axis the centers spread furthest on
+	XMFLOAT3 centerMin = entries[begin].center;
+	XMFLOAT3 centerMax = centerMin;
+	for (int i = begin + 1; i < end; i++)
+	{
+		const XMFLOAT3& c = entries[i].center;
+		centerMin = XMFLOAT3(std::min(centerMin.x, c.x), std::min(centerMin.y, c.y), std::min(centerMin.z, c.z));
+		centerMax = XMFLOAT3(std::max(centerMax.x, c.x), std::max(centerMax.y, c.y), std::max(centerMax.z, c.z));
+	}
+	float spread[3] = { centerMax.x - centerMin.x, centerMax.y - centerMin.y, centerMax.z - centerMin.z };
+	int axis = spread[0] > spread[1] ? (spread[0] > spread[2] ? 0 : 2) : (spread[1] > spread[2] ? 1 : 2);
+	float axisMin = (&centerMin.x)[axis];
+	auto axisCenter = [axis](const BuildEntry& entry) { return (&entry.center.x)[axis]; };
+
+	int mid = begin;
+	if (spread[axis] > 0.0f && depth < MaxSAHBuildDepth)
+	{
+		// Bucket the boxes by center, then try a split between every pair
+		// of buckets - the cost is each side's area times its box count
+		float scale = BuildBins / spread[axis];
+		auto binOf = [&](const BuildEntry& entry) { return std::min(BuildBins - 1, (int)((axisCenter(entry) - axisMin) * scale)); };
+
+		int binCounts[BuildBins] = {};
+		AABB binBoxes[BuildBins];
+		for (int i = begin; i < end; i++)
+		{
+			int bin = binOf(entries[i]);
+			binBoxes[bin] = binCounts[bin] == 0 ? entries[i].box : Union(binBoxes[bin], entries[i].box);
+			binCounts[bin]++;
+		}
+
+		// Right-hand sides first, then sweep in from the left
+		float rightCosts[BuildBins] = {};
+		AABB sweep = {};
+		int sweepCount = 0;
+		for (int b = BuildBins - 1; b > 0; b--)
+		{
+			if (binCounts[b] > 0)
+			{
+				sweep = sweepCount == 0 ? binBoxes[b] : Union(sweep, binBoxes[b]);
+				sweepCount += binCounts[b];
+			}
+			rightCosts[b] = sweepCount > 0 ? SurfaceArea(sweep) * sweepCount : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		int bestBin = -1;
+		sweepCount = 0;
+		for (int b = 0; b < BuildBins - 1; b++)
+		{
+			if (binCounts[b] > 0)
+			{
+				sweep = sweepCount == 0 ? binBoxes[b] : Union(sweep, binBoxes[b]);
+				sweepCount += binCounts[b];
+			}
+			if (sweepCount == 0 || sweepCount == count)
+				continue;
+			float cost = SurfaceArea(sweep) * sweepCount + rightCosts[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = b;
+			}
+		}
+
+		if (bestBin >= 0)
+		{
+			mid = (int)(std::partition(entries + begin, entries + end,
+				[&](const BuildEntry& entry) { return binOf(entry) <= bestBin; }) - entries);
+		}
+	}
+
+	// Centers all in one place, or too deep already - split in half
+	if (mid <= begin || mid >= end)
+	{
+		mid = begin + count / 2;
+		std::nth_element(entries + begin, entries + mid, entries + end,
+			[&](const BuildEntry& a, const BuildEntry& b) { return axisCenter(a) < axisCenter(b); });
+	}
+
+	// The parent first, so each subtree ends up together in memory
+	int node = AllocateNode();
+	int child1 = BuildRange(entries, begin, mid, depth + 1);
+	int child2 = BuildRange(entries, mid, end, depth + 1);
+
+	Node& n = nodes[node];
+	n.child1 = child1;
+	n.child2 = child2;
+	n.box = Union(nodes[child1].box, nodes[child2].box);
+	n.height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+	nodes[child1].parent = node;
+	nodes[child2].parent = node;
+	return node;
+}
+
+int AABBTree::GetUserData(int proxy) const
+{
+	return nodes[proxy].userData;
+}
+
+const AABB& AABBTree::GetFatAABB(int proxy) const
+{
+	return nodes[proxy].box;
+}
+
+int AABBTree::GetProxyCount() const
+{
+	return proxyCount;
+}
+
+int AABBTree::GetHeight() const
+{
+	return root == NullNode ? 0 : nodes[root].height;
+}
+
+float AABBTree::GetAreaRatio() const
+{
+	if (root == NullNode)
+		return 0.0f;
+
+	float total = 0.0f;
+	for (const Node& node : nodes)
+	{
+		if (node.height > 0)
+			total += SurfaceArea(node.box);
+	}
+	return total / SurfaceArea(nodes[root].box);
+}
+
+bool AABBTree::Validate() const
+{
+	// Every node is either reachable from the root or on the free list
+	int freeCount = 0;
+	for (int node = freeList; node != NullNode; node = nodes[node].parent)
+	{
+		if (nodes[node].height != -1 || ++freeCount > (int)nodes.size())
+			return false;
+	}
+
+	int reachable = 0;
+	int leafCount = 0;
+	if (root != NullNode)
+	{
+		if (nodes[root].parent != NullNode)
+			return false;
+
+		std::vector<int> stack = { root };
+		while (!stack.empty())
+		{
+			int index = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[index];
+			reachable++;
+			if (node.IsLeaf())
+			{
+				if (node.child2 != NullNode || node.height != 0)
+					return false;
+				leafCount++;
+				continue;
+			}
+
+			const Node& child1 = nodes[node.child1];
+			const Node& child2 = nodes[node.child2];
+			if (child1.parent != index || child2.parent != index
+				|| node.height != 1 + std::max(child1.height, child2.height)
+				|| !Contains(node.box, child1.box) || !Contains(node.box, child2.box))
+				return false;
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+
+	return leafCount == proxyCount && reachable + freeCount == (int)nodes.size();
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "Bounds.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------
+// A dynamic bounding volume hierarchy over boxes that move
+//
+// - Each object (a proxy) is a leaf holding its box grown by
+//   a margin, so small moves stay inside it and cost nothing;
+//   only a move out of the fat box re-inserts the leaf
+// - Insertion walks down towards the sibling that adds the
+//   least surface area (the SAH cost, counting what it adds
+//   to every ancestor), and the path back up is kept
+//   balanced with AVL-style rotations
+// - Build() makes the whole tree at once (binned SAH, top
+//   down), for a lot of objects that appear together, like
+//   static geometry at load.  Rebuild() does the same over
+//   what's already there, keeping every proxy id - one at a
+//   time insertion makes a much worse tree than that
+//   (around ten times the SAH cost at a million objects)
+// - Queries walk the tree with a fixed-size stack on the
+//   call stack, so they never allocate.  Rotations keep the
+//   height near 1.44 log2(n) (about 30 at a million objects)
+//   and Build() falls back to median splits past a depth of
+//   64, well inside MaxStackDepth
+// --------------------------------------------------------
+class AABBTree
+{
+public:
+	static const int NullNode = -1;
+	static const int MaxStackDepth = 256;
+
+private:
+	struct Node
+	{
+		AABB box;
+		int userData;
+
+		// The next free node, while on the free list
+		int parent;
+		int child1;
+		int child2;
+
+		// Leaves are 0, free nodes -1
+		int height;
+
+		bool IsLeaf() const { return child1 == NullNode; }
+	};
+
+	std::vector<Node> nodes;
+	int root;
+	int freeList;
+	int proxyCount;
+	float margin;
+
+	int AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int Balance(int node);
+
+	// Builds a subtree over entries [begin, end), reordering them, and
+	// returns its root
+	struct BuildEntry;
+	int BuildRange(BuildEntry* entries, int begin, int end, int depth);
+
+	static AABB Union(const AABB& a, const AABB& b);
+	static float SurfaceArea(const AABB& box);
+	static bool Contains(const AABB& outer, const AABB& inner);
+	static bool Overlaps(const AABB& a, const AABB& b);
+
+public:
+	// margin is how far (in world units) each leaf's box is grown on
+	// every side
+	AABBTree(float margin = 0.1f);
+
+	void Clear();
+
+	// Adds an object, returning its proxy id
+	int Insert(const AABB& box, int userData);
+	void Remove(int proxy);
+
+	// Updates an object's box - returns true if it left its fat box and
+	// was re-inserted, false if nothing had to change
+	bool Move(int proxy, const AABB& box);
+
+	// Replaces everything in the tree with count objects, built top
+	// down - proxies[i] gets the i-th object's proxy id
+	void Build(const AABB* boxes, const int* userData, int count, int* proxies);
+
+	// Builds the tree again from its leaves the way Build() would
+	void Rebuild();
+
+	int GetUserData(int proxy) const;
+	const AABB& GetFatAABB(int proxy) const;
+
+	int GetProxyCount() const;
+	int GetHeight() const;
+
+	// Total surface area of the internal nodes over the root's - the
+	// SAH cost of a query, so lower is a better tree
+	float GetAreaRatio() const;
+
+	// Checks every link, height and box (for tests)
+	bool Validate() const;
+
+	// Each query calls fn(proxy) for every fat box that passes, and
+	// stops early if fn returns false
+
+	template<typename Fn>
+	void QueryAABB(const AABB& box, Fn fn) const
+	{
+		int stack[MaxStackDepth];
+		int top = 0;
+		if (root != NullNode)
+			stack[top++] = root;
+		while (top > 0)
+		{
+			const Node& node = nodes[stack[--top]];
+			if (!Overlaps(node.box, box))
+				continue;
+			if (node.IsLeaf())
+			{
+				if (!fn((int)(&node - nodes.data())))
+					return;
+				continue;
+			}
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+
+	template<typename Fn>
+	void QuerySphere(const Sphere& sphere, Fn fn) const
+	{
+		const DirectX::XMFLOAT3& c = sphere.center;
+		float radiusSq = sphere.radius * sphere.radius;
+
+		int stack[MaxStackDepth];
+		int top = 0;
+		if (root != NullNode)
+			stack[top++] = root;
+		while (top > 0)
+		{
+			const Node& node = nodes[stack[--top]];
+
+			// Squared distance from the center to the box's nearest point
+			float dx = std::max(std::max(node.box.min.x - c.x, 0.0f), c.x - node.box.max.x);
+			float dy = std::max(std::max(node.box.min.y - c.y, 0.0f), c.y - node.box.max.y);
+			float dz = std::max(std::max(node.box.min.z - c.z, 0.0f), c.z - node.box.max.z);
+			if (dx * dx + dy * dy + dz * dz > radiusSq)
+				continue;
+			if (node.IsLeaf())
+			{
+				if (!fn((int)(&node - nodes.data())))
+					return;
+				continue;
+			}
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+
+	// Planes as from Camera::GetFrustumPlanes() (normals inwards).  A
+	// node entirely inside every plane has its whole subtree reported
+	// without testing any more planes.
+	template<typename Fn>
+	void QueryFrustum(const DirectX::XMFLOAT4 planes[6], Fn fn) const
+	{
+		// Entries for nodes already known to be inside are stored as ~node
+		int stack[MaxStackDepth];
+		int top = 0;
+		if (root != NullNode)
+			stack[top++] = root;
+		while (top > 0)
+		{
+			int entry = stack[--top];
+			bool inside = entry < 0;
+			const Node& node = nodes[inside ? ~entry : entry];
+
+			if (!inside)
+			{
+				DirectX::XMFLOAT3 center(
+					(node.box.min.x + node.box.max.x) * 0.5f,
+					(node.box.min.y + node.box.max.y) * 0.5f,
+					(node.box.min.z + node.box.max.z) * 0.5f);
+				DirectX::XMFLOAT3 extents(
+					node.box.max.x - center.x,
+					node.box.max.y - center.y,
+					node.box.max.z - center.z);
+
+				bool outside = false;
+				inside = true;
+				for (int p = 0; p < 6 && !outside; p++)
+				{
+					const DirectX::XMFLOAT4& plane = planes[p];
+					float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+					float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+					outside = distance + radius < 0.0f;
+					inside = inside && distance - radius >= 0.0f;
+				}
+				if (outside)
+					continue;
+			}
+
+			if (node.IsLeaf())
+			{
+				if (!fn((int)(&node - nodes.data())))
+					return;
+				continue;
+			}
+			stack[top++] = inside ? ~node.child1 : node.child1;
+			stack[top++] = inside ? ~node.child2 : node.child2;
+		}
+	}
+
+	// Calls fn(proxy, distance) for every fat box the ray enters before
+	// maxDistance, nearer children first (distance is where it enters,
+	// 0 if it starts inside).  fn returns how far to keep looking:
+	// the same maxDistance to find everything, its hit's distance to
+	// find only closer ones, or a negative number to stop.
+	template<typename Fn>
+	void RayCast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, Fn fn) const
+	{
+		// Division by zero gives infinities the slab test handles
+		DirectX::XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		auto entryDistance = [&](const AABB& box)
+		{
+			float tx0 = (box.min.x - origin.x) * inverse.x, tx1 = (box.max.x - origin.x) * inverse.x;
+			float ty0 = (box.min.y - origin.y) * inverse.y, ty1 = (box.max.y - origin.y) * inverse.y;
+			float tz0 = (box.min.z - origin.z) * inverse.z, tz1 = (box.max.z - origin.z) * inverse.z;
+			float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+			float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::max(tz0, tz1));
+			return tNear <= tFar ? tNear : INFINITY;
+		};
+
+		int stack[MaxStackDepth];
+		int top = 0;
+		if (root != NullNode && entryDistance(nodes[root].box) <= maxDistance)
+			stack[top++] = root;
+		while (top > 0)
+		{
+			const Node& node = nodes[stack[--top]];
+			if (node.IsLeaf())
+			{
+				// Still worth it, if an earlier hit didn't shorten the ray
+				float distance = entryDistance(node.box);
+				if (distance > maxDistance)
+					continue;
+				maxDistance = fn((int)(&node - nodes.data()), distance);
+				if (maxDistance < 0.0f)
+					return;
+				continue;
+			}
+
+			// The nearer child goes on top, so it's searched first
+			float distance1 = entryDistance(nodes[node.child1].box);
+			float distance2 = entryDistance(nodes[node.child2].box);
+			int nearChild = node.child1, farChild = node.child2;
+			if (distance2 < distance1)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(distance1, distance2);
+			}
+			if (distance2 <= maxDistance)
+				stack[top++] = farChild;
+			if (distance1 <= maxDistance)
+				stack[top++] = nearChild;
+		}
+	}
+};
@@ -0,0 +1,1813 @@
+#include "Benchmarks.h"
+#include "AABBTree.h"
+#include "Bounds.h"
+#include "BufferStructs.h"
+#include "Camera.h"
+#include "EntityWorld.h"
+#include "FrustumCuller.h"
+#include "InstanceBatcher.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "ObjLoader.h"
+#include "OcclusionBuffer.h"
+#include "RangeAllocator.h"
+#include "RenderQueue.h"
+#include "RenderSystem.h"
+#include "Transform.h"
+#include "TransformSystem.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+void Benchmarks::RunMeshCacheBenchmark(const char* objFileName)
+{
+	const int Iterations = 5;
+	printf("--- Mesh cache: %s ---\n", objFileName);
+
+	// Cold path: parse the text file, cook tangents and build LODs
+	double coldTotal = 0.0;
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	std::vector<MeshLod> lods;
+	std::vector<ObjSubmesh> submeshes;
+	std::vector<std::string> materialLibraries;
+	std::vector<MeshLod> submeshLods;
+	for (int i = 0; i < Iterations; i++)
+	{
+		Clock::time_point start = Clock::now();
+		verts.clear();
+		indices.clear();
+		if (!ObjLoader::Load(objFileName, verts, indices, &submeshes, &materialLibraries) || verts.empty())
+		{
+			printf("  Could not load %s\n", objFileName);
+			return;
+		}
+		Mesh::CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+		std::vector<MeshLod> ranges;
+		for (const ObjSubmesh& submesh : submeshes)
+			ranges.push_back({ submesh.firstIndex, submesh.indexCount, 0.0f });
+		MeshSimplifier::GenerateLods(&verts[0], (int)verts.size(), indices, &ranges[0], (int)ranges.size(), lods, submeshLods);
+		coldTotal += MillisecondsSince(start);
+	}
+
+	// Make sure there's a cache to read back
+	std::vector<std::string> names;
+	std::vector<std::string> materials;
+	for (const ObjSubmesh& submesh : submeshes)
+	{
+		names.push_back(submesh.name);
+		materials.push_back(submesh.material);
+	}
+	MeshCache::Write(objFileName, &verts[0], (int)verts.size(), &indices[0], (int)indices.size(), &lods[0], (int)lods.size(),
+		&submeshLods[0], (int)submeshes.size(), names.data(), materials.data(), materialLibraries.data(), (int)materialLibraries.size());
+
+	// Cached path: map, validate and touch every byte we'd upload
+	double cachedTotal = 0.0;
+	for (int i = 0; i < Iterations; i++)
+	{
+		Clock::time_point start = Clock::now();
+		MeshCache cache(objFileName);
+		if (!cache.IsValid())
+		{
+			printf("  Cache for %s failed validation\n", objFileName);
+			return;
+		}
+
+		float checksum = 0.0f;
+		for (int v = 0; v < cache.GetVertexCount(); v++)
+			checksum += cache.GetVertices()[v].Tangent.x;
+		unsigned int indexSum = 0;
+		for (int n = 0; n < cache.GetIndexCount(); n++)
+			indexSum += cache.GetIndices()[n];
+		cachedTotal += MillisecondsSince(start);
+
+		// Keep the reads from being optimized away
+		if (checksum == 12345.0f && indexSum == 12345)
+			printf(" ");
+	}
+
+	double cold = coldTotal / Iterations;
+	double cached = cachedTotal / Iterations;
+	printf("  Cold parse: %.3f ms   Cached load: %.3f ms   (%.1fx faster)\n",
+		cold, cached, cached > 0 ? cold / cached : 0.0);
+}
+
+void Benchmarks::RunVertexPackingBenchmark(const char* objFileName)
+{
+	printf("--- Vertex packing: %s ---\n", objFileName);
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!ObjLoader::Load(objFileName, verts, indices) || verts.empty())
+	{
+		printf("  Could not load %s\n", objFileName);
+		return;
+	}
+	Mesh::CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+
+	std::vector<PackedVertex> packed(verts.size());
+	Clock::time_point start = Clock::now();
+	VertexPacking::PackVertices(&verts[0], (int)verts.size(), &packed[0]);
+	double packTime = MillisecondsSince(start);
+
+	// Memory on the GPU, including the switch to 16-bit indices
+	size_t indexSize = verts.size() < 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+	size_t before = verts.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+	size_t after = verts.size() * sizeof(PackedVertex) + indices.size() * indexSize;
+	printf("  %d vertices packed in %.3f ms - %.1f KB -> %.1f KB (%.0f%% smaller)\n",
+		(int)verts.size(), packTime, before / 1024.0, after / 1024.0,
+		100.0 * (1.0 - (double)after / before));
+}
+
+void Benchmarks::RunSimplifierBenchmark(const char* objFileName)
+{
+	printf("--- Mesh simplifier: %s ---\n", objFileName);
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!ObjLoader::Load(objFileName, verts, indices) || verts.empty())
+	{
+		printf("  Could not load %s\n", objFileName);
+		return;
+	}
+
+	// Size of the mesh, so errors can be shown relative to it
+	XMFLOAT3 boundsMin = verts[0].Position;
+	XMFLOAT3 boundsMax = verts[0].Position;
+	for (const Vertex& v : verts)
+	{
+		boundsMin = XMFLOAT3(fminf(boundsMin.x, v.Position.x), fminf(boundsMin.y, v.Position.y), fminf(boundsMin.z, v.Position.z));
+		boundsMax = XMFLOAT3(fmaxf(boundsMax.x, v.Position.x), fmaxf(boundsMax.y, v.Position.y), fmaxf(boundsMax.z, v.Position.z));
+	}
+	float extent = fmaxf(boundsMax.x - boundsMin.x, fmaxf(boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z));
+
+	std::vector<MeshLod> lods;
+	Clock::time_point start = Clock::now();
+	MeshSimplifier::GenerateLods(&verts[0], (int)verts.size(), indices, lods);
+	double buildTime = MillisecondsSince(start);
+
+	for (size_t i = 0; i < lods.size(); i++)
+	{
+		const MeshLod& lod = lods[i];
+		printf("  LOD %d: %6d triangles (%5.1f%%)   error %.5f (%.3f%% of extent)\n",
+			(int)i, lod.indexCount / 3, 100.0f * lod.indexCount / lods[0].indexCount,
+			lod.error, extent > 0 ? 100.0f * lod.error / extent : 0.0f);
+	}
+	printf("  Built %d LODs in %.2f ms\n", (int)lods.size(), buildTime);
+}
+
+void Benchmarks::RunMeshletCullingBenchmark(const char* objFileName)
+{
+	printf("--- Meshlet culling: %s ---\n", objFileName);
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!ObjLoader::Load(objFileName, verts, indices) || verts.empty())
+	{
+		printf("  Could not load %s\n", objFileName);
+		return;
+	}
+	MeshOptimizer::Optimize(verts, indices, objFileName);
+
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> meshletVertices;
+	std::vector<unsigned char> meshletTriangles;
+	Clock::time_point start = Clock::now();
+	Meshlets::Build(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), meshlets, meshletVertices, meshletTriangles);
+	double buildTime = MillisecondsSince(start);
+	printf("  %d meshlets in %.2f ms (%.1f vertices, %.1f triangles each)\n",
+		(int)meshlets.size(), buildTime,
+		(float)meshletVertices.size() / meshlets.size(),
+		(float)meshletTriangles.size() / 3 / meshlets.size());
+
+	// Orbit the mesh, sometimes looking straight at it and sometimes
+	// off to the side, so both frustum and backface culling get work
+	XMFLOAT3 center(0, 0, 0);
+	float radius = 0.0f;
+	for (const Vertex& v : verts)
+	{
+		center.x += v.Position.x / verts.size();
+		center.y += v.Position.y / verts.size();
+		center.z += v.Position.z / verts.size();
+	}
+	for (const Vertex& v : verts)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&v.Position), XMLoadFloat3(&center));
+		radius = fmaxf(radius, XMVectorGetX(XMVector3Length(offset)));
+	}
+
+	const int Positions = 32;
+	const float LookOffsets[] = { 0.0f, 0.35f, 0.7f };
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+
+	MeshletCullStats total = {};
+	std::vector<int> visible;
+	double cullTime = 0.0;
+	for (int i = 0; i < Positions; i++)
+	{
+		float angle = XM_2PI * i / Positions;
+		float distance = radius * 2.5f;
+		for (float lookOffset : LookOffsets)
+		{
+			Camera camera(
+				center.x + sinf(angle) * distance,
+				center.y + radius * 0.5f,
+				center.z - cosf(angle) * distance,
+				0.2f,
+				-angle + lookOffset,
+				0.0f,
+				XM_PIDIV4,
+				1.0f,
+				1.0f,
+				16.0f / 9.0f,
+				0.1f,
+				distance * 4.0f);
+
+			start = Clock::now();
+			MeshletCullStats stats = Meshlets::Cull(&meshlets[0], (int)meshlets.size(), world, &camera, visible);
+			cullTime += MillisecondsSince(start);
+
+			total.meshletsTested += stats.meshletsTested;
+			total.meshletsVisible += stats.meshletsVisible;
+			total.trianglesTested += stats.trianglesTested;
+			total.trianglesFrustumCulled += stats.trianglesFrustumCulled;
+			total.trianglesBackfaceCulled += stats.trianglesBackfaceCulled;
+		}
+	}
+
+	float frustumPercent = 100.0f * total.trianglesFrustumCulled / total.trianglesTested;
+	float backfacePercent = 100.0f * total.trianglesBackfaceCulled / total.trianglesTested;
+	printf("  Triangles culled: %.1f%% (frustum %.1f%%, backface cone %.1f%%) - %.1f ns per meshlet\n",
+		frustumPercent + backfacePercent, frustumPercent, backfacePercent,
+		cullTime * 1000000.0 / total.meshletsTested);
+}
+
+void Benchmarks::RunTangentBenchmark(const char* objFileName, int minTriangles)
+{
+	printf("--- Tangent generation: %s ---\n", objFileName);
+
+	std::vector<Vertex> baseVerts;
+	std::vector<unsigned int> baseIndices;
+	if (!ObjLoader::Load(objFileName, baseVerts, baseIndices) || baseVerts.empty())
+	{
+		printf("  Could not load %s\n", objFileName);
+		return;
+	}
+
+	// Tile copies of the mesh until it's big enough to be interesting
+	int copies = std::max(1, (int)(((size_t)minTriangles * 3 + baseIndices.size() - 1) / baseIndices.size()));
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	verts.reserve(baseVerts.size() * copies);
+	indices.reserve(baseIndices.size() * copies);
+	for (int c = 0; c < copies; c++)
+	{
+		unsigned int base = (unsigned int)verts.size();
+		for (Vertex v : baseVerts)
+		{
+			v.Position.x += 3.0f * c;
+			verts.push_back(v);
+		}
+		for (unsigned int index : baseIndices)
+			indices.push_back(base + index);
+	}
+	int triangleCount = (int)indices.size() / 3;
+
+	std::vector<Vertex> reference = verts;
+	Clock::time_point start = Clock::now();
+	Mesh::CalculateTangentsReference(&reference[0], (int)reference.size(), &indices[0], (int)indices.size());
+	double referenceTime = MillisecondsSince(start);
+
+	const int Iterations = 5;
+	double fastTime = 0.0;
+	for (int i = 0; i < Iterations; i++)
+	{
+		start = Clock::now();
+		Mesh::CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+		fastTime += MillisecondsSince(start);
+	}
+	fastTime /= Iterations;
+
+	printf("  %d triangles - reference: %.2f ms (%.1f Mtri/s)   SIMD + %u threads: %.2f ms (%.1f Mtri/s, %.1fx)\n",
+		triangleCount,
+		referenceTime, triangleCount / (referenceTime * 1000.0),
+		std::max(1u, std::thread::hardware_concurrency()),
+		fastTime, triangleCount / (fastTime * 1000.0),
+		fastTime > 0 ? referenceTime / fastTime : 0.0);
+}
+
+void Benchmarks::RunObjStreamBenchmark(const char* objFileName)
+{
+	printf("--- Streaming OBJ import: %s ---\n", objFileName);
+
+	Clock::time_point start = Clock::now();
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!ObjLoader::Load(objFileName, verts, indices) || verts.empty())
+	{
+		printf("  Couldn't load %s\n", objFileName);
+		return;
+	}
+	double loadTime = MillisecondsSince(start);
+	size_t loadBytes = verts.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+
+	long long streamTriangles = 0;
+	ObjStreamStats stats = {};
+	start = Clock::now();
+	ObjLoader::Stream(objFileName, [&](const ObjStreamChunk& chunk)
+	{
+		streamTriangles += chunk.indexCount / 3;
+		return true;
+	}, ObjStreamChunkVertices, &stats);
+	double streamTime = MillisecondsSince(start);
+
+	printf("  Streamed %lld triangles in %.2f ms (Load: %d in %.2f ms)\n",
+		streamTriangles, streamTime, (int)indices.size() / 3, loadTime);
+	printf("  Working set: %.2f MB streamed vs. %.2f MB for the loaded mesh\n",
+		stats.workingSetBytes / (1024.0 * 1024.0), loadBytes / (1024.0 * 1024.0));
+}
+
+void Benchmarks::RunAsyncMeshLoadBenchmark(const std::vector<std::string>& objFileNames, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	printf("--- Async mesh loading: %d files ---\n", (int)objFileNames.size());
+
+	// Baseline: the blocking constructor, one file after another
+	Clock::time_point start = Clock::now();
+	for (const std::string& fileName : objFileNames)
+		delete new Mesh(fileName.c_str(), device, true);
+	double sequentialTime = MillisecondsSince(start);
+	printf("  Sequential: %.2f ms\n", sequentialTime);
+
+	int threadCounts[] = { 1, JobSystem::GetDefault().GetWorkerCount() };
+	for (int threadCount : threadCounts)
+	{
+		std::vector<MeshHandle> handles;
+		start = Clock::now();
+		MeshLoader loader(device, threadCount);
+		for (const std::string& fileName : objFileNames)
+			handles.push_back(loader.LoadAsync(fileName.c_str(), true));
+		double queueTime = MillisecondsSince(start);
+
+		loader.WaitAll();
+		double totalTime = MillisecondsSince(start);
+
+		// Repeated file names share a mesh, so only delete each once
+		int resident = 0;
+		std::vector<Mesh*> meshes;
+		for (MeshHandle& handle : handles)
+		{
+			Mesh* mesh = handle.ready.get();
+			resident += mesh != nullptr && mesh->IsResident() ? 1 : 0;
+			meshes.push_back(handle.mesh);
+		}
+		std::sort(meshes.begin(), meshes.end());
+		meshes.erase(std::unique(meshes.begin(), meshes.end()), meshes.end());
+		for (Mesh* mesh : meshes)
+			delete mesh;
+
+		printf("  %2d loads: blocked %.3f ms, all resident after %.2f ms (%.2fx), %d/%d resident\n",
+			threadCount, queueTime, totalTime, totalTime > 0 ? sequentialTime / totalTime : 0.0,
+			resident, (int)objFileNames.size());
+	}
+}
+
+void Benchmarks::RunBoundsBenchmark(const char* objFileName)
+{
+	printf("--- Mesh bounds: %s ---\n", objFileName);
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	Clock::time_point start = Clock::now();
+	if (!ObjLoader::Load(objFileName, verts, indices) || verts.empty())
+	{
+		printf("  Couldn't load %s\n", objFileName);
+		return;
+	}
+	double loadTime = MillisecondsSince(start);
+
+	AABB box = Bounds::ComputeAABB(verts.data(), (int)verts.size());
+	Sphere sphere = Bounds::ComputeSphere(verts.data(), (int)verts.size(), box);
+
+	// Timing, on a copy tiled up to a decent size
+	const int MinVertices = 4000000;
+	std::vector<Vertex> tiled;
+	tiled.reserve(std::max(verts.size(), (size_t)MinVertices));
+	while (tiled.size() < (size_t)MinVertices)
+		tiled.insert(tiled.end(), verts.begin(), verts.end());
+
+	const int Iterations = 10;
+	start = Clock::now();
+	for (int i = 0; i < Iterations; i++)
+	{
+		AABB b = Bounds::ComputeAABB(tiled.data(), (int)tiled.size());
+		Bounds::ComputeSphere(tiled.data(), (int)tiled.size(), b);
+	}
+	double boundsTime = MillisecondsSince(start) / Iterations;
+	double nsPerVertex = boundsTime * 1000000.0 / tiled.size();
+
+	printf("  Box (%.3f, %.3f, %.3f) - (%.3f, %.3f, %.3f), sphere radius %.3f\n",
+		box.min.x, box.min.y, box.min.z, box.max.x, box.max.y, box.max.z, sphere.radius);
+	printf("  Box + sphere: %.2f ns/vertex (%.3f ms for this mesh, %.2f%% of its %.2f ms parse)\n",
+		nsPerVertex, nsPerVertex * verts.size() / 1000000.0,
+		100.0 * nsPerVertex * verts.size() / 1000000.0 / loadTime, loadTime);
+}
+
+void Benchmarks::RunRangeAllocatorBenchmark()
+{
+	printf("--- Range allocator ---\n");
+
+	const int Capacity = 1 << 20;
+	const int Operations = 200000;
+	RangeAllocator allocator(Capacity);
+	std::vector<int> live;
+	std::mt19937 random(12345);
+
+	int failedAllocations = 0;
+	int usedSize = 0;
+	float peakFragmentation = 0.0f;
+	Clock::time_point start = Clock::now();
+	for (int op = 0; op < Operations; op++)
+	{
+		// Grow towards ~75% full, then churn
+		bool allocate = live.empty() || (random() % 100) < (usedSize < Capacity * 3 / 4 ? 60 : 45);
+		if (allocate)
+		{
+			int size = 1 + (int)(random() % 2048);
+			int id = allocator.Allocate(size);
+			if (id < 0)
+			{
+				failedAllocations++;
+				continue;
+			}
+			live.push_back(id);
+			usedSize += size;
+		}
+		else
+		{
+			int slot = (int)(random() % live.size());
+			usedSize -= allocator.GetSize(live[slot]);
+			allocator.Free(live[slot]);
+			live[slot] = live.back();
+			live.pop_back();
+		}
+		if (op % 1000 == 0)
+			peakFragmentation = std::max(peakFragmentation, allocator.GetStats().fragmentation);
+	}
+	double churnTime = MillisecondsSince(start);
+	RangeAllocatorStats before = allocator.GetStats();
+
+	std::vector<RangeMove> moves;
+	start = Clock::now();
+	allocator.Compact(moves);
+	double compactTime = MillisecondsSince(start);
+	RangeAllocatorStats after = allocator.GetStats();
+
+	printf("  %d operations in %.2f ms (%.0f ns each), %d allocations didn't fit\n",
+		Operations, churnTime, churnTime * 1000000.0 / Operations, failedAllocations);
+	printf("  Before compaction: %d allocations, %.1f%% used, %d free blocks (largest %d), fragmentation %.3f (peak %.3f)\n",
+		before.allocationCount, 100.0 * before.usedSize / before.capacity, before.freeBlockCount, before.largestFreeBlock, before.fragmentation, peakFragmentation);
+	printf("  After compaction: %d moves in %.3f ms, %d free block(s), fragmentation %.3f\n",
+		(int)moves.size(), compactTime, after.freeBlockCount, after.fragmentation);
+}
+
+void Benchmarks::RunMaterialGroupBenchmark(const char* objFileName)
+{
+	printf("--- OBJ material groups: %s ---\n", objFileName);
+
+	// Copy the mesh, switching material every few faces so each
+	// material's faces are scattered through the file
+	const int FacesPerRun = 37;
+	std::string testFileName = std::string(objFileName) + ".material_test.obj";
+	FILE* source = fopen(objFileName, "rb");
+	FILE* testFile = fopen(testFileName.c_str(), "wb");
+	if (!source || !testFile)
+	{
+		printf("  Couldn't read %s or write the test file\n", objFileName);
+		if (source) fclose(source);
+		if (testFile) fclose(testFile);
+		return;
+	}
+
+	int faces = 0;
+	char line[1024];
+	while (fgets(line, sizeof(line), source))
+	{
+		if (line[0] == 'f' && line[1] == ' ')
+		{
+			int run = faces++ / FacesPerRun;
+			if (faces % FacesPerRun == 1)
+				fprintf(testFile, "g part%d\nusemtl %s\n", run, run % 2 == 0 ? "red" : "blue");
+		}
+		fputs(line, testFile);
+	}
+	fclose(source);
+	fclose(testFile);
+
+	// Parse with and without grouping - it shouldn't cost much
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	std::vector<ObjSubmesh> submeshes;
+	std::vector<std::string> libraries;
+	Clock::time_point start = Clock::now();
+	ObjLoader::Load(testFileName.c_str(), verts, indices);
+	double plainTime = MillisecondsSince(start);
+	start = Clock::now();
+	ObjLoader::Load(testFileName.c_str(), verts, indices, &submeshes, &libraries);
+	double groupedTime = MillisecondsSince(start);
+
+	// Full cook (optimize, tangents, per-submesh LODs)
+	remove(MeshCache::GetCachePath(testFileName.c_str()).c_str());
+	MeshData cooked;
+	start = Clock::now();
+	bool loaded = Mesh::LoadData(testFileName.c_str(), false, cooked);
+	double cookTime = MillisecondsSince(start);
+
+	int submeshCount = (int)cooked.submeshNames.size();
+	if (loaded && submeshCount > 0 && cooked.submeshLods.size() == cooked.lods.size() * submeshCount)
+	{
+		for (int l = 0; l < (int)cooked.lods.size(); l++)
+		{
+			printf("  LOD %d:", l);
+			for (int s = 0; s < submeshCount; s++)
+				printf(" %s%7d", s > 0 ? "+ " : "", cooked.submeshLods[l * submeshCount + s].indexCount / 3);
+			printf(" triangles (error %.5f)\n", cooked.lods[l].error);
+		}
+	}
+
+	printf("  Parse: %.2f ms without grouping, %.2f ms with (%d submeshes)\n", plainTime, groupedTime, (int)submeshes.size());
+	printf("  Cook: %.2f ms\n", cookTime);
+	remove(MeshCache::GetCachePath(testFileName.c_str()).c_str());
+	remove(testFileName.c_str());
+}
+
+void Benchmarks::RunTransformHierarchyBenchmark(int nodeCount)
+{
+	printf("--- Transform hierarchy: %d nodes ---\n", nodeCount);
+
+	const int Iterations = 5;
+	const char* ShapeNames[] = { "deep", "wide", "bushy" };
+	for (int shape = 0; shape < 3; shape++)
+	{
+		// Allocated in one order, linked in a shuffled one, so tree
+		// order and memory order don't line up
+		TransformSystem system(nodeCount);
+		std::vector<Transform*> transforms(nodeCount);
+		for (int i = 0; i < nodeCount; i++)
+			transforms[i] = new Transform(&system);
+		std::vector<int> order(nodeCount);
+		for (int i = 0; i < nodeCount; i++)
+			order[i] = i;
+		std::mt19937 rng(1234 + shape);
+		std::shuffle(order.begin() + 1, order.end(), rng);
+
+		for (int i = 0; i < nodeCount; i++)
+		{
+			Transform* t = transforms[order[i]];
+			t->SetPosition(0.01f * (i % 7), 0.01f, 0.02f * (i % 3));
+			t->SetRotation(0.001f * (i % 5), 0.002f, 0.0f);
+			if (i == 0)
+				continue;
+
+			int parent = shape == 0 ? i - 1 : shape == 1 ? 0 : (i - 1) / 4;
+			t->SetParent(transforms[order[parent]]);
+		}
+		Transform* root = transforms[order[0]];
+
+		system.Update();
+
+		// Each scenario dirties part of the tree, then rebuilds it either
+		// by asking every node for its world matrix (in memory order) or
+		// with the system's single pass
+		double markTime[2] = { 0, 0 };
+		double lazyTime[2] = { 0, 0 };
+		double flatTime[2] = { 0, 0 };
+		int dirtyCounts[2] = { 0, 0 };
+		std::uniform_int_distribution<int> pick(0, nodeCount - 1);
+		for (int scenario = 0; scenario < 2; scenario++)
+		{
+			for (int i = 0; i < Iterations * 2; i++)
+			{
+				Clock::time_point start = Clock::now();
+				if (scenario == 0)
+					root->Rotate(0.0f, 0.01f, 0.0f);
+				else
+				{
+					for (int n = 0; n < nodeCount / 100; n++)
+						transforms[pick(rng)]->MoveAbsolute(0.0f, 0.001f, 0.0f);
+				}
+				markTime[scenario] += MillisecondsSince(start);
+
+				start = Clock::now();
+				if (i % 2 == 0)
+				{
+					float checksum = 0.0f;
+					for (Transform* t : transforms)
+						checksum += t->GetWorldMatrix()._41;
+					lazyTime[scenario] += MillisecondsSince(start);
+					if (checksum == 12345.0f)
+						printf(" ");
+				}
+				else
+				{
+					dirtyCounts[scenario] = system.Update();
+					flatTime[scenario] += MillisecondsSince(start);
+				}
+			}
+		}
+
+		printf("  %-5s  root moved: mark %6.2f ms  lazy %6.2f ms (%5.1f ns/node)  flat %6.2f ms (%5.1f ns/node)\n",
+			ShapeNames[shape], markTime[0] / (Iterations * 2), lazyTime[0] / Iterations, lazyTime[0] / Iterations * 1e6 / nodeCount,
+			flatTime[0] / Iterations, flatTime[0] / Iterations * 1e6 / nodeCount);
+		printf("         1%% moved:   mark %6.2f ms  lazy %6.2f ms  flat %6.2f ms  (%d dirty)\n",
+			markTime[1] / (Iterations * 2), lazyTime[1] / Iterations, flatTime[1] / Iterations, dirtyCounts[1]);
+
+		for (Transform* t : transforms)
+			delete t;
+	}
+}
+
+void Benchmarks::RunTransformSystemBenchmark(int count)
+{
+	printf("--- Transform system: %d transforms ---\n", count);
+
+	TransformSystem system(count);
+	std::vector<int> handles(count);
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+	for (int i = 0; i < count; i++)
+	{
+		handles[i] = system.Create();
+		system.SetPosition(handles[i], position(rng), position(rng), position(rng));
+		system.SetRotation(handles[i], angle(rng), angle(rng), angle(rng));
+		system.SetScale(handles[i], scale(rng), scale(rng), scale(rng));
+	}
+	system.Update();
+
+	// One object at a time, the way Transform used to build them
+	const int Iterations = 5;
+	std::vector<XMFLOAT4X4> reference(count);
+	Clock::time_point start = Clock::now();
+	for (int it = 0; it < Iterations; it++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			XMFLOAT3 p = system.GetPosition(handles[i]);
+			XMFLOAT3 r = system.GetRotation(handles[i]);
+			XMFLOAT3 s = system.GetScale(handles[i]);
+			XMMATRIX world = XMMatrixScaling(s.x, s.y, s.z) * XMMatrixRotationRollPitchYaw(r.x, r.y, r.z) * XMMatrixTranslation(p.x, p.y, p.z);
+			XMStoreFloat4x4(&reference[i], world);
+		}
+	}
+	double scalarTime = MillisecondsSince(start) / Iterations;
+
+	// Every transform dirty each time, so both passes do the same work
+	int threadCounts[2] = { 1, std::max(1, (int)std::thread::hardware_concurrency()) };
+	double batchTime[2] = { 0, 0 };
+	int rebuilt = 0;
+	for (int t = 0; t < 2; t++)
+	{
+		for (int it = 0; it < Iterations; it++)
+		{
+			for (int i = 0; i < count; i++)
+				system.MarkDirty(handles[i]);
+
+			start = Clock::now();
+			rebuilt = system.Update(threadCounts[t]);
+			batchTime[t] += MillisecondsSince(start);
+		}
+		batchTime[t] /= Iterations;
+	}
+
+	const double FrameTime = 1000.0 / 60.0;
+	double perMillion = 1000000.0 / count;
+	printf("  Scalar:             %7.2f ms  (%5.2f ms per 1M)\n", scalarTime, scalarTime * perMillion);
+	for (int t = 0; t < 2; t++)
+	{
+		printf("  SIMD, %2d thread(s): %7.2f ms  (%5.2f ms per 1M, %4.1fx)  %s\n",
+			threadCounts[t], batchTime[t], batchTime[t] * perMillion, scalarTime / batchTime[t],
+			batchTime[t] * perMillion < FrameTime ? "fits in a 60 Hz frame" : "over a 60 Hz frame");
+	}
+	printf("  %d world matrices rebuilt per pass\n", rebuilt);
+}
+
+void Benchmarks::RunTransformBasisBenchmark(int callCount)
+{
+	printf("--- Transform basis: %d calls ---\n", callCount);
+
+	// Calls cycle through a set of transforms, so the rotation can't
+	// just be worked out once and reused
+	const int TransformCount = 1024;
+	TransformSystem system(TransformCount);
+	std::vector<Transform*> transforms(TransformCount);
+	std::vector<XMFLOAT3> angles(TransformCount);
+	std::vector<XMFLOAT3> positions(TransformCount);
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	for (int t = 0; t < TransformCount; t++)
+	{
+		transforms[t] = new Transform(&system);
+		angles[t] = XMFLOAT3(angle(rng), angle(rng), angle(rng));
+		transforms[t]->SetRotation(angles[t].x, angles[t].y, angles[t].z);
+		positions[t] = transforms[t]->GetPosition();
+	}
+	system.Update();
+
+	// The old way: a quaternion from the angles on every call
+	auto rotate = [](const XMFLOAT3& angles, float x, float y, float z)
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVector3Rotate(XMVectorSet(x, y, z, 0), XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z)));
+		return result;
+	};
+
+	// Basis lookups, one axis per call
+	float checksum = 0.0f;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < callCount; i++)
+	{
+		XMFLOAT3 axis = rotate(angles[i % TransformCount], (float)(i % 3 == 0), (float)(i % 3 == 1), (float)(i % 3 == 2));
+		checksum += axis.x;
+	}
+	double eulerBasisTime = MillisecondsSince(start);
+
+	start = Clock::now();
+	for (int i = 0; i < callCount; i++)
+	{
+		Transform* t = transforms[i % TransformCount];
+		XMFLOAT3 axis = i % 3 == 0 ? t->GetLocalRight() : i % 3 == 1 ? t->GetLocalUp() : t->GetLocalForward();
+		checksum -= axis.x;
+	}
+	double cachedBasisTime = MillisecondsSince(start);
+
+	// Relative moves
+	start = Clock::now();
+	for (int i = 0; i < callCount; i++)
+	{
+		int t = i % TransformCount;
+		XMFLOAT3 move = rotate(angles[t], 0.0f, 0.0f, 0.001f);
+		positions[t].x += move.x;
+		positions[t].y += move.y;
+		positions[t].z += move.z;
+	}
+	double eulerMoveTime = MillisecondsSince(start);
+
+	start = Clock::now();
+	for (int i = 0; i < callCount; i++)
+		transforms[i % TransformCount]->MoveRelative(0.0f, 0.0f, 0.001f);
+	double cachedMoveTime = MillisecondsSince(start);
+
+	printf("  Basis:         Euler %6.1f ns/call  cached %6.1f ns/call  (%4.1fx)\n",
+		eulerBasisTime * 1e6 / callCount, cachedBasisTime * 1e6 / callCount, eulerBasisTime / cachedBasisTime);
+	printf("  MoveRelative:  Euler %6.1f ns/call  stored %6.1f ns/call  (%4.1fx)\n",
+		eulerMoveTime * 1e6 / callCount, cachedMoveTime * 1e6 / callCount, eulerMoveTime / cachedMoveTime);
+	checksum += positions[0].x;
+	if (checksum == 12345.0f)
+		printf(" ");
+
+	for (Transform* t : transforms)
+		delete t;
+}
+
+void Benchmarks::RunTransformVersionBenchmark(int objectCount, int frameCount)
+{
+	printf("--- Transform versions: %d objects, %d frames ---\n", objectCount, frameCount);
+
+	// One object in a hundred moves every frame, and carries four
+	// children that never move themselves
+	const int ChildrenPerMover = 4;
+	int moverCount = std::max(1, objectCount / 100);
+	TransformSystem system(objectCount);
+	std::vector<Transform*> transforms(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		transforms[i] = new Transform(&system);
+		transforms[i]->SetPosition((float)(i % 100), 0.0f, (float)(i / 100));
+	}
+	for (int m = 0; m < moverCount; m++)
+	{
+		for (int c = 0; c < ChildrenPerMover; c++)
+		{
+			int child = moverCount + m * ChildrenPerMover + c;
+			if (child < objectCount)
+				transforms[child]->SetParent(transforms[m]);
+		}
+	}
+	system.Update();
+
+	// Stand-ins for each object's constant buffer and world bounds
+	AABB box = { XMFLOAT3(-1, -1, -1), XMFLOAT3(1, 1, 1) };
+	std::vector<VertexShaderPerObjectData> alwaysUploads(objectCount), versionedUploads(objectCount);
+	std::vector<AABB> alwaysBounds(objectCount), versionedBounds(objectCount);
+	std::vector<unsigned int> seenVersions(objectCount, 0);
+	double alwaysTime = 0.0;
+	double versionedTime = 0.0;
+	long long uploads = 0;
+	for (int f = 0; f < frameCount; f++)
+	{
+		for (int m = 0; m < moverCount; m++)
+			transforms[m]->Rotate(0.0f, 0.01f, 0.0f);
+		system.Update();
+
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < objectCount; i++)
+		{
+			alwaysUploads[i].worldMatrix = transforms[i]->GetWorldMatrix();
+			alwaysBounds[i] = Bounds::TransformAABB(box, alwaysUploads[i].worldMatrix);
+		}
+		alwaysTime += MillisecondsSince(start);
+
+		start = Clock::now();
+		for (int i = 0; i < objectCount; i++)
+		{
+			unsigned int version = transforms[i]->GetVersion();
+			if (version == seenVersions[i])
+				continue;
+			versionedUploads[i].worldMatrix = transforms[i]->GetWorldMatrix();
+			versionedBounds[i] = Bounds::TransformAABB(box, versionedUploads[i].worldMatrix);
+			seenVersions[i] = version;
+			uploads++;
+		}
+		versionedTime += MillisecondsSince(start);
+	}
+
+	// The first frame uploads everything, so it's left out of the ratio
+	long long steadyUploads = uploads - objectCount;
+	long long steadyTotal = (long long)objectCount * (frameCount - 1);
+	printf("  Every frame:   %6.3f ms/frame\n", alwaysTime / frameCount);
+	printf("  Versioned:     %6.3f ms/frame  (%4.1fx)\n", versionedTime / frameCount, alwaysTime / versionedTime);
+	printf("  Uploads skipped after the first frame: %.1f%% (%lld of %lld)\n",
+		steadyTotal > 0 ? 100.0 * (steadyTotal - steadyUploads) / steadyTotal : 0.0,
+		steadyTotal - steadyUploads, steadyTotal);
+
+	for (Transform* t : transforms)
+		delete t;
+}
+
+void Benchmarks::RunObjectMatricesBenchmark(int objectCount)
+{
+	printf("--- Object matrices: %d objects ---\n", objectCount);
+
+	// Random placements, a quarter of them parented to an earlier one,
+	// with every 16th mirrored on one axis and the last one flattened
+	TransformSystem system(objectCount);
+	std::vector<Transform*> transforms(objectCount);
+	std::mt19937 rng(777);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(0.2f, 5.0f);
+	for (int i = 0; i < objectCount; i++)
+	{
+		transforms[i] = new Transform(&system);
+		transforms[i]->SetPosition(position(rng), position(rng), position(rng));
+		transforms[i]->SetRotation(angle(rng), angle(rng), angle(rng));
+		transforms[i]->SetScale(scale(rng) * (i % 16 == 5 ? -1.0f : 1.0f), scale(rng), scale(rng));
+		if (i > 0 && i % 4 == 0)
+			transforms[i]->SetParent(transforms[std::uniform_int_distribution<int>(0, i - 1)(rng)]);
+	}
+	transforms[objectCount - 1]->SetScale(1.0f, 0.0f, 1.0f);
+	system.Update();
+
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(
+		XMMatrixLookToLH(XMVectorSet(0, 10, -100, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f)));
+
+	// Shuffled handles, in a count that isn't a multiple of four
+	std::vector<int> handles(objectCount);
+	for (int i = 0; i < objectCount; i++)
+		handles[i] = transforms[i]->GetHandle();
+	std::shuffle(handles.begin(), handles.end(), rng);
+	std::swap(*std::find(handles.begin(), handles.end(), transforms[objectCount - 1]->GetHandle()), handles.front());
+	int count = objectCount % 4 != 0 ? objectCount : objectCount - 1;
+
+	const int Iterations = 5;
+	std::vector<VertexShaderPerObjectData> batched(count), reference(count);
+	Clock::time_point start = Clock::now();
+	for (int it = 0; it < Iterations; it++)
+		system.ComputeObjectMatrices(handles.data(), count, viewProj, batched.data());
+	double batchTime = MillisecondsSince(start) / Iterations;
+
+	XMMATRIX viewProjMatrix = XMLoadFloat4x4(&viewProj);
+	start = Clock::now();
+	for (int it = 0; it < Iterations; it++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&system.GetWorldMatrix(handles[i]));
+			XMStoreFloat4x4(&reference[i].worldMatrix, world);
+			XMStoreFloat4x4(&reference[i].worldViewProjMatrix, XMMatrixMultiply(world, viewProjMatrix));
+			XMMATRIX normal = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+			normal.r[0] = XMVectorSetW(normal.r[0], 0.0f);
+			normal.r[1] = XMVectorSetW(normal.r[1], 0.0f);
+			normal.r[2] = XMVectorSetW(normal.r[2], 0.0f);
+			normal.r[3] = XMVectorSet(0, 0, 0, 1);
+			XMStoreFloat4x4(&reference[i].normalMatrix, normal);
+		}
+	}
+	double referenceTime = MillisecondsSince(start) / Iterations;
+
+	printf("  Batched:     %6.2f ms  (%5.1f ns/object)\n", batchTime, batchTime * 1e6 / count);
+	printf("  Per object:  %6.2f ms  (%5.1f ns/object, %4.1fx slower)\n", referenceTime, referenceTime * 1e6 / count, referenceTime / batchTime);
+
+	for (Transform* t : transforms)
+		delete t;
+}
+
+namespace
+{
+	// The members Game's entities used to have, each one new'd on its own
+	struct LegacyEntity
+	{
+		Transform transform;
+		Mesh* mesh;
+		Material* material;
+		std::vector<Material*> submeshMaterials;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> perObjectBuffer;
+		unsigned int uploadedVersion;
+		unsigned int uploadedCameraVersion;
+		AABB worldBounds;
+		Sphere worldSphere;
+		unsigned int boundsVersion;
+		bool boundsValid;
+
+		LegacyEntity(TransformSystem* system) : transform(system) {}
+	};
+
+	// Fastest of a few runs, in nanoseconds per entity
+	template<typename Fn>
+	double NanosecondsPerEntity(int entityCount, Fn fn)
+	{
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			Clock::time_point start = Clock::now();
+			fn();
+			best = std::min(best, MillisecondsSince(start));
+		}
+		return best * 1e6 / entityCount;
+	}
+}
+
+void Benchmarks::RunEntityWorldBenchmark()
+{
+	printf("--- Entity world ---\n");
+
+	// Iteration cost, with the same per-entity work in both layouts
+	int counts[] = { 10000, 100000, 1000000 };
+	for (int entityCount : counts)
+	{
+		printf("  %d entities:\n", entityCount);
+		std::mt19937 rng(4242);
+		std::uniform_int_distribution<int> junkSize(16, 512);
+
+		// The old layout, allocated between other allocations the way
+		// a level's entities end up interleaved with everything else
+		TransformSystem legacySystem(entityCount);
+		std::vector<LegacyEntity*> legacy(entityCount);
+		std::vector<char*> junk(entityCount);
+		for (int i = 0; i < entityCount; i++)
+		{
+			junk[i] = new char[junkSize(rng)];
+			legacy[i] = new LegacyEntity(&legacySystem);
+			legacy[i]->transform.SetPosition((float)(i % 1000), 0.0f, (float)(i / 1000));
+			legacy[i]->uploadedVersion = 0;
+			legacy[i]->uploadedCameraVersion = 0;
+		}
+		std::shuffle(junk.begin(), junk.end(), rng);
+		for (int i = 0; i < entityCount / 2; i++)
+		{
+			delete[] junk[i];
+			junk[i] = nullptr;
+		}
+
+		TransformSystem ecsSystem(entityCount);
+		EntityWorld world;
+		for (int i = 0; i < entityCount; i++)
+		{
+			Transform transform(&ecsSystem);
+			transform.SetPosition((float)(i % 1000), 0.0f, (float)(i / 1000));
+			world.Create(std::move(transform), MeshRenderer{}, ObjectConstants{ nullptr, 0, 0 }, WorldBounds{});
+		}
+
+		// The update loop from Game::Update
+		double legacyUpdate = NanosecondsPerEntity(entityCount, [&]()
+		{
+			for (LegacyEntity* e : legacy)
+			{
+				e->transform.MoveAbsolute(0.00001f, 0.00001f, 0);
+				e->transform.Rotate(0.0f, 0.0f, 0.016f);
+			}
+		});
+		double ecsUpdate = NanosecondsPerEntity(entityCount, [&]()
+		{
+			world.ForEach<Transform>([](EntityId id, Transform& transform)
+			{
+				transform.MoveAbsolute(0.00001f, 0.00001f, 0);
+				transform.Rotate(0.0f, 0.0f, 0.016f);
+			});
+		});
+
+		// The stale-constants scan before drawing, which finds everything
+		// stale since the versions were bumped above
+		std::vector<int> legacyStale, ecsStale;
+		legacyStale.reserve(entityCount);
+		ecsStale.reserve(entityCount);
+		unsigned int cameraVersion = 1;
+		double legacyScan = NanosecondsPerEntity(entityCount, [&]()
+		{
+			legacyStale.clear();
+			for (LegacyEntity* e : legacy)
+			{
+				if (e->perObjectBuffer.Get() == nullptr
+					|| e->uploadedVersion != e->transform.GetVersion()
+					|| e->uploadedCameraVersion != cameraVersion)
+					legacyStale.push_back(e->transform.GetHandle());
+			}
+		});
+		double ecsScan = NanosecondsPerEntity(entityCount, [&]()
+		{
+			ecsStale.clear();
+			world.ForEachChunk<Transform, ObjectConstants>(
+				[&](int count, const EntityId* ids, Transform* transforms, ObjectConstants* constants)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					if (constants[i].buffer.Get() == nullptr
+						|| constants[i].transformVersion != transforms[i].GetVersion()
+						|| constants[i].cameraVersion != cameraVersion)
+						ecsStale.push_back(transforms[i].GetHandle());
+				}
+			});
+		});
+
+		printf("    Update:       old %6.2f ns/entity, ECS %6.2f ns/entity  (%4.1fx)\n", legacyUpdate, ecsUpdate, legacyUpdate / ecsUpdate);
+		printf("    Render prep:  old %6.2f ns/entity, ECS %6.2f ns/entity  (%4.1fx), %d and %d stale\n",
+			legacyScan, ecsScan, legacyScan / ecsScan, (int)legacyStale.size(), (int)ecsStale.size());
+
+		for (LegacyEntity* e : legacy)
+			delete e;
+		for (char* j : junk)
+			delete[] j;
+	}
+}
+
+void Benchmarks::RunRenderQueueBenchmark(int drawCount)
+{
+	printf("--- Render queue: %d draws ---\n", drawCount);
+	std::mt19937 rng(2020);
+
+	// The sort itself, against the standard library, with plenty of ties
+	std::vector<uint64_t> keys(drawCount), keyScratch(drawCount);
+	std::vector<uint32_t> order(drawCount), orderScratch(drawCount);
+	std::uniform_int_distribution<uint64_t> anyKey(0, 4095);
+	for (int i = 0; i < drawCount; i++)
+		keys[i] = anyKey(rng) << 52 | anyKey(rng) << 20 | (uint64_t)(i % 7);
+	std::vector<uint64_t> original = keys;
+	std::vector<uint32_t> expected(drawCount);
+	for (int i = 0; i < drawCount; i++)
+		expected[i] = (uint32_t)i;
+
+	Clock::time_point start = Clock::now();
+	std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return original[a] < original[b]; });
+	double stdTime = MillisecondsSince(start);
+
+	start = Clock::now();
+	RenderQueue::RadixSort(keys.data(), order.data(), keyScratch.data(), orderScratch.data(), drawCount);
+	double radixTime = MillisecondsSince(start);
+
+	printf("  Radix sort:   %7.3f ms, std::stable_sort %7.3f ms (%4.1fx)\n",
+		radixTime, stdTime, stdTime / radixTime);
+
+	// A scene's worth of state - shaders and textures are never touched
+	// without a device, so stand-in pointers will do
+	const int ShaderCount = 4, MaterialsPerShader = 16, MeshCount = 32;
+	char shaderStandIns[ShaderCount * 2];
+	std::vector<Material*> materials;
+	for (int s = 0; s < ShaderCount; s++)
+	{
+		for (int m = 0; m < MaterialsPerShader; m++)
+		{
+			materials.push_back(new Material(
+				XMFLOAT4(1, 1, 1, 1), 0.5f,
+				(SimplePixelShader*)&shaderStandIns[s * 2 + 1],
+				(SimpleVertexShader*)&shaderStandIns[s * 2],
+				nullptr, nullptr, nullptr, nullptr, nullptr));
+		}
+	}
+	std::vector<Mesh*> meshes;
+	for (int m = 0; m < MeshCount; m++)
+		meshes.push_back(new Mesh());
+
+	// Every draw its own object, in random order, one in ten transparent
+	std::vector<ID3D11Buffer*> objectBuffers(drawCount);
+	for (int i = 0; i < drawCount; i++)
+		objectBuffers[i] = (ID3D11Buffer*)(uintptr_t)(i + 1);
+	std::uniform_int_distribution<int> anyMaterial(0, (int)materials.size() - 1);
+	std::uniform_int_distribution<int> anyMesh(0, MeshCount - 1);
+	std::uniform_real_distribution<float> anyDepth(0.1f, 500.0f);
+	struct QueuedDraw { RenderPass pass; int material; int mesh; float depth; };
+	std::vector<QueuedDraw> draws(drawCount);
+	for (QueuedDraw& draw : draws)
+		draw = { rng() % 10 == 0 ? TransparentPass : OpaquePass, anyMaterial(rng), anyMesh(rng), anyDepth(rng) };
+
+	RenderQueue queue;
+	double addTime = 1e30, sortTime = 1e30;
+	RenderQueueStats unsorted = {};
+	for (int run = 0; run < 5; run++)
+	{
+		start = Clock::now();
+		queue.Clear();
+		for (int i = 0; i < drawCount; i++)
+			queue.Add(draws[i].pass, meshes[draws[i].mesh], materials[draws[i].material], objectBuffers[i], 36, 0, draws[i].depth);
+		addTime = std::min(addTime, MillisecondsSince(start));
+		unsorted = RenderQueue::CountStateChanges(queue.GetPackets().data(), drawCount, true);
+
+		start = Clock::now();
+		queue.Sort();
+		sortTime = std::min(sortTime, MillisecondsSince(start));
+	}
+
+	const std::vector<DrawPacket>& packets = queue.GetPackets();
+	RenderQueueStats before = RenderQueue::CountStateChanges(packets.data(), drawCount, false);
+	RenderQueueStats after = RenderQueue::CountStateChanges(packets.data(), drawCount, true);
+	printf("  Add:          %7.3f ms (%5.1f ns/draw)\n", addTime, addTime * 1e6 / drawCount);
+	printf("  Sort:         %7.3f ms (%5.1f ns/draw)\n", sortTime, sortTime * 1e6 / drawCount);
+	printf("  State changes           shaders  materials   geometry  constants      total\n");
+	auto printStats = [](const char* label, const RenderQueueStats& stats)
+	{
+		printf("    %-20s %7d %10d %10d %10d %10d\n", label,
+			stats.shaderChanges, stats.materialChanges, stats.geometryChanges, stats.constantBufferChanges, stats.GetTotal());
+	};
+	printStats("Every draw:", before);
+	printStats("Unsorted, filtered:", unsorted);
+	printStats("Sorted, filtered:", after);
+
+	for (Material* m : materials)
+		delete m;
+	for (Mesh* m : meshes)
+		delete m;
+}
+
+void Benchmarks::RunInstancingBenchmark(int entityCount)
+{
+	printf("--- Instancing: %d entities ---\n", entityCount);
+
+	// Stand-in shaders and meshes, since nothing is submitted
+	const int MeshCount = 8, MaterialCount = 6, LodCount = 3;
+	char shaderStandIns[3];
+	std::vector<Material*> materials;
+	for (int m = 0; m < MaterialCount; m++)
+	{
+		materials.push_back(new Material(
+			XMFLOAT4(1.0f, 0.5f + m * 0.1f, 1.0f, 1.0f), 0.5f,
+			(SimplePixelShader*)&shaderStandIns[0],
+			(SimpleVertexShader*)&shaderStandIns[1],
+			nullptr, nullptr, nullptr, nullptr, nullptr));
+		materials.back()->SetInstancedVertexShader((SimpleVertexShader*)&shaderStandIns[2]);
+	}
+	std::vector<Mesh*> meshes;
+	for (int m = 0; m < MeshCount; m++)
+		meshes.push_back(new Mesh());
+
+	// Objects scattered around, each with a mesh, material and LOD
+	struct Object { int mesh; int material; unsigned int indexCount; float depth; int handle; };
+	TransformSystem system(entityCount);
+	std::vector<Transform*> transforms(entityCount);
+	std::vector<Object> objects(entityCount);
+	std::mt19937 rng(2121);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	for (int i = 0; i < entityCount; i++)
+	{
+		transforms[i] = new Transform(&system);
+		transforms[i]->SetPosition(position(rng), position(rng), position(rng));
+		transforms[i]->SetRotation(0.0f, position(rng), 0.0f);
+		objects[i] = { (int)(rng() % MeshCount), (int)(rng() % MaterialCount), 36u << (rng() % LodCount), position(rng) + 100.0f, transforms[i]->GetHandle() };
+	}
+	system.Update();
+
+	// Per object: its own constants and its own draw, as before
+	std::vector<int> handles(entityCount);
+	for (int i = 0; i < entityCount; i++)
+		handles[i] = objects[i].handle;
+	std::vector<VertexShaderPerObjectData> objectMatrices(entityCount);
+	std::vector<ID3D11Buffer*> objectBuffers(entityCount);
+	for (int i = 0; i < entityCount; i++)
+		objectBuffers[i] = (ID3D11Buffer*)(uintptr_t)(i + 1);
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 500.0f));
+
+	RenderQueue queue;
+	double perObjectTime = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		Clock::time_point start = Clock::now();
+		system.ComputeObjectMatrices(handles.data(), entityCount, viewProjection, objectMatrices.data());
+		queue.Clear();
+		for (int i = 0; i < entityCount; i++)
+		{
+			const Object& o = objects[i];
+			queue.Add(OpaquePass, meshes[o.mesh], materials[o.material], objectBuffers[i], o.indexCount, 0, o.depth);
+		}
+		queue.Sort();
+		perObjectTime = std::min(perObjectTime, MillisecondsSince(start));
+	}
+	RenderQueueStats perObjectStats = RenderQueue::CountStateChanges(queue.GetPackets().data(), (int)queue.GetPackets().size(), true);
+
+	// Grouped and packed into one instance buffer's worth of data
+	InstanceBatcher batcher;
+	double instancedTime = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		Clock::time_point start = Clock::now();
+		batcher.Clear();
+		for (int i = 0; i < entityCount; i++)
+		{
+			const Object& o = objects[i];
+			batcher.Add(meshes[o.mesh], materials[o.material], o.indexCount, 0, &system.GetWorldMatrix(o.handle), o.depth);
+		}
+		batcher.Build();
+
+		queue.Clear();
+		for (const InstanceGroup& group : batcher.GetGroups())
+		{
+			queue.AddInstanced(OpaquePass, group.mesh, group.material, group.indexCount, group.firstIndex,
+				group.firstInstance, group.instanceCount, group.depth);
+		}
+		queue.Sort();
+		instancedTime = std::min(instancedTime, MillisecondsSince(start));
+	}
+	RenderQueueStats instancedStats = RenderQueue::CountStateChanges(queue.GetPackets().data(), (int)queue.GetPackets().size(), true);
+
+	printf("  Per object:  %7.3f ms (%5.1f ns/entity), %6d draws, %6d state changes, %7.2f MB of constants\n",
+		perObjectTime, perObjectTime * 1e6 / entityCount, perObjectStats.draws, perObjectStats.GetTotal(),
+		entityCount * sizeof(VertexShaderPerObjectData) / (1024.0 * 1024.0));
+	printf("  Instanced:   %7.3f ms (%5.1f ns/entity), %6d draws, %6d state changes, %7.2f MB of instances\n",
+		instancedTime, instancedTime * 1e6 / entityCount, instancedStats.draws, instancedStats.GetTotal(),
+		entityCount * sizeof(InstanceData) / (1024.0 * 1024.0));
+
+	for (Transform* t : transforms)
+		delete t;
+	for (Material* m : materials)
+		delete m;
+	for (Mesh* m : meshes)
+		delete m;
+}
+
+void Benchmarks::RunFrustumCullingBenchmark(int objectCount)
+{
+	printf("--- Frustum culling: %d objects ---\n", objectCount);
+
+	// Boxes of all sizes scattered around a camera at the origin
+	std::mt19937 rng(2222);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.1f, 10.0f);
+	std::vector<AABB> boxes(objectCount);
+	for (AABB& box : boxes)
+	{
+		XMFLOAT3 center(position(rng), position(rng), position(rng));
+		XMFLOAT3 half(size(rng), size(rng), size(rng));
+		box.min = XMFLOAT3(center.x - half.x, center.y - half.y, center.z - half.z);
+		box.max = XMFLOAT3(center.x + half.x, center.y + half.y, center.z + half.z);
+	}
+	Camera camera(0.0f, 0.0f, 0.0f, 0.0f, 0.3f, 0.0f, XM_PIDIV4, 1.0f, 1.0f, 16.0f / 9.0f, 0.1f, 400.0f);
+	XMFLOAT4 planes[6];
+	camera.GetFrustumPlanes(planes);
+
+	// Box at a time: the corner furthest along each plane's normal has
+	// to be behind it
+	auto cullReference = [&](const AABB& box)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			float x = planes[p].x >= 0.0f ? box.max.x : box.min.x;
+			float y = planes[p].y >= 0.0f ? box.max.y : box.min.y;
+			float z = planes[p].z >= 0.0f ? box.max.z : box.min.z;
+			if (planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w < 0.0f)
+				return false;
+		}
+		return true;
+	};
+
+	double referenceTime = 1e30;
+	int expectedVisible = 0;
+	for (int run = 0; run < 3; run++)
+	{
+		Clock::time_point start = Clock::now();
+		expectedVisible = 0;
+		for (int i = 0; i < objectCount; i++)
+			expectedVisible += cullReference(boxes[i]);
+		referenceTime = std::min(referenceTime, MillisecondsSince(start));
+	}
+
+	// Refilled every frame in practice, so into arrays already allocated
+	FrustumCuller culler;
+	culler.Reserve(objectCount);
+	double fillTime = 1e30;
+	for (int run = 0; run < 3; run++)
+	{
+		Clock::time_point start = Clock::now();
+		culler.Clear();
+		for (const AABB& box : boxes)
+			culler.Add(box);
+		fillTime = std::min(fillTime, MillisecondsSince(start));
+	}
+
+	// One thread, then all of them (if there's more than one)
+	int threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	int threadCounts[2] = { 1, threadCount };
+	int splitCount = threadCount > 1 ? 2 : 1;
+	double simdTimes[2] = { 1e30, 1e30 };
+	std::vector<unsigned char> visible(objectCount);
+	for (int t = 0; t < splitCount; t++)
+	{
+		for (int run = 0; run < 5; run++)
+		{
+			Clock::time_point start = Clock::now();
+			culler.Cull(planes, visible.data(), threadCounts[t]);
+			simdTimes[t] = std::min(simdTimes[t], MillisecondsSince(start));
+		}
+	}
+
+	printf("  %d visible, %d culled (%.1f%% culled)\n",
+		expectedVisible, objectCount - expectedVisible, 100.0f * (objectCount - expectedVisible) / objectCount);
+	printf("  Box at a time:       %8.3f ms (%5.2f ns/object)\n", referenceTime, referenceTime * 1e6 / objectCount);
+	printf("  Filling SoA blocks:  %8.3f ms (%5.2f ns/object)\n", fillTime, fillTime * 1e6 / objectCount);
+	for (int t = 0; t < splitCount; t++)
+	{
+		printf("  SIMD, %2d thread%s:    %8.3f ms (%5.2f ns/object, %4.1fx)\n",
+			threadCounts[t], threadCounts[t] == 1 ? " " : "s", simdTimes[t], simdTimes[t] * 1e6 / objectCount,
+			referenceTime / simdTimes[t]);
+	}
+}
+
+void Benchmarks::RunAABBTreeBenchmark(int objectCount)
+{
+	printf("--- AABB tree: %d objects ---\n", objectCount);
+
+	// Small boxes spread through a big space, like a scene's props
+	std::mt19937 rng(2323);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	std::vector<AABB> boxes(objectCount);
+	std::vector<int> userData(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		XMFLOAT3 center(position(rng), position(rng), position(rng));
+		XMFLOAT3 half(size(rng), size(rng), size(rng));
+		boxes[i].min = XMFLOAT3(center.x - half.x, center.y - half.y, center.z - half.z);
+		boxes[i].max = XMFLOAT3(center.x + half.x, center.y + half.y, center.z + half.z);
+		userData[i] = i;
+	}
+
+	// One at a time
+	AABBTree tree;
+	std::vector<int> proxies(objectCount);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < objectCount; i++)
+		proxies[i] = tree.Insert(boxes[i], userData[i]);
+	double insertTime = MillisecondsSince(start);
+	printf("  Insert:          %8.2f ms (%6.1f ns/object), height %2d, SAH cost %7.1f\n",
+		insertTime, insertTime * 1e6 / objectCount, tree.GetHeight(), tree.GetAreaRatio());
+
+	// Every object drifting a little (mostly staying in its fat box),
+	// then a tenth of them jumping somewhere else entirely
+	auto moveBox = [](AABB& box, float x, float y, float z)
+	{
+		box.min = XMFLOAT3(box.min.x + x, box.min.y + y, box.min.z + z);
+		box.max = XMFLOAT3(box.max.x + x, box.max.y + y, box.max.z + z);
+	};
+	std::uniform_real_distribution<float> drift(-0.03f, 0.03f);
+	int reinserted = 0;
+	start = Clock::now();
+	for (int i = 0; i < objectCount; i++)
+	{
+		moveBox(boxes[i], drift(rng), drift(rng), drift(rng));
+		reinserted += tree.Move(proxies[i], boxes[i]);
+	}
+	double driftTime = MillisecondsSince(start);
+
+	int jumpCount = std::max(1, objectCount / 10);
+	int jumped = 0;
+	start = Clock::now();
+	for (int i = 0; i < jumpCount; i++)
+	{
+		int index = (int)(rng() % objectCount);
+		moveBox(boxes[index], position(rng) * 0.1f, position(rng) * 0.1f, position(rng) * 0.1f);
+		jumped += tree.Move(proxies[index], boxes[index]);
+	}
+	double jumpTime = MillisecondsSince(start);
+	printf("  Small moves:     %8.2f ms (%6.1f ns/object), %d of %d reinserted\n",
+		driftTime, driftTime * 1e6 / objectCount, reinserted, objectCount);
+	printf("  Big moves:       %8.2f ms (%6.1f ns/object), %d of %d reinserted, height %2d, SAH cost %7.1f\n",
+		jumpTime, jumpTime * 1e6 / jumpCount, jumped, jumpCount, tree.GetHeight(), tree.GetAreaRatio());
+
+	// All at once, from where everything ended up
+	AABBTree built;
+	std::vector<int> builtProxies(objectCount);
+	start = Clock::now();
+	built.Build(boxes.data(), userData.data(), objectCount, builtProxies.data());
+	double buildTime = MillisecondsSince(start);
+	printf("  Build:           %8.2f ms (%6.1f ns/object), height %2d, SAH cost %7.1f\n",
+		buildTime, buildTime * 1e6 / objectCount, built.GetHeight(), built.GetAreaRatio());
+
+	// Queries in a few shapes, from random places
+	const int QueryCount = 1000;
+	XMFLOAT4 planes[6];
+	XMFLOAT3 rayOrigin, rayDirection;
+	float rayLength = 300.0f;
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+	const AABBTree* trees[2] = { &tree, &built };
+	const char* treeNames[2] = { "inserted", "built" };
+	for (int t = 0; t < 2; t++)
+	{
+		const AABBTree& queried = *trees[t];
+		long long results[5] = {};
+		double times[5] = {};
+
+		for (int q = 0; q < QueryCount; q++)
+		{
+			// A camera somewhere, looking any which way
+			Camera camera(position(rng) * 0.5f, position(rng) * 0.5f, position(rng) * 0.5f,
+				0.0f, unit(rng), angle(rng), XM_PIDIV4, 1.0f, 1.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+			camera.GetFrustumPlanes(planes);
+			int found = 0;
+			start = Clock::now();
+			queried.QueryFrustum(planes, [&](int proxy) { found++; return true; });
+			times[0] += MillisecondsSince(start);
+			results[0] += found;
+
+			// Boxes and spheres a few units across
+			XMFLOAT3 c(position(rng), position(rng), position(rng));
+			AABB region = { XMFLOAT3(c.x - 10, c.y - 10, c.z - 10), XMFLOAT3(c.x + 10, c.y + 10, c.z + 10) };
+			found = 0;
+			start = Clock::now();
+			queried.QueryAABB(region, [&](int proxy) { found++; return true; });
+			times[1] += MillisecondsSince(start);
+			results[1] += found;
+
+			Sphere sphere = { c, 10.0f };
+			found = 0;
+			start = Clock::now();
+			queried.QuerySphere(sphere, [&](int proxy) { found++; return true; });
+			times[2] += MillisecondsSince(start);
+			results[2] += found;
+
+			// Rays: everything they pass through, then just the nearest
+			rayOrigin = XMFLOAT3(position(rng), position(rng), position(rng));
+			XMStoreFloat3(&rayDirection, XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f)));
+			found = 0;
+			start = Clock::now();
+			queried.RayCast(rayOrigin, rayDirection, rayLength, [&](int proxy, float distance) { found++; return rayLength; });
+			times[3] += MillisecondsSince(start);
+			results[3] += found;
+
+			float nearest = INFINITY;
+			start = Clock::now();
+			queried.RayCast(rayOrigin, rayDirection, rayLength, [&](int proxy, float distance)
+			{
+				nearest = fminf(nearest, distance);
+				return nearest;
+			});
+			times[4] += MillisecondsSince(start);
+			results[4] += nearest <= rayLength;
+		}
+
+		const char* queryNames[5] = { "frustum", "20-unit box", "10-unit sphere", "ray (all hits)", "ray (nearest)" };
+		printf("  Queries on the %s tree, %d of each\n", treeNames[t], QueryCount);
+		for (int k = 0; k < 5; k++)
+		{
+			printf("    %-16s %8.2f us/query, %9.1f results/query\n",
+				queryNames[k], times[k] * 1000.0 / QueryCount, (double)results[k] / QueryCount);
+		}
+	}
+
+	// Rebuilding the inserted tree in place
+	float insertedCost = tree.GetAreaRatio();
+	start = Clock::now();
+	tree.Rebuild();
+	double rebuildTime = MillisecondsSince(start);
+	printf("  Rebuild:         %8.2f ms (%6.1f ns/object), height %2d, SAH cost %7.1f (from %.1f)\n",
+		rebuildTime, rebuildTime * 1e6 / objectCount, tree.GetHeight(), tree.GetAreaRatio(), insertedCost);
+}
+
+void Benchmarks::RunOcclusionCullingBenchmark(int objectCount)
+{
+	printf("--- Occlusion culling: %d objects ---\n", objectCount);
+
+	// Box triangles facing outwards (clockwise seen from outside, like
+	// everything D3D draws by default)
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	auto addBox = [&](const XMFLOAT3& center, const XMFLOAT3& half)
+	{
+		unsigned int base = (unsigned int)positions.size();
+		for (int corner = 0; corner < 8; corner++)
+		{
+			positions.push_back(XMFLOAT3(
+				center.x + ((corner & 1) ? half.x : -half.x),
+				center.y + ((corner & 2) ? half.y : -half.y),
+				center.z + ((corner & 4) ? half.z : -half.z)));
+		}
+		const int faces[6][4] = { { 0, 2, 6, 4 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 5, 7, 6 } };
+		for (int f = 0; f < 6; f++)
+		{
+			XMVECTOR faceCenter = XMVectorZero();
+			for (int k = 0; k < 4; k++)
+				faceCenter = XMVectorAdd(faceCenter, XMLoadFloat3(&positions[base + faces[f][k]]));
+			XMVECTOR outward = XMVectorSubtract(XMVectorScale(faceCenter, 0.25f), XMLoadFloat3(&center));
+			for (int t = 0; t < 2; t++)
+			{
+				unsigned int a = base + faces[f][0], b = base + faces[f][t + 1], c = base + faces[f][t + 2];
+				XMVECTOR pa = XMLoadFloat3(&positions[a]);
+				XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&positions[b]), pa), XMVectorSubtract(XMLoadFloat3(&positions[c]), pa));
+				if (XMVectorGetX(XMVector3Dot(normal, outward)) < 0.0f)
+					std::swap(b, c);
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(c);
+			}
+		}
+	};
+
+	// Blocks of buildings down the view, with small objects scattered
+	// between and behind them
+	std::mt19937 rng(2424);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < 64; i++)
+	{
+		XMFLOAT3 half(2.0f + 8.0f * unit(rng), 3.0f + 12.0f * unit(rng), 2.0f + 8.0f * unit(rng));
+		addBox(XMFLOAT3(-120.0f + 240.0f * unit(rng), half.y - 10.0f, 20.0f + 180.0f * unit(rng)), half);
+	}
+	int occluderTriangles = (int)indices.size() / 3;
+	std::vector<AABB> boxes(objectCount);
+	for (AABB& box : boxes)
+	{
+		XMFLOAT3 center(-150.0f + 300.0f * unit(rng), -10.0f + 30.0f * unit(rng), 5.0f + 295.0f * unit(rng));
+		XMFLOAT3 half(0.1f + 0.9f * unit(rng), 0.1f + 0.9f * unit(rng), 0.1f + 0.9f * unit(rng));
+		box.min = XMFLOAT3(center.x - half.x, center.y - half.y, center.z - half.z);
+		box.max = XMFLOAT3(center.x + half.x, center.y + half.y, center.z + half.z);
+	}
+
+	OcclusionBuffer buffer(320, 192);
+	Camera camera(0.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, XM_PIDIV4, 1.0f, 1.0f,
+		(float)buffer.GetWidth() / buffer.GetHeight(), 0.1f, 400.0f);
+	XMFLOAT4X4 viewProjection = camera.GetViewProjectionMatrix();
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	// Only what's left after frustum culling is tested, as in RenderSystem
+	XMFLOAT4 planes[6];
+	camera.GetFrustumPlanes(planes);
+	FrustumCuller culler;
+	for (const AABB& box : boxes)
+		culler.Add(box);
+	std::vector<unsigned char> inFrustum(objectCount);
+	culler.Cull(planes, inFrustum.data());
+	std::vector<AABB> tested;
+	for (int i = 0; i < objectCount; i++)
+	{
+		if (inFrustum[i])
+			tested.push_back(boxes[i]);
+	}
+	int testCount = (int)tested.size();
+
+	// Setting up the occluders, then rasterizing them on one thread
+	// and on all of them
+	int threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	int threadCounts[2] = { 1, threadCount };
+	int splitCount = threadCount > 1 ? 2 : 1;
+	double setupTime = 1e30;
+	double rasterTimes[2] = { 1e30, 1e30 };
+	for (int t = 0; t < splitCount; t++)
+	{
+		for (int run = 0; run < 5; run++)
+		{
+			Clock::time_point start = Clock::now();
+			buffer.Begin(viewProjection);
+			buffer.AddOccluder(positions.data(), (int)positions.size(), indices.data(), (int)indices.size(), identity);
+			setupTime = std::min(setupTime, MillisecondsSince(start));
+			start = Clock::now();
+			buffer.Rasterize(threadCounts[t]);
+			rasterTimes[t] = std::min(rasterTimes[t], MillisecondsSince(start));
+		}
+	}
+
+	// Testing, the same way
+	double testTimes[2] = { 1e30, 1e30 };
+	int visibleCounts[2] = { 0, 0 };
+	std::vector<unsigned char> visible(testCount);
+	for (int t = 0; t < splitCount; t++)
+	{
+		for (int run = 0; run < 5; run++)
+		{
+			Clock::time_point start = Clock::now();
+			visibleCounts[t] = buffer.TestBoxes(tested.data(), testCount, visible.data(), threadCounts[t]);
+			testTimes[t] = std::min(testTimes[t], MillisecondsSince(start));
+		}
+	}
+
+	int occluded = testCount - visibleCounts[0];
+
+	printf("  %d in the frustum, %d occluded (%.1f%%) by %d triangles\n",
+		testCount, occluded, testCount > 0 ? 100.0f * occluded / testCount : 0.0f, occluderTriangles);
+	printf("  Triangle setup:      %8.3f ms\n", setupTime);
+	for (int t = 0; t < splitCount; t++)
+	{
+		printf("  Rasterize, %2d thread%s: %8.3f ms\n", threadCounts[t], threadCounts[t] == 1 ? " " : "s", rasterTimes[t]);
+	}
+	for (int t = 0; t < splitCount; t++)
+	{
+		printf("  Test, %2d thread%s:      %8.3f ms (%5.1f ns/object)\n",
+			threadCounts[t], threadCounts[t] == 1 ? " " : "s", testTimes[t], testCount > 0 ? testTimes[t] * 1e6 / testCount : 0.0);
+	}
+}
+
+void Benchmarks::RunJobSystemBenchmark(int elementCount)
+{
+	printf("--- Job system: %d elements ---\n", elementCount);
+
+	// Something worth splitting up - a few dozen flops per element
+	auto work = [](int i)
+	{
+		float x = (float)(i % 1000) * 0.001f;
+		for (int k = 0; k < 8; k++)
+			x = sqrtf(x * x + 1.0f) * 0.5f + sinf(x) * 0.25f;
+		return x;
+	};
+	std::vector<float> results(elementCount);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < elementCount; i++)
+		results[i] = work(i);
+	double serialTime = MillisecondsSince(start);
+
+	// One thread, then doubling up to one per core (and always at
+	// least four, so the splitting is exercised anywhere)
+	int hardwareThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+	std::vector<int> threadCounts;
+	for (int t = 1; t < std::max(4, hardwareThreads); t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(std::max(4, hardwareThreads));
+
+	const int TinyJobCount = 100000;
+	const int OuterCount = 64;
+	printf("  Serial loop:      %8.2f ms\n", serialTime);
+	double oneThreadTime = 0.0;
+	for (int threadCount : threadCounts)
+	{
+		JobSystem jobs(threadCount - 1);
+
+		// A flat ParallelFor over everything
+		double forTime = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			start = Clock::now();
+			jobs.ParallelFor(elementCount, 1024, [&](int begin, int end)
+			{
+				for (int i = begin; i < end; i++)
+					results[i] = work(i);
+			});
+			forTime = std::min(forTime, MillisecondsSince(start));
+		}
+		if (threadCount == 1)
+			oneThreadTime = forTime;
+
+		// Jobs that do nothing, to see what each one costs
+		std::atomic<int> ran(0);
+		JobCounter counter;
+		start = Clock::now();
+		for (int i = 0; i < TinyJobCount; i++)
+			jobs.Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		jobs.Wait(counter);
+		double tinyTime = MillisecondsSince(start);
+
+		// ParallelFor()s inside a ParallelFor(), each waiting on its own
+		std::atomic<long long> nestedSum(0);
+		start = Clock::now();
+		jobs.ParallelFor(OuterCount, 1, [&](int outerBegin, int outerEnd)
+		{
+			for (int o = outerBegin; o < outerEnd; o++)
+			{
+				int first = (int)((long long)elementCount * o / OuterCount);
+				int last = (int)((long long)elementCount * (o + 1) / OuterCount);
+				jobs.ParallelFor(last - first, 256, [&](int begin, int end)
+				{
+					long long sum = 0;
+					for (int i = first + begin; i < first + end; i++)
+						sum += (long long)(work(i) * 1000.0f);
+					nestedSum.fetch_add(sum, std::memory_order_relaxed);
+				});
+			}
+		});
+		double nestedTime = MillisecondsSince(start);
+
+		printf("  %2d thread%s: ParallelFor %8.2f ms (%4.2fx)  tiny jobs %6.1f ns/job  nested %8.2f ms\n",
+			threadCount, threadCount == 1 ? " " : "s", forTime, oneThreadTime / forTime,
+			tinyTime * 1e6 / TinyJobCount, nestedTime);
+	}
+
+	// The rest on more workers than cores, so threads get switched out
+	// at the worst moments
+	JobSystem jobs(std::max(4, hardwareThreads) + 2);
+
+	// Every job spawning two more, down to a depth of 15
+	const int SpawnDepth = 15;
+	std::atomic<int> spawned(0);
+	JobCounter spawnCounter;
+	std::function<void(int)> spawn = [&](int depth)
+	{
+		spawned.fetch_add(1, std::memory_order_relaxed);
+		if (depth == 0)
+			return;
+		jobs.Run([&spawn, depth]() { spawn(depth - 1); }, &spawnCounter);
+		jobs.Run([&spawn, depth]() { spawn(depth - 1); }, &spawnCounter);
+	};
+	start = Clock::now();
+	jobs.Run([&spawn]() { spawn(SpawnDepth); }, &spawnCounter);
+	jobs.Wait(spawnCounter);
+	double spawnTime = MillisecondsSince(start);
+	printf("  Jobs spawning jobs: %d in %.2f ms\n", spawned.load(), spawnTime);
+
+	// A chain of stages, each job in one only starting after every job
+	// in the one before has finished
+	const int StageCount = 500;
+	const int JobsPerStage = 8;
+	std::vector<std::unique_ptr<JobCounter>> stages;
+	std::vector<std::atomic<int>> finished(StageCount);
+	for (std::atomic<int>& f : finished)
+		f.store(0);
+	start = Clock::now();
+	for (int s = 0; s < StageCount; s++)
+	{
+		stages.emplace_back(new JobCounter());
+		JobCounter* after = s > 0 ? stages[s - 1].get() : nullptr;
+		for (int j = 0; j < JobsPerStage; j++)
+		{
+			jobs.Run([&finished, s]()
+			{
+				finished[s].fetch_add(1);
+			}, stages[s].get(), after);
+		}
+	}
+	jobs.Wait(*stages.back());
+	double chainTime = MillisecondsSince(start);
+	printf("  %d dependent stages of %d jobs in %.2f ms\n", StageCount, JobsPerStage, chainTime);
+
+	// Outside threads all queueing (and waiting) at once, alongside
+	// a ParallelFor from this one
+	const int ProducerCount = 4;
+	const int JobsPerProducer = 20000;
+	std::atomic<int> produced(0);
+	std::vector<std::thread> producers;
+	start = Clock::now();
+	for (int p = 0; p < ProducerCount; p++)
+	{
+		producers.emplace_back([&]()
+		{
+			JobCounter counter;
+			for (int i = 0; i < JobsPerProducer; i++)
+				jobs.Run([&produced]() { produced.fetch_add(1, std::memory_order_relaxed); }, &counter);
+			jobs.Wait(counter);
+		});
+	}
+	std::atomic<int> covered(0);
+	jobs.ParallelFor(elementCount, 64, [&](int begin, int end) { covered.fetch_add(end - begin); });
+	for (std::thread& t : producers)
+		t.join();
+	double producerTime = MillisecondsSince(start);
+	printf("  %d outside threads x %d jobs, plus a ParallelFor, in %.2f ms\n",
+		ProducerCount, JobsPerProducer, producerTime);
+}
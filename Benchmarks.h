@@ -0,0 +1,124 @@
+#pragma once
+
+#include <d3d11.h>
+#include <string>
+#include <vector>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// Timing runs for the engine's CPU-side systems
+//
+// - Results go to the console via printf()
+// - Game::Init() runs these when RUN_BENCHMARKS is defined
+//   (add it to the project's preprocessor definitions)
+// --------------------------------------------------------
+class Benchmarks
+{
+public:
+	// Cold OBJ parse + tangents + LODs vs. mapping the binary cache
+	static void RunMeshCacheBenchmark(const char* objFileName);
+
+	// Times packing every vertex of a mesh and reports the savings
+	static void RunVertexPackingBenchmark(const char* objFileName);
+
+	// Builds a mesh's LOD chain and reports triangle reduction
+	// and error per level
+	static void RunSimplifierBenchmark(const char* objFileName);
+
+	// Splits a mesh into meshlets, then culls them from cameras orbiting
+	// it and reports how many triangles never need to be drawn
+	static void RunMeshletCullingBenchmark(const char* objFileName);
+
+	// Reference vs. SIMD/multithreaded tangent generation on a mesh tiled
+	// up to at least minTriangles
+	static void RunTangentBenchmark(const char* objFileName, int minTriangles = 2000000);
+
+	// Streams a file and compares the time and working set with Load()
+	static void RunObjStreamBenchmark(const char* objFileName);
+
+	// Times a mesh's bounds against the cost of parsing the file
+	static void RunBoundsBenchmark(const char* objFileName);
+
+	// Times random allocate/free churn against a RangeAllocator and
+	// compacting it afterwards, reporting fragmentation along the way
+	static void RunRangeAllocatorBenchmark();
+
+	// Loads a set of meshes one after another, then through MeshLoader
+	// with one worker and with one per core, and reports how long the
+	// calling thread was blocked and how long until all were resident
+	static void RunAsyncMeshLoadBenchmark(
+		const std::vector<std::string>& objFileNames,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+
+	// Rewrites a mesh with its faces split between two interleaved
+	// "usemtl" materials, then times parsing it with and without
+	// grouping and reports each material's triangles per LOD
+	static void RunMaterialGroupBenchmark(const char* objFileName);
+
+	// Builds deep (one long chain), wide (one parent) and bushy (four
+	// children each) hierarchies of nodeCount transforms, then moves the
+	// root or a few scattered nodes and compares updating the world
+	// matrices lazily, node by node, against TransformSystem::Update()'s
+	// single pass
+	static void RunTransformHierarchyBenchmark(int nodeCount = 100000);
+
+	// Fills a TransformSystem with count random transforms, then times
+	// rebuilding every world matrix one object at a time against
+	// Update()'s SIMD pass (on one thread and on every core), and
+	// whether it fits in a 60 Hz frame
+	static void RunTransformSystemBenchmark(int count = 1000000);
+
+	// Times the basis lookups and relative moves a camera makes each
+	// frame against rebuilding the rotation from Euler angles per call
+	static void RunTransformBasisBenchmark(int callCount = 1000000);
+
+	// A mostly static scene (a few moving objects, each carrying some
+	// children) where per-object uploads and world bounds are redone
+	// every frame, or only when a transform's version has changed -
+	// reports how many were skipped
+	static void RunTransformVersionBenchmark(int objectCount = 10000, int frameCount = 100);
+
+	// Times TransformSystem::ComputeObjectMatrices() for objectCount
+	// objects against doing each one separately with DirectXMath (matrix
+	// multiply, and transpose of the inverse)
+	static void RunObjectMatricesBenchmark(int objectCount = 100000);
+
+	// Times the per-frame update and render-prep loops at 10k, 100k
+	// and 1M entities in an EntityWorld against the old layout (a
+	// vector of separately new'd entities scattered through the heap)
+	static void RunEntityWorldBenchmark();
+
+	// Times RenderQueue's radix sort against std::stable_sort, then
+	// queues drawCount draws over a spread of shaders, materials and
+	// meshes in random order, timing the adds and the sort and
+	// comparing state changes before and after sorting - all without
+	// a GPU, since nothing is submitted
+	static void RunRenderQueueBenchmark(int drawCount = 100000);
+
+	// Groups entityCount objects (spread over a few meshes, materials
+	// and LODs) with InstanceBatcher, and times it against preparing
+	// one draw and one set of constants per object
+	static void RunInstancingBenchmark(int entityCount = 100000);
+
+	// Culls objectCount random boxes against a camera's frustum with
+	// FrustumCuller (on one thread and on all of them) and box at a
+	// time, reporting visible and culled counts and the cost per object
+	static void RunFrustumCullingBenchmark(int objectCount = 1000000);
+
+	// Fills an AABBTree with objectCount random boxes (inserted one at
+	// a time and built all at once), moves them around, and times
+	// frustum, box, sphere and ray queries and rebuilding in place
+	static void RunAABBTreeBenchmark(int objectCount = 1000000);
+
+	// Draws a city of box-shaped occluders into an OcclusionBuffer and
+	// tests the objectCount small boxes left in the camera's frustum
+	// against it (on one thread and on all of them), reporting occluded
+	// counts and the cost of each step
+	static void RunOcclusionCullingBenchmark(int objectCount = 100000);
+
+	// Times JobSystem from one thread up to one per core: a SIMD-free
+	// ParallelFor, lots of tiny jobs and nested ParallelFor()s against
+	// a serial loop.  Then under contention: jobs spawning jobs, chains
+	// of dependent jobs and outside threads all queueing at once.
+	static void RunJobSystemBenchmark(int elementCount = 1 << 22);
+};
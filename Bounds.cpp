@@ -0,0 +1,119 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+AABB Bounds::ComputeAABB(const Vertex* verts, int vertexCount)
+{
+	AABB box = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) };
+	if (vertexCount <= 0)
+		return box;
+
+	// Two independent min/max pairs, four vertices per iteration,
+	// so consecutive min/max instructions don't wait on each other
+	XMVECTOR min0 = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR max0 = min0;
+	XMVECTOR min1 = min0;
+	XMVECTOR max1 = min0;
+	int i = 0;
+	for (; i + 4 <= vertexCount; i += 4)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[i + 0].Position);
+		XMVECTOR p1 = XMLoadFloat3(&verts[i + 1].Position);
+		XMVECTOR p2 = XMLoadFloat3(&verts[i + 2].Position);
+		XMVECTOR p3 = XMLoadFloat3(&verts[i + 3].Position);
+		min0 = XMVectorMin(min0, XMVectorMin(p0, p1));
+		max0 = XMVectorMax(max0, XMVectorMax(p0, p1));
+		min1 = XMVectorMin(min1, XMVectorMin(p2, p3));
+		max1 = XMVectorMax(max1, XMVectorMax(p2, p3));
+	}
+	for (; i < vertexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[i].Position);
+		min0 = XMVectorMin(min0, p);
+		max0 = XMVectorMax(max0, p);
+	}
+
+	XMStoreFloat3(&box.min, XMVectorMin(min0, min1));
+	XMStoreFloat3(&box.max, XMVectorMax(max0, max1));
+	return box;
+}
+
+Sphere Bounds::ComputeSphere(const Vertex* verts, int vertexCount, const AABB& box)
+{
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&box.min), XMLoadFloat3(&box.max)), 0.5f);
+
+	// Largest squared distance, kept in every lane so no horizontal
+	// reduction is needed until the very end
+	XMVECTOR radiusSq0 = XMVectorZero();
+	XMVECTOR radiusSq1 = XMVectorZero();
+	int i = 0;
+	for (; i + 2 <= vertexCount; i += 2)
+	{
+		XMVECTOR d0 = XMVectorSubtract(XMLoadFloat3(&verts[i + 0].Position), center);
+		XMVECTOR d1 = XMVectorSubtract(XMLoadFloat3(&verts[i + 1].Position), center);
+		radiusSq0 = XMVectorMax(radiusSq0, XMVector3LengthSq(d0));
+		radiusSq1 = XMVectorMax(radiusSq1, XMVector3LengthSq(d1));
+	}
+	for (; i < vertexCount; i++)
+	{
+		XMVECTOR d = XMVectorSubtract(XMLoadFloat3(&verts[i].Position), center);
+		radiusSq0 = XMVectorMax(radiusSq0, XMVector3LengthSq(d));
+	}
+
+	Sphere sphere;
+	XMStoreFloat3(&sphere.center, center);
+	sphere.radius = XMVectorGetX(XMVectorSqrt(XMVectorMax(radiusSq0, radiusSq1)));
+	return sphere;
+}
+
+AABB Bounds::TransformAABB(const AABB& box, const XMFLOAT4X4& world)
+{
+	XMVECTOR boxMin = XMLoadFloat3(&box.min);
+	XMVECTOR boxMax = XMLoadFloat3(&box.max);
+	XMVECTOR center = XMVectorScale(XMVectorAdd(boxMin, boxMax), 0.5f);
+	XMVECTOR extents = XMVectorScale(XMVectorSubtract(boxMax, boxMin), 0.5f);
+
+	// Row vectors, so each extent axis scales the matching row
+	XMMATRIX m = XMLoadFloat4x4(&world);
+	XMVECTOR worldCenter = XMVector3Transform(center, m);
+	XMVECTOR worldExtents = XMVectorMultiply(XMVectorSplatX(extents), XMVectorAbs(m.r[0]));
+	worldExtents = XMVectorMultiplyAdd(XMVectorSplatY(extents), XMVectorAbs(m.r[1]), worldExtents);
+	worldExtents = XMVectorMultiplyAdd(XMVectorSplatZ(extents), XMVectorAbs(m.r[2]), worldExtents);
+
+	AABB result;
+	XMStoreFloat3(&result.min, XMVectorSubtract(worldCenter, worldExtents));
+	XMStoreFloat3(&result.max, XMVectorAdd(worldCenter, worldExtents));
+	return result;
+}
+
+Sphere Bounds::TransformSphere(const Sphere& sphere, const XMFLOAT4X4& world)
+{
+	XMMATRIX m = XMLoadFloat4x4(&world);
+	float scaleSq = std::max(
+		XMVectorGetX(XMVector3LengthSq(m.r[0])),
+		std::max(XMVectorGetX(XMVector3LengthSq(m.r[1])), XMVectorGetX(XMVector3LengthSq(m.r[2]))));
+
+	Sphere result;
+	XMStoreFloat3(&result.center, XMVector3Transform(XMLoadFloat3(&sphere.center), m));
+	result.radius = sphere.radius * sqrtf(scaleSq);
+	return result;
+}
+
+void Bounds::GetFrustumPlanes(const XMFLOAT4X4& viewProjection, XMFLOAT4 planes[6])
+{
+	// Gribb/Hartmann: with row vectors, each plane is a sum or
+	// difference of the view-projection matrix's columns
+	const XMFLOAT4X4& m = viewProjection;
+	planes[0] = XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);
+	planes[1] = XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);
+	planes[2] = XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);
+	planes[3] = XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);
+	planes[4] = XMFLOAT4(m._13, m._23, m._33, m._43);
+	planes[5] = XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);
+
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(XMLoadFloat4(&planes[i])));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Vertex.h"
+#include <DirectXMath.h>
+
+// Axis-aligned bounding box
+struct AABB
+{
+	DirectX::XMFLOAT3 min;
+	DirectX::XMFLOAT3 max;
+};
+
+// Bounding sphere
+struct Sphere
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+};
+
+// --------------------------------------------------------
+// Bounding volume helpers
+//
+// - Building them is a single SIMD pass over the vertices
+//   (two for the sphere), so they're cheap enough to compute
+//   every time a mesh loads
+// - Transforming them never touches the vertices again: the
+//   results always contain the transformed mesh, but may be
+//   looser than bounds computed from scratch
+// --------------------------------------------------------
+class Bounds
+{
+public:
+	// Min/max of every vertex position (an empty box at the
+	// origin if there are no vertices)
+	static AABB ComputeAABB(const Vertex* verts, int vertexCount);
+
+	// Sphere centered on the box, just big enough for every vertex
+	static Sphere ComputeSphere(const Vertex* verts, int vertexCount, const AABB& box);
+
+	// The box around a box after it's been transformed by "world"
+	// (Arvo's method - the absolute matrix applied to the extents)
+	static AABB TransformAABB(const AABB& box, const DirectX::XMFLOAT4X4& world);
+
+	// Moves the center and grows the radius by the largest axis scale
+	static Sphere TransformSphere(const Sphere& sphere, const DirectX::XMFLOAT4X4& world);
+
+	// The six planes (xyz = inward normal, w = distance) of the frustum
+	// a view-projection matrix sees, in the order left, right, bottom,
+	// top, near, far - world space for a camera's view * projection
+	static void GetFrustumPlanes(const DirectX::XMFLOAT4X4& viewProjection, DirectX::XMFLOAT4 planes[6]);
+};
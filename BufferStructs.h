@@ -2,10 +2,31 @@
 
 #include <DirectXMath.h>
 
-struct VertexShaderExternalData
+// The vertex shaders' constant buffers (see VertexShader.hlsl)
+
+// b0 - one buffer per object, only updated when the object or
+// the camera moves (see TransformSystem::ComputeObjectMatrices)
+struct VertexShaderPerObjectData
+{
+	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldViewProjMatrix;
+
+	// Inverse transpose of the world matrix's upper 3x3, so normals
+	// stay perpendicular to surfaces under non-uniform scale
+	DirectX::XMFLOAT4X4 normalMatrix;
+};
+
+// b1 - set with each material
+struct VertexShaderPerMaterialData
 {
 	DirectX::XMFLOAT4 colorTint;
+};
+
+// One instance in an instance buffer, read from input slot 1 by the
+// instanced vertex shaders (see NormalMapPackedInstanced_VS.hlsl)
+// - the world matrix's rows as DirectXMath keeps them, then the tint
+struct InstanceData
+{
 	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 viewMatrix;
-	DirectX::XMFLOAT4X4 projMatrix;
-};
\ No newline at end of file
+	DirectX::XMFLOAT4 colorTint;
+};
@@ -1,4 +1,6 @@
 #include "Camera.h"
+#include "Bounds.h"
+#include <cstring>
 
 
 
@@ -26,24 +28,40 @@ Camera::Camera(
 	aspectRatio = aspectRatioInit;
 	nearClipPlaneDistance = nearClipPlaneInit;
 	farClipPlaneDistance = farClipPlaneInit;
+	version = 0;
+	memset(&viewMatrix, 0, sizeof(viewMatrix));
+	memset(&projMatrix, 0, sizeof(projMatrix));
 	UpdateViewMatrix();
 	UpdateProjectionMatrix(aspectRatio);
 }
 
 void Camera::UpdateProjectionMatrix(float newAspectRatio)
 {
-	DirectX::XMStoreFloat4x4(&projMatrix, DirectX::XMMatrixPerspectiveFovLH(fieldOfViewAngle, newAspectRatio, nearClipPlaneDistance, farClipPlaneDistance));
+	DirectX::XMFLOAT4X4 newProjMatrix;
+	DirectX::XMStoreFloat4x4(&newProjMatrix, DirectX::XMMatrixPerspectiveFovLH(fieldOfViewAngle, newAspectRatio, nearClipPlaneDistance, farClipPlaneDistance));
+	if (memcmp(&newProjMatrix, &projMatrix, sizeof(projMatrix)) != 0)
+	{
+		projMatrix = newProjMatrix;
+		version++;
+	}
 }
 
 void Camera::UpdateViewMatrix()
 {
-	DirectX::XMStoreFloat4x4(&viewMatrix, 
+	// Called every frame, so the version only moves if the camera did
+	DirectX::XMFLOAT4X4 newViewMatrix;
+	DirectX::XMStoreFloat4x4(&newViewMatrix, 
 		DirectX::XMMatrixLookToLH(
 			DirectX::XMLoadFloat3(&transform.GetPosition()),
 			DirectX::XMLoadFloat3(&transform.GetLocalForward()),
 			DirectX::XMVectorSet(0, 1, 0, 0)
 		)
 	);
+	if (memcmp(&newViewMatrix, &viewMatrix, sizeof(viewMatrix)) != 0)
+	{
+		viewMatrix = newViewMatrix;
+		version++;
+	}
 }
 
 void Camera::Update(float dt, HWND windowHandle)
@@ -105,7 +123,26 @@ DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix() const
 	return projMatrix;
 }
 
+DirectX::XMFLOAT4X4 Camera::GetViewProjectionMatrix() const
+{
+	DirectX::XMFLOAT4X4 viewProjMatrix;
+	DirectX::XMStoreFloat4x4(&viewProjMatrix, DirectX::XMMatrixMultiply(
+		DirectX::XMLoadFloat4x4(&viewMatrix),
+		DirectX::XMLoadFloat4x4(&projMatrix)));
+	return viewProjMatrix;
+}
+
+unsigned int Camera::GetVersion() const
+{
+	return version;
+}
+
 Transform* Camera::GetTransform() 
 {
 	return &transform;
-}
\ No newline at end of file
+}
+
+void Camera::GetFrustumPlanes(DirectX::XMFLOAT4 planes[6]) const
+{
+	Bounds::GetFrustumPlanes(GetViewProjectionMatrix(), planes);
+}
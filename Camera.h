@@ -18,6 +18,9 @@ class Camera
 	float fieldOfViewAngle;
 	float aspectRatio;
 
+	// Goes up whenever the view or projection matrix changes
+	unsigned int version;
+
 public:
 	Camera(
 		float x = 0.0f,
@@ -36,8 +39,17 @@ public:
 
 	DirectX::XMFLOAT4X4 GetViewMatrix() const;
 	DirectX::XMFLOAT4X4 GetProjectionMatrix() const;
+	DirectX::XMFLOAT4X4 GetViewProjectionMatrix() const;
+
+	// Anything built from the view or projection matrix (such as
+	// per-object world-view-projection matrices) only needs redoing
+	// when this changes
+	unsigned int GetVersion() const;
 	Transform* GetTransform();
 
+	// World space planes of the view frustum (see Bounds::GetFrustumPlanes())
+	void GetFrustumPlanes(DirectX::XMFLOAT4 planes[6]) const;
+
 	void UpdateProjectionMatrix(float newAspectRatio);
 	void UpdateViewMatrix();
 	void Update(float dt, HWND windowHandle);
@@ -0,0 +1,394 @@
+#include "EntityWorld.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+namespace
+{
+	// Filled in once per type and never moved, so lookups need no lock
+	ComponentInfo componentInfos[MaxComponentTypes];
+	int componentTypeCount = 0;
+	std::mutex componentTypeMutex;
+
+	// Bytes of payload per command buffer page
+	const size_t CommandPageBytes = 16 * 1024;
+
+	// Placeholder ids from EntityCommandBuffer::Create()
+	const uint32_t PendingGeneration = 0xFFFFFFFF;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+int ComponentTypes::Register(const ComponentInfo& info)
+{
+	std::lock_guard<std::mutex> lock(componentTypeMutex);
+	if (componentTypeCount == MaxComponentTypes)
+	{
+		// Handing out a slot that's already taken would quietly mix
+		// two types' columns together, so there's no way to carry on
+		printf("ERROR: more than %d component types\n", MaxComponentTypes);
+		assert(componentTypeCount < MaxComponentTypes);
+		std::abort();
+	}
+	componentInfos[componentTypeCount] = info;
+	return componentTypeCount++;
+}
+
+const ComponentInfo& ComponentTypes::GetInfo(int type)
+{
+	return componentInfos[type];
+}
+
+EntityWorld::EntityWorld()
+{
+	liveCount = 0;
+	GetArchetype(0);
+}
+
+EntityWorld::~EntityWorld()
+{
+	for (Archetype* archetype : archetypeList)
+	{
+		for (int row = 0; row < archetype->count; row++)
+		{
+			for (size_t c = 0; c < archetype->types.size(); c++)
+				ComponentTypes::GetInfo(archetype->types[c]).destroy(archetype->GetComponent(row, (int)c));
+		}
+		for (unsigned char* chunk : archetype->chunks)
+			::operator delete(chunk, std::align_val_t(64));
+		delete archetype;
+	}
+}
+
+Archetype* EntityWorld::GetArchetype(uint64_t mask)
+{
+	auto found = archetypes.find(mask);
+	if (found != archetypes.end())
+		return found->second;
+
+	Archetype* archetype = new Archetype();
+	archetype->mask = mask;
+	archetype->count = 0;
+	for (int t = 0; t < MaxComponentTypes; t++)
+	{
+		archetype->columns[t] = -1;
+		if (mask & ((uint64_t)1 << t))
+		{
+			archetype->columns[t] = (int)archetype->types.size();
+			archetype->types.push_back(t);
+		}
+	}
+
+	// As many rows as fit once every column is aligned (with the
+	// worst-case padding set aside up front)
+	size_t rowBytes = sizeof(EntityId);
+	size_t padding = 0;
+	for (int t : archetype->types)
+	{
+		rowBytes += ComponentTypes::GetInfo(t).size;
+		padding += ComponentTypes::GetInfo(t).alignment;
+	}
+	archetype->chunkCapacity = std::max(1, (int)((EntityChunkBytes - padding) / rowBytes));
+
+	size_t offset = sizeof(EntityId) * archetype->chunkCapacity;
+	for (int t : archetype->types)
+	{
+		const ComponentInfo& info = ComponentTypes::GetInfo(t);
+		offset = AlignUp(offset, info.alignment);
+		archetype->offsets.push_back(offset);
+		archetype->sizes.push_back(info.size);
+		offset += info.size * archetype->chunkCapacity;
+	}
+
+	archetypes[mask] = archetype;
+	archetypeList.push_back(archetype);
+	return archetype;
+}
+
+Archetype* EntityWorld::GetNeighbor(Archetype* archetype, int type, bool add)
+{
+	std::unordered_map<int, Archetype*>& edges = add ? archetype->withComponent : archetype->withoutComponent;
+	auto found = edges.find(type);
+	if (found != edges.end())
+		return found->second;
+
+	uint64_t bit = (uint64_t)1 << type;
+	Archetype* neighbor = GetArchetype(add ? archetype->mask | bit : archetype->mask & ~bit);
+	edges[type] = neighbor;
+	return neighbor;
+}
+
+int EntityWorld::AllocateRow(Archetype* archetype, EntityId id)
+{
+	int row = archetype->count;
+	int chunk = row / archetype->chunkCapacity;
+	if (chunk == (int)archetype->chunks.size())
+		archetype->chunks.push_back((unsigned char*)::operator new(EntityChunkBytes, std::align_val_t(64)));
+
+	archetype->GetIds(chunk)[row % archetype->chunkCapacity] = id;
+	archetype->count++;
+	return row;
+}
+
+void EntityWorld::RemoveRow(Archetype* archetype, int row)
+{
+	int last = archetype->count - 1;
+	if (row != last)
+	{
+		for (size_t c = 0; c < archetype->types.size(); c++)
+		{
+			ComponentTypes::GetInfo(archetype->types[c]).moveConstruct(
+				archetype->GetComponent(row, (int)c),
+				archetype->GetComponent(last, (int)c));
+		}
+
+		EntityId moved = archetype->GetIds(last / archetype->chunkCapacity)[last % archetype->chunkCapacity];
+		archetype->GetIds(row / archetype->chunkCapacity)[row % archetype->chunkCapacity] = moved;
+		records[moved.index].row = row;
+	}
+	archetype->count--;
+
+	// Keep one spare chunk, so an entity going back and forth across
+	// a chunk boundary doesn't allocate every time
+	while ((int)archetype->chunks.size() > archetype->count / archetype->chunkCapacity + 2)
+	{
+		::operator delete(archetype->chunks.back(), std::align_val_t(64));
+		archetype->chunks.pop_back();
+	}
+}
+
+void EntityWorld::MoveEntity(EntityId id, Archetype* target)
+{
+	EntityRecord& record = records[id.index];
+	Archetype* source = record.archetype;
+	if (source == target)
+		return;
+
+	int newRow = AllocateRow(target, id);
+	for (size_t c = 0; c < source->types.size(); c++)
+	{
+		int type = source->types[c];
+		void* component = source->GetComponent(record.row, (int)c);
+		if (target->columns[type] >= 0)
+			ComponentTypes::GetInfo(type).moveConstruct(target->GetComponent(newRow, target->columns[type]), component);
+		else
+			ComponentTypes::GetInfo(type).destroy(component);
+	}
+
+	RemoveRow(source, record.row);
+	record.archetype = target;
+	record.row = newRow;
+}
+
+EntityId EntityWorld::Create()
+{
+	EntityId id;
+	if (!freeIndices.empty())
+	{
+		id.index = freeIndices.back();
+		freeIndices.pop_back();
+		id.generation = records[id.index].generation;
+	}
+	else
+	{
+		id.index = (uint32_t)records.size();
+		id.generation = 0;
+		records.push_back({ nullptr, -1, 0 });
+	}
+
+	Archetype* empty = GetArchetype(0);
+	records[id.index].archetype = empty;
+	records[id.index].row = AllocateRow(empty, id);
+	liveCount++;
+	return id;
+}
+
+void EntityWorld::Destroy(EntityId id)
+{
+	if (!IsAlive(id))
+		return;
+
+	EntityRecord& record = records[id.index];
+	Archetype* archetype = record.archetype;
+	for (size_t c = 0; c < archetype->types.size(); c++)
+		ComponentTypes::GetInfo(archetype->types[c]).destroy(archetype->GetComponent(record.row, (int)c));
+	RemoveRow(archetype, record.row);
+
+	// Generations skip the pending marker, so a real id never looks
+	// like a command buffer placeholder
+	record.archetype = nullptr;
+	record.row = -1;
+	record.generation++;
+	if (record.generation == PendingGeneration)
+		record.generation = 0;
+	freeIndices.push_back(id.index);
+	liveCount--;
+}
+
+bool EntityWorld::IsAlive(EntityId id) const
+{
+	return id.index < records.size()
+		&& records[id.index].archetype != nullptr
+		&& records[id.index].generation == id.generation;
+}
+
+int EntityWorld::GetCount() const
+{
+	return liveCount;
+}
+
+void* EntityWorld::AddComponent(EntityId id, int type)
+{
+	if (!IsAlive(id))
+		return nullptr;
+
+	EntityRecord& record = records[id.index];
+	int column = record.archetype->columns[type];
+	if (column >= 0)
+	{
+		void* existing = record.archetype->GetComponent(record.row, column);
+		ComponentTypes::GetInfo(type).destroy(existing);
+		return existing;
+	}
+
+	Archetype* target = GetNeighbor(record.archetype, type, true);
+	MoveEntity(id, target);
+	return target->GetComponent(record.row, target->columns[type]);
+}
+
+void EntityWorld::RemoveComponent(EntityId id, int type)
+{
+	if (!IsAlive(id) || records[id.index].archetype->columns[type] < 0)
+		return;
+
+	MoveEntity(id, GetNeighbor(records[id.index].archetype, type, false));
+}
+
+void* EntityWorld::GetComponent(EntityId id, int type) const
+{
+	if (!IsAlive(id))
+		return nullptr;
+
+	const EntityRecord& record = records[id.index];
+	int column = record.archetype->columns[type];
+	return column >= 0 ? record.archetype->GetComponent(record.row, column) : nullptr;
+}
+
+int EntityWorld::GetArchetypeCount() const
+{
+	return (int)archetypeList.size();
+}
+
+EntityCommandBuffer::EntityCommandBuffer()
+{
+	pendingCount = 0;
+	pageUsed = CommandPageBytes;
+}
+
+EntityCommandBuffer::~EntityCommandBuffer()
+{
+	Clear();
+	for (unsigned char* page : pages)
+		::operator delete(page, std::align_val_t(64));
+}
+
+void* EntityCommandBuffer::Allocate(size_t size, size_t alignment)
+{
+	// Oversized payloads get a page to themselves, kept at the front
+	// so the current page stays at the back
+	if (size > CommandPageBytes)
+	{
+		unsigned char* page = (unsigned char*)::operator new(size, std::align_val_t(64));
+		pages.insert(pages.begin(), page);
+		return page;
+	}
+
+	pageUsed = AlignUp(pageUsed, alignment);
+	if (pages.empty() || pageUsed + size > CommandPageBytes)
+	{
+		pages.push_back((unsigned char*)::operator new(CommandPageBytes, std::align_val_t(64)));
+		pageUsed = 0;
+	}
+	void* payload = pages.back() + pageUsed;
+	pageUsed += size;
+	return payload;
+}
+
+void EntityCommandBuffer::Clear()
+{
+	// Anything never played back still has to be destroyed
+	for (Command& command : commands)
+	{
+		if (command.component != nullptr)
+			ComponentTypes::GetInfo(command.componentType).destroy(command.component);
+	}
+	commands.clear();
+	pendingCount = 0;
+
+	// Keep one page for next time
+	while (pages.size() > 1)
+	{
+		::operator delete(pages.back(), std::align_val_t(64));
+		pages.pop_back();
+	}
+	pageUsed = 0;
+}
+
+EntityId EntityCommandBuffer::Create()
+{
+	EntityId placeholder = { pendingCount++, PendingGeneration };
+	commands.push_back({ CreateCommand, placeholder, -1, nullptr });
+	return placeholder;
+}
+
+void EntityCommandBuffer::Destroy(EntityId id)
+{
+	commands.push_back({ DestroyCommand, id, -1, nullptr });
+}
+
+bool EntityCommandBuffer::IsEmpty() const
+{
+	return commands.empty();
+}
+
+void EntityCommandBuffer::Playback(EntityWorld& world)
+{
+	std::vector<EntityId> created(pendingCount, InvalidEntity);
+	for (Command& command : commands)
+	{
+		EntityId id = command.entity;
+		if (id.generation == PendingGeneration)
+			id = created[id.index];
+
+		switch (command.type)
+		{
+		case CreateCommand:
+			created[command.entity.index] = world.Create();
+			break;
+		case DestroyCommand:
+			world.Destroy(id);
+			break;
+		case AddCommand:
+		{
+			// The payload is moved out (and destroyed) either way
+			void* destination = world.AddComponent(id, command.componentType);
+			if (destination != nullptr)
+				ComponentTypes::GetInfo(command.componentType).moveConstruct(destination, command.component);
+			else
+				ComponentTypes::GetInfo(command.componentType).destroy(command.component);
+			command.component = nullptr;
+			break;
+		}
+		case RemoveCommand:
+			world.RemoveComponent(id, command.componentType);
+			break;
+		}
+	}
+	Clear();
+}
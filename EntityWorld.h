@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Component types are bits in a 64-bit mask
+const int MaxComponentTypes = 64;
+
+// Bytes of component data per chunk
+const size_t EntityChunkBytes = 16 * 1024;
+
+// --------------------------------------------------------
+// An entity: a slot in an EntityWorld plus that slot's
+// generation, so ids of destroyed entities never match the
+// entities that reuse their slots
+// --------------------------------------------------------
+struct EntityId
+{
+	uint32_t index;
+	uint32_t generation;
+
+	bool operator==(const EntityId& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const EntityId& other) const { return !(*this == other); }
+};
+
+const EntityId InvalidEntity = { 0xFFFFFFFF, 0 };
+
+// How to move and destroy a component without knowing its type
+struct ComponentInfo
+{
+	size_t size;
+	size_t alignment;
+
+	// Move-constructs into raw memory, then destroys the source
+	void (*moveConstruct)(void* destination, void* source);
+	void (*destroy)(void* component);
+};
+
+// --------------------------------------------------------
+// Hands out a small id (0 to MaxComponentTypes - 1) for each
+// component type the first time it's used - registering more
+// than MaxComponentTypes types aborts the program
+// --------------------------------------------------------
+class ComponentTypes
+{
+	static int Register(const ComponentInfo& info);
+
+public:
+	template<typename T>
+	static int Get()
+	{
+		static const int type = Register(ComponentInfo{
+			sizeof(T),
+			alignof(T),
+			[](void* destination, void* source) { new (destination) T(std::move(*(T*)source)); ((T*)source)->~T(); },
+			[](void* component) { ((T*)component)->~T(); } });
+		return type;
+	}
+
+	static const ComponentInfo& GetInfo(int type);
+};
+
+// --------------------------------------------------------
+// Every entity with exactly the same set of components
+//
+// - Rows are packed into fixed-size chunks, each holding one
+//   contiguous array per component (plus the entity ids),
+//   so a query walks straight through memory
+// - Rows stay dense: removing one moves the last row into it
+// --------------------------------------------------------
+struct Archetype
+{
+	uint64_t mask;
+	std::vector<int> types;
+
+	// Index into types (and offsets) for each component type, or -1
+	int columns[MaxComponentTypes];
+
+	// Where each column starts within a chunk (the ids start at 0),
+	// and the size of one of its components
+	std::vector<size_t> offsets;
+	std::vector<size_t> sizes;
+	int chunkCapacity;
+
+	std::vector<unsigned char*> chunks;
+	int count;
+
+	// The archetypes one component away, filled in as they're used
+	std::unordered_map<int, Archetype*> withComponent;
+	std::unordered_map<int, Archetype*> withoutComponent;
+
+	EntityId* GetIds(int chunk) const { return (EntityId*)chunks[chunk]; }
+	void* GetColumn(int chunk, int column) const { return chunks[chunk] + offsets[column]; }
+	void* GetComponent(int row, int column) const
+	{
+		return chunks[row / chunkCapacity] + offsets[column] + (size_t)(row % chunkCapacity) * sizes[column];
+	}
+	int GetChunkCount(int chunk) const { return count - chunk * chunkCapacity < chunkCapacity ? count - chunk * chunkCapacity : chunkCapacity; }
+};
+
+// --------------------------------------------------------
+// Archetype-based entity/component storage
+//
+// - Components can be any movable type; entities with the
+//   same set of them share an Archetype, so iterating one
+//   component type (or several) touches only dense arrays
+// - Adding or removing a component moves the entity to
+//   another archetype.  Pointers to components stay valid
+//   until the next structural change (create, destroy, add,
+//   remove) - which must not happen inside ForEach(); queue
+//   them up in an EntityCommandBuffer instead
+// --------------------------------------------------------
+class EntityWorld
+{
+	struct EntityRecord
+	{
+		Archetype* archetype;
+		int row;
+		uint32_t generation;
+	};
+
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+	std::unordered_map<uint64_t, Archetype*> archetypes;
+	std::vector<Archetype*> archetypeList;
+	int liveCount;
+
+	Archetype* GetArchetype(uint64_t mask);
+	Archetype* GetNeighbor(Archetype* archetype, int type, bool add);
+
+	// A new row (with its id written) at the end of the archetype
+	int AllocateRow(Archetype* archetype, EntityId id);
+
+	// Fills the hole left by a row whose components have already
+	// been moved out or destroyed
+	void RemoveRow(Archetype* archetype, int row);
+
+	// Moves an entity's components into another archetype, destroying
+	// any the new one doesn't have
+	void MoveEntity(EntityId id, Archetype* target);
+
+	template<typename T>
+	static uint64_t MaskOf() { return (uint64_t)1 << ComponentTypes::Get<T>(); }
+
+public:
+	EntityWorld();
+	~EntityWorld();
+
+	EntityWorld(const EntityWorld&) = delete;
+	EntityWorld& operator=(const EntityWorld&) = delete;
+
+	// An entity with no components
+	EntityId Create();
+
+	// An entity created straight into the archetype of its components
+	template<typename... Ts>
+	EntityId Create(Ts&&... components)
+	{
+		EntityId id = Create();
+		Archetype* archetype = GetArchetype((MaskOf<typename std::decay<Ts>::type>() | ... | 0));
+		MoveEntity(id, archetype);
+		int row = records[id.index].row;
+		(new (archetype->GetComponent(row, archetype->columns[ComponentTypes::Get<typename std::decay<Ts>::type>()]))
+			typename std::decay<Ts>::type(std::forward<Ts>(components)), ...);
+		return id;
+	}
+
+	void Destroy(EntityId id);
+	bool IsAlive(EntityId id) const;
+	int GetCount() const;
+
+	// Raw memory for a component of the given type (the entity moves
+	// archetypes first if needed) - an existing component is destroyed,
+	// so the caller always constructs a new one in place
+	void* AddComponent(EntityId id, int type);
+	void RemoveComponent(EntityId id, int type);
+	void* GetComponent(EntityId id, int type) const;
+
+	template<typename T>
+	void Add(EntityId id, T component)
+	{
+		void* destination = AddComponent(id, ComponentTypes::Get<T>());
+		if (destination != nullptr)
+			new (destination) T(std::move(component));
+	}
+
+	template<typename T>
+	void Remove(EntityId id)
+	{
+		RemoveComponent(id, ComponentTypes::Get<T>());
+	}
+
+	// Null if the entity doesn't have one
+	template<typename T>
+	T* Get(EntityId id) const
+	{
+		return (T*)GetComponent(id, ComponentTypes::Get<T>());
+	}
+
+	template<typename T>
+	bool Has(EntityId id) const
+	{
+		return GetComponent(id, ComponentTypes::Get<T>()) != nullptr;
+	}
+
+	// Calls fn(count, ids, Ts*...) once per chunk of every entity
+	// that has all of Ts, with one array per component type
+	template<typename... Ts, typename Fn>
+	void ForEachChunk(Fn fn)
+	{
+		uint64_t required = (MaskOf<Ts>() | ... | 0);
+		for (Archetype* archetype : archetypeList)
+		{
+			if ((archetype->mask & required) != required || archetype->count == 0)
+				continue;
+			for (int c = 0; c * archetype->chunkCapacity < archetype->count; c++)
+			{
+				fn(archetype->GetChunkCount(c), archetype->GetIds(c),
+					(Ts*)archetype->GetColumn(c, archetype->columns[ComponentTypes::Get<Ts>()])...);
+			}
+		}
+	}
+
+	// Calls fn(id, Ts&...) for every entity that has all of Ts
+	template<typename... Ts, typename Fn>
+	void ForEach(Fn fn)
+	{
+		ForEachChunk<Ts...>([&fn](int count, const EntityId* ids, Ts*... columns)
+		{
+			for (int i = 0; i < count; i++)
+				fn(ids[i], columns[i]...);
+		});
+	}
+
+	// How many entities have all of Ts
+	template<typename... Ts>
+	int Count() const
+	{
+		uint64_t required = (MaskOf<Ts>() | ... | 0);
+		int count = 0;
+		for (Archetype* archetype : archetypeList)
+		{
+			if ((archetype->mask & required) == required)
+				count += archetype->count;
+		}
+		return count;
+	}
+
+	int GetArchetypeCount() const;
+};
+
+// --------------------------------------------------------
+// Structural changes recorded for later, so they can be made
+// while iterating a world and applied once it's done
+//
+// - Create() hands back a placeholder id that only this buffer
+//   understands, until Playback() swaps in the real one
+// - Commands are applied in the order they were recorded
+// --------------------------------------------------------
+class EntityCommandBuffer
+{
+	enum CommandType { CreateCommand, DestroyCommand, AddCommand, RemoveCommand };
+
+	struct Command
+	{
+		CommandType type;
+		EntityId entity;
+		int componentType;
+		void* component;
+	};
+
+	std::vector<Command> commands;
+	uint32_t pendingCount;
+
+	// Component payloads, bump-allocated from pages that never move
+	std::vector<unsigned char*> pages;
+	size_t pageUsed;
+	void* Allocate(size_t size, size_t alignment);
+	void Clear();
+
+public:
+	EntityCommandBuffer();
+	~EntityCommandBuffer();
+
+	EntityCommandBuffer(const EntityCommandBuffer&) = delete;
+	EntityCommandBuffer& operator=(const EntityCommandBuffer&) = delete;
+
+	EntityId Create();
+	void Destroy(EntityId id);
+
+	template<typename T>
+	void Add(EntityId id, T component)
+	{
+		int type = ComponentTypes::Get<T>();
+		void* payload = Allocate(sizeof(T), alignof(T));
+		new (payload) T(std::move(component));
+		commands.push_back({ AddCommand, id, type, payload });
+	}
+
+	template<typename T>
+	void Remove(EntityId id)
+	{
+		commands.push_back({ RemoveCommand, id, ComponentTypes::Get<T>(), nullptr });
+	}
+
+	bool IsEmpty() const;
+
+	// Applies everything, then empties the buffer
+	void Playback(EntityWorld& world);
+};
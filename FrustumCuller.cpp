@@ -0,0 +1,136 @@
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+
+using namespace DirectX;
+
+FrustumCuller::FrustumCuller()
+{
+	count = 0;
+}
+
+void FrustumCuller::Clear()
+{
+	blocks.clear();
+	count = 0;
+}
+
+void FrustumCuller::Reserve(int boxCount)
+{
+	blocks.reserve((size_t)(boxCount + 3) / 4 * BlockFloats);
+}
+
+int FrustumCuller::Add(const AABB& box)
+{
+	// A new block whenever the last is full - unused lanes are empty
+	// boxes at the origin, whose results are never written
+	if ((count & 3) == 0)
+		blocks.resize(blocks.size() + BlockFloats, 0.0f);
+
+	float* lanes = GetLanes(count);
+	lanes[0] = (box.min.x + box.max.x) * 0.5f;
+	lanes[4] = (box.min.y + box.max.y) * 0.5f;
+	lanes[8] = (box.min.z + box.max.z) * 0.5f;
+	lanes[12] = (box.max.x - box.min.x) * 0.5f;
+	lanes[16] = (box.max.y - box.min.y) * 0.5f;
+	lanes[20] = (box.max.z - box.min.z) * 0.5f;
+	return count++;
+}
+
+int FrustumCuller::AddUnbounded()
+{
+	// Extents this big put every plane's distance at +infinity (and never
+	// NaN, as infinite extents would against a zero normal component)
+	AABB origin = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) };
+	int index = Add(origin);
+	float* lanes = GetLanes(index);
+	lanes[12] = lanes[16] = lanes[20] = FLT_MAX;
+	return index;
+}
+
+int FrustumCuller::GetCount() const
+{
+	return count;
+}
+
+int FrustumCuller::CullRange(const XMFLOAT4 planes[6], unsigned char* visible, int begin, int end) const
+{
+	// Each plane's components splatted across the lanes, plus the
+	// absolute normal the extents are projected onto
+	XMVECTOR nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; p++)
+	{
+		nx[p] = XMVectorReplicate(planes[p].x);
+		ny[p] = XMVectorReplicate(planes[p].y);
+		nz[p] = XMVectorReplicate(planes[p].z);
+		nw[p] = XMVectorReplicate(planes[p].w);
+		ax[p] = XMVectorAbs(nx[p]);
+		ay[p] = XMVectorAbs(ny[p]);
+		az[p] = XMVectorAbs(nz[p]);
+	}
+
+	// Outside a plane if center distance + projected radius < 0
+	auto outsideMask = [&](int i)
+	{
+		const XMFLOAT4* block = (const XMFLOAT4*)&blocks[(size_t)(i >> 2) * BlockFloats];
+		XMVECTOR cx = XMLoadFloat4(&block[0]);
+		XMVECTOR cy = XMLoadFloat4(&block[1]);
+		XMVECTOR cz = XMLoadFloat4(&block[2]);
+		XMVECTOR ex = XMLoadFloat4(&block[3]);
+		XMVECTOR ey = XMLoadFloat4(&block[4]);
+		XMVECTOR ez = XMLoadFloat4(&block[5]);
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(nx[p], cx, XMVectorMultiplyAdd(ny[p], cy, XMVectorMultiplyAdd(nz[p], cz, nw[p])));
+			XMVECTOR radius = XMVectorMultiplyAdd(ax[p], ex, XMVectorMultiplyAdd(ay[p], ey, XMVectorMultiply(az[p], ez)));
+			outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(distance, radius), XMVectorZero()));
+		}
+		return outside;
+	};
+
+	int visibleCount = 0;
+	auto store = [&](XMVECTOR outside, int i)
+	{
+		XMUINT4 lanes;
+		XMStoreUInt4(&lanes, outside);
+		const uint32_t* lane = &lanes.x;
+		int lanesUsed = std::min(4, end - i);
+		for (int k = 0; k < lanesUsed; k++)
+		{
+			visible[i + k] = lane[k] == 0;
+			visibleCount += lane[k] == 0;
+		}
+	};
+
+	// Two independent groups of four per iteration, then any last group
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		XMVECTOR outside0 = outsideMask(i);
+		XMVECTOR outside1 = outsideMask(i + 4);
+		store(outside0, i);
+		store(outside1, i + 4);
+	}
+	for (; i < end; i += 4)
+		store(outsideMask(i), i);
+	return visibleCount;
+}
+
+int FrustumCuller::Cull(const XMFLOAT4 planes[6], unsigned char* visible, int threadCount) const
+{
+	// Jobs over runs of whole groups of four, no more than threadCount
+	int groupCount = (count + 3) / 4;
+	int jobCount = std::max(1, threadCount);
+	int groupsPerJob = (groupCount + jobCount - 1) / jobCount;
+	std::atomic<int> visibleCount(0);
+	JobSystem::GetDefault().ParallelFor(groupCount, groupsPerJob, [&](int firstGroup, int endGroup)
+	{
+		visibleCount.fetch_add(CullRange(planes, visible, firstGroup * 4, std::min(count, endGroup * 4)), std::memory_order_relaxed);
+	});
+	return visibleCount.load();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Bounds.h"
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Tests many world space boxes against a camera's frustum
+//
+// - Boxes are kept as centers and half extents, SoA in
+//   blocks of four (four center x's, four center y's and so
+//   on), so each plane test covers four boxes with a handful
+//   of SIMD instructions - two blocks per iteration, so
+//   neither waits on the other
+// - A box is culled only if it's entirely behind one of
+//   the six planes; boxes crossing a corner outside the
+//   frustum are kept (conservative, like any plane test)
+// --------------------------------------------------------
+class FrustumCuller
+{
+	// Center x, y, z then extent x, y, z, four lanes each
+	static const int BlockFloats = 24;
+	std::vector<float> blocks;
+	int count;
+
+	float* GetLanes(int index) { return &blocks[(size_t)(index >> 2) * BlockFloats + (index & 3)]; }
+
+	// Culls boxes [begin, end) - begin has to be a multiple of four
+	int CullRange(const DirectX::XMFLOAT4 planes[6], unsigned char* visible, int begin, int end) const;
+
+public:
+	FrustumCuller();
+
+	void Clear();
+	void Reserve(int boxCount);
+
+	// Adds a box, returning its index
+	int Add(const AABB& box);
+
+	// A box that's never culled, for things without bounds yet
+	int AddUnbounded();
+
+	int GetCount() const;
+
+	// Sets visible[i] to 1 if box i may be inside the planes (see
+	// Camera::GetFrustumPlanes(), normals pointing inwards) and 0 if
+	// not, split into as many as threadCount jobs - returns how many are
+	// visible
+	int Cull(const DirectX::XMFLOAT4 planes[6], unsigned char* visible, int threadCount = 1) const;
+};
@@ -1,5 +1,6 @@
 #include "BufferStructs.h"
 #include "Game.h"
+#include "Benchmarks.h"
 #include <cmath>
 
 // Needed for a helper function to read compiled shader files from the hard drive
@@ -25,6 +26,9 @@ Game::Game(HINSTANCE hInstance)
 		720,			   // Height of the window's client area
 		true)			   // Show extra stats (fps) in title bar?
 {
+	reportedStateChanges = -1;
+	reportedVisibleCount = -1;
+	reportedOccludedCount = -1;
 
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -45,22 +49,20 @@ Game::~Game()
 	// we don't need to explicitly clean up those DirectX objects
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object created in Game
+	delete meshLoader;
 	for (Mesh* m : meshes)
 	{
 		delete m;
 	}
 
-	for (Entity* e : entities)
-	{
-		delete e;
-	}
-	
 	delete material_cobblestone;
 	delete material_wood;
 	delete material_bronze;
 	delete material_scratched;
 	delete material_paint;
 	delete material_floor;
+	for (MaterialLibrary* library : materialLibraries)
+		delete library;
 
 	delete mainCamera;
 
@@ -68,7 +70,11 @@ Game::~Game()
 	delete vertexShader;
 	delete pixelShaderNormalMap;
 	delete vertexShaderNormalMap;
+	delete vertexShaderNormalMapInstanced;
 	delete skybox;
+
+	// Last, since pooled meshes hand their ranges back as they're deleted
+	delete geometryPool;
 }
 
 // --------------------------------------------------------
@@ -307,6 +313,11 @@ void Game::Init()
 	material_paint = new Material(DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.5f, pixelShaderNormalMap, vertexShaderNormalMap, paintAlbedoSRV.Get(), samplerState.Get(), paintNormalSRV.Get(), paintRoughnessSRV.Get(), paintMetalSRV.Get());
 	material_floor = new Material(DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.5f, pixelShaderNormalMap, vertexShaderNormalMap, floorAlbedoSRV.Get(), samplerState.Get(), floorNormalSRV.Get(), floorRoughnessSRV.Get(), floorMetalSRV.Get());
 
+	// Entities sharing a mesh and one of these get drawn together
+	Material* instancedMaterials[] = { material_wood, material_bronze, material_cobblestone, material_scratched, material_paint, material_floor };
+	for (Material* material : instancedMaterials)
+		material->SetInstancedVertexShader(vertexShaderNormalMapInstanced);
+
 	directionalLight1 = DirectionalLight();
 	directionalLight1.ambientColor = XMFLOAT3(0.01f, 0.01f, 0.02f);
 	directionalLight1.diffuseColor = XMFLOAT3(0.3f, 0.3f, 0.4f);
@@ -327,6 +338,47 @@ void Game::Init()
 	pointLight1.color = XMFLOAT3(1, 1, 1);
 	pointLight1.position = XMFLOAT3(-5, 100, 0);
 
+#if defined(RUN_BENCHMARKS)
+	Benchmarks::RunMeshCacheBenchmark(GetFullPathTo("../../assets/meshes/sphere.obj").c_str());
+	Benchmarks::RunMeshCacheBenchmark(GetFullPathTo("../../assets/meshes/helix.obj").c_str());
+	Benchmarks::RunVertexPackingBenchmark(GetFullPathTo("../../assets/meshes/sphere.obj").c_str());
+	Benchmarks::RunVertexPackingBenchmark(GetFullPathTo("../../assets/meshes/helix.obj").c_str());
+	Benchmarks::RunSimplifierBenchmark(GetFullPathTo("../../assets/meshes/sphere.obj").c_str());
+	Benchmarks::RunSimplifierBenchmark(GetFullPathTo("../../assets/meshes/helix.obj").c_str());
+	Benchmarks::RunMeshletCullingBenchmark(GetFullPathTo("../../assets/meshes/sphere.obj").c_str());
+	Benchmarks::RunMeshletCullingBenchmark(GetFullPathTo("../../assets/meshes/helix.obj").c_str());
+	Benchmarks::RunTangentBenchmark(GetFullPathTo("../../assets/meshes/helix.obj").c_str());
+	Benchmarks::RunObjStreamBenchmark(GetFullPathTo("../../assets/meshes/helix.obj").c_str());
+	Benchmarks::RunMaterialGroupBenchmark(GetFullPathTo("../../assets/meshes/sphere.obj").c_str());
+	Benchmarks::RunBoundsBenchmark(GetFullPathTo("../../assets/meshes/sphere.obj").c_str());
+	Benchmarks::RunBoundsBenchmark(GetFullPathTo("../../assets/meshes/helix.obj").c_str());
+	Benchmarks::RunRangeAllocatorBenchmark();
+	Benchmarks::RunTransformHierarchyBenchmark();
+	Benchmarks::RunTransformSystemBenchmark();
+	Benchmarks::RunTransformBasisBenchmark();
+	Benchmarks::RunTransformVersionBenchmark();
+	Benchmarks::RunObjectMatricesBenchmark();
+	Benchmarks::RunEntityWorldBenchmark();
+	Benchmarks::RunRenderQueueBenchmark();
+	Benchmarks::RunInstancingBenchmark();
+	Benchmarks::RunFrustumCullingBenchmark();
+	Benchmarks::RunAABBTreeBenchmark();
+	Benchmarks::RunOcclusionCullingBenchmark();
+	Benchmarks::RunJobSystemBenchmark();
+	Benchmarks::RunAsyncMeshLoadBenchmark(
+		{
+			GetFullPathTo("../../assets/meshes/cube.obj"),
+			GetFullPathTo("../../assets/meshes/cylinder.obj"),
+			GetFullPathTo("../../assets/meshes/helix.obj"),
+			GetFullPathTo("../../assets/meshes/sphere.obj"),
+		},
+		device);
+#endif
+
+	// Meshes are loaded on worker threads, and uploaded in Update() into
+	// one shared pool (it grows if this initial size runs out)
+	geometryPool = new GeometryPool(device, context, sizeof(PackedVertex), 256 * 1024, 1024 * 1024);
+	meshLoader = new MeshLoader(device, 0, geometryPool);
 	CreateBasicGeometry();
 	mainCamera = new Camera(
 		0,
@@ -348,21 +400,12 @@ void Game::Init()
 	// Essentially: "What kind of shape should the GPU draw with our data?"
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	// Create constant buffer for VertexShaderExternalData
-	unsigned int size = sizeof(VertexShaderExternalData);
-	size = (size + 15) / 16 * 16;
-	D3D11_BUFFER_DESC cbDesc	= {}; //sets to all zeros
-	cbDesc.BindFlags			= D3D11_BIND_CONSTANT_BUFFER;
-	cbDesc.ByteWidth			= size;
-	cbDesc.CPUAccessFlags		= D3D11_CPU_ACCESS_WRITE;
-	cbDesc.Usage				= D3D11_USAGE_DYNAMIC;
-
 
 	//Setup skybox
 	
 	//meshes.push_back(new Mesh(GetFullPathTo("../../assets/meshes/cube.obj").c_str(), device));
 	skybox = new Sky(
-		new Mesh(GetFullPathTo("../../assets/meshes/cube.obj").c_str(), device),
+		meshLoader->LoadAsync(GetFullPathTo("../../assets/meshes/cube.obj").c_str()).mesh,
 		samplerState.Get(),
 		GetFullPathTo_Wide(L"../../assets/textures/SpaceCubeMap.dds").c_str(),
 		device.Get(),
@@ -392,10 +435,64 @@ void Game::LoadShaders()
 		context.Get(), 
 		GetFullPathTo_Wide(L"PixelShader.cso").c_str()
 	);
+
+	// The normal mapped meshes use the packed vertex format, which
+	// reflection can't describe (it would assume 32-bit floats), so
+	// that shader gets an explicit input layout instead
+	D3D11_INPUT_ELEMENT_DESC packedLayout[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT",  0, DXGI_FORMAT_R16G16_SNORM,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	// The instanced version reads the same vertices from slot 0, plus
+	// each instance's InstanceData from slot 1
+	D3D11_INPUT_ELEMENT_DESC packedInstancedLayout[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT",  0, DXGI_FORMAT_R16G16_SNORM,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WORLD_PER_INSTANCE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD_PER_INSTANCE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD_PER_INSTANCE", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD_PER_INSTANCE", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "COLOR_PER_INSTANCE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
+
+	// Input layouts have to be checked against the shader's byte code
+	auto createInputLayout = [&](const wchar_t* shaderFile, const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount)
+	{
+		ID3D11InputLayout* inputLayout = 0;
+		Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+		if (SUCCEEDED(D3DReadFileToBlob(GetFullPathTo_Wide(shaderFile).c_str(), shaderBlob.GetAddressOf())))
+		{
+			device->CreateInputLayout(
+				elements,
+				elementCount,
+				shaderBlob->GetBufferPointer(),
+				shaderBlob->GetBufferSize(),
+				&inputLayout);
+		}
+		return inputLayout;
+	};
+
+	// The shaders take ownership of the input layouts
 	vertexShaderNormalMap = new SimpleVertexShader(
 		device.Get(),
 		context.Get(),
-		GetFullPathTo_Wide(L"NormalMap_VS.cso").c_str()
+		GetFullPathTo_Wide(L"NormalMapPacked_VS.cso").c_str(),
+		createInputLayout(L"NormalMapPacked_VS.cso", packedLayout, ARRAYSIZE(packedLayout)),
+		false
+	);
+	vertexShaderNormalMapInstanced = new SimpleVertexShader(
+		device.Get(),
+		context.Get(),
+		GetFullPathTo_Wide(L"NormalMapPackedInstanced_VS.cso").c_str(),
+		createInputLayout(L"NormalMapPackedInstanced_VS.cso", packedInstancedLayout, ARRAYSIZE(packedInstancedLayout)),
+		true
 	);
 	pixelShaderNormalMap = new SimplePixelShader(
 		device.Get(),
@@ -442,7 +539,6 @@ void Game::CreateBasicGeometry()
 	unsigned int indices[] = { 0, 1, 2 };
 
 	//meshes.push_back( new Mesh(vertices, 3, indices, 3, device) );
-	//entities.push_back(new Entity(meshes.back()));
 
 	// square mesh
 	Vertex squareVertices[] =
@@ -454,52 +550,92 @@ void Game::CreateBasicGeometry()
 	};
 	unsigned int squareIndices[] = { 0, 1, 2, 0, 2, 3 };
 
-	meshes.push_back(new Mesh(GetFullPathTo("../../assets/meshes/helix.obj").c_str(), device));
-	entities.push_back(new Entity(meshes.back(), material_cobblestone));
-	entities.push_back(new Entity(meshes.back(), material_wood));
-	entities.push_back(new Entity(meshes.back(), material_bronze));
-	entities.push_back(new Entity(meshes.back(), material_scratched));
-	entities.push_back(new Entity(meshes.back(), material_paint));
-	entities.push_back(new Entity(meshes.back(), material_floor));
-
-	for (int i = 0; i < entities.size(); i++)
+	// Six of each mesh, one per material, in rows
+	Material* materials[] = { material_cobblestone, material_wood, material_bronze, material_scratched, material_paint, material_floor };
+	const char* rowMeshes[] = { "../../assets/meshes/helix.obj", "../../assets/meshes/sphere.obj", "../../assets/meshes/cylinder.obj" };
+	for (int row = 0; row < 3; row++)
 	{
-		Transform* t = entities[i]->GetTransform();
-		t->SetPosition(i * 2.0f + -1.0f, -1.0f, 1.0f);
-		t->SetRotation(0.0f, 0.0f, 0.0f);
-		t->SetScale(0.7f, 0.7f, 0.7f);
+		meshes.push_back(meshLoader->LoadAsync(GetFullPathTo(rowMeshes[row]).c_str(), true).mesh);
+		meshesAwaitingMaterials.push_back(meshes.back());
+		for (int m = 0; m < 6; m++)
+		{
+			int i = row * 6 + m;
+			Transform transform;
+			if (row == 0)
+			{
+				transform.SetPosition(i * 2.0f + -1.0f, -1.0f, 1.0f);
+				transform.SetScale(0.7f, 0.7f, 0.7f);
+			}
+			else if (row == 1)
+				transform.SetPosition(i * 2.0f + -14, 1.0f, 1.0f);
+			else
+				transform.SetPosition(i * 2.0f + -28, 3.0f, 1.0f);
+
+			// The sphere and cylinder rows hide what's behind them - the
+			// helix is mostly gaps its simplified occluder would fill in
+			if (row == 0)
+			{
+				scene.Create(
+					std::move(transform),
+					MeshRenderer{ meshes.back(), materials[m] },
+					ObjectConstants{},
+					WorldBounds{});
+			}
+			else
+			{
+				scene.Create(
+					std::move(transform),
+					MeshRenderer{ meshes.back(), materials[m] },
+					ObjectConstants{},
+					WorldBounds{},
+					Occluder{});
+			}
+		}
 	}
+}
 
-	meshes.push_back(new Mesh(GetFullPathTo("../../assets/meshes/sphere.obj").c_str(), device));
-	entities.push_back(new Entity(meshes.back(), material_cobblestone));
-	entities.push_back(new Entity(meshes.back(), material_wood));
-	entities.push_back(new Entity(meshes.back(), material_bronze));
-	entities.push_back(new Entity(meshes.back(), material_scratched));
-	entities.push_back(new Entity(meshes.back(), material_paint));
-	entities.push_back(new Entity(meshes.back(), material_floor));
-
-	for (int i = (int)entities.size() / 2; i < entities.size(); i++)
-	{
-		Transform* t = entities[i]->GetTransform();
-		t->SetPosition(i * 2.0f + -14, 1.0f, 1.0f);
-		t->SetRotation(0.0f, 0.0f, 0.0f);
-		t->SetScale(1, 1, 1);
-	}
-
-	meshes.push_back(new Mesh(GetFullPathTo("../../assets/meshes/cylinder.obj").c_str(), device));
-	entities.push_back(new Entity(meshes.back(), material_cobblestone));
-	entities.push_back(new Entity(meshes.back(), material_wood));
-	entities.push_back(new Entity(meshes.back(), material_bronze));
-	entities.push_back(new Entity(meshes.back(), material_scratched));
-	entities.push_back(new Entity(meshes.back(), material_paint));
-	entities.push_back(new Entity(meshes.back(), material_floor));
-
-	for (int i = (int)entities.size() * 2 / 3; i < entities.size(); i++)
+// --------------------------------------------------------
+// Once a mesh is resident, builds a MaterialLibrary from the MTL
+// files it names (if any) and points every MeshRenderer using it
+// at the material for each of its submeshes
+// - Submeshes naming a material the library doesn't have keep
+//   the renderer's own material
+// --------------------------------------------------------
+void Game::ApplyMaterialLibraries()
+{
+	for (size_t i = 0; i < meshesAwaitingMaterials.size(); )
 	{
-		Transform* t = entities[i]->GetTransform();
-		t->SetPosition(i * 2.0f + -28, 3.0f, 1.0f);
-		t->SetRotation(0.0f, 0.0f, 0.0f);
-		t->SetScale(1, 1, 1);
+		Mesh* mesh = meshesAwaitingMaterials[i];
+		if (!mesh->IsResident())
+		{
+			i++;
+			continue;
+		}
+		meshesAwaitingMaterials.erase(meshesAwaitingMaterials.begin() + i);
+		if (mesh->GetMaterialLibraries().empty())
+			continue;
+
+		MaterialLibrary* library = new MaterialLibrary(
+			mesh->GetMaterialLibraries(),
+			pixelShaderNormalMap,
+			vertexShaderNormalMap,
+			samplerState.Get(),
+			device,
+			context);
+		if (library->GetMaterialCount() == 0)
+		{
+			delete library;
+			continue;
+		}
+		for (int m = 0; m < library->GetMaterialCount(); m++)
+			library->GetMaterial(m)->SetInstancedVertexShader(vertexShaderNormalMapInstanced);
+		materialLibraries.push_back(library);
+
+		scene.ForEach<MeshRenderer>([&](EntityId id, MeshRenderer& renderer)
+		{
+			if (renderer.mesh == mesh)
+				renderer.submeshMaterials = library->GetSubmeshMaterials(mesh, renderer.material);
+		});
 	}
 }
 
@@ -523,12 +659,23 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	// Create GPU buffers for any meshes the loader has finished with
+	if (meshLoader->Update() > 0)
+		ApplyMaterialLibraries();
+
 	mainCamera->Update(deltaTime, this->hWnd);
-	for (Entity* e : entities)
+	scene.ForEach<Transform>([&](EntityId id, Transform& transform)
 	{
-		e->GetTransform()->MoveAbsolute(sin(totalTime ) * 0.00001f, cos(totalTime) * 0.00001f, 0);
-		e->GetTransform()->Rotate(0.0f, 0.0f, deltaTime);
-	}
+		transform.MoveAbsolute(sin(totalTime ) * 0.00001f, cos(totalTime) * 0.00001f, 0);
+		transform.Rotate(0.0f, 0.0f, deltaTime);
+	});
+
+	// Every dirty world matrix (entities, anything attached to them and
+	// the camera) in one batched pass, spread over the job system's
+	// threads, then the bounds of whatever moved
+	TransformSystem::GetDefault().Update(JobSystem::GetDefault().GetThreadCount());
+	renderSystem.UpdateBounds(scene);
+
 	// Quit if the escape key is pressed
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
@@ -599,9 +746,32 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	//=====================================| DRAW MESHES
 
-	for (Entity* entity : entities)
+	// Per-object matrices (world-view-projection and normal matrices
+	// included) for every entity that moved, or all of them if the
+	// camera did, in one batch - everything else keeps last frame's
+	renderSystem.UpdateObjectConstants(scene, context, mainCamera);
+
+	// Culled against the camera's frustum and then the occluders,
+	// sorted by shader, material and mesh, so only what changes
+	// between draws is set
+	// (one vertex/index buffer bind covers every pooled mesh)
+	renderSystem.Draw(scene, context, mainCamera, (float)height);
+
+	// Report what was culled and the frame's state changes whenever
+	// either moves (as meshes finish loading or the camera turns, say)
+	const RenderQueueStats& stats = renderSystem.GetQueue().GetLastStats();
+	int visibleCount = renderSystem.GetLastVisibleCount();
+	int occludedCount = renderSystem.GetLastOccludedCount();
+	if (stats.GetTotal() != reportedStateChanges || visibleCount != reportedVisibleCount || occludedCount != reportedOccludedCount)
 	{
-		entity->Draw(context, mainCamera);
+		const RenderQueueStats& unfiltered = renderSystem.GetQueue().GetLastUnfilteredStats();
+		int candidateCount = renderSystem.GetLastCandidateCount();
+		printf("%d visible, %d culled, %d occluded (%.3f ms): %d objects in %d draws, %d state changes (%d drawing each object on its own)\n",
+			visibleCount - occludedCount, candidateCount - visibleCount, occludedCount, renderSystem.GetLastOcclusionMilliseconds(),
+			stats.instances, stats.draws, stats.GetTotal(), unfiltered.GetTotal());
+		reportedStateChanges = stats.GetTotal();
+		reportedVisibleCount = visibleCount;
+		reportedOccludedCount = occludedCount;
 	}
 
 	// Draw the skybox last
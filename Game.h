@@ -1,12 +1,16 @@
 #pragma once
 
 #include "DXCore.h"
+#include "JobSystem.h"
 #include "Mesh.h"
-#include "Entity.h"
+#include "MeshLoader.h"
+#include "EntityWorld.h"
+#include "RenderSystem.h"
 #include "Vertex.h"
 #include "Camera.h"
 #include "Material.h"
 #include "Lights.h"
+#include "MaterialLibrary.h"
 #include "Sky.h"
 #include "WICTextureLoader.h"
 
@@ -35,9 +39,32 @@ private:
 	void LoadShaders(); 
 	void CreateBasicGeometry();
 
+	// Gives each newly resident mesh that names MTL files their
+	// materials, one per submesh
+	void ApplyMaterialLibraries();
+
 	// Custom entities
+	// - OBJ meshes load in the background; entities that use them
+	//   start drawing as each one becomes resident
+	// - Meshes that fit share the pool's buffers, bound once per frame
+	GeometryPool* geometryPool;
+	MeshLoader* meshLoader;
 	std::vector<Mesh*> meshes;
-	std::vector<Entity*> entities;
+
+	// Materials from the meshes' own MTL files - meshes wait in the
+	// list until they're resident, since only then are their submeshes
+	// and material libraries known
+	std::vector<Mesh*> meshesAwaitingMaterials;
+	std::vector<MaterialLibrary*> materialLibraries;
+
+	// Every entity, as components (a Transform, a MeshRenderer and so
+	// on), plus the per-frame work that draws them
+	EntityWorld scene;
+	RenderSystem renderSystem;
+	int reportedStateChanges;
+	int reportedVisibleCount;
+	int reportedOccludedCount;
+
 	Material* material_wood;
 	Material* material_bronze;
 	Material* material_cobblestone;
@@ -59,6 +86,7 @@ private:
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShaderNormalMap;
 	SimpleVertexShader* vertexShaderNormalMap;
+	SimpleVertexShader* vertexShaderNormalMapInstanced;
 
 
 	Camera* mainCamera;
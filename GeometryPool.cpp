@@ -0,0 +1,217 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+
+GeometryPool::GeometryPool(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	UINT vertexStride,
+	int vertexCapacity,
+	int indexCapacity,
+	DXGI_FORMAT indexFormat)
+	: vertexAllocator(vertexCapacity), indexAllocator(indexCapacity)
+{
+	this->device = device;
+	this->context = context;
+	this->vertexStride = vertexStride;
+	this->indexFormat = indexFormat;
+	indexSize = (indexFormat == DXGI_FORMAT_R16_UINT) ? sizeof(unsigned short) : sizeof(unsigned int);
+	compactionCount = 0;
+	growCount = 0;
+
+	vertexBuffer = CreateBuffer(D3D11_BIND_VERTEX_BUFFER, vertexStride * vertexCapacity);
+	indexBuffer = CreateBuffer(D3D11_BIND_INDEX_BUFFER, indexSize * indexCapacity);
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeometryPool::CreateBuffer(UINT bindFlags, UINT byteWidth)
+{
+	// Default usage, since meshes are copied in (and moved around)
+	// after creation, but never touched by the CPU otherwise
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = byteWidth;
+	desc.BindFlags = bindFlags;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+	return buffer;
+}
+
+int GeometryPool::Add(const void* vertexData, int vertexCount, const void* indexData, int indexCount)
+{
+	if (vertexCount <= 0 || indexCount <= 0)
+		return -1;
+	if (indexFormat == DXGI_FORMAT_R16_UINT && vertexCount > 65536)
+		return -1;
+
+	int vertexAllocation = vertexAllocator.Allocate(vertexCount);
+	int indexAllocation = indexAllocator.Allocate(indexCount);
+	if (vertexAllocation < 0 || indexAllocation < 0)
+	{
+		vertexAllocator.Free(vertexAllocation);
+		indexAllocator.Free(indexAllocation);
+
+		// Compacting is enough if there's room, just not in one piece,
+		// otherwise make room for the new mesh plus as much again
+		RangeAllocatorStats vertexStats = vertexAllocator.GetStats();
+		RangeAllocatorStats indexStats = indexAllocator.GetStats();
+		int vertexCapacity = vertexStats.capacity;
+		int indexCapacity = indexStats.capacity;
+		if (vertexStats.freeSize < vertexCount)
+			vertexCapacity = std::max(vertexCapacity * 2, vertexStats.usedSize + vertexCount * 2);
+		if (indexStats.freeSize < indexCount)
+			indexCapacity = std::max(indexCapacity * 2, indexStats.usedSize + indexCount * 2);
+		Rebuild(vertexCapacity, indexCapacity);
+
+		vertexAllocation = vertexAllocator.Allocate(vertexCount);
+		indexAllocation = indexAllocator.Allocate(indexCount);
+	}
+
+	// Copy the mesh into its ranges
+	D3D11_BOX box = {};
+	box.bottom = 1;
+	box.back = 1;
+	box.left = vertexAllocator.GetOffset(vertexAllocation) * vertexStride;
+	box.right = box.left + vertexCount * vertexStride;
+	context->UpdateSubresource(vertexBuffer.Get(), 0, &box, vertexData, 0, 0);
+
+	box.left = indexAllocator.GetOffset(indexAllocation) * indexSize;
+	box.right = box.left + indexCount * indexSize;
+	context->UpdateSubresource(indexBuffer.Get(), 0, &box, indexData, 0, 0);
+
+	// Reuse a dead entry if there is one
+	Entry entry = { vertexAllocation, indexAllocation, true };
+	for (int id = 0; id < (int)entries.size(); id++)
+	{
+		if (!entries[id].live)
+		{
+			entries[id] = entry;
+			return id;
+		}
+	}
+	entries.push_back(entry);
+	return (int)entries.size() - 1;
+}
+
+void GeometryPool::Remove(int id)
+{
+	if (id < 0 || id >= (int)entries.size() || !entries[id].live)
+		return;
+
+	vertexAllocator.Free(entries[id].vertexAllocation);
+	indexAllocator.Free(entries[id].indexAllocation);
+	entries[id].live = false;
+}
+
+GeometryRange GeometryPool::GetRange(int id) const
+{
+	const Entry& entry = entries[id];
+	GeometryRange range;
+	range.baseVertex = vertexAllocator.GetOffset(entry.vertexAllocation);
+	range.firstIndex = indexAllocator.GetOffset(entry.indexAllocation);
+	range.indexCount = indexAllocator.GetSize(entry.indexAllocation);
+	return range;
+}
+
+void GeometryPool::Bind(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &vertexStride, &offset);
+	context->IASetIndexBuffer(indexBuffer.Get(), indexFormat, 0);
+}
+
+void GeometryPool::Compact()
+{
+	Rebuild(vertexAllocator.GetStats().capacity, indexAllocator.GetStats().capacity);
+}
+
+void GeometryPool::Rebuild(int vertexCapacity, int indexCapacity)
+{
+	bool growing = vertexCapacity > vertexAllocator.GetStats().capacity || indexCapacity > indexAllocator.GetStats().capacity;
+
+	// Remember where everything was before the allocators move it
+	std::vector<GeometryRange> oldRanges(entries.size());
+	std::vector<int> oldVertexCounts(entries.size());
+	for (int id = 0; id < (int)entries.size(); id++)
+	{
+		if (entries[id].live)
+		{
+			oldRanges[id] = GetRange(id);
+			oldVertexCounts[id] = vertexAllocator.GetSize(entries[id].vertexAllocation);
+		}
+	}
+
+	std::vector<RangeMove> vertexMoves;
+	std::vector<RangeMove> indexMoves;
+	vertexAllocator.Compact(vertexMoves);
+	indexAllocator.Compact(indexMoves);
+	vertexAllocator.Grow(vertexCapacity);
+	indexAllocator.Grow(indexCapacity);
+
+	// Nothing moved and nothing grew - the buffers are fine as they are
+	if (vertexMoves.empty() && indexMoves.empty() && !growing)
+		return;
+	compactionCount += (vertexMoves.empty() && indexMoves.empty()) ? 0 : 1;
+	growCount += growing ? 1 : 0;
+
+	// A buffer can't be copied onto itself, so everything goes into
+	// fresh buffers (the old ones are released once the GPU is done)
+	Microsoft::WRL::ComPtr<ID3D11Buffer> newVertexBuffer = CreateBuffer(D3D11_BIND_VERTEX_BUFFER, vertexStride * vertexCapacity);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> newIndexBuffer = CreateBuffer(D3D11_BIND_INDEX_BUFFER, indexSize * indexCapacity);
+	for (int id = 0; id < (int)entries.size(); id++)
+	{
+		if (!entries[id].live)
+			continue;
+
+		GeometryRange range = GetRange(id);
+		D3D11_BOX box = {};
+		box.bottom = 1;
+		box.back = 1;
+
+		box.left = oldRanges[id].baseVertex * vertexStride;
+		box.right = box.left + oldVertexCounts[id] * vertexStride;
+		context->CopySubresourceRegion(newVertexBuffer.Get(), 0, range.baseVertex * vertexStride, 0, 0, vertexBuffer.Get(), 0, &box);
+
+		box.left = oldRanges[id].firstIndex * indexSize;
+		box.right = box.left + range.indexCount * indexSize;
+		context->CopySubresourceRegion(newIndexBuffer.Get(), 0, range.firstIndex * indexSize, 0, 0, indexBuffer.Get(), 0, &box);
+	}
+
+	vertexBuffer = newVertexBuffer;
+	indexBuffer = newIndexBuffer;
+}
+
+UINT GeometryPool::GetVertexStride() const
+{
+	return vertexStride;
+}
+
+DXGI_FORMAT GeometryPool::GetIndexFormat() const
+{
+	return indexFormat;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Device> GeometryPool::GetDevice() const
+{
+	return device;
+}
+
+RangeAllocatorStats GeometryPool::GetVertexStats() const
+{
+	return vertexAllocator.GetStats();
+}
+
+RangeAllocatorStats GeometryPool::GetIndexStats() const
+{
+	return indexAllocator.GetStats();
+}
+
+int GeometryPool::GetCompactionCount() const
+{
+	return compactionCount;
+}
+
+int GeometryPool::GetGrowCount() const
+{
+	return growCount;
+}
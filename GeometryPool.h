@@ -0,0 +1,93 @@
+#pragma once
+
+#include "RangeAllocator.h"
+#include <d3d11.h>
+#include <vector>
+#include <wrl/client.h>
+
+// Where one mesh lives inside a GeometryPool - pass these
+// straight to DrawIndexed()
+struct GeometryRange
+{
+	int baseVertex;
+	int firstIndex;
+	int indexCount;
+};
+
+// --------------------------------------------------------
+// One big vertex buffer and one big index buffer shared by
+// many static meshes
+//
+// - Every mesh is a range of each buffer, so drawing any of
+//   them only needs the pool bound once
+// - All meshes in a pool share one vertex stride and one index
+//   format; indices are relative to the mesh's own vertices
+//   (DrawIndexed adds baseVertex), so 16-bit indices work for
+//   any mesh with fewer than 65536 vertices
+// - When a new mesh doesn't fit, the pool first compacts (if
+//   fragmentation is the problem) and otherwise doubles
+// - Ids stay valid across compaction and growth - look the
+//   range up with GetRange() whenever it's needed
+// --------------------------------------------------------
+class GeometryPool
+{
+private:
+	struct Entry
+	{
+		int vertexAllocation;
+		int indexAllocation;
+		bool live;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	UINT vertexStride;
+	DXGI_FORMAT indexFormat;
+	UINT indexSize;
+
+	RangeAllocator vertexAllocator;
+	RangeAllocator indexAllocator;
+	std::vector<Entry> entries;
+	int compactionCount;
+	int growCount;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> CreateBuffer(UINT bindFlags, UINT byteWidth);
+
+	// Compacts and/or resizes both buffers, copying every mesh across
+	void Rebuild(int vertexCapacity, int indexCapacity);
+
+public:
+	GeometryPool(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		UINT vertexStride,
+		int vertexCapacity,
+		int indexCapacity,
+		DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT);
+
+	// Copies a mesh into the pool - indexData must already be in the
+	// pool's index format.  Returns an id, or -1 if the mesh can't
+	// go in this pool (16-bit indices with too many vertices)
+	int Add(const void* vertexData, int vertexCount, const void* indexData, int indexCount);
+	void Remove(int id);
+
+	GeometryRange GetRange(int id) const;
+
+	// Binds both buffers - once per frame is enough for every mesh
+	// in the pool
+	void Bind(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	// Squeezes out the holes left by removed meshes
+	void Compact();
+
+	UINT GetVertexStride() const;
+	DXGI_FORMAT GetIndexFormat() const;
+	Microsoft::WRL::ComPtr<ID3D11Device> GetDevice() const;
+
+	RangeAllocatorStats GetVertexStats() const;
+	RangeAllocatorStats GetIndexStats() const;
+	int GetCompactionCount() const;
+	int GetGrowCount() const;
+};
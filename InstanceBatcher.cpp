@@ -0,0 +1,167 @@
+#include "InstanceBatcher.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace
+{
+	// Below this, another packing job costs more than it saves
+	const int MinInstancesPerBuildJob = 16384;
+}
+
+size_t InstanceBatcher::GroupKeyHash::operator()(const GroupKey& key) const
+{
+	size_t hash = std::hash<const void*>()(key.mesh);
+	hash = hash * 31 + std::hash<const void*>()(key.material);
+	hash = hash * 31 + key.indexCount;
+	return hash * 31 + key.firstIndex;
+}
+
+InstanceBatcher::InstanceBatcher()
+{
+	lastKey = { nullptr, nullptr, 0, 0 };
+	lastGroup = -1;
+	bufferCapacity = 0;
+}
+
+void InstanceBatcher::Clear()
+{
+	groupLookup.clear();
+	groups.clear();
+	pending.clear();
+	instances.clear();
+	lastGroup = -1;
+}
+
+void InstanceBatcher::Add(
+	Mesh* mesh,
+	Material* material,
+	unsigned int indexCount,
+	unsigned int firstIndex,
+	const DirectX::XMFLOAT4X4* worldMatrix,
+	float depth)
+{
+	GroupKey key = { mesh, material, indexCount, firstIndex };
+	if (lastGroup < 0 || !(key == lastKey))
+	{
+		auto found = groupLookup.find(key);
+		if (found == groupLookup.end())
+		{
+			found = groupLookup.insert({ key, (int)groups.size() }).first;
+			groups.push_back({ mesh, material, indexCount, firstIndex, 0, 0, depth });
+		}
+		lastKey = key;
+		lastGroup = found->second;
+	}
+
+	InstanceGroup& group = groups[lastGroup];
+	group.instanceCount++;
+	group.depth = std::min(group.depth, depth);
+	pending.push_back({ lastGroup, worldMatrix });
+}
+
+void InstanceBatcher::Build()
+{
+	// Each group's slice of the buffer, in the order groups were made
+	int offset = 0;
+	for (InstanceGroup& group : groups)
+	{
+		group.firstInstance = offset;
+		offset += group.instanceCount;
+	}
+
+	// Then every instance straight into the next free slot of its
+	// group.  Big frames are split into ranges, packed as jobs: each
+	// range first counts its instances in every group, so it knows
+	// where its share of each group starts and add order is kept.
+	int count = (int)pending.size();
+	int groupCount = (int)groups.size();
+	JobSystem& jobs = JobSystem::GetDefault();
+	int rangeCount = std::max(1, std::min(jobs.GetThreadCount(), count / MinInstancesPerBuildJob));
+	rangeCursors.assign((size_t)rangeCount * groupCount, 0);
+	if (rangeCount > 1)
+	{
+		jobs.ParallelRanges(count, rangeCount, [&](int range, int begin, int end)
+		{
+			int* counts = &rangeCursors[(size_t)range * groupCount];
+			for (int i = begin; i < end; i++)
+				counts[pending[i].group]++;
+		});
+	}
+
+	std::vector<DirectX::XMFLOAT4> tints(groupCount);
+	for (int g = 0; g < groupCount; g++)
+	{
+		tints[g] = groups[g].material->GetColorTint();
+		int cursor = groups[g].firstInstance;
+		for (int r = 0; r < rangeCount; r++)
+		{
+			int& slot = rangeCursors[(size_t)r * groupCount + g];
+			int rangeInstances = slot;
+			slot = cursor;
+			cursor += rangeInstances;
+		}
+	}
+
+	instances.resize(count);
+	jobs.ParallelRanges(count, rangeCount, [&](int range, int begin, int end)
+	{
+		int* cursors = &rangeCursors[(size_t)range * groupCount];
+		for (int i = begin; i < end; i++)
+		{
+			const PendingInstance& instance = pending[i];
+			InstanceData& data = instances[cursors[instance.group]++];
+			data.worldMatrix = *instance.worldMatrix;
+			data.colorTint = tints[instance.group];
+		}
+	});
+}
+
+bool InstanceBatcher::Upload(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (instances.empty())
+		return false;
+
+	if ((int)instances.size() > bufferCapacity)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		context->GetDevice(device.GetAddressOf());
+
+		int capacity = std::max((int)instances.size(), std::max(bufferCapacity * 2, 64));
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = capacity * sizeof(InstanceData);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		instanceBuffer.Reset();
+		bufferCapacity = 0;
+		if (FAILED(device->CreateBuffer(&desc, 0, instanceBuffer.GetAddressOf())))
+			return false;
+		bufferCapacity = capacity;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return false;
+	memcpy(mapped.pData, instances.data(), instances.size() * sizeof(InstanceData));
+	context->Unmap(instanceBuffer.Get(), 0);
+	return true;
+}
+
+const std::vector<InstanceGroup>& InstanceBatcher::GetGroups() const
+{
+	return groups;
+}
+
+const std::vector<InstanceData>& InstanceBatcher::GetInstances() const
+{
+	return instances;
+}
+
+ID3D11Buffer* InstanceBatcher::GetBuffer() const
+{
+	return instanceBuffer.Get();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "DXCore.h"
+
+#include "BufferStructs.h"
+#include "Material.h"
+#include "Mesh.h"
+#include <DirectXMath.h>
+#include <unordered_map>
+#include <vector>
+#include <wrl/client.h>
+
+// Draws that can share one DrawIndexedInstanced() - the same
+// mesh, material and index range
+struct InstanceGroup
+{
+	Mesh* mesh;
+	Material* material;
+	unsigned int indexCount;
+	unsigned int firstIndex;
+
+	// The group's instances, back to back in the instance buffer
+	int firstInstance;
+	int instanceCount;
+
+	// Distance to the nearest instance, for sorting
+	float depth;
+};
+
+// --------------------------------------------------------
+// Collects a frame's instanceable draws and packs them into
+// one dynamic instance buffer, grouped by mesh, material
+// and index range
+//
+// - Add() only records where each world matrix lives; Build()
+//   copies every one straight into its group's slot, split
+//   into jobs on the shared JobSystem when there are plenty
+// - The GPU buffer grows (doubling) when a frame needs more,
+//   and is rewritten each frame with WRITE_DISCARD
+// --------------------------------------------------------
+class InstanceBatcher
+{
+	struct GroupKey
+	{
+		Mesh* mesh;
+		Material* material;
+		unsigned int indexCount;
+		unsigned int firstIndex;
+
+		bool operator==(const GroupKey& other) const
+		{
+			return mesh == other.mesh && material == other.material
+				&& indexCount == other.indexCount && firstIndex == other.firstIndex;
+		}
+	};
+
+	struct GroupKeyHash
+	{
+		size_t operator()(const GroupKey& key) const;
+	};
+
+	struct PendingInstance
+	{
+		int group;
+		const DirectX::XMFLOAT4X4* worldMatrix;
+	};
+
+	std::unordered_map<GroupKey, int, GroupKeyHash> groupLookup;
+	std::vector<InstanceGroup> groups;
+	std::vector<PendingInstance> pending;
+	std::vector<InstanceData> instances;
+
+	// Where each of Build()'s ranges writes its next instance of each
+	// group, range by range
+	std::vector<int> rangeCursors;
+
+	// Neighbouring entities often share a group, so the last one is
+	// checked before the hash map
+	GroupKey lastKey;
+	int lastGroup;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	int bufferCapacity;
+
+public:
+	InstanceBatcher();
+
+	void Clear();
+
+	// One instance of the mesh's [firstIndex, firstIndex + indexCount)
+	// range - worldMatrix has to stay where it is until Build()
+	void Add(
+		Mesh* mesh,
+		Material* material,
+		unsigned int indexCount,
+		unsigned int firstIndex,
+		const DirectX::XMFLOAT4X4* worldMatrix,
+		float depth);
+
+	// Packs the instances group by group, each with its material's tint
+	// - within a group they stay in the order they were added
+	void Build();
+
+	// Copies the packed instances to the GPU - false if there are none
+	// (or the buffer couldn't be made)
+	bool Upload(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	const std::vector<InstanceGroup>& GetGroups() const;
+	const std::vector<InstanceData>& GetInstances() const;
+	ID3D11Buffer* GetBuffer() const;
+};
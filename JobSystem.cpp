@@ -0,0 +1,393 @@
+#include "JobSystem.h"
+
+namespace
+{
+	// Which system (and which of its workers) the calling thread is
+	struct ThreadIdentity
+	{
+		const JobSystem* system = nullptr;
+		WorkStealingQueue* queue = nullptr;
+		uint32_t random = 0x9E3779B9u;
+	};
+	thread_local ThreadIdentity identity;
+
+	// Jobs this thread has finished running, ready to be reused - they
+	// move between threads through the queues, so one thread's list
+	// can grow from another's allocations
+	struct JobFreeList
+	{
+		std::vector<Job*> jobs;
+		~JobFreeList()
+		{
+			for (Job* job : jobs)
+				delete job;
+		}
+	};
+	thread_local JobFreeList freeJobs;
+
+	// How many failed searches a worker spins through before sleeping
+	const int SpinsBeforeSleeping = 64;
+}
+
+WorkStealingQueue::WorkStealingQueue()
+{
+	top.store(0, std::memory_order_relaxed);
+	bottom.store(0, std::memory_order_relaxed);
+	for (std::atomic<Job*>& slot : slots)
+		slot.store(nullptr, std::memory_order_relaxed);
+}
+
+bool WorkStealingQueue::Push(Job* job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= Capacity)
+		return false;
+
+	slots[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* WorkStealingQueue::Pop()
+{
+	// Claim the bottom slot first, so thieves see it's taken
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Already empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = slots[b & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// The last one - a thief could be after it too
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingQueue::Steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return nullptr;
+
+	Job* job = slots[t & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+bool WorkStealingQueue::IsEmpty() const
+{
+	return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+JobCounter::JobCounter()
+{
+	count.store(0, std::memory_order_relaxed);
+}
+
+JobCounter::~JobCounter()
+{
+	// The job that took the count to zero may not have let go yet
+	std::lock_guard<std::mutex> lock(mutex);
+}
+
+bool JobCounter::IsDone() const
+{
+	return count.load(std::memory_order_acquire) == 0;
+}
+
+int JobCounter::GetCount() const
+{
+	return count.load(std::memory_order_acquire);
+}
+
+JobSystem::JobSystem(int workerCount)
+{
+	if (workerCount < 0)
+		workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+	sharedCount.store(0);
+	backgroundCount.store(0);
+	queuedCount.store(0);
+	sleepingCount.store(0);
+	stopping.store(false);
+
+	// Every queue exists before any worker starts stealing
+	for (int i = 0; i < workerCount; i++)
+		queues.push_back(new WorkStealingQueue());
+	for (int i = 0; i < workerCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	// Workers finish whatever's still queued before they exit
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping.store(true);
+	}
+	wake.notify_all();
+	for (std::thread& t : workers)
+		t.join();
+	for (WorkStealingQueue* queue : queues)
+		delete queue;
+}
+
+int JobSystem::GetThreadCount() const
+{
+	return (int)workers.size() + 1;
+}
+
+int JobSystem::GetWorkerCount() const
+{
+	return (int)workers.size();
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+	identity.system = this;
+	identity.queue = queues[index];
+	identity.random = 0x9E3779B9u * (uint32_t)(index + 1);
+
+	int idleSpins = 0;
+	while (true)
+	{
+		Job* job = FindJob(true);
+		if (job != nullptr)
+		{
+			Execute(job);
+			idleSpins = 0;
+			continue;
+		}
+		if (stopping.load())
+			return;
+		if (++idleSpins < SpinsBeforeSleeping)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Nothing anywhere - sleep until something's queued.  Counting
+		// ourselves as asleep before checking means Enqueue() either
+		// sees us or we see its job.
+		idleSpins = 0;
+		sleepingCount.fetch_add(1);
+		{
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this] { return queuedCount.load() > 0 || stopping.load(); });
+		}
+		sleepingCount.fetch_sub(1);
+	}
+}
+
+WorkStealingQueue* JobSystem::GetLocalQueue() const
+{
+	return identity.system == this ? identity.queue : nullptr;
+}
+
+Job* JobSystem::AllocateJob()
+{
+	if (freeJobs.jobs.empty())
+		return new Job();
+	Job* job = freeJobs.jobs.back();
+	freeJobs.jobs.pop_back();
+	return job;
+}
+
+void JobSystem::FreeJob(Job* job)
+{
+	freeJobs.jobs.push_back(job);
+}
+
+void JobSystem::Schedule(Job* job, JobCounter* after)
+{
+	// Held by the counter it's waiting on, unless that's already done
+	// - the lock orders this against the job that takes it to zero
+	if (after != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(after->mutex);
+		if (after->count.load(std::memory_order_acquire) > 0)
+		{
+			after->dependents.push_back(job);
+			return;
+		}
+	}
+	Enqueue(job);
+}
+
+void JobSystem::Enqueue(Job* job)
+{
+	queuedCount.fetch_add(1);
+
+	// On a full queue there's no waiting for room - it just runs now
+	WorkStealingQueue* local = GetLocalQueue();
+	if (local != nullptr)
+	{
+		if (!local->Push(job))
+		{
+			queuedCount.fetch_sub(1);
+			Execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		sharedQueue.push_back(job);
+		sharedCount.fetch_add(1);
+	}
+
+	if (sleepingCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+void JobSystem::EnqueueBackground(Job* job)
+{
+	queuedCount.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		backgroundQueue.push_back(job);
+		backgroundCount.fetch_add(1);
+	}
+
+	if (sleepingCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+Job* JobSystem::FindJob(bool includeBackground)
+{
+	// Our own newest job first, while it's still in cache
+	WorkStealingQueue* local = GetLocalQueue();
+	Job* job = local != nullptr ? local->Pop() : nullptr;
+
+	// Then the shared queue - workers take its oldest job, the other
+	// threads its newest, which is most likely the one they're waiting
+	// for - then the other workers
+	if (job == nullptr && sharedCount.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		if (!sharedQueue.empty() && local != nullptr)
+		{
+			job = sharedQueue.front();
+			sharedQueue.pop_front();
+		}
+		else if (!sharedQueue.empty())
+		{
+			job = sharedQueue.back();
+			sharedQueue.pop_back();
+		}
+		if (job != nullptr)
+			sharedCount.fetch_sub(1);
+	}
+	int queueCount = (int)queues.size();
+	if (job == nullptr && queueCount > 0)
+	{
+		uint32_t& random = identity.random;
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		int first = (int)(random % (uint32_t)queueCount);
+		for (int i = 0; i < queueCount && job == nullptr; i++)
+		{
+			WorkStealingQueue* victim = queues[(first + i) % queueCount];
+			if (victim != local)
+				job = victim->Steal();
+		}
+	}
+
+	// Only when there's nothing else to do
+	if (job == nullptr && includeBackground && backgroundCount.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		if (!backgroundQueue.empty())
+		{
+			job = backgroundQueue.front();
+			backgroundQueue.pop_front();
+			backgroundCount.fetch_sub(1);
+		}
+	}
+
+	if (job != nullptr)
+		queuedCount.fetch_sub(1);
+	return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->function(job);
+
+	JobCounter* counter = job->counter;
+	FreeJob(job);
+	if (counter == nullptr)
+		return;
+
+	// Anything but the last job just counts down
+	int count = counter->count.load(std::memory_order_relaxed);
+	while (count > 1)
+	{
+		if (counter->count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+			return;
+	}
+
+	// The last one takes the lock first, so the counter isn't destroyed
+	// under it (see ~JobCounter()), and releases what's waiting on it
+	std::vector<Job*> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			released.swap(counter->dependents);
+	}
+	for (Job* dependent : released)
+		Enqueue(dependent);
+}
+
+bool JobSystem::IsLocalQueueEmpty() const
+{
+	WorkStealingQueue* local = GetLocalQueue();
+	return local != nullptr ? local->IsEmpty() : sharedCount.load(std::memory_order_relaxed) == 0;
+}
+
+void JobSystem::Wait(JobCounter& counter, bool runBackground)
+{
+	while (!counter.IsDone())
+	{
+		if (!TryRunJob(runBackground))
+			std::this_thread::yield();
+	}
+}
+
+bool JobSystem::TryRunJob(bool runBackground)
+{
+	Job* job = FindJob(runBackground);
+	if (job == nullptr)
+		return false;
+	Execute(job);
+	return true;
+}
+
+JobSystem& JobSystem::GetDefault()
+{
+	static JobSystem system;
+	return system;
+}
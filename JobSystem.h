@@ -0,0 +1,305 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+class JobCounter;
+
+// A unit of work - function(job) runs it, and what the other fields
+// mean is up to the function
+struct Job
+{
+	void (*function)(Job* job);
+	void* data;
+	int begin;
+	int end;
+	JobCounter* counter;
+};
+
+// --------------------------------------------------------
+// A Chase-Lev work-stealing deque of jobs (Chase & Lev 2005,
+// with the C11 memory orderings of Le et al. 2013)
+//
+// - Only its owner pushes and pops, at the bottom, newest
+//   first; any thread can steal from the top, oldest first
+// - Fixed capacity - Push() returns false once it's full
+// --------------------------------------------------------
+class WorkStealingQueue
+{
+public:
+	static const int Capacity = 4096;
+
+private:
+	std::atomic<int64_t> top;
+	std::atomic<int64_t> bottom;
+	std::atomic<Job*> slots[Capacity];
+
+public:
+	WorkStealingQueue();
+
+	// Owner only
+	bool Push(Job* job);
+	Job* Pop();
+
+	// Any thread - null if it's empty or another thread won the race
+	Job* Steal();
+
+	// Only a hint when other threads are using it
+	bool IsEmpty() const;
+};
+
+// --------------------------------------------------------
+// Counts jobs that haven't finished yet
+//
+// - Every job given one when it's started adds one, and takes
+//   it away again once it has run
+// - Jobs can be started to run only once a counter gets to
+//   zero (see JobSystem::Run()) - that's how they depend on
+//   each other
+// - Once it's at zero it can be used again
+// --------------------------------------------------------
+class JobCounter
+{
+	friend class JobSystem;
+
+	std::atomic<int> count;
+
+	// Jobs waiting for this one to get to zero
+	std::mutex mutex;
+	std::vector<Job*> dependents;
+
+public:
+	JobCounter();
+	~JobCounter();
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const;
+	int GetCount() const;
+};
+
+// --------------------------------------------------------
+// Runs jobs on a set of worker threads
+//
+// - Each worker has a WorkStealingQueue: the jobs it starts
+//   go on its own queue, and when that's empty it steals from
+//   a random other worker.  Threads that aren't workers (like
+//   the main thread) share one locked queue instead.
+// - Waiting never blocks: Wait() runs other jobs (its own
+//   first, if it's a worker) until the counter gets to zero,
+//   so jobs can start jobs and wait for them without tying up
+//   a thread.  Idle workers sleep until there's work.
+// - ParallelFor() splits a range lazily: a job only hands half
+//   of what's left to its queue when that queue is empty, so
+//   the range only gets cut up as finely as idle workers need
+//   (no finer than minGrain).  With nobody stealing, it's a
+//   plain loop on the calling thread.
+// - A waiting thread may pick up any job started with Run(),
+//   including a long one, before it gets back to what it was
+//   waiting for.  Long jobs that nothing per-frame waits on
+//   (loading files, say) go through RunBackground() instead:
+//   only idle workers take those, so a Wait() or ParallelFor()
+//   never ends up running one.
+// --------------------------------------------------------
+class JobSystem
+{
+private:
+	std::vector<std::thread> workers;
+	std::vector<WorkStealingQueue*> queues;
+
+	// For threads that aren't workers
+	std::mutex sharedMutex;
+	std::deque<Job*> sharedQueue;
+	std::atomic<int> sharedCount;
+
+	// RunBackground() jobs, oldest first - under sharedMutex too
+	std::deque<Job*> backgroundQueue;
+	std::atomic<int> backgroundCount;
+
+	// Sleeping workers are woken whenever a job is queued
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queuedCount;
+	std::atomic<int> sleepingCount;
+	std::atomic<bool> stopping;
+
+	void WorkerLoop(int index);
+
+	// The calling thread's queue, or null if it isn't one of ours
+	WorkStealingQueue* GetLocalQueue() const;
+
+	// Jobs come from (and go back to) a per-thread free list
+	static Job* AllocateJob();
+	static void FreeJob(Job* job);
+
+	// Queues a job that's ready to run, or holds it until after's count
+	// gets to zero
+	void Schedule(Job* job, JobCounter* after);
+	void Enqueue(Job* job);
+	void EnqueueBackground(Job* job);
+
+	// Background jobs are only looked for once there's nothing else
+	Job* FindJob(bool includeBackground);
+	void Execute(Job* job);
+	bool IsLocalQueueEmpty() const;
+
+	template<typename Fn>
+	struct ForState
+	{
+		JobSystem* system;
+		const Fn* fn;
+		int grain;
+		JobCounter counter;
+	};
+
+	// Runs [begin, end) of a ParallelFor(), handing the back half to
+	// the queue whenever it's run dry - only while there's at least
+	// two grains left, so neither half (nor the last piece) ends up
+	// smaller than one
+	template<typename Fn>
+	static void RunRange(ForState<Fn>& state, int begin, int end)
+	{
+		while (end - begin - state.grain >= state.grain)
+		{
+			if (state.system->IsLocalQueueEmpty())
+			{
+				int middle = begin + (end - begin) / 2;
+				Job* job = AllocateJob();
+				job->function = &RunRangeJob<Fn>;
+				job->data = &state;
+				job->begin = middle;
+				job->end = end;
+				job->counter = &state.counter;
+				state.counter.count.fetch_add(1, std::memory_order_relaxed);
+				state.system->Enqueue(job);
+				end = middle;
+			}
+			else
+			{
+				(*state.fn)(begin, begin + state.grain);
+				begin += state.grain;
+			}
+		}
+		if (begin < end)
+			(*state.fn)(begin, end);
+	}
+
+	template<typename Fn>
+	static void RunRangeJob(Job* job)
+	{
+		RunRange(*(ForState<Fn>*)job->data, job->begin, job->end);
+	}
+
+	template<typename Fn>
+	static void RunCallable(Job* job)
+	{
+		Fn* fn = (Fn*)job->data;
+		(*fn)();
+		delete fn;
+	}
+
+public:
+	// workerCount of -1 means one less than the hardware threads (the
+	// calling thread helps out whenever it waits), but at least one
+	// - 0 runs everything on whichever thread waits for it
+	JobSystem(int workerCount = -1);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Workers plus the thread that waits
+	int GetThreadCount() const;
+	int GetWorkerCount() const;
+
+	// Starts fn() as a job - counter (if given) goes up by one until it
+	// has run, and it doesn't start until after (if given) is at zero
+	template<typename Fn>
+	void Run(Fn fn, JobCounter* counter = nullptr, JobCounter* after = nullptr)
+	{
+		Job* job = AllocateJob();
+		job->function = &RunCallable<Fn>;
+		job->data = new Fn(std::move(fn));
+		job->begin = 0;
+		job->end = 0;
+		job->counter = counter;
+		if (counter != nullptr)
+			counter->count.fetch_add(1, std::memory_order_relaxed);
+		Schedule(job, after);
+	}
+
+	// Starts fn() as a background job - only a worker with nothing else
+	// to do runs it (or a thread that asks to, see Wait()).  For long
+	// work nothing per-frame waits on.
+	template<typename Fn>
+	void RunBackground(Fn fn, JobCounter* counter = nullptr)
+	{
+		Job* job = AllocateJob();
+		job->function = &RunCallable<Fn>;
+		job->data = new Fn(std::move(fn));
+		job->begin = 0;
+		job->end = 0;
+		job->counter = counter;
+		if (counter != nullptr)
+			counter->count.fetch_add(1, std::memory_order_relaxed);
+		EnqueueBackground(job);
+	}
+
+	// Runs jobs until counter gets to zero - background jobs too, if
+	// runBackground is set (which waiting on one with no workers needs)
+	void Wait(JobCounter& counter, bool runBackground = false);
+
+	// Runs one queued job on this thread - false if there wasn't one
+	bool TryRunJob(bool runBackground = false);
+
+	// Calls fn(begin, end) over pieces of [0, count), no smaller than
+	// minGrain (unless count itself is), and returns once they've all run
+	template<typename Fn>
+	void ParallelFor(int count, int minGrain, const Fn& fn)
+	{
+		minGrain = std::max(1, minGrain);
+		if (count <= minGrain || workers.empty())
+		{
+			if (count > 0)
+				fn(0, count);
+			return;
+		}
+
+		ForState<Fn> state;
+		state.system = this;
+		state.fn = &fn;
+		state.grain = minGrain;
+		RunRange(state, 0, count);
+		Wait(state.counter);
+	}
+
+	// Splits [0, count) into rangeCount contiguous ranges and calls
+	// fn(range, begin, end) on each, for work that keeps something
+	// per range (partial sums, say)
+	template<typename Fn>
+	void ParallelRanges(int count, int rangeCount, const Fn& fn)
+	{
+		rangeCount = std::max(1, rangeCount);
+		int perRange = (count + rangeCount - 1) / rangeCount;
+		ParallelFor(rangeCount, 1, [&](int first, int last)
+		{
+			for (int r = first; r < last; r++)
+			{
+				int begin = std::min(count, r * perRange);
+				fn(r, begin, std::min(count, begin + perRange));
+			}
+		});
+	}
+
+	// The system everything in the engine shares
+	static JobSystem& GetDefault();
+};
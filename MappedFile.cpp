@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const char* fileName)
+{
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+	data = nullptr;
+	size = 0;
+
+	// Sequential scan lets the OS read ahead aggressively
+	// - Others may still write while it's mapped (MeshCache patches
+	//   its own header in place), or rename a new file over it (a
+	//   re-cooked cache replacing the one being read)
+	fileHandle = CreateFileA(
+		fileName,
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+		return;
+	size = (size_t)fileSize.QuadPart;
+
+	// Empty files can't be mapped, but they are still "open"
+	if (size == 0)
+		return;
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		size = 0;
+		return;
+	}
+
+	data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+		size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+}
+
+bool MappedFile::IsOpen() const
+{
+	return fileHandle != INVALID_HANDLE_VALUE;
+}
+
+const char* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// A read-only, memory-mapped view of an entire file
+//
+// - The OS pages the file in on demand, so nothing is copied
+//   into our own buffers up front
+// - The view stays valid until this object is destroyed
+// --------------------------------------------------------
+class MappedFile
+{
+private:
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+	const char* data;
+	size_t size;
+
+public:
+	MappedFile(const char* fileName);
+	~MappedFile();
+
+	// Not copyable - we own the OS handles
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen() const;
+	const char* GetData() const;
+	size_t GetSize() const;
+};
@@ -14,6 +14,7 @@ Material::Material(
 	colorTint = tintInit;
 	pixelShader = pixelShaderInit;
 	vertexShader = vertexShaderInit;
+	instancedVertexShader = nullptr;
 	specularity = specularityInit;
 	srv = srvInit;
 	samplerState = samplerStateInit;
@@ -32,6 +33,16 @@ SimplePixelShader* Material::GetPixelShader()
 	return pixelShader;
 }
 
+SimpleVertexShader* Material::GetInstancedVertexShader()
+{
+	return instancedVertexShader;
+}
+
+void Material::SetInstancedVertexShader(SimpleVertexShader* value)
+{
+	instancedVertexShader = value;
+}
+
 DirectX::XMFLOAT4 Material::GetColorTint()
 {
 	return colorTint;
@@ -10,6 +10,7 @@ class Material
 	float specularity;
 	SimplePixelShader* pixelShader;
 	SimpleVertexShader* vertexShader;
+	SimpleVertexShader* instancedVertexShader;
 	ID3D11ShaderResourceView* srv;
 	ID3D11ShaderResourceView* srvNormal;
 	ID3D11ShaderResourceView* srvRoughness;
@@ -31,6 +32,13 @@ public:
 
 	SimpleVertexShader* GetVertexShader();
 	SimplePixelShader* GetPixelShader();
+
+	// The same vertex shader, taking its world matrix and tint per
+	// instance (see InstanceData) - null if the material can't be
+	// instanced, which it can't until one is given
+	SimpleVertexShader* GetInstancedVertexShader();
+	void SetInstancedVertexShader(SimpleVertexShader* value);
+
 	DirectX::XMFLOAT4 GetColorTint();
 	float GetSpecularity() const;
 	void SetColorTint(DirectX::XMFLOAT4 value);
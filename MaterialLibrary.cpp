@@ -0,0 +1,153 @@
+#include "MaterialLibrary.h"
+#include "WICTextureLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+using namespace DirectX;
+
+namespace
+{
+	unsigned char ToUnorm8(float value)
+	{
+		return (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+MaterialLibrary::MaterialLibrary(
+	const std::vector<std::string>& mtlFileNames,
+	SimplePixelShader* pixelShader,
+	SimpleVertexShader* vertexShader,
+	ID3D11SamplerState* samplerState,
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	std::vector<ObjMaterial> parsed;
+	for (const std::string& fileName : mtlFileNames)
+	{
+		if (!ObjLoader::LoadMaterials(fileName.c_str(), parsed))
+			printf("Could not open material library %s\n", fileName.c_str());
+	}
+
+	for (const ObjMaterial& m : parsed)
+	{
+		// Constants stand in for any map that isn't there
+		ID3D11ShaderResourceView* albedo = LoadTexture(m.diffuseMap, GetConstantTexture(XMFLOAT4(1, 1, 1, 1), device), device, context);
+		ID3D11ShaderResourceView* normal = LoadTexture(m.normalMap, GetConstantTexture(XMFLOAT4(0.5f, 0.5f, 1, 1), device), device, context);
+		ID3D11ShaderResourceView* roughness = LoadTexture(m.roughnessMap, GetConstantTexture(XMFLOAT4(m.roughness, m.roughness, m.roughness, 1), device), device, context);
+		ID3D11ShaderResourceView* metalness = LoadTexture(m.metalnessMap, GetConstantTexture(XMFLOAT4(m.metalness, m.metalness, m.metalness, 1), device), device, context);
+
+		// Smoother surfaces are shinier
+		names.push_back(m.name);
+		materials.push_back(new Material(
+			XMFLOAT4(m.diffuseColor.x, m.diffuseColor.y, m.diffuseColor.z, m.opacity),
+			1.0f - std::min(std::max(m.roughness, 0.0f), 1.0f),
+			pixelShader,
+			vertexShader,
+			albedo,
+			samplerState,
+			normal,
+			roughness,
+			metalness));
+	}
+
+	printf("Loaded %d materials (%d textures) from %d material libraries\n",
+		(int)materials.size(), (int)textures.size(), (int)mtlFileNames.size());
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+	for (Material* m : materials)
+		delete m;
+}
+
+ID3D11ShaderResourceView* MaterialLibrary::LoadTexture(const std::string& path, ID3D11ShaderResourceView* fallback, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (path.empty())
+		return fallback;
+
+	auto existing = textures.find(path);
+	if (existing != textures.end())
+		return existing->second.Get() != nullptr ? existing->second.Get() : fallback;
+
+	// Failures are remembered too, so a missing file is only tried once
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(CreateWICTextureFromFile(device.Get(), context.Get(), std::filesystem::path(path).wstring().c_str(), nullptr, srv.GetAddressOf())))
+	{
+		printf("Could not load texture %s\n", path.c_str());
+		srv = nullptr;
+	}
+	textures[path] = srv;
+	return srv.Get() != nullptr ? srv.Get() : fallback;
+}
+
+ID3D11ShaderResourceView* MaterialLibrary::GetConstantTexture(XMFLOAT4 value, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	unsigned char texel[4] = { ToUnorm8(value.x), ToUnorm8(value.y), ToUnorm8(value.z), ToUnorm8(value.w) };
+	std::string key = "#" + std::to_string(texel[0]) + "," + std::to_string(texel[1]) + "," + std::to_string(texel[2]) + "," + std::to_string(texel[3]);
+
+	auto existing = textures.find(key);
+	if (existing != textures.end())
+		return existing->second.Get();
+
+	// A single, immutable texel
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = texel;
+	initialData.SysMemPitch = sizeof(texel);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	device->CreateTexture2D(&desc, &initialData, texture.GetAddressOf());
+	if (texture.Get() != nullptr)
+		device->CreateShaderResourceView(texture.Get(), nullptr, srv.GetAddressOf());
+
+	textures[key] = srv;
+	return srv.Get();
+}
+
+int MaterialLibrary::GetMaterialCount() const
+{
+	return (int)materials.size();
+}
+
+Material* MaterialLibrary::GetMaterial(int index) const
+{
+	return materials[index];
+}
+
+const std::string& MaterialLibrary::GetMaterialName(int index) const
+{
+	return names[index];
+}
+
+Material* MaterialLibrary::Find(const std::string& name) const
+{
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (names[i] == name)
+			return materials[i];
+	}
+	return nullptr;
+}
+
+std::vector<Material*> MaterialLibrary::GetSubmeshMaterials(const Mesh* mesh, Material* fallback) const
+{
+	std::vector<Material*> result;
+	for (int s = 0; s < mesh->GetSubmeshCount(); s++)
+	{
+		Material* m = Find(mesh->GetSubmeshMaterial(s));
+		result.push_back(m != nullptr ? m : fallback);
+	}
+	return result;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "DXCore.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "ObjLoader.h"
+#include "d3d11.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// The Materials described by one or more MTL files
+//
+// - Every "newmtl" becomes a Material using the given shaders
+//   and sampler, tinted by its Kd color and d opacity
+// - Each texture map is loaded once, however many materials
+//   share it.  A map the MTL doesn't give (or that fails to
+//   load) becomes a 1x1 texture of the MTL's constant instead:
+//   white albedo, a flat normal, and Pr / Pm (or the roughness
+//   derived from Ns) for roughness and metalness
+// - Owns its Materials and textures, so it has to outlive any
+//   entity drawing with them
+// --------------------------------------------------------
+class MaterialLibrary
+{
+private:
+	std::vector<std::string> names;
+	std::vector<Material*> materials;
+
+	// Shared textures, by file path (or "#r,g,b,a" for constants)
+	std::map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textures;
+
+	ID3D11ShaderResourceView* LoadTexture(
+		const std::string& path,
+		ID3D11ShaderResourceView* fallback,
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	ID3D11ShaderResourceView* GetConstantTexture(
+		DirectX::XMFLOAT4 value,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+
+public:
+	// mtlFileNames is usually a mesh's GetMaterialLibraries() - files
+	// that can't be opened are skipped
+	MaterialLibrary(
+		const std::vector<std::string>& mtlFileNames,
+		SimplePixelShader* pixelShader,
+		SimpleVertexShader* vertexShader,
+		ID3D11SamplerState* samplerState,
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~MaterialLibrary();
+
+	MaterialLibrary(const MaterialLibrary&) = delete;
+	MaterialLibrary& operator=(const MaterialLibrary&) = delete;
+
+	int GetMaterialCount() const;
+	Material* GetMaterial(int index) const;
+	const std::string& GetMaterialName(int index) const;
+
+	// Null if there's no material with that name
+	Material* Find(const std::string& name) const;
+
+	// The material for each of a (resident) mesh's submeshes, in order,
+	// ready for a MeshRenderer - unknown names get "fallback"
+	std::vector<Material*> GetSubmeshMaterials(const Mesh* mesh, Material* fallback) const;
+};
@@ -1,9 +1,89 @@
 #include "Mesh.h"
-#include <fstream>
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <climits>
 #include <vector>
 
 using namespace DirectX;
 
+namespace
+{
+	// Below these, another job costs more than it saves
+	const int MinTrianglesPerThread = 32768;
+	const int MinVerticesPerThread = 32768;
+
+	int RangeCountFor(int count, int minPerRange)
+	{
+		int threadCount = JobSystem::GetDefault().GetThreadCount();
+		return std::max(1, std::min(threadCount, count / minPerRange));
+	}
+
+	// Adds the tangents of triangles [begin, end) into the XMFLOAT3 at
+	// sums + (index - firstVertex) * stride, four triangles at a time
+	void AccumulateTangents(const Vertex* verts, const unsigned int* indices, int begin, int end, char* sums, size_t stride, unsigned int firstVertex)
+	{
+		XMFLOAT4 tangentX, tangentY, tangentZ;
+		float* lanes[3] = { &tangentX.x, &tangentY.x, &tangentZ.x };
+
+		for (int t = begin; t < end; t += 4)
+		{
+			int count = std::min(4, end - t);
+
+			// Gather the corners into SoA lanes (unused lanes repeat the last triangle)
+			XMFLOAT4 px[3], py[3], pz[3], u[3], v[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const Vertex& a = verts[indices[(t + std::min(0, count - 1)) * 3 + corner]];
+				const Vertex& b = verts[indices[(t + std::min(1, count - 1)) * 3 + corner]];
+				const Vertex& c = verts[indices[(t + std::min(2, count - 1)) * 3 + corner]];
+				const Vertex& d = verts[indices[(t + std::min(3, count - 1)) * 3 + corner]];
+				px[corner] = XMFLOAT4(a.Position.x, b.Position.x, c.Position.x, d.Position.x);
+				py[corner] = XMFLOAT4(a.Position.y, b.Position.y, c.Position.y, d.Position.y);
+				pz[corner] = XMFLOAT4(a.Position.z, b.Position.z, c.Position.z, d.Position.z);
+				u[corner] = XMFLOAT4(a.UV.x, b.UV.x, c.UV.x, d.UV.x);
+				v[corner] = XMFLOAT4(a.UV.y, b.UV.y, c.UV.y, d.UV.y);
+			}
+
+			XMVECTOR x0 = XMLoadFloat4(&px[0]), y0 = XMLoadFloat4(&py[0]), z0 = XMLoadFloat4(&pz[0]);
+			XMVECTOR x1 = XMVectorSubtract(XMLoadFloat4(&px[1]), x0);
+			XMVECTOR y1 = XMVectorSubtract(XMLoadFloat4(&py[1]), y0);
+			XMVECTOR z1 = XMVectorSubtract(XMLoadFloat4(&pz[1]), z0);
+			XMVECTOR x2 = XMVectorSubtract(XMLoadFloat4(&px[2]), x0);
+			XMVECTOR y2 = XMVectorSubtract(XMLoadFloat4(&py[2]), y0);
+			XMVECTOR z2 = XMVectorSubtract(XMLoadFloat4(&pz[2]), z0);
+
+			XMVECTOR u0 = XMLoadFloat4(&u[0]), v0 = XMLoadFloat4(&v[0]);
+			XMVECTOR s1 = XMVectorSubtract(XMLoadFloat4(&u[1]), u0);
+			XMVECTOR t1 = XMVectorSubtract(XMLoadFloat4(&v[1]), v0);
+			XMVECTOR s2 = XMVectorSubtract(XMLoadFloat4(&u[2]), u0);
+			XMVECTOR t2 = XMVectorSubtract(XMLoadFloat4(&v[2]), v0);
+
+			// Degenerate UVs get r = 0 instead of infinity
+			XMVECTOR det = XMVectorSubtract(XMVectorMultiply(s1, t2), XMVectorMultiply(s2, t1));
+			XMVECTOR r = XMVectorSelect(XMVectorZero(), XMVectorReciprocal(det), XMVectorNotEqual(det, XMVectorZero()));
+
+			XMStoreFloat4(&tangentX, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, x1), XMVectorMultiply(t1, x2)), r));
+			XMStoreFloat4(&tangentY, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, y1), XMVectorMultiply(t1, y2)), r));
+			XMStoreFloat4(&tangentZ, XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, z1), XMVectorMultiply(t1, z2)), r));
+
+			for (int lane = 0; lane < count; lane++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					XMFLOAT3* sum = (XMFLOAT3*)(sums + (indices[(t + lane) * 3 + corner] - firstVertex) * stride);
+					sum->x += lanes[0][lane];
+					sum->y += lanes[1][lane];
+					sum->z += lanes[2][lane];
+				}
+			}
+		}
+	}
+}
+
 Mesh::Mesh(
 	Vertex* vertexArray,
 	int vertexArrayCount,
@@ -11,173 +91,78 @@ Mesh::Mesh(
 	int indexArrayCount,
 	Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
+	compactVertices = false;
+	resident = false;
+	pool = nullptr;
+	poolId = -1;
 	CreateBuffers(vertexArray, vertexArrayCount, indexArray, indexArrayCount, device);
 }
 
-Mesh::Mesh(const char* fileName, Microsoft::WRL::ComPtr<ID3D11Device> device)
+Mesh::Mesh(const char* fileName, Microsoft::WRL::ComPtr<ID3D11Device> device, bool compactVertices)
+	: Mesh(compactVertices)
 {
-	// NOTE: You'll need to #include <fstream>
-
-	// File input object
-	std::ifstream obj(fileName);
+	MeshData data;
+	if (LoadData(fileName, compactVertices, data))
+		CreateBuffers(data, device);
+}
 
-	// Check for successful open
-	if (!obj.is_open())
-		return;
+Mesh::Mesh(bool compactVertices)
+{
+	this->compactVertices = compactVertices;
+	resident = false;
+	pool = nullptr;
+	poolId = -1;
+	vertexCount = 0;
+	indexCount = 0;
+	vertexStride = compactVertices ? sizeof(PackedVertex) : sizeof(Vertex);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	bounds = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) };
+	boundingSphere = { XMFLOAT3(0, 0, 0), 0.0f };
+}
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
+Mesh::~Mesh()
+{
+	if (pool != nullptr)
+		pool->Remove(poolId);
+}
 
-	// Still have data left?
-	while (obj.good())
+bool Mesh::LoadData(const char* fileName, bool compactVertices, MeshData& data)
+{
+	// Is there an up-to-date binary cache?  If so, its vertex and
+	// index blobs are ready to go - no parsing, no tangents
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
+		MeshCache cache(fileName);
+		if (cache.IsValid())
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			//  If the model is missing any of these, this 
-			//  code will not handle the file correctly!
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
+			PrepareData(cache.GetVertices(), cache.GetVertexCount(), cache.GetIndices(), cache.GetIndexCount(), cache.GetLods(), cache.GetLodCount(), compactVertices, data,
+				cache.GetSubmeshLods(), cache.GetSubmeshCount());
+			for (int i = 0; i < cache.GetSubmeshCount(); i++)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
+				data.submeshNames[i] = cache.GetSubmeshName(i);
+				data.submeshMaterials[i] = cache.GetSubmeshMaterial(i);
 			}
+			for (int i = 0; i < cache.GetMaterialLibraryCount(); i++)
+				data.materialLibraries.push_back(cache.GetMaterialLibrary(i));
+			return true;
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	// Variables filled in by the loader
+	std::vector<Vertex> verts;           // Verts we're assembling
+	std::vector<UINT> indices;           // Indices of these verts
+	std::vector<ObjSubmesh> submeshes;   // Material groups within the indices
+	std::vector<std::string> materialLibraries;
+
+	// Parse the file (bail if it couldn't be opened)
+	if (!ObjLoader::Load(fileName, verts, indices, &submeshes, &materialLibraries) || verts.empty())
+		return false;
 
+	// Reorder for the post-transform cache, overdraw and vertex fetch,
+	// keeping each material group in one piece
+	std::vector<MeshLod> submeshRanges;
+	for (const ObjSubmesh& submesh : submeshes)
+		submeshRanges.push_back({ submesh.firstIndex, submesh.indexCount, 0.0f });
+	MeshOptimizer::Optimize(verts, indices, fileName, submeshRanges.data(), (int)submeshRanges.size());
 
 	// - At this point, "verts" is a vector of Vertex structs, and can be used
 	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
@@ -185,14 +170,83 @@ Mesh::Mesh(const char* fileName, Microsoft::WRL::ComPtr<ID3D11Device> device)
 	// - The vector "indices" is similar. It's a vector of unsigned ints and
 	//    can be used directly for the index buffer: &indices[0] is the address of the first int
 	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-	vertexCount = (int)verts.size();
-	indexCount = (int)indices.size();
+	// - The loader welds identical corners, so there are usually far fewer
+	//    vertices than indices
+	int vertexCount = (int)verts.size();
+	int indexCount = (int)indices.size();
+
+	// Cook the tangents now so the cache can skip them next time
+	CalculateTangents(&verts[0], vertexCount, &indices[0], indexCount);
+
+	// Append the coarser LODs after the full resolution indices
+	// (each material group simplified on its own)
+	std::vector<MeshLod> lodChain;
+	std::vector<MeshLod> submeshLods;
+	MeshSimplifier::GenerateLods(&verts[0], vertexCount, indices, &submeshRanges[0], (int)submeshRanges.size(), lodChain, submeshLods);
+
+	std::vector<std::string> submeshNames;
+	std::vector<std::string> submeshMaterials;
+	for (const ObjSubmesh& submesh : submeshes)
+	{
+		submeshNames.push_back(submesh.name);
+		submeshMaterials.push_back(submesh.material);
+	}
+	MeshCache::Write(fileName, &verts[0], vertexCount, &indices[0], (int)indices.size(), &lodChain[0], (int)lodChain.size(),
+		&submeshLods[0], (int)submeshes.size(), submeshNames.data(), submeshMaterials.data(), materialLibraries.data(), (int)materialLibraries.size());
+
+	PrepareData(&verts[0], vertexCount, &indices[0], (int)indices.size(), &lodChain[0], (int)lodChain.size(), compactVertices, data,
+		&submeshLods[0], (int)submeshes.size());
+	data.submeshNames.swap(submeshNames);
+	data.submeshMaterials.swap(submeshMaterials);
+	data.materialLibraries.swap(materialLibraries);
+	return true;
+}
+
+void Mesh::PrepareData(const Vertex* vertexArray, int vertexArrayCount, const unsigned int* indexArray, int indexArrayCount, const MeshLod* lodArray, int lodArrayCount, bool compactVertices, MeshData& data, const MeshLod* submeshLodArray, int submeshCount)
+{
+	// Pack the vertices down to 24 bytes each, if requested
+	if (compactVertices)
+	{
+		data.packedVerts.resize(vertexArrayCount);
+		VertexPacking::PackVertices(vertexArray, vertexArrayCount, data.packedVerts.data());
+	}
+	else
+	{
+		data.verts.assign(vertexArray, vertexArray + vertexArrayCount);
+	}
+
+	// Small meshes only need 16-bit indices, which halves the index buffer
+	if (vertexArrayCount < 65536)
+		data.shortIndices.assign(indexArray, indexArray + indexArrayCount);
+	else
+		data.indices.assign(indexArray, indexArray + indexArrayCount);
+
+	// The index count of the mesh is that of its full resolution LOD
+	if (lodArray != nullptr && lodArrayCount > 0)
+		data.lods.assign(lodArray, lodArray + lodArrayCount);
+	else
+		data.lods.assign(1, MeshLod{ 0, indexArrayCount, 0.0f });
+
+	// Without material groups, each LOD is one big submesh
+	if (submeshLodArray != nullptr && submeshCount > 0)
+	{
+		data.submeshLods.assign(submeshLodArray, submeshLodArray + data.lods.size() * submeshCount);
+	}
+	else
+	{
+		data.submeshLods = data.lods;
+		submeshCount = 1;
+	}
+	data.submeshNames.assign(submeshCount, std::string());
+	data.submeshMaterials.assign(submeshCount, std::string());
+	data.materialLibraries.clear();
 
-	CreateBuffers(&verts[0], vertexCount, &indices[0], indexCount, device);
+	// Meshlets are cheap to build, so they aren't cached
+	Meshlets::Build(vertexArray, vertexArrayCount, indexArray, data.lods[0].indexCount, data.meshlets, data.meshletVertices, data.meshletTriangles);
+
+	// Same goes for the bounds - one quick pass over the positions
+	data.bounds = Bounds::ComputeAABB(vertexArray, vertexArrayCount);
+	data.boundingSphere = Bounds::ComputeSphere(vertexArray, vertexArrayCount, data.bounds);
 }
 
 void Mesh::CreateBuffers(Vertex* vertexArray, int vertexArrayCount, unsigned int* indexArray, int indexArrayCount, Microsoft::WRL::ComPtr<ID3D11Device> device)
@@ -200,11 +254,33 @@ void Mesh::CreateBuffers(Vertex* vertexArray, int vertexArrayCount, unsigned int
 	//Compute tangents
 	CalculateTangents(vertexArray, vertexArrayCount, indexArray, indexArrayCount);
 
+	CreateBuffers((const Vertex*)vertexArray, vertexArrayCount, (const unsigned int*)indexArray, indexArrayCount, device);
+}
+
+void Mesh::CreateBuffers(const Vertex* vertexArray, int vertexArrayCount, const unsigned int* indexArray, int indexArrayCount, Microsoft::WRL::ComPtr<ID3D11Device> device, const MeshLod* lodArray, int lodArrayCount)
+{
+	MeshData data;
+	PrepareData(vertexArray, vertexArrayCount, indexArray, indexArrayCount, lodArray, lodArrayCount, compactVertices, data);
+	CreateBuffers(data, device);
+}
+
+void Mesh::CreateBuffers(MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	// Whichever vertex format PrepareData() produced
+	const void* vertexData = data.verts.data();
+	int vertexArrayCount = (int)data.verts.size();
+	vertexStride = sizeof(Vertex);
+	if (!data.packedVerts.empty())
+	{
+		vertexData = data.packedVerts.data();
+		vertexArrayCount = (int)data.packedVerts.size();
+		vertexStride = sizeof(PackedVertex);
+	}
 
 	// Create the VERTEX BUFFER description -----------------------------------
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * vertexArrayCount;
+	vbd.ByteWidth = vertexStride * vertexArrayCount;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -213,17 +289,30 @@ void Mesh::CreateBuffers(Vertex* vertexArray, int vertexArrayCount, unsigned int
 	// Create the proper struct to hold the initial vertex data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertexArray;
+	initialVertexData.pSysMem = vertexData;
 
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
 	device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
 	vertexCount = vertexArrayCount;
 
+	// And whichever index size it picked
+	const void* indexData = data.indices.data();
+	int indexArrayCount = (int)data.indices.size();
+	UINT indexSize = sizeof(unsigned int);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	if (!data.shortIndices.empty())
+	{
+		indexData = data.shortIndices.data();
+		indexArrayCount = (int)data.shortIndices.size();
+		indexSize = sizeof(unsigned short);
+		indexFormat = DXGI_FORMAT_R16_UINT;
+	}
+
 	// Create the INDEX BUFFER description ------------------------------------
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * indexArrayCount;
+	ibd.ByteWidth = indexSize * indexArrayCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -232,12 +321,129 @@ void Mesh::CreateBuffers(Vertex* vertexArray, int vertexArrayCount, unsigned int
 	// Create the proper struct to hold the initial index data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indexArray;
+	initialIndexData.pSysMem = indexData;
 
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
 	device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
-	indexCount = indexArrayCount;
+
+	TakeCpuData(data);
+}
+
+void Mesh::CreateBuffers(MeshData& data, GeometryPool* pool)
+{
+	const void* vertexData = data.packedVerts.empty() ? (const void*)data.verts.data() : (const void*)data.packedVerts.data();
+	int vertexArrayCount = data.packedVerts.empty() ? (int)data.verts.size() : (int)data.packedVerts.size();
+	UINT stride = data.packedVerts.empty() ? sizeof(Vertex) : sizeof(PackedVertex);
+
+	// The pool's index size wins - 16-bit indices widen to 32 if needed,
+	// but 32-bit ones can't shrink
+	const void* indexData = nullptr;
+	int indexArrayCount = 0;
+	std::vector<unsigned int> wideIndices;
+	if (pool->GetIndexFormat() == DXGI_FORMAT_R16_UINT && !data.shortIndices.empty())
+	{
+		indexData = data.shortIndices.data();
+		indexArrayCount = (int)data.shortIndices.size();
+	}
+	else if (pool->GetIndexFormat() == DXGI_FORMAT_R32_UINT)
+	{
+		if (!data.shortIndices.empty())
+			wideIndices.assign(data.shortIndices.begin(), data.shortIndices.end());
+		const std::vector<unsigned int>& source = data.shortIndices.empty() ? data.indices : wideIndices;
+		indexData = source.data();
+		indexArrayCount = (int)source.size();
+	}
+
+	int id = -1;
+	if (stride == pool->GetVertexStride() && indexData != nullptr)
+		id = pool->Add(vertexData, vertexArrayCount, indexData, indexArrayCount);
+	if (id < 0)
+	{
+		CreateBuffers(data, pool->GetDevice());
+		return;
+	}
+
+	this->pool = pool;
+	poolId = id;
+	vertexStride = stride;
+	indexFormat = pool->GetIndexFormat();
+	vertexCount = vertexArrayCount;
+	TakeCpuData(data);
+}
+
+void Mesh::TakeCpuData(MeshData& data)
+{
+	// Occluder triangles from the finest LOD that's small enough,
+	// renumbered over only the vertices it uses - a mesh with none small
+	// enough isn't drawn as an occluder at all, rather than costing more
+	// to rasterize than it's likely to save
+	int occluderLod = -1;
+	for (int l = 0; l < (int)data.lods.size(); l++)
+	{
+		if (data.lods[l].indexCount / 3 <= MaxOccluderTriangles)
+		{
+			occluderLod = l;
+			break;
+		}
+	}
+	occluderPositions.clear();
+	occluderIndices.clear();
+	if (occluderLod >= 0)
+	{
+		const MeshLod& lod = data.lods[occluderLod];
+		std::vector<int> remap(data.packedVerts.empty() ? data.verts.size() : data.packedVerts.size(), -1);
+		occluderIndices.resize(lod.indexCount);
+		for (int i = 0; i < lod.indexCount; i++)
+		{
+			int index = data.shortIndices.empty() ? (int)data.indices[lod.firstIndex + i] : (int)data.shortIndices[lod.firstIndex + i];
+			if (remap[index] < 0)
+			{
+				remap[index] = (int)occluderPositions.size();
+				occluderPositions.push_back(data.packedVerts.empty() ? data.verts[index].Position : data.packedVerts[index].Position);
+			}
+			occluderIndices[i] = remap[index];
+		}
+	}
+
+	// The CPU-side data just moves over
+	lods.swap(data.lods);
+	submeshLods.swap(data.submeshLods);
+	submeshNames.swap(data.submeshNames);
+	submeshMaterials.swap(data.submeshMaterials);
+	materialLibraries.swap(data.materialLibraries);
+	meshlets.swap(data.meshlets);
+	meshletVertices.swap(data.meshletVertices);
+	meshletTriangles.swap(data.meshletTriangles);
+	bounds = data.bounds;
+	boundingSphere = data.boundingSphere;
+	indexCount = lods[0].indexCount;
+	resident = true;
+}
+
+bool Mesh::IsResident() const
+{
+	return resident;
+}
+
+bool Mesh::IsPooled() const
+{
+	return pool != nullptr;
+}
+
+GeometryPool* Mesh::GetPool() const
+{
+	return pool;
+}
+
+int Mesh::GetFirstIndex() const
+{
+	return pool != nullptr ? pool->GetRange(poolId).firstIndex : 0;
+}
+
+int Mesh::GetBaseVertex() const
+{
+	return pool != nullptr ? pool->GetRange(poolId).baseVertex : 0;
 }
 
 const Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
@@ -255,6 +461,191 @@ const int Mesh::GetIndexCount()
 	return indexCount;
 }
 
+UINT Mesh::GetVertexStride() const
+{
+	return vertexStride;
+}
+
+DXGI_FORMAT Mesh::GetIndexFormat() const
+{
+	return indexFormat;
+}
+
+int Mesh::GetLodCount() const
+{
+	return (int)lods.size();
+}
+
+const MeshLod& Mesh::GetLod(int lod) const
+{
+	return lods[lod];
+}
+
+int Mesh::SelectLod(float pixelsPerUnit, float maxPixelError) const
+{
+	// Errors only grow down the chain, so stop at the first one that's too big
+	int selected = 0;
+	for (int i = 1; i < (int)lods.size(); i++)
+	{
+		if (lods[i].error * pixelsPerUnit > maxPixelError)
+			break;
+		selected = i;
+	}
+	return selected;
+}
+
+int Mesh::GetSubmeshCount() const
+{
+	return (int)submeshNames.size();
+}
+
+const MeshLod& Mesh::GetSubmeshLod(int lod, int submesh) const
+{
+	return submeshLods[lod * submeshNames.size() + submesh];
+}
+
+const std::string& Mesh::GetSubmeshName(int submesh) const
+{
+	return submeshNames[submesh];
+}
+
+const std::string& Mesh::GetSubmeshMaterial(int submesh) const
+{
+	return submeshMaterials[submesh];
+}
+
+const std::vector<std::string>& Mesh::GetMaterialLibraries() const
+{
+	return materialLibraries;
+}
+
+const std::vector<Meshlet>& Mesh::GetMeshlets() const
+{
+	return meshlets;
+}
+
+const std::vector<unsigned int>& Mesh::GetMeshletVertices() const
+{
+	return meshletVertices;
+}
+
+const std::vector<unsigned char>& Mesh::GetMeshletTriangles() const
+{
+	return meshletTriangles;
+}
+
+const std::vector<XMFLOAT3>& Mesh::GetOccluderPositions() const
+{
+	return occluderPositions;
+}
+
+const std::vector<unsigned int>& Mesh::GetOccluderIndices() const
+{
+	return occluderIndices;
+}
+
+const AABB& Mesh::GetBounds() const
+{
+	return bounds;
+}
+
+const Sphere& Mesh::GetBoundingSphere() const
+{
+	return boundingSphere;
+}
+
+AABB Mesh::GetWorldBounds(const XMFLOAT4X4& world) const
+{
+	return Bounds::TransformAABB(bounds, world);
+}
+
+Sphere Mesh::GetWorldBoundingSphere(const XMFLOAT4X4& world) const
+{
+	return Bounds::TransformSphere(boundingSphere, world);
+}
+
+// Calculates the tangents of the vertices in a mesh
+// - Same math as CalculateTangentsReference() below, restructured so
+//   it vectorizes and spreads across jobs without any races:
+//   1. Each job takes a range of triangles, computes their tangents
+//      four at a time in SoA form and adds them into its own partial
+//      buffer, which only spans the vertices that range touches (the
+//      first range adds straight into the vertices instead)
+//   2. Jobs then take ranges of vertices, add in the partial buffers
+//      covering them, then Gram-Schmidt and normalize
+// - Triangles with degenerate UVs contribute nothing, rather than
+//   turning their vertices' tangents into NaNs
+//
+// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+//
+void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	struct PartialTangents
+	{
+		unsigned int firstVertex;
+		unsigned int lastVertex;
+		std::vector<XMFLOAT3> sums;
+	};
+
+	// Reset tangents
+	for (int i = 0; i < numVerts; i++)
+	{
+		verts[i].Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	// 1. Accumulate triangle tangents - the first range adds straight
+	//    into the vertices, so a single thread needs no extra memory
+	int triangleCount = numIndices / 3;
+	int triangleRanges = RangeCountFor(triangleCount, MinTrianglesPerThread);
+	std::vector<PartialTangents> partials(triangleRanges);
+	JobSystem& jobs = JobSystem::GetDefault();
+	jobs.ParallelRanges(triangleCount, triangleRanges, [&](int range, int begin, int end)
+	{
+		if (range == 0)
+		{
+			AccumulateTangents(verts, indices, begin, end, (char*)&verts[0].Tangent, sizeof(Vertex), 0);
+			return;
+		}
+
+		PartialTangents& partial = partials[range];
+		partial.firstVertex = UINT_MAX;
+		partial.lastVertex = 0;
+		for (int i = begin * 3; i < end * 3; i++)
+		{
+			partial.firstVertex = std::min(partial.firstVertex, indices[i]);
+			partial.lastVertex = std::max(partial.lastVertex, indices[i]);
+		}
+		if (begin == end)
+			return;
+
+		partial.sums.assign(partial.lastVertex - partial.firstVertex + 1, XMFLOAT3(0, 0, 0));
+		AccumulateTangents(verts, indices, begin, end, (char*)partial.sums.data(), sizeof(XMFLOAT3), partial.firstVertex);
+	});
+
+	// 2. Add up the partial sums, then make each tangent orthogonal
+	//    to its normal (Gram-Schmidt) and normalize it
+	jobs.ParallelFor(numVerts, MinVerticesPerThread, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			unsigned int vertex = (unsigned int)i;
+			XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+			for (const PartialTangents& partial : partials)
+			{
+				if (!partial.sums.empty() && vertex >= partial.firstVertex && vertex <= partial.lastVertex)
+					tangent = XMVectorAdd(tangent, XMLoadFloat3(&partial.sums[vertex - partial.firstVertex]));
+			}
+
+			// Gram-Schmidt, leaving zero length tangents at zero
+			XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+			tangent = XMVectorSubtract(tangent, XMVectorMultiply(normal, XMVector3Dot(normal, tangent)));
+			XMVECTOR lengthSq = XMVector3Dot(tangent, tangent);
+			tangent = XMVectorSelect(XMVectorZero(), XMVectorDivide(tangent, XMVectorSqrt(lengthSq)), XMVectorGreater(lengthSq, XMVectorZero()));
+			XMStoreFloat3(&verts[i].Tangent, tangent);
+		}
+	});
+}
+
 // Calculates the tangents of the vertices in a mesh
 // - Code originally adapted from: http://www.terathon.com/code/tangent.html
 //   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
@@ -263,9 +654,10 @@ const int Mesh::GetIndexCount()
 // - Note: For this code to work, your Vertex format must
 //         contain an XMFLOAT3 called Tangent
 //
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// - This is the original scalar version: CalculateTangents() above is
+//   the one to use, this one stays as its reference
 //
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+void Mesh::CalculateTangentsReference(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
 	// Reset tangents
 	for (int i = 0; i < numVerts; i++)
@@ -3,11 +3,47 @@
 #include "DXCore.h"
 #include <DirectXMath.h>
 #include "d3d11.h"
+#include "Bounds.h"
+#include "GeometryPool.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
 #include "Vertex.h"
 #include <fstream>
+#include <string>
 #include <vector>
 #include <wrl/client.h>
 
+// --------------------------------------------------------
+// A mesh that's been loaded and cooked on the CPU, but doesn't
+// have GPU buffers yet
+//
+// - Building one (Mesh::LoadData / Mesh::PrepareData) touches
+//   no D3D objects, so it's safe on any thread
+// - Only one of each vertex/index pair is filled, depending on
+//   the vertex format and the index size the mesh needs
+// --------------------------------------------------------
+struct MeshData
+{
+	std::vector<Vertex> verts;
+	std::vector<PackedVertex> packedVerts;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned short> shortIndices;
+
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> meshletVertices;
+	std::vector<unsigned char> meshletTriangles;
+
+	// Material groups - lods.size() * submeshCount ranges, LOD-major
+	std::vector<MeshLod> submeshLods;
+	std::vector<std::string> submeshNames;
+	std::vector<std::string> submeshMaterials;
+	std::vector<std::string> materialLibraries;
+
+	AABB bounds;
+	Sphere boundingSphere;
+};
+
 class Mesh
 {
 private:
@@ -16,6 +52,45 @@ private:
 	int vertexCount;
 	int indexCount;
 
+	// Index ranges of each level of detail, finest first
+	std::vector<MeshLod> lods;
+
+	// Each material group's range within every LOD (LOD-major), plus
+	// the names and materials from the source file
+	std::vector<MeshLod> submeshLods;
+	std::vector<std::string> submeshNames;
+	std::vector<std::string> submeshMaterials;
+	std::vector<std::string> materialLibraries;
+
+	// CPU-side clusters of the full resolution LOD, for culling
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> meshletVertices;
+	std::vector<unsigned char> meshletTriangles;
+
+	// A coarse LOD's triangles over only the vertices they use, kept
+	// on the CPU for occlusion culling (see OcclusionBuffer)
+	std::vector<DirectX::XMFLOAT3> occluderPositions;
+	std::vector<unsigned int> occluderIndices;
+
+	// Object space bounds of every vertex
+	AABB bounds;
+	Sphere boundingSphere;
+
+	// Vertex layout and index size actually used on the GPU
+	bool compactVertices;
+	UINT vertexStride;
+	DXGI_FORMAT indexFormat;
+
+	// Whether the GPU buffers exist yet (see MeshLoader)
+	bool resident;
+
+	// Set when the mesh lives in a shared pool instead of its own buffers
+	GeometryPool* pool;
+	int poolId;
+
+	// Moves the LODs, meshlets and bounds over from cooked data
+	void TakeCpuData(MeshData& data);
+
 public:
 	Mesh(
 		Vertex* vertexArray, 
@@ -24,9 +99,32 @@ public:
 		int indexArrayCount,
 		Microsoft::WRL::ComPtr<ID3D11Device> device);
 
+	// compactVertices - store the GPU copy as PackedVertex instead of Vertex
+	//  (it must then be drawn with a shader that reads PackedVertexShaderInput)
 	Mesh(
 		const char* fileName,
-		Microsoft::WRL::ComPtr<ID3D11Device> device);
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		bool compactVertices = false);
+
+	// An empty mesh with no GPU buffers yet - it can be handed to entities
+	// right away, and becomes drawable once CreateBuffers() fills it in
+	Mesh(bool compactVertices = false);
+
+	~Mesh();
+
+	// A copy would hand its pool range back a second time
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	// False until the mesh's GPU buffers have been created
+	bool IsResident() const;
+
+	// Pooled meshes have no buffers of their own - bind the pool, then
+	// draw with GetFirstIndex() and GetBaseVertex() as offsets
+	bool IsPooled() const;
+	GeometryPool* GetPool() const;
+	int GetFirstIndex() const;
+	int GetBaseVertex() const;
 
 	const Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 
@@ -34,11 +132,99 @@ public:
 
 	const int GetIndexCount();
 
+	UINT GetVertexStride() const;
+
+	DXGI_FORMAT GetIndexFormat() const;
+
+	int GetLodCount() const;
+
+	const MeshLod& GetLod(int lod) const;
+
+	// Picks the coarsest LOD whose error stays under maxPixelError once
+	// projected - pixelsPerUnit is how many pixels one object space unit
+	// covers on screen at the mesh's distance
+	int SelectLod(float pixelsPerUnit, float maxPixelError = 1.0f) const;
+
+	// Material groups ("usemtl" in the OBJ) - always at least one,
+	// drawn back to back they cover the whole LOD
+	int GetSubmeshCount() const;
+	const MeshLod& GetSubmeshLod(int lod, int submesh) const;
+	const std::string& GetSubmeshName(int submesh) const;
+	const std::string& GetSubmeshMaterial(int submesh) const;
+
+	// MTL files the OBJ referenced (see MaterialLibrary)
+	const std::vector<std::string>& GetMaterialLibraries() const;
+
+	const std::vector<Meshlet>& GetMeshlets() const;
+
+	const std::vector<unsigned int>& GetMeshletVertices() const;
+
+	const std::vector<unsigned char>& GetMeshletTriangles() const;
+
+	// Object space triangles for drawing the mesh as an occluder - the
+	// finest LOD with at most MaxOccluderTriangles, or none (empty) if
+	// even the coarsest has more.  Simplified LODs can stick out past
+	// the real surface, so only tag simple, convex-ish meshes Occluder.
+	static const int MaxOccluderTriangles = 256;
+	const std::vector<DirectX::XMFLOAT3>& GetOccluderPositions() const;
+	const std::vector<unsigned int>& GetOccluderIndices() const;
+
+	// Object space bounds (zero-sized until the mesh is resident)
+	const AABB& GetBounds() const;
+	const Sphere& GetBoundingSphere() const;
+
+	// The bounds once the mesh is placed with "world" (such as an
+	// entity's Transform::GetWorldMatrix()) - see Bounds.h
+	AABB GetWorldBounds(const DirectX::XMFLOAT4X4& world) const;
+	Sphere GetWorldBoundingSphere(const DirectX::XMFLOAT4X4& world) const;
+
 	void CreateBuffers(Vertex* vertexArray,
 		int vertexArrayCount,
 		unsigned int* indexArray,
 		int indexArrayCount,
 		Microsoft::WRL::ComPtr<ID3D11Device> device);
 
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	// For data that's already cooked (tangents included), such as a mesh cache
+	// - Without a LOD table, the whole index array is a single LOD
+	void CreateBuffers(const Vertex* vertexArray,
+		int vertexArrayCount,
+		const unsigned int* indexArray,
+		int indexArrayCount,
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		const MeshLod* lodArray = nullptr,
+		int lodArrayCount = 0);
+
+	// Creates the GPU buffers from pre-cooked data - the only part of
+	// loading that needs the device (LODs and meshlets move out of data)
+	void CreateBuffers(MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device);
+
+	// Same, but suballocated from a shared pool - falls back to buffers
+	// of its own if the data doesn't match the pool's formats
+	void CreateBuffers(MeshData& data, GeometryPool* pool);
+
+	// Loads and cooks an OBJ file (via the mesh cache when possible)
+	// without touching the device - returns false if it can't be read
+	static bool LoadData(const char* fileName, bool compactVertices, MeshData& data);
+
+	// Packs, shrinks indices and builds meshlets for already cooked data
+	// - Without submesh ranges the mesh is a single, unnamed submesh
+	//   (names and materials are left for the caller to fill in)
+	static void PrepareData(
+		const Vertex* vertexArray,
+		int vertexArrayCount,
+		const unsigned int* indexArray,
+		int indexArrayCount,
+		const MeshLod* lodArray,
+		int lodArrayCount,
+		bool compactVertices,
+		MeshData& data,
+		const MeshLod* submeshLodArray = nullptr,
+		int submeshCount = 0);
+
+	// SIMD, multithreaded tangent generation - see Mesh.cpp
+	static void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+
+	// The original one-triangle-at-a-time version, kept as the
+	// reference the fast path is checked against
+	static void CalculateTangentsReference(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 };
\ No newline at end of file
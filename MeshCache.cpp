@@ -0,0 +1,275 @@
+#include "MeshCache.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t MeshCacheMagic = 0x4853454D; // "MESH"
+
+	// Fast 64-bit hash of a whole file, eight bytes at a time
+	uint64_t HashBytes(const char* data, size_t size)
+	{
+		const uint64_t Prime = 0x9E3779B97F4A7C15ull;
+		uint64_t h = size * Prime;
+
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t k;
+			memcpy(&k, data + i, 8);
+			k *= Prime;
+			k ^= k >> 31;
+			h = (h ^ k) * 0xBF58476D1CE4E5B9ull;
+		}
+
+		uint64_t tail = 0;
+		if (i < size)
+			memcpy(&tail, data + i, size - i);
+		h = (h ^ (tail * Prime)) * 0x94D049BB133111EBull;
+		return h ^ (h >> 29);
+	}
+
+	bool GetSourceInfo(const char* sourceFileName, uint64_t& size, int64_t& timestamp)
+	{
+		std::error_code error;
+		size = (uint64_t)std::filesystem::file_size(sourceFileName, error);
+		if (error)
+			return false;
+		timestamp = (int64_t)std::filesystem::last_write_time(sourceFileName, error).time_since_epoch().count();
+		return !error;
+	}
+
+	bool HashSource(const char* sourceFileName, uint64_t& hash)
+	{
+		MappedFile source(sourceFileName);
+		if (!source.IsOpen())
+			return false;
+		hash = HashBytes(source.GetData(), source.GetSize());
+		return true;
+	}
+
+	// Overwrites just the source timestamp in a cache's header
+	void WriteSourceTimestamp(const std::string& cachePath, int64_t timestamp)
+	{
+		std::fstream out(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		if (!out.is_open())
+			return;
+		out.seekp(offsetof(MeshCacheHeader, sourceTimestamp));
+		out.write((const char*)&timestamp, sizeof(timestamp));
+	}
+}
+
+MeshCache::MeshCache(const char* sourceFileName)
+	: file(GetCachePath(sourceFileName).c_str())
+{
+	header = nullptr;
+	if (file.GetSize() < sizeof(MeshCacheHeader))
+		return;
+
+	const MeshCacheHeader* h = (const MeshCacheHeader*)file.GetData();
+	if (h->magic != MeshCacheMagic ||
+		h->version != MeshCacheVersion ||
+		h->vertexStride != sizeof(Vertex))
+		return;
+
+	// Make sure the blobs actually fit in the file
+	uint64_t expectedSize = sizeof(MeshCacheHeader) +
+		(uint64_t)h->vertexCount * sizeof(Vertex) +
+		(uint64_t)h->indexCount * sizeof(unsigned int) +
+		(uint64_t)h->lodCount * sizeof(MeshLod) +
+		(uint64_t)h->lodCount * h->submeshCount * sizeof(MeshLod) +
+		h->stringBytes;
+	if (h->lodCount == 0 || h->submeshCount == 0 || file.GetSize() != expectedSize)
+		return;
+
+	// Split the string blob, which must hold exactly as many
+	// strings as the header says
+	const char* blob = file.GetData() + file.GetSize() - h->stringBytes;
+	size_t stringCount = (size_t)h->submeshCount * 2 + h->materialLibraryCount;
+	strings.clear();
+	for (const char* p = blob; p < blob + h->stringBytes; p += strlen(p) + 1)
+	{
+		if (memchr(p, 0, blob + h->stringBytes - p) == nullptr)
+			return;
+		strings.push_back(p);
+	}
+	if (strings.size() != stringCount)
+		return;
+
+	// Is the source unchanged?  Size and timestamp are cheap to
+	// check - only hash the whole source if the timestamp moved
+	uint64_t sourceSize;
+	int64_t sourceTimestamp;
+	if (!GetSourceInfo(sourceFileName, sourceSize, sourceTimestamp) || sourceSize != h->sourceSize)
+		return;
+
+	if (sourceTimestamp != h->sourceTimestamp)
+	{
+		uint64_t sourceHash;
+		if (!HashSource(sourceFileName, sourceHash) || sourceHash != h->sourceHash)
+			return;
+
+		// Only touched - store the new timestamp, so the next load
+		// is back to the cheap check instead of hashing again
+		WriteSourceTimestamp(GetCachePath(sourceFileName), sourceTimestamp);
+	}
+
+	header = h;
+}
+
+bool MeshCache::IsValid() const
+{
+	return header != nullptr;
+}
+
+const Vertex* MeshCache::GetVertices() const
+{
+	return (const Vertex*)(file.GetData() + sizeof(MeshCacheHeader));
+}
+
+int MeshCache::GetVertexCount() const
+{
+	return (int)header->vertexCount;
+}
+
+const unsigned int* MeshCache::GetIndices() const
+{
+	return (const unsigned int*)(file.GetData() + sizeof(MeshCacheHeader) + header->vertexCount * sizeof(Vertex));
+}
+
+int MeshCache::GetIndexCount() const
+{
+	return (int)header->indexCount;
+}
+
+const MeshLod* MeshCache::GetLods() const
+{
+	return (const MeshLod*)(GetIndices() + header->indexCount);
+}
+
+int MeshCache::GetLodCount() const
+{
+	return (int)header->lodCount;
+}
+
+const MeshLod* MeshCache::GetSubmeshLods() const
+{
+	return GetLods() + header->lodCount;
+}
+
+int MeshCache::GetSubmeshCount() const
+{
+	return (int)header->submeshCount;
+}
+
+const char* MeshCache::GetSubmeshName(int submesh) const
+{
+	return strings[submesh];
+}
+
+const char* MeshCache::GetSubmeshMaterial(int submesh) const
+{
+	return strings[header->submeshCount + submesh];
+}
+
+int MeshCache::GetMaterialLibraryCount() const
+{
+	return (int)header->materialLibraryCount;
+}
+
+const char* MeshCache::GetMaterialLibrary(int library) const
+{
+	return strings[header->submeshCount * 2 + library];
+}
+
+XMFLOAT3 MeshCache::GetBoundsMin() const
+{
+	return header->boundsMin;
+}
+
+XMFLOAT3 MeshCache::GetBoundsMax() const
+{
+	return header->boundsMax;
+}
+
+std::string MeshCache::GetCachePath(const char* sourceFileName)
+{
+	return std::string(sourceFileName) + ".meshcache";
+}
+
+bool MeshCache::Write(const char* sourceFileName, const Vertex* verts, int vertexCount, const unsigned int* indices, int indexCount, const MeshLod* lods, int lodCount, const MeshLod* submeshLods, int submeshCount, const std::string* submeshNames, const std::string* submeshMaterials, const std::string* materialLibraries, int materialLibraryCount)
+{
+	// Every string, null-terminated, in the order the reader expects
+	std::string stringBlob;
+	for (int i = 0; i < submeshCount; i++)
+		stringBlob.append(submeshNames[i].c_str(), submeshNames[i].size() + 1);
+	for (int i = 0; i < submeshCount; i++)
+		stringBlob.append(submeshMaterials[i].c_str(), submeshMaterials[i].size() + 1);
+	for (int i = 0; i < materialLibraryCount; i++)
+		stringBlob.append(materialLibraries[i].c_str(), materialLibraries[i].size() + 1);
+
+	MeshCacheHeader h = {};
+	h.magic = MeshCacheMagic;
+	h.version = MeshCacheVersion;
+	h.vertexStride = sizeof(Vertex);
+	h.vertexCount = (uint32_t)vertexCount;
+	h.indexCount = (uint32_t)indexCount;
+	h.lodCount = (uint32_t)lodCount;
+	h.submeshCount = (uint32_t)submeshCount;
+	h.materialLibraryCount = (uint32_t)materialLibraryCount;
+	h.stringBytes = (uint32_t)stringBlob.size();
+	if (!GetSourceInfo(sourceFileName, h.sourceSize, h.sourceTimestamp) ||
+		!HashSource(sourceFileName, h.sourceHash))
+		return false;
+
+	// Bounds of the cooked positions
+	h.boundsMin = vertexCount > 0 ? verts[0].Position : XMFLOAT3(0, 0, 0);
+	h.boundsMax = h.boundsMin;
+	for (int i = 1; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = verts[i].Position;
+		h.boundsMin = XMFLOAT3(fminf(h.boundsMin.x, p.x), fminf(h.boundsMin.y, p.y), fminf(h.boundsMin.z, p.z));
+		h.boundsMax = XMFLOAT3(fmaxf(h.boundsMax.x, p.x), fmaxf(h.boundsMax.y, p.y), fmaxf(h.boundsMax.z, p.z));
+	}
+
+	// Write to a temporary file first, then swap it into place, so a
+	// crash mid-write never leaves a half-finished cache behind (the
+	// name is per thread, in case two threads cook the same file)
+	std::string cachePath = GetCachePath(sourceFileName);
+	std::string tempPath = cachePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	bool written = false;
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write((const char*)&h, sizeof(h));
+		out.write((const char*)verts, (std::streamsize)vertexCount * sizeof(Vertex));
+		out.write((const char*)indices, (std::streamsize)indexCount * sizeof(unsigned int));
+		out.write((const char*)lods, (std::streamsize)lodCount * sizeof(MeshLod));
+		out.write((const char*)submeshLods, (std::streamsize)lodCount * submeshCount * sizeof(MeshLod));
+		out.write(stringBlob.data(), (std::streamsize)stringBlob.size());
+		written = out.good();
+	}
+
+	// Either way, a temporary file that didn't make it into place
+	// is removed (after the stream above has closed it)
+	std::error_code error;
+	if (written)
+		std::filesystem::rename(tempPath, cachePath, error);
+	if (!written || error)
+	{
+		std::error_code removeError;
+		std::filesystem::remove(tempPath, removeError);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+#include "Vertex.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump this whenever the cooked vertex/index data would change,
+// so old caches get rebuilt instead of silently reused
+const uint32_t MeshCacheVersion = 4;
+
+// --------------------------------------------------------
+// Header at the very start of a binary mesh cache file
+//
+// Layout on disk:  [header][vertex blob][index blob][LOD table]
+//                   [submesh LOD table][string blob]
+//
+// - The index blob holds every LOD, one after another
+// - The submesh LOD table has lodCount * submeshCount ranges,
+//   LOD-major (see MeshSimplifier::GenerateLods)
+// - The string blob is null-terminated strings: every submesh
+//   name, then every submesh material, then every material library
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t submeshCount;
+	uint32_t materialLibraryCount;
+	uint32_t stringBytes;
+	uint32_t padding;
+	uint64_t sourceSize;
+	int64_t sourceTimestamp;
+	uint64_t sourceHash;
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+};
+
+// --------------------------------------------------------
+// A cooked, ready-to-upload copy of a mesh file
+//
+// - Written the first time a source file is loaded
+// - Later loads memory-map it and hand the vertex and index
+//   blobs straight to the GPU, skipping parsing and tangents
+// - A cache is only used if it matches the source's size and
+//   timestamp, or (if the file was merely touched) its hash -
+//   then the new timestamp is written back into the header
+// --------------------------------------------------------
+class MeshCache
+{
+private:
+	MappedFile file;
+	const MeshCacheHeader* header;
+
+	// Start of each string in the string blob
+	std::vector<const char*> strings;
+
+public:
+	// Opens and validates the cache for the given source file
+	MeshCache(const char* sourceFileName);
+
+	bool IsValid() const;
+	const Vertex* GetVertices() const;
+	int GetVertexCount() const;
+	const unsigned int* GetIndices() const;
+	int GetIndexCount() const;
+	const MeshLod* GetLods() const;
+	int GetLodCount() const;
+	const MeshLod* GetSubmeshLods() const;
+	int GetSubmeshCount() const;
+	const char* GetSubmeshName(int submesh) const;
+	const char* GetSubmeshMaterial(int submesh) const;
+	int GetMaterialLibraryCount() const;
+	const char* GetMaterialLibrary(int library) const;
+	DirectX::XMFLOAT3 GetBoundsMin() const;
+	DirectX::XMFLOAT3 GetBoundsMax() const;
+
+	static std::string GetCachePath(const char* sourceFileName);
+
+	static bool Write(
+		const char* sourceFileName,
+		const Vertex* verts,
+		int vertexCount,
+		const unsigned int* indices,
+		int indexCount,
+		const MeshLod* lods,
+		int lodCount,
+		const MeshLod* submeshLods,
+		int submeshCount,
+		const std::string* submeshNames,
+		const std::string* submeshMaterials,
+		const std::string* materialLibraries,
+		int materialLibraryCount);
+};
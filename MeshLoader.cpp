@@ -0,0 +1,168 @@
+#include "MeshLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+
+MeshLoader::MeshLoader(Microsoft::WRL::ComPtr<ID3D11Device> device, int threadCount, GeometryPool* pool)
+{
+	this->device = device;
+	this->pool = pool;
+	pendingCount = 0;
+	stopping = false;
+
+	if (threadCount <= 0)
+		threadCount = std::max(1, JobSystem::GetDefault().GetWorkerCount());
+	maxLoads = threadCount;
+	activeLoads = 0;
+}
+
+MeshLoader::~MeshLoader()
+{
+	// Meshes mid-load are finished (but never uploaded) before the
+	// loader jobs return
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	JobSystem::GetDefault().Wait(loading, true);
+
+	// Nothing else touches the requests now - whoever is still waiting
+	// on one gets nullptr instead of a broken promise
+	for (std::unique_ptr<Request>& request : queued)
+		request->promise.set_value(nullptr);
+	for (std::unique_ptr<Request>& request : cooked)
+		request->promise.set_value(nullptr);
+}
+
+MeshHandle MeshLoader::LoadAsync(const char* fileName, bool compactVertices)
+{
+	// A running loader job picks it up, unless there's room for another
+	bool startLoad = false;
+	MeshHandle handle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::pair<std::string, bool> key(fileName, compactVertices);
+		auto existing = handles.find(key);
+		if (existing != handles.end())
+			return existing->second;
+
+		std::unique_ptr<Request> request(new Request());
+		request->fileName = fileName;
+		request->mesh = new Mesh(compactVertices);
+		request->compactVertices = compactVertices;
+		request->loaded = false;
+
+		handle = { request->mesh, request->promise.get_future().share() };
+		handles[key] = handle;
+
+		queued.push_back(std::move(request));
+		pendingCount++;
+		if (activeLoads < maxLoads)
+		{
+			activeLoads++;
+			startLoad = true;
+		}
+	}
+	if (startLoad)
+		JobSystem::GetDefault().RunBackground([this]() { LoadQueued(); }, &loading);
+	return handle;
+}
+
+void MeshLoader::LoadQueued()
+{
+	while (true)
+	{
+		std::unique_ptr<Request> request;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping || queued.empty())
+			{
+				activeLoads--;
+				return;
+			}
+
+			request = std::move(queued.front());
+			queued.pop_front();
+		}
+
+		// All of the slow, device-free work
+		request->loaded = Mesh::LoadData(request->fileName.c_str(), request->compactVertices, request->data);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cooked.push_back(std::move(request));
+		}
+	}
+}
+
+void MeshLoader::Upload(std::vector<std::unique_ptr<Request>>& requests)
+{
+	for (std::unique_ptr<Request>& request : requests)
+	{
+		if (!request->loaded)
+		{
+			printf("Couldn't load mesh %s\n", request->fileName.c_str());
+			request->promise.set_value(nullptr);
+			continue;
+		}
+
+		if (pool != nullptr)
+			request->mesh->CreateBuffers(request->data, pool);
+		else
+			request->mesh->CreateBuffers(request->data, device);
+		request->promise.set_value(request->mesh);
+	}
+}
+
+int MeshLoader::Update(int maxUploads)
+{
+	// Grab finished requests under the lock, but create the
+	// buffers outside it so loader jobs never wait on the driver
+	std::vector<std::unique_ptr<Request>> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		int count = std::min(maxUploads, (int)cooked.size());
+		for (int i = 0; i < count; i++)
+			ready.push_back(std::move(cooked[i]));
+		cooked.erase(cooked.begin(), cooked.begin() + count);
+		pendingCount -= count;
+	}
+
+	Upload(ready);
+	return (int)ready.size();
+}
+
+void MeshLoader::WaitAll()
+{
+	while (true)
+	{
+		std::vector<std::unique_ptr<Request>> ready;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (pendingCount == 0)
+				return;
+
+			ready.swap(cooked);
+			pendingCount -= (int)ready.size();
+		}
+
+		// Upload each batch as soon as it's cooked, while the
+		// loader jobs carry on with the rest - with nothing to
+		// upload, help with whatever jobs are queued, loads included
+		if (!ready.empty())
+			Upload(ready);
+		else if (!JobSystem::GetDefault().TryRunJob(true))
+			std::this_thread::yield();
+	}
+}
+
+int MeshLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pendingCount;
+}
+
+int MeshLoader::GetThreadCount() const
+{
+	return maxLoads;
+}
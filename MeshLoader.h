@@ -0,0 +1,111 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Mesh.h"
+#include <climits>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// What MeshLoader::LoadAsync() hands back right away
+//
+// - mesh can be given to entities immediately; it draws
+//   nothing until it's resident
+// - ready becomes ready (holding the same mesh) once the
+//   GPU buffers exist
+// - ready holds nullptr if the load failed (the file couldn't
+//   be read or parsed) or was dropped (the loader was
+//   destroyed first) - either way the mesh never becomes
+//   resident
+// --------------------------------------------------------
+struct MeshHandle
+{
+	Mesh* mesh;
+	std::shared_future<Mesh*> ready;
+};
+
+// --------------------------------------------------------
+// Loads meshes as jobs on the shared JobSystem
+//
+// - Loader jobs do all of the CPU work (cache lookup, parsing,
+//   optimizing, tangents, LODs, packing, meshlets), each one
+//   taking queued files until there are none left.  They're
+//   background jobs, so only idle workers pick them up - never
+//   a thread waiting on a frame's jobs.
+// - Only so many files load at once, so the rest of the
+//   engine's jobs still get the workers
+// - Only the final ID3D11Device::CreateBuffer() calls happen on
+//   the owning thread, inside Update() or WaitAll()
+// - Asking for the same file (and vertex format) twice returns
+//   the same mesh
+// - The caller owns the returned meshes, as with new Mesh(...)
+// --------------------------------------------------------
+class MeshLoader
+{
+private:
+	struct Request
+	{
+		std::string fileName;
+		Mesh* mesh;
+		bool compactVertices;
+		bool loaded;
+		MeshData data;
+		std::promise<Mesh*> promise;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	GeometryPool* pool;
+
+	std::mutex mutex;
+	std::deque<std::unique_ptr<Request>> queued;
+	std::vector<std::unique_ptr<Request>> cooked;
+	int pendingCount;
+	bool stopping;
+
+	// Loader jobs running, at most maxLoads
+	int maxLoads;
+	int activeLoads;
+	JobCounter loading;
+
+	// Every request so far, by file name and vertex format (under mutex)
+	std::map<std::pair<std::string, bool>, MeshHandle> handles;
+
+	void LoadQueued();
+	void Upload(std::vector<std::unique_ptr<Request>>& requests);
+
+public:
+	// threadCount is how many files load at once - 0 means one per
+	// job system worker
+	// - With a pool, meshes are suballocated from it where they fit
+	MeshLoader(Microsoft::WRL::ComPtr<ID3D11Device> device, int threadCount = 0, GeometryPool* pool = nullptr);
+	~MeshLoader();
+
+	// Not copyable - the loader jobs point back at us
+	MeshLoader(const MeshLoader&) = delete;
+	MeshLoader& operator=(const MeshLoader&) = delete;
+
+	// Queues a file and returns immediately (see Mesh's file constructor)
+	// - Safe to call from any thread
+	MeshHandle LoadAsync(const char* fileName, bool compactVertices = false);
+
+	// Creates GPU buffers for up to maxUploads finished meshes - call
+	// once a frame from the thread that owns the device
+	// - Returns how many meshes became resident
+	int Update(int maxUploads = INT_MAX);
+
+	// Blocks until every queued mesh is resident, running jobs while
+	// it waits
+	void WaitAll();
+
+	// Meshes queued or loading but not resident yet
+	int GetPendingCount();
+
+	// How many files load at once, at most
+	int GetThreadCount() const;
+};
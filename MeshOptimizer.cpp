@@ -0,0 +1,444 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+namespace
+{
+	// Forsyth's scoring parameters
+	// - See: https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+	const int ForsythCacheSize = 32;
+	const int ForsythMaxValence = 64;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	struct ForsythTables
+	{
+		float cache[ForsythCacheSize];
+		float valence[ForsythMaxValence];
+
+		ForsythTables()
+		{
+			for (int i = 0; i < ForsythCacheSize; i++)
+			{
+				// The last triangle's three verts get a fixed score, so
+				// whichever of them is picked, it doesn't matter
+				if (i < 3)
+				{
+					cache[i] = LastTriScore;
+					continue;
+				}
+
+				float scaler = 1.0f / (ForsythCacheSize - 3);
+				cache[i] = powf(1.0f - (i - 3) * scaler, CacheDecayPower);
+			}
+
+			valence[0] = 0.0f;
+			for (int i = 1; i < ForsythMaxValence; i++)
+				valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+		}
+	};
+
+	float VertexScore(const ForsythTables& tables, int cachePosition, int liveTriangles)
+	{
+		// No triangles left that need this vertex
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+		return score + tables.valence[std::min(liveTriangles, ForsythMaxValence - 1)];
+	}
+
+	// Triangle-to-vertex adjacency in compressed (CSR) form
+	struct Adjacency
+	{
+		std::vector<int> counts;
+		std::vector<int> offsets;
+		std::vector<int> triangles;
+
+		Adjacency(const unsigned int* indices, int indexCount, int vertexCount)
+		{
+			counts.assign(vertexCount, 0);
+			offsets.assign(vertexCount, 0);
+			triangles.resize(indexCount);
+
+			for (int i = 0; i < indexCount; i++)
+				counts[indices[i]]++;
+
+			int offset = 0;
+			for (int v = 0; v < vertexCount; v++)
+			{
+				offsets[v] = offset;
+				offset += counts[v];
+			}
+
+			std::vector<int> fill(vertexCount, 0);
+			for (int i = 0; i < indexCount; i++)
+			{
+				unsigned int v = indices[i];
+				triangles[offsets[v] + fill[v]++] = i / 3;
+			}
+		}
+	};
+
+	// Simple FIFO post-transform cache, like the hardware uses
+	class FifoCache
+	{
+	private:
+		std::vector<unsigned int> timestamps;
+		unsigned int time;
+		int size;
+
+	public:
+		FifoCache(int vertexCount, int cacheSize)
+			: timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize)
+		{
+		}
+
+		// Returns true on a miss
+		bool Access(unsigned int v)
+		{
+			if (time - timestamps[v] > (unsigned int)size)
+			{
+				timestamps[v] = time++;
+				return true;
+			}
+			return false;
+		}
+
+		void Reset()
+		{
+			time += size + 1;
+		}
+	};
+}
+
+void MeshOptimizer::Optimize(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, const char* name, const MeshLod* ranges, int rangeCount)
+{
+	if (verts.empty() || indices.empty())
+		return;
+
+	int indexCount = (int)indices.size();
+	VertexCacheStats before = AnalyzeVertexCache(&indices[0], indexCount, (int)verts.size());
+
+	// Triangles only move around inside their own range, so submeshes
+	// stay contiguous - vertex fetch order is global either way
+	MeshLod whole = { 0, indexCount, 0.0f };
+	if (ranges == nullptr || rangeCount <= 0)
+	{
+		ranges = &whole;
+		rangeCount = 1;
+	}
+	std::vector<unsigned int> original;
+	for (int r = 0; r < rangeCount; r++)
+	{
+		if (ranges[r].indexCount == 0)
+			continue;
+		unsigned int* rangeIndices = &indices[ranges[r].firstIndex];
+		original.assign(rangeIndices, rangeIndices + ranges[r].indexCount);
+
+		OptimizeVertexCache(rangeIndices, ranges[r].indexCount, (int)verts.size());
+		OptimizeOverdraw(rangeIndices, ranges[r].indexCount, &verts[0], (int)verts.size());
+
+		// Input that's already in a good order (such as strips) can
+		// beat the greedy result - keep whichever misses less
+		if (AnalyzeVertexCache(rangeIndices, ranges[r].indexCount, (int)verts.size()).acmr >
+			AnalyzeVertexCache(original.data(), ranges[r].indexCount, (int)verts.size()).acmr)
+			std::copy(original.begin(), original.end(), rangeIndices);
+	}
+	verts.resize(OptimizeVertexFetch(&verts[0], (int)verts.size(), &indices[0], indexCount));
+
+	VertexCacheStats after = AnalyzeVertexCache(&indices[0], indexCount, (int)verts.size());
+	printf("  Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		name, before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount)
+{
+	static const ForsythTables tables;
+
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	Adjacency adjacency(indices, indexCount, vertexCount);
+
+	// Per-vertex state
+	std::vector<int> liveTriangles(adjacency.counts);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		vertexScores[v] = VertexScore(tables, -1, liveTriangles[v]);
+
+	// Per-triangle state
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	int bestTriangle = 0;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] =
+			vertexScores[indices[t * 3 + 0]] +
+			vertexScores[indices[t * 3 + 1]] +
+			vertexScores[indices[t * 3 + 2]];
+
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	// Room for the full cache plus the three verts being pushed in
+	int cache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+
+	std::vector<unsigned int> output(indexCount);
+	int nextUnemitted = 0;
+
+	for (int outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++)
+	{
+		// Nothing in the cache has live triangles - take the next one in input order
+		if (bestTriangle < 0)
+		{
+			while (emitted[nextUnemitted])
+				nextUnemitted++;
+			bestTriangle = nextUnemitted;
+		}
+
+		const unsigned int* tri = &indices[bestTriangle * 3];
+		output[outputTriangle * 3 + 0] = tri[0];
+		output[outputTriangle * 3 + 1] = tri[1];
+		output[outputTriangle * 3 + 2] = tri[2];
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from each vertex's live list
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			int* list = &adjacency.triangles[adjacency.offsets[v]];
+			int count = liveTriangles[v];
+			for (int i = 0; i < count; i++)
+			{
+				if (list[i] == bestTriangle)
+				{
+					list[i] = list[count - 1];
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// Push the triangle's verts to the front of the cache
+		int newCache[ForsythCacheSize + 3];
+		int newCount = 0;
+		for (int k = 0; k < 3; k++)
+			newCache[newCount++] = (int)tri[k];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore every vertex that was or still is in the cache
+		for (int i = 0; i < newCount; i++)
+		{
+			int v = newCache[i];
+			cachePosition[v] = i < ForsythCacheSize ? i : -1;
+			vertexScores[v] = VertexScore(tables, cachePosition[v], liveTriangles[v]);
+		}
+
+		// Rescore their triangles and pick the best one for next time
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; i++)
+		{
+			int v = newCache[i];
+			const int* list = &adjacency.triangles[adjacency.offsets[v]];
+			for (int n = 0; n < liveTriangles[v]; n++)
+			{
+				int t = list[n];
+				float score =
+					vertexScores[indices[t * 3 + 0]] +
+					vertexScores[indices[t * 3 + 1]] +
+					vertexScores[indices[t * 3 + 2]];
+				triangleScores[t] = score;
+
+				// Ties go to the lowest triangle index, to stay deterministic
+				if (score > bestScore || (score == bestScore && t < bestTriangle))
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, ForsythCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* indices, int indexCount, const Vertex* verts, int vertexCount, float threshold)
+{
+	const int CacheSize = 16;
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Hard boundaries: triangles where all three verts miss the
+	// cache, meaning the cache was effectively restarted there
+	std::vector<int> hardClusters;
+	{
+		FifoCache cache(vertexCount, CacheSize);
+		for (int t = 0; t < triangleCount; t++)
+		{
+			int misses =
+				cache.Access(indices[t * 3 + 0]) +
+				cache.Access(indices[t * 3 + 1]) +
+				cache.Access(indices[t * 3 + 2]);
+			if (t == 0 || misses == 3)
+				hardClusters.push_back(t);
+		}
+	}
+	hardClusters.push_back(triangleCount);
+
+	// Soft boundaries: split each hard cluster further wherever the
+	// running ACMR is still within the threshold of the cluster's own
+	std::vector<int> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+	{
+		int start = hardClusters[c];
+		int end = hardClusters[c + 1];
+
+		FifoCache cache(vertexCount, CacheSize);
+		int clusterMisses = 0;
+		for (int t = start; t < end; t++)
+		{
+			clusterMisses +=
+				cache.Access(indices[t * 3 + 0]) +
+				cache.Access(indices[t * 3 + 1]) +
+				cache.Access(indices[t * 3 + 2]);
+		}
+		float clusterThreshold = threshold * clusterMisses / (end - start);
+
+		cache.Reset();
+		clusters.push_back(start);
+		int runningMisses = 0;
+		int runningTriangles = 0;
+		for (int t = start; t < end; t++)
+		{
+			runningMisses +=
+				cache.Access(indices[t * 3 + 0]) +
+				cache.Access(indices[t * 3 + 1]) +
+				cache.Access(indices[t * 3 + 2]);
+			runningTriangles++;
+
+			if (t + 1 < end && (float)runningMisses / runningTriangles <= clusterThreshold)
+			{
+				clusters.push_back(t + 1);
+				cache.Reset();
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Area-weighted centroid of the whole mesh
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	std::vector<XMFLOAT4> clusterData(clusters.size() - 1); // Centroid xyz + area
+	std::vector<XMFLOAT3> clusterNormals(clusters.size() - 1);
+	for (size_t c = 0; c + 1 < clusters.size(); c++)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (int t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			XMVECTOR a = XMLoadFloat3(&verts[indices[t * 3 + 0]].Position);
+			XMVECTOR b = XMLoadFloat3(&verts[indices[t * 3 + 1]].Position);
+			XMVECTOR d = XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+
+			// Clockwise front faces in left-handed space, so this points outward
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(d, a));
+			float triArea = XMVectorGetX(XMVector3Length(n));
+
+			centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(a, b), d), triArea / 3.0f));
+			normal = XMVectorAdd(normal, n);
+			area += triArea;
+		}
+
+		meshCentroid = XMVectorAdd(meshCentroid, centroid);
+		meshArea += area;
+
+		if (area > 0.0f)
+			centroid = XMVectorScale(centroid, 1.0f / area);
+		XMStoreFloat4(&clusterData[c], XMVectorSetW(centroid, area));
+		XMStoreFloat3(&clusterNormals[c], XMVector3Normalize(normal));
+	}
+	if (meshArea > 0.0f)
+		meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+	// Clusters that face away from the center occlude more, so they go first
+	std::vector<float> sortKeys(clusterData.size());
+	std::vector<int> order(clusterData.size());
+	for (size_t c = 0; c < clusterData.size(); c++)
+	{
+		XMVECTOR centroid = XMLoadFloat4(&clusterData[c]);
+		XMVECTOR normal = XMLoadFloat3(&clusterNormals[c]);
+		sortKeys[c] = XMVectorGetX(XMVector3Dot(XMVectorSubtract(centroid, meshCentroid), normal));
+		order[c] = (int)c;
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[&](int a, int b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	for (int c : order)
+		output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+int MeshOptimizer::OptimizeVertexFetch(Vertex* verts, int vertexCount, unsigned int* indices, int indexCount)
+{
+	const unsigned int Unused = 0xFFFFFFFFu;
+	std::vector<unsigned int> remap(vertexCount, Unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertexCount);
+
+	for (int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] == Unused)
+		{
+			remap[v] = (unsigned int)reordered.size();
+			reordered.push_back(verts[v]);
+		}
+		indices[i] = remap[v];
+	}
+
+	std::copy(reordered.begin(), reordered.end(), verts);
+	return (int)reordered.size();
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	VertexCacheStats stats = {};
+	if (indexCount == 0 || vertexCount == 0)
+		return stats;
+
+	FifoCache cache(vertexCount, cacheSize);
+	int misses = 0;
+	for (int i = 0; i < indexCount; i++)
+		misses += cache.Access(indices[i]);
+
+	stats.acmr = (float)misses / (indexCount / 3);
+	stats.atvr = (float)misses / vertexCount;
+	return stats;
+}
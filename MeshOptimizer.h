@@ -0,0 +1,72 @@
+#pragma once
+
+#include "MeshSimplifier.h"
+#include "Vertex.h"
+#include <vector>
+
+// --------------------------------------------------------
+// Stats from running an index buffer through a simulated
+// post-transform vertex cache (FIFO)
+//
+// - ACMR: average cache misses per triangle (lower is better, 0.5 is ideal-ish)
+// - ATVR: average transforms per vertex (1.0 is ideal)
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+// --------------------------------------------------------
+// At-load index and vertex reordering passes
+//
+// All of these are deterministic: the same input always
+// produces the same output, so results can be compared
+// across runs and machines
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	// Runs all three passes below, in order, and prints ACMR/ATVR
+	// before and after - vertices may be reordered (and unused
+	// ones dropped), so the vectors are resized to match
+	// - A range keeps its original triangle order if that has
+	//   the lower ACMR
+	// - ranges (optional) are index ranges, such as submeshes, that
+	//   triangles must not be reordered across
+	static void Optimize(
+		std::vector<Vertex>& verts,
+		std::vector<unsigned int>& indices,
+		const char* name,
+		const MeshLod* ranges = nullptr,
+		int rangeCount = 0);
+
+	// Reorders triangles for post-transform cache reuse (Forsyth's algorithm)
+	static void OptimizeVertexCache(
+		unsigned int* indices,
+		int indexCount,
+		int vertexCount);
+
+	// Reorders clusters of triangles so outward-facing ones draw first,
+	// as long as ACMR doesn't get worse than "threshold" times the input
+	static void OptimizeOverdraw(
+		unsigned int* indices,
+		int indexCount,
+		const Vertex* verts,
+		int vertexCount,
+		float threshold = 1.05f);
+
+	// Reorders vertices into first-use order for linear fetches and
+	// rewrites the indices to match - returns the new vertex count
+	static int OptimizeVertexFetch(
+		Vertex* verts,
+		int vertexCount,
+		unsigned int* indices,
+		int indexCount);
+
+	static VertexCacheStats AnalyzeVertexCache(
+		const unsigned int* indices,
+		int indexCount,
+		int vertexCount,
+		int cacheSize = 16);
+};
@@ -0,0 +1,466 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	// LODs below this many triangles aren't worth the draw call savings
+	const int MinLodTriangles = 32;
+
+	// A level has to come in under this fraction of the previous one to be kept
+	const float MinLodShrink = 0.75f;
+
+	// Collapses that bend a neighboring triangle's normal by more than
+	// ~75 degrees (or flip it outright) are rejected
+	const double MinNormalCosine = 0.25;
+
+	// Symmetric 4x4 matrix of a sum of squared plane distances,
+	// along with the total weight (area) of those planes
+	struct Quadric
+	{
+		double a2, b2, c2, d2;
+		double ab, ac, ad;
+		double bc, bd;
+		double cd;
+		double weight;
+	};
+
+	void AddPlane(Quadric& q, double a, double b, double c, double d, double weight)
+	{
+		q.a2 += weight * a * a;
+		q.b2 += weight * b * b;
+		q.c2 += weight * c * c;
+		q.d2 += weight * d * d;
+		q.ab += weight * a * b;
+		q.ac += weight * a * c;
+		q.ad += weight * a * d;
+		q.bc += weight * b * c;
+		q.bd += weight * b * d;
+		q.cd += weight * c * d;
+		q.weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a2 += other.a2;
+		q.b2 += other.b2;
+		q.c2 += other.c2;
+		q.d2 += other.d2;
+		q.ab += other.ab;
+		q.ac += other.ac;
+		q.ad += other.ad;
+		q.bc += other.bc;
+		q.bd += other.bd;
+		q.cd += other.cd;
+		q.weight += other.weight;
+	}
+
+	// Area-weighted mean squared distance from p to the quadric's planes
+	double EvaluateQuadric(const Quadric& q, const XMFLOAT3& p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double error =
+			q.a2 * x * x + q.b2 * y * y + q.c2 * z * z +
+			2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z) +
+			2.0 * (q.ad * x + q.bd * y + q.cd * z) +
+			q.d2;
+		return q.weight > 0.0 ? fabs(error) / q.weight : 0.0;
+	}
+
+	// Unnormalized triangle normal (length is twice the area)
+	void TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, double n[3])
+	{
+		double ux = (double)p1.x - p0.x, uy = (double)p1.y - p0.y, uz = (double)p1.z - p0.z;
+		double vx = (double)p2.x - p0.x, vy = (double)p2.y - p0.y, vz = (double)p2.z - p0.z;
+		n[0] = uy * vz - uz * vy;
+		n[1] = uz * vx - ux * vz;
+		n[2] = ux * vy - uy * vx;
+	}
+
+	// A possible edge collapse: vertex "from" moves onto vertex "to"
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double error;
+	};
+
+	// Vertex-to-triangle adjacency in compressed (CSR) form
+	struct TriangleAdjacency
+	{
+		std::vector<int> offsets;
+		std::vector<int> triangles;
+
+		TriangleAdjacency(const unsigned int* indices, int indexCount, int vertexCount)
+		{
+			offsets.assign(vertexCount + 1, 0);
+			triangles.resize(indexCount);
+
+			for (int i = 0; i < indexCount; i++)
+				offsets[indices[i] + 1]++;
+			for (int v = 0; v < vertexCount; v++)
+				offsets[v + 1] += offsets[v];
+
+			std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+			for (int i = 0; i < indexCount; i++)
+				triangles[fill[indices[i]]++] = i / 3;
+		}
+
+		const int* Begin(unsigned int v) const { return &triangles[0] + offsets[v]; }
+		const int* End(unsigned int v) const { return &triangles[0] + offsets[v + 1]; }
+	};
+
+	// Links every vertex to the others that share its exact position
+	// - positionOf[v] is the lowest index with v's position
+	// - nextWedge[] is a circular list through each such group
+	void GroupPositions(const Vertex* verts, int vertexCount, std::vector<unsigned int>& positionOf, std::vector<unsigned int>& nextWedge)
+	{
+		std::vector<unsigned int> order(vertexCount);
+		for (int i = 0; i < vertexCount; i++)
+			order[i] = i;
+
+		std::sort(order.begin(), order.end(), [verts](unsigned int a, unsigned int b)
+		{
+			int c = memcmp(&verts[a].Position, &verts[b].Position, sizeof(XMFLOAT3));
+			return c != 0 ? c < 0 : a < b;
+		});
+
+		positionOf.resize(vertexCount);
+		nextWedge.resize(vertexCount);
+		for (int start = 0; start < vertexCount;)
+		{
+			int end = start + 1;
+			while (end < vertexCount &&
+				memcmp(&verts[order[start]].Position, &verts[order[end]].Position, sizeof(XMFLOAT3)) == 0)
+				end++;
+
+			for (int i = start; i < end; i++)
+			{
+				positionOf[order[i]] = order[start];
+				nextWedge[order[i]] = order[i + 1 < end ? i + 1 : start];
+			}
+			start = end;
+		}
+	}
+
+	// Collects the (position) neighbors of every triangle touching v
+	void GatherRing(const TriangleAdjacency& adjacency, const unsigned int* indices, const std::vector<unsigned int>& positionOf, unsigned int v, std::vector<unsigned int>& ring)
+	{
+		for (const int* t = adjacency.Begin(v); t != adjacency.End(v); t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int p = positionOf[indices[*t * 3 + k]];
+				if (p != positionOf[v])
+					ring.push_back(p);
+			}
+		}
+	}
+}
+
+int MeshSimplifier::Simplify(unsigned int* destination, const unsigned int* indices, int indexCount, const Vertex* verts, int vertexCount, int targetIndexCount, float maxError, float* resultError)
+{
+	if (resultError)
+		*resultError = 0.0f;
+	if (destination != indices)
+		memcpy(destination, indices, sizeof(unsigned int) * indexCount);
+	if (indexCount <= targetIndexCount || vertexCount == 0)
+		return indexCount;
+
+	std::vector<unsigned int> positionOf;
+	std::vector<unsigned int> nextWedge;
+	GroupPositions(verts, vertexCount, positionOf, nextWedge);
+
+	// Count every directed edge between positions - on a closed, manifold
+	// patch each one appears exactly once, and so does its reverse
+	std::unordered_map<uint64_t, int> edgeCounts;
+	edgeCounts.reserve(indexCount);
+	for (int i = 0; i < indexCount; i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			uint64_t a = positionOf[indices[i + k]];
+			uint64_t b = positionOf[indices[i + (k + 1) % 3]];
+			edgeCounts[(a << 32) | b]++;
+		}
+	}
+
+	// Only vertices with a single wedge, surrounded entirely by manifold
+	// edges, may move - seams, borders and anything stranger stay put
+	std::vector<unsigned char> movable(vertexCount, 0);
+	for (int v = 0; v < vertexCount; v++)
+		movable[v] = nextWedge[v] == (unsigned int)v;
+
+	for (const std::pair<const uint64_t, int>& edge : edgeCounts)
+	{
+		uint64_t a = edge.first >> 32;
+		uint64_t b = edge.first & 0xFFFFFFFF;
+		std::unordered_map<uint64_t, int>::const_iterator reverse = edgeCounts.find((b << 32) | a);
+		if (edge.second != 1 || reverse == edgeCounts.end() || reverse->second != 1)
+		{
+			movable[a] = 0;
+			movable[b] = 0;
+		}
+	}
+
+	// Each position accumulates the planes of the triangles around it
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	for (int i = 0; i < indexCount; i += 3)
+	{
+		const XMFLOAT3& p0 = verts[indices[i + 0]].Position;
+		const XMFLOAT3& p1 = verts[indices[i + 1]].Position;
+		const XMFLOAT3& p2 = verts[indices[i + 2]].Position;
+
+		double n[3];
+		TriangleNormal(p0, p1, p2, n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0)
+			continue;
+
+		double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+		double d = -(a * p0.x + b * p0.y + c * p0.z);
+		for (int k = 0; k < 3; k++)
+			AddPlane(quadrics[positionOf[indices[i + k]]], a, b, c, d, length * 0.5);
+	}
+
+	// Collapse in passes: find every legal collapse, then apply the
+	// cheapest ones whose neighborhoods don't overlap, and repeat
+	double maxCost = (double)maxError * maxError;
+	double worstCost = 0.0;
+	int currentCount = indexCount;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned char> locked(vertexCount);
+	std::vector<Collapse> candidates;
+	std::vector<unsigned int> ringFrom;
+	std::vector<unsigned int> ringTo;
+	while (currentCount > targetIndexCount)
+	{
+		TriangleAdjacency adjacency(destination, currentCount, vertexCount);
+
+		candidates.clear();
+		for (int i = 0; i < currentCount; i++)
+		{
+			unsigned int from = destination[i];
+			unsigned int to = destination[i - i % 3 + (i + 1) % 3];
+			if (!movable[from])
+				continue;
+
+			// The edge must not be a seam, which means the neighboring
+			// triangle has to use the very same two vertices
+			bool paired = false;
+			for (const int* t = adjacency.Begin(from); t != adjacency.End(from) && !paired; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					if (destination[*t * 3 + k] == to && destination[*t * 3 + (k + 1) % 3] == from)
+						paired = true;
+				}
+			}
+			if (!paired)
+				continue;
+
+			Quadric q = quadrics[from];
+			AddQuadric(q, quadrics[positionOf[to]]);
+			double cost = EvaluateQuadric(q, verts[to].Position);
+			if (cost <= maxCost)
+				candidates.push_back({ from, to, cost });
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b)
+		{
+			if (a.error != b.error)
+				return a.error < b.error;
+			return a.from != b.from ? a.from < b.from : a.to < b.to;
+		});
+
+		for (int v = 0; v < vertexCount; v++)
+			remap[v] = v;
+		std::fill(locked.begin(), locked.end(), (unsigned char)0);
+
+		int trianglesToRemove = (currentCount - targetIndexCount + 2) / 3;
+		int removed = 0;
+		for (const Collapse& c : candidates)
+		{
+			if (removed >= trianglesToRemove)
+				break;
+
+			unsigned int from = c.from;
+			unsigned int to = positionOf[c.to];
+			if (locked[from] || locked[to])
+				continue;
+
+			// Link condition: the edge's endpoints must share exactly two
+			// neighbors, or the collapse would pinch the surface
+			ringFrom.clear();
+			ringTo.clear();
+			GatherRing(adjacency, destination, positionOf, from, ringFrom);
+			unsigned int wedge = to;
+			do
+			{
+				GatherRing(adjacency, destination, positionOf, wedge, ringTo);
+				wedge = nextWedge[wedge];
+			} while (wedge != to);
+
+			std::sort(ringFrom.begin(), ringFrom.end());
+			ringFrom.erase(std::unique(ringFrom.begin(), ringFrom.end()), ringFrom.end());
+			std::sort(ringTo.begin(), ringTo.end());
+			ringTo.erase(std::unique(ringTo.begin(), ringTo.end()), ringTo.end());
+
+			int shared = 0;
+			for (size_t a = 0, b = 0; a < ringFrom.size() && b < ringTo.size();)
+			{
+				if (ringFrom[a] < ringTo[b]) a++;
+				else if (ringTo[b] < ringFrom[a]) b++;
+				else { shared++; a++; b++; }
+			}
+			if (shared != 2)
+				continue;
+
+			// Triangles that survive the collapse must not flip or collapse
+			bool flips = false;
+			int collapsing = 0;
+			for (const int* t = adjacency.Begin(from); t != adjacency.End(from) && !flips; t++)
+			{
+				const unsigned int* tri = &destination[*t * 3];
+				if (positionOf[tri[0]] == to || positionOf[tri[1]] == to || positionOf[tri[2]] == to)
+				{
+					collapsing++;
+					continue;
+				}
+
+				XMFLOAT3 p[3];
+				XMFLOAT3 moved[3];
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = verts[tri[k]].Position;
+					moved[k] = tri[k] == from ? verts[c.to].Position : p[k];
+				}
+
+				double before[3];
+				double after[3];
+				TriangleNormal(p[0], p[1], p[2], before);
+				TriangleNormal(moved[0], moved[1], moved[2], after);
+				double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				double lengths = sqrt(
+					(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+					(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+				flips = dot <= MinNormalCosine * lengths;
+			}
+			if (flips)
+				continue;
+
+			remap[from] = c.to;
+			AddQuadric(quadrics[to], quadrics[from]);
+			worstCost = std::max(worstCost, c.error);
+			removed += collapsing;
+
+			// Nothing else this pass may touch either neighborhood, which keeps
+			// the adjacency (and the checks above) exact for later collapses
+			locked[from] = 1;
+			locked[to] = 1;
+			for (unsigned int p : ringFrom)
+				locked[p] = 1;
+			for (unsigned int p : ringTo)
+				locked[p] = 1;
+		}
+
+		if (removed == 0)
+			break;
+
+		// Apply the collapses and drop triangles that lost their area
+		int write = 0;
+		for (int i = 0; i < currentCount; i += 3)
+		{
+			unsigned int a = remap[destination[i + 0]];
+			unsigned int b = remap[destination[i + 1]];
+			unsigned int c = remap[destination[i + 2]];
+			if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c])
+				continue;
+
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		currentCount = write;
+	}
+
+	if (resultError)
+		*resultError = (float)sqrt(worstCost);
+	return currentCount;
+}
+
+void MeshSimplifier::GenerateLods(const Vertex* verts, int vertexCount, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods, int maxLodCount, float reduction)
+{
+	MeshLod whole = { 0, (int)indices.size(), 0.0f };
+	std::vector<MeshLod> submeshLods;
+	GenerateLods(verts, vertexCount, indices, &whole, 1, lods, submeshLods, maxLodCount, reduction);
+}
+
+void MeshSimplifier::GenerateLods(const Vertex* verts, int vertexCount, std::vector<unsigned int>& indices, const MeshLod* submeshes, int submeshCount, std::vector<MeshLod>& lods, std::vector<MeshLod>& submeshLods, int maxLodCount, float reduction)
+{
+	int baseCount = (int)indices.size();
+	lods.clear();
+	lods.push_back({ 0, baseCount, 0.0f });
+	submeshLods.assign(submeshes, submeshes + submeshCount);
+
+	// Every level is simplified from the full mesh (rather than the level
+	// before it) so its error is measured against the real surface
+	std::vector<unsigned int> lod(baseCount);
+	int previousCount = baseCount;
+	float previousError = 0.0f;
+	for (int level = 1; level < maxLodCount; level++)
+	{
+		// Each submesh on its own, so no collapse crosses a material
+		// boundary - ones too small to shrink carry over unchanged
+		const MeshLod* previous = &submeshLods[(level - 1) * submeshCount];
+		std::vector<MeshLod> ranges(submeshCount);
+		int count = 0;
+		float error = previousError;
+		for (int s = 0; s < submeshCount; s++)
+		{
+			ranges[s] = { (int)indices.size() + count, previous[s].indexCount, previous[s].error };
+
+			int target = (int)(previous[s].indexCount * reduction) / 3 * 3;
+			int simplifiedCount = -1;
+			float simplifiedError = 0.0f;
+			if (target >= MinLodTriangles * 3)
+			{
+				simplifiedCount = Simplify(&lod[count], &indices[submeshes[s].firstIndex], submeshes[s].indexCount, verts, vertexCount, target, FLT_MAX, &simplifiedError);
+				if (simplifiedCount > previous[s].indexCount * MinLodShrink)
+					simplifiedCount = -1;
+			}
+
+			if (simplifiedCount < 0)
+			{
+				std::copy(&indices[previous[s].firstIndex], &indices[previous[s].firstIndex] + previous[s].indexCount, &lod[count]);
+			}
+			else
+			{
+				MeshOptimizer::OptimizeVertexCache(&lod[count], simplifiedCount, vertexCount);
+				ranges[s].indexCount = simplifiedCount;
+				ranges[s].error = std::max(previous[s].error, simplifiedError);
+			}
+
+			error = std::max(error, ranges[s].error);
+			count += ranges[s].indexCount;
+		}
+
+		// Stop once the level as a whole stops shrinking
+		if (count == previousCount || count > previousCount * MinLodShrink)
+			break;
+
+		previousError = error;
+		lods.push_back({ (int)indices.size(), count, previousError });
+		indices.insert(indices.end(), lod.begin(), lod.begin() + count);
+		submeshLods.insert(submeshLods.end(), ranges.begin(), ranges.end());
+		previousCount = count;
+	}
+}
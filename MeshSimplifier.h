@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Vertex.h"
+#include <vector>
+
+// --------------------------------------------------------
+// One level of detail inside a mesh's index buffer
+//
+// - All LODs share the mesh's vertex buffer; each one is just
+//   a range of the index buffer
+// - error is how far (in object space units) this LOD's surface
+//   may stray from the full resolution mesh
+// --------------------------------------------------------
+struct MeshLod
+{
+	int firstIndex;
+	int indexCount;
+	float error;
+};
+
+// --------------------------------------------------------
+// Edge collapse simplification using quadric error metrics
+// (Garland & Heckbert)
+//
+// - Only the index buffer changes: every collapse moves one
+//   vertex onto a neighboring vertex, so the existing vertex
+//   data stays valid for every LOD
+// - Vertices on UV/normal seams (several vertices sharing one
+//   position) and on open borders never move, which keeps
+//   seams and silhouettes of open meshes intact
+// --------------------------------------------------------
+class MeshSimplifier
+{
+public:
+	// Simplifies a triangle list until it has at most targetIndexCount
+	// indices, or until no collapse stays under maxError
+	// - destination needs room for indexCount indices
+	// - Returns the number of indices written to destination
+	// - resultError (optional) gets the object space error of the result
+	static int Simplify(
+		unsigned int* destination,
+		const unsigned int* indices,
+		int indexCount,
+		const Vertex* verts,
+		int vertexCount,
+		int targetIndexCount,
+		float maxError,
+		float* resultError = nullptr);
+
+	// Appends a chain of coarser LODs to "indices", each roughly
+	// "reduction" times the size of the one before it
+	// - On input, "indices" is the full resolution mesh (LOD 0)
+	// - The chain stops early once a level stops shrinking
+	static void GenerateLods(
+		const Vertex* verts,
+		int vertexCount,
+		std::vector<unsigned int>& indices,
+		std::vector<MeshLod>& lods,
+		int maxLodCount = 5,
+		float reduction = 0.5f);
+
+	// Same, for a mesh split into submeshes (index ranges of LOD 0)
+	// - Each submesh is simplified on its own, so no collapse crosses
+	//   from one material into another, and every LOD keeps them in
+	//   the same order, back to back
+	// - submeshLods gets lods.size() * submeshCount ranges, LOD-major:
+	//   submesh s of LOD l is submeshLods[l * submeshCount + s]
+	// - A submesh too small to shrink any further carries over to the
+	//   next level unchanged
+	static void GenerateLods(
+		const Vertex* verts,
+		int vertexCount,
+		std::vector<unsigned int>& indices,
+		const MeshLod* submeshes,
+		int submeshCount,
+		std::vector<MeshLod>& lods,
+		std::vector<MeshLod>& submeshLods,
+		int maxLodCount = 5,
+		float reduction = 0.5f);
+};
@@ -0,0 +1,250 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Normal cones whose triangles spread wider than this (as the
+	// minimum cosine to the axis) aren't worth testing
+	const float MinConeCosine = 0.1f;
+
+	// Fills in the bounding sphere and normal cone of a finished meshlet
+	void ComputeMeshletBounds(Meshlet& m, const Vertex* verts, const unsigned int* meshletVertices, const unsigned char* meshletTriangles)
+	{
+		// Sphere around the center of the meshlet's AABB
+		XMVECTOR boundsMin = XMLoadFloat3(&verts[meshletVertices[0]].Position);
+		XMVECTOR boundsMax = boundsMin;
+		for (unsigned int i = 1; i < m.vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&verts[meshletVertices[i]].Position);
+			boundsMin = XMVectorMin(boundsMin, p);
+			boundsMax = XMVectorMax(boundsMax, p);
+		}
+
+		XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+		float radiusSq = 0.0f;
+		for (unsigned int i = 0; i < m.vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&verts[meshletVertices[i]].Position);
+			radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p, center))));
+		}
+		XMStoreFloat3(&m.center, center);
+		m.radius = sqrtf(radiusSq);
+
+		// Cone around the average face normal (clockwise winding, so
+		// cross(b - a, c - a) points out of the front face)
+		XMVECTOR normals[MeshletMaxTriangles];
+		XMVECTOR axis = XMVectorZero();
+		int normalCount = 0;
+		for (unsigned int t = 0; t < m.triangleCount; t++)
+		{
+			XMVECTOR a = XMLoadFloat3(&verts[meshletVertices[meshletTriangles[t * 3 + 0]]].Position);
+			XMVECTOR b = XMLoadFloat3(&verts[meshletVertices[meshletTriangles[t * 3 + 1]]].Position);
+			XMVECTOR c = XMLoadFloat3(&verts[meshletVertices[meshletTriangles[t * 3 + 2]]].Position);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+			if (XMVectorGetX(XMVector3LengthSq(n)) == 0.0f)
+				continue;
+
+			n = XMVector3Normalize(n);
+			normals[normalCount++] = n;
+			axis = XMVectorAdd(axis, n);
+		}
+
+		m.coneAxis = XMFLOAT3(0, 0, 0);
+		m.coneCutoff = 1.0f;
+		if (normalCount == 0 || XMVectorGetX(XMVector3LengthSq(axis)) == 0.0f)
+			return;
+
+		axis = XMVector3Normalize(axis);
+		float minCosine = 1.0f;
+		for (int i = 0; i < normalCount; i++)
+			minCosine = std::min(minCosine, XMVectorGetX(XMVector3Dot(normals[i], axis)));
+
+		XMStoreFloat3(&m.coneAxis, axis);
+		if (minCosine > MinConeCosine)
+			m.coneCutoff = sqrtf(1.0f - minCosine * minCosine);
+	}
+}
+
+void Meshlets::Build(const Vertex* verts, int vertexCount, const unsigned int* indices, int indexCount, std::vector<Meshlet>& meshlets, std::vector<unsigned int>& meshletVertices, std::vector<unsigned char>& meshletTriangles)
+{
+	meshlets.clear();
+	meshletVertices.clear();
+	meshletTriangles.clear();
+
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Vertex-to-triangle adjacency in compressed (CSR) form
+	std::vector<int> offsets(vertexCount + 1, 0);
+	std::vector<int> adjacent(triangleCount * 3);
+	for (int i = 0; i < triangleCount * 3; i++)
+		offsets[indices[i] + 1]++;
+	for (int v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int i = 0; i < triangleCount * 3; i++)
+		adjacent[fill[indices[i]]++] = i / 3;
+
+	// Unit face normals (zero for degenerate triangles)
+	std::vector<XMFLOAT3> faceNormals(triangleCount);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR a = XMLoadFloat3(&verts[indices[t * 3 + 0]].Position);
+		XMVECTOR b = XMLoadFloat3(&verts[indices[t * 3 + 1]].Position);
+		XMVECTOR c = XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+		XMVECTOR n = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+		if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+			n = XMVector3Normalize(n);
+		XMStoreFloat3(&faceNormals[t], n);
+	}
+
+	// Where each vertex lives in the meshlet being built (-1 if it doesn't)
+	std::vector<int> localIndex(vertexCount, -1);
+	std::vector<unsigned char> used(triangleCount, 0);
+	std::vector<int> candidates;
+
+	int seed = 0;
+	while (true)
+	{
+		// Start each meshlet from the first unused triangle in index order
+		while (seed < triangleCount && used[seed])
+			seed++;
+		if (seed == triangleCount)
+			break;
+
+		Meshlet current = {};
+		current.vertexOffset = (unsigned int)meshletVertices.size();
+		current.triangleOffset = (unsigned int)meshletTriangles.size();
+		XMVECTOR normalSum = XMVectorZero();
+		candidates.clear();
+
+		int next = seed;
+		while (next >= 0)
+		{
+			// Add the triangle, and queue up everything touching its new vertices
+			const unsigned int* tri = &indices[next * 3];
+			for (int k = 0; k < 3; k++)
+			{
+				if (localIndex[tri[k]] < 0)
+				{
+					localIndex[tri[k]] = (int)current.vertexCount++;
+					meshletVertices.push_back(tri[k]);
+					for (int a = offsets[tri[k]]; a < offsets[tri[k] + 1]; a++)
+					{
+						if (!used[adjacent[a]])
+							candidates.push_back(adjacent[a]);
+					}
+				}
+				meshletTriangles.push_back((unsigned char)localIndex[tri[k]]);
+			}
+			used[next] = 1;
+			current.triangleCount++;
+			normalSum = XMVectorAdd(normalSum, XMLoadFloat3(&faceNormals[next]));
+
+			if (current.triangleCount == MeshletMaxTriangles)
+				break;
+
+			// Grow towards the neighbor that adds the fewest vertices,
+			// then the one that best matches the meshlet's facing
+			next = -1;
+			int bestNewVertices = 4;
+			float bestFacing = -FLT_MAX;
+			size_t write = 0;
+			for (size_t c = 0; c < candidates.size(); c++)
+			{
+				int t = candidates[c];
+				if (used[t])
+					continue;
+				candidates[write++] = t;
+
+				const unsigned int* candidate = &indices[t * 3];
+				int newVertices =
+					(localIndex[candidate[0]] < 0) +
+					(localIndex[candidate[1]] < 0 && candidate[1] != candidate[0]) +
+					(localIndex[candidate[2]] < 0 && candidate[2] != candidate[0] && candidate[2] != candidate[1]);
+				if (current.vertexCount + newVertices > MeshletMaxVertices || newVertices > bestNewVertices)
+					continue;
+
+				float facing = XMVectorGetX(XMVector3Dot(normalSum, XMLoadFloat3(&faceNormals[t])));
+				if (newVertices < bestNewVertices || facing > bestFacing)
+				{
+					next = t;
+					bestNewVertices = newVertices;
+					bestFacing = facing;
+				}
+			}
+			candidates.resize(write);
+		}
+
+		ComputeMeshletBounds(current, verts, &meshletVertices[current.vertexOffset], &meshletTriangles[current.triangleOffset]);
+		meshlets.push_back(current);
+
+		for (unsigned int v = 0; v < current.vertexCount; v++)
+			localIndex[meshletVertices[current.vertexOffset + v]] = -1;
+	}
+}
+
+MeshletCullStats Meshlets::Cull(const Meshlet* meshlets, int meshletCount, const XMFLOAT4X4& world, Camera* camera, std::vector<int>& visible)
+{
+	MeshletCullStats stats = {};
+	stats.meshletsTested = meshletCount;
+	visible.clear();
+
+	XMFLOAT4 planes[6];
+	camera->GetFrustumPlanes(planes);
+	XMFLOAT3 cameraPositionFloat = camera->GetTransform()->GetPosition();
+	XMVECTOR cameraPosition = XMLoadFloat3(&cameraPositionFloat);
+
+	// Spheres grow by the largest axis scale - the cones are only
+	// trusted when the scale is (close to) uniform
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	float scaleX = XMVectorGetX(XMVector3Length(worldMatrix.r[0]));
+	float scaleY = XMVectorGetX(XMVector3Length(worldMatrix.r[1]));
+	float scaleZ = XMVectorGetX(XMVector3Length(worldMatrix.r[2]));
+	float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+	float minScale = std::min(scaleX, std::min(scaleY, scaleZ));
+	bool useCones = maxScale > 0.0f && minScale > maxScale * 0.99f;
+
+	for (int i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& m = meshlets[i];
+		stats.trianglesTested += m.triangleCount;
+
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&m.center), worldMatrix);
+		float radius = m.radius * maxScale;
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[p]), center)) < -radius;
+		if (outside)
+		{
+			stats.trianglesFrustumCulled += m.triangleCount;
+			continue;
+		}
+
+		// Every triangle faces away if the view direction lies inside
+		// the (sphere-padded) cone around the axis
+		if (useCones && m.coneCutoff < 1.0f)
+		{
+			XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&m.coneAxis), worldMatrix));
+			XMVECTOR view = XMVectorSubtract(center, cameraPosition);
+			float along = XMVectorGetX(XMVector3Dot(view, axis));
+			if (along >= m.coneCutoff * XMVectorGetX(XMVector3Length(view)) + radius)
+			{
+				stats.trianglesBackfaceCulled += m.triangleCount;
+				continue;
+			}
+		}
+
+		visible.push_back(i);
+		stats.meshletsVisible++;
+	}
+
+	return stats;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Camera.h"
+#include "Vertex.h"
+#include <DirectXMath.h>
+#include <vector>
+
+// Meshlet size limits (the usual mesh shader sweet spot)
+const int MeshletMaxVertices = 64;
+const int MeshletMaxTriangles = 124;
+
+// --------------------------------------------------------
+// A small cluster of a mesh's triangles
+//
+// - Its vertices are meshletVertices[vertexOffset ...], which
+//   index into the mesh's vertex buffer
+// - Its triangles are triangleCount * 3 bytes starting at
+//   meshletTriangles[triangleOffset], indexing into its vertices
+// - Bounds and cone are in object space
+// --------------------------------------------------------
+struct Meshlet
+{
+	unsigned int vertexOffset;
+	unsigned int triangleOffset;
+	unsigned int vertexCount;
+	unsigned int triangleCount;
+
+	// Bounding sphere
+	DirectX::XMFLOAT3 center;
+	float radius;
+
+	// Normal cone: every triangle faces within asin(coneCutoff) of
+	// the axis - a cutoff of 1 means the cone can never be culled
+	DirectX::XMFLOAT3 coneAxis;
+	float coneCutoff;
+};
+
+// Triangle and meshlet counts from one culling pass
+struct MeshletCullStats
+{
+	int meshletsTested;
+	int meshletsVisible;
+	int trianglesTested;
+	int trianglesFrustumCulled;
+	int trianglesBackfaceCulled;
+};
+
+// --------------------------------------------------------
+// Splits index buffers into meshlets and culls them on the CPU
+// --------------------------------------------------------
+class Meshlets
+{
+public:
+	// Grows each meshlet from the first unused triangle, always adding
+	// the neighboring triangle that brings in the fewest new vertices
+	// (ties go to the one facing most like the meshlet so far), until
+	// the vertex or triangle limit is reached
+	static void Build(
+		const Vertex* verts,
+		int vertexCount,
+		const unsigned int* indices,
+		int indexCount,
+		std::vector<Meshlet>& meshlets,
+		std::vector<unsigned int>& meshletVertices,
+		std::vector<unsigned char>& meshletTriangles);
+
+	// Fills "visible" with the indices of the meshlets (of a mesh placed
+	// with "world") that are inside the camera's frustum and not facing
+	// entirely away from it
+	static MeshletCullStats Cull(
+		const Meshlet* meshlets,
+		int meshletCount,
+		const DirectX::XMFLOAT4X4& world,
+		Camera* camera,
+		std::vector<int>& visible);
+};
@@ -0,0 +1,66 @@
+#include "ShaderIncludes.hlsli"
+
+// Set once per frame - everything else comes in per instance
+cbuffer PerFrame : register(b0)
+{
+	matrix viewProj;
+}
+
+// PackedVertexShaderInput plus the instance's own data, which
+// SimpleShader's reflection would put in input slot 1 (the engine
+// gives it an explicit layout that does the same)
+struct PackedInstancedVertexShaderInput
+{
+	float3 position		: POSITION;
+	float2 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float2 tangent		: TANGENT;
+
+	// The world matrix's rows (see InstanceData in BufferStructs.h)
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+	float4 colorTint	: COLOR_PER_INSTANCE;
+};
+
+// --------------------------------------------------------
+// Same as NormalMapPacked_VS, for many objects per draw
+//
+// - The normal matrix (the inverse transpose of the world
+//   matrix's 3x3) isn't sent: its cofactors point the same way,
+//   so three cross products and a normalize do instead
+// --------------------------------------------------------
+VertexToPixelNormalMap main(PackedInstancedVertexShaderInput input)
+{
+	// Set up output struct
+	VertexToPixelNormalMap output;
+
+	float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+	float4 worldPos = mul(float4(input.position, 1.0f), world);
+	output.position = mul(viewProj, worldPos);
+	output.worldPos = worldPos.xyz;
+
+	// Pass the color through
+	output.color = input.colorTint;
+
+	// Unpack the octahedral normal and tangent
+	float3 normal = DecodeOctahedral(input.normal);
+	float3 tangent = DecodeOctahedral(input.tangent);
+
+	// Cofactor rows, flipped for mirrored instances so normals
+	// still face outwards
+	float3 r0 = input.world0.xyz;
+	float3 r1 = input.world1.xyz;
+	float3 r2 = input.world2.xyz;
+	float3 c0 = cross(r1, r2);
+	float3 c1 = cross(r2, r0);
+	float3 c2 = cross(r0, r1);
+	float mirror = dot(r0, c0) < 0.0f ? -1.0f : 1.0f;
+	output.normal = normalize(mirror * (normal.x * c0 + normal.y * c1 + normal.z * c2));
+	output.tangent = mul(tangent, (float3x3)world);
+
+	output.uv = input.uv;
+
+	return output;
+}
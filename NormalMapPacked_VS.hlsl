@@ -0,0 +1,46 @@
+#include "ShaderIncludes.hlsli"
+
+// Everything per object is worked out on the CPU, once per object
+// rather than once per vertex (the engine binds each object's own
+// buffer to b0, and only re-uploads it when something moved)
+cbuffer PerObject : register(b0)
+{
+	matrix world;
+	matrix worldViewProj;
+	matrix normalMatrix;
+}
+
+cbuffer PerMaterial : register(b1)
+{
+	float4 colorTint;
+}
+
+// --------------------------------------------------------
+// Same as NormalMap_VS, but reads the compact PackedVertex
+// format and decodes its normal/tangent first
+// --------------------------------------------------------
+VertexToPixelNormalMap main(PackedVertexShaderInput input)
+{
+	// Set up output struct
+	VertexToPixelNormalMap output;
+
+	output.position = mul(worldViewProj, float4(input.position, 1.0f));
+
+	// Pass the color through
+	output.color = colorTint;
+
+	// Unpack the octahedral normal and tangent
+	float3 normal = DecodeOctahedral(input.normal);
+	float3 tangent = DecodeOctahedral(input.tangent);
+
+	// Normals go through the normal matrix, tangents (which lie along
+	// the surface) through the world matrix
+	output.normal = normalize(mul((float3x3)normalMatrix, normal));
+	output.tangent = mul((float3x3)world, tangent);
+
+	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
+
+	output.uv = input.uv;
+
+	return output;
+}
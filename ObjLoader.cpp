@@ -0,0 +1,1154 @@
+#include "ObjLoader.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+
+using namespace DirectX;
+
+namespace
+{
+	// Chunks smaller than this aren't worth a job of their own
+	const size_t MinBytesPerChunk = 256 * 1024;
+
+	// Position, Normal and UV are the first 8 floats of a Vertex -
+	// those are what make two face corners the "same" vertex
+	const int WeldedWordCount = 8;
+
+	// One face corner, exactly as written in the file (1-based)
+	struct ObjCorner
+	{
+		int position;
+		int uv;
+		int normal;
+	};
+
+	// A face with more than four corners - its triangles are held as
+	// placeholders until every position is known and it can be
+	// ear clipped
+	struct ObjPolygon
+	{
+		size_t firstCorner;          // Into ObjChunk::corners (its triangles)
+		size_t firstPolygonCorner;   // Into ObjChunk::polygonCorners (the face as written)
+		size_t count;
+	};
+
+	// A "usemtl", "o" or "g" line, and how many of its chunk's
+	// triangles came before it
+	struct ObjGroupEvent
+	{
+		size_t triangle;
+		bool material;   // usemtl (otherwise o or g)
+		std::string name;
+	};
+
+	// Everything parsed out of one line-aligned slice of the file
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT2> uvs;
+		std::vector<ObjCorner> corners;   // Three per triangle, winding already flipped
+		std::vector<ObjPolygon> polygons;
+		std::vector<ObjCorner> polygonCorners;
+		std::vector<ObjGroupEvent> events;
+		std::vector<std::string> materialLibraries;
+	};
+
+	const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		return p;
+	}
+
+	const char* SkipLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	const char* ParseFloat(const char* p, const char* end, float& out)
+	{
+		p = SkipSpaces(p, end);
+		if (p < end && *p == '+')
+			p++;
+
+		std::from_chars_result result = std::from_chars(p, end, out);
+		if (result.ec != std::errc())
+		{
+			out = 0.0f;
+			return p;
+		}
+		return result.ptr;
+	}
+
+	const char* ParseInt(const char* p, const char* end, int& out)
+	{
+		std::from_chars_result result = std::from_chars(p, end, out);
+		if (result.ec != std::errc())
+		{
+			out = 0;
+			return p;
+		}
+		return result.ptr;
+	}
+
+	// If the line starts with the given keyword (followed by a space),
+	// returns what comes after it - otherwise null
+	const char* MatchKeyword(const char* p, const char* end, const char* keyword)
+	{
+		size_t length = strlen(keyword);
+		if ((size_t)(end - p) <= length || memcmp(p, keyword, length) != 0 ||
+			(p[length] != ' ' && p[length] != '\t'))
+			return nullptr;
+		return p + length;
+	}
+
+	// The rest of the line, without surrounding whitespace
+	std::string ParseName(const char* p, const char* end)
+	{
+		p = SkipSpaces(p, end);
+		const char* lineEnd = p;
+		while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r')
+			lineEnd++;
+		while (lineEnd > p && (lineEnd[-1] == ' ' || lineEnd[-1] == '\t'))
+			lineEnd--;
+		return std::string(p, lineEnd);
+	}
+
+	// The last whitespace separated word on the line (texture maps
+	// put their options before the file name)
+	std::string ParseLastWord(const char* p, const char* end)
+	{
+		std::string line = ParseName(p, end);
+		size_t space = line.find_last_of(" \t");
+		return space == std::string::npos ? line : line.substr(space + 1);
+	}
+
+	// A path from inside an OBJ or MTL file, made relative to that file's folder
+	std::string ResolvePath(const char* baseFileName, const std::string& path)
+	{
+		std::filesystem::path relative(path);
+		if (relative.is_absolute())
+			return path;
+		return (std::filesystem::path(baseFileName).parent_path() / relative).string();
+	}
+
+	// Reads a "v/vt/vn" corner - returns null if there isn't one
+	const char* ParseCorner(const char* p, const char* end, ObjCorner& corner)
+	{
+		p = SkipSpaces(p, end);
+		if (p == end || *p < '0' || *p > '9')
+			return nullptr;
+
+		corner = { 0, 0, 0 };
+		p = ParseInt(p, end, corner.position);
+		if (p < end && *p == '/')
+			p = ParseInt(p + 1, end, corner.uv);
+		if (p < end && *p == '/')
+			p = ParseInt(p + 1, end, corner.normal);
+		return p;
+	}
+
+	void ParseChunk(ObjChunk& chunk)
+	{
+		const char* p = chunk.begin;
+		const char* end = chunk.end;
+
+		// A rough guess of ~32 bytes per line keeps regrowth rare
+		size_t lineEstimate = (end - p) / 32;
+		chunk.positions.reserve(lineEstimate / 4);
+		chunk.normals.reserve(lineEstimate / 4);
+		chunk.uvs.reserve(lineEstimate / 4);
+		chunk.corners.reserve(lineEstimate);
+
+		std::vector<ObjCorner> face;
+		while (p < end)
+		{
+			if (p[0] == 'v' && p + 1 < end && p[1] == 'n')
+			{
+				XMFLOAT3 norm;
+				p = ParseFloat(p + 2, end, norm.x);
+				p = ParseFloat(p, end, norm.y);
+				p = ParseFloat(p, end, norm.z);
+				chunk.normals.push_back(norm);
+			}
+			else if (p[0] == 'v' && p + 1 < end && p[1] == 't')
+			{
+				XMFLOAT2 uv;
+				p = ParseFloat(p + 2, end, uv.x);
+				p = ParseFloat(p, end, uv.y);
+				chunk.uvs.push_back(uv);
+			}
+			else if (p[0] == 'v')
+			{
+				XMFLOAT3 pos;
+				p = ParseFloat(p + 1, end, pos.x);
+				p = ParseFloat(p, end, pos.y);
+				p = ParseFloat(p, end, pos.z);
+				chunk.positions.push_back(pos);
+			}
+			else if (p[0] == 'f')
+			{
+				// Gather every corner on the line
+				face.clear();
+				ObjCorner corner;
+				const char* next = p + 1;
+				while ((next = ParseCorner(next, end, corner)) != nullptr)
+				{
+					p = next;
+					face.push_back(corner);
+				}
+
+				// Bigger faces may be concave, so they're ear clipped
+				// later (the same way Stream() does it) - they always
+				// become count - 2 triangles, so just reserve the room
+				size_t count = face.size();
+				if (count > 4)
+				{
+					chunk.polygons.push_back({ chunk.corners.size(), chunk.polygonCorners.size(), count });
+					chunk.polygonCorners.insert(chunk.polygonCorners.end(), face.begin(), face.end());
+					chunk.corners.resize(chunk.corners.size() + (count - 2) * 3);
+				}
+				else
+				{
+					// Fan out triangles and quads, flipping the winding order
+					// for left-handed space (same order the old quad path used)
+					for (size_t i = 1; i + 1 < count; i++)
+					{
+						chunk.corners.push_back(face[0]);
+						chunk.corners.push_back(face[i + 1]);
+						chunk.corners.push_back(face[i]);
+					}
+				}
+			}
+			else if (p[0] == 'u' || p[0] == 'o' || p[0] == 'g' || p[0] == 'm')
+			{
+				// Group boundaries are just noted here - they're turned
+				// into submeshes once every chunk is merged
+				const char* rest;
+				if ((rest = MatchKeyword(p, end, "usemtl")) != nullptr)
+					chunk.events.push_back({ chunk.corners.size() / 3, true, ParseName(rest, end) });
+				else if ((rest = MatchKeyword(p, end, "o")) != nullptr || (rest = MatchKeyword(p, end, "g")) != nullptr)
+					chunk.events.push_back({ chunk.corners.size() / 3, false, ParseName(rest, end) });
+				else if ((rest = MatchKeyword(p, end, "mtllib")) != nullptr)
+				{
+					// Possibly several files on one line
+					std::string names = ParseName(rest, end);
+					size_t start = 0;
+					while ((start = names.find_first_not_of(" \t", start)) != std::string::npos)
+					{
+						size_t stop = names.find_first_of(" \t", start);
+						chunk.materialLibraries.push_back(names.substr(start, stop - start));
+						start = stop;
+					}
+				}
+			}
+
+			p = SkipLine(p, end);
+		}
+	}
+
+	// Turns a chunk's corners into final vertices, now that every
+	// position/uv/normal in the whole file is known
+	void ResolveChunk(
+		const ObjChunk& chunk,
+		const std::vector<XMFLOAT3>& positions,
+		const std::vector<XMFLOAT3>& normals,
+		const std::vector<XMFLOAT2>& uvs,
+		Vertex* out)
+	{
+		for (const ObjCorner& c : chunk.corners)
+		{
+			// OBJ File indices are 1-based, so they need to be adjusted
+			Vertex v = {};
+			if (c.position > 0 && c.position <= (int)positions.size())
+				v.Position = positions[c.position - 1];
+			if (c.uv > 0 && c.uv <= (int)uvs.size())
+				v.UV = uvs[c.uv - 1];
+			if (c.normal > 0 && c.normal <= (int)normals.size())
+				v.Normal = normals[c.normal - 1];
+
+			// The model is most likely in a right-handed space, so:
+			//  - Flip the UV's since they're probably "upside down"
+			//  - Invert the Z position and the normal's Z
+			v.UV.y = 1.0f - v.UV.y;
+			v.Position.z *= -1.0f;
+			v.Normal.z *= -1.0f;
+
+			*out++ = v;
+		}
+	}
+
+	// Mixes the position, normal and uv bits of a vertex into a hash
+	unsigned int HashVertex(const Vertex& v)
+	{
+		const unsigned int* words = (const unsigned int*)&v;
+		unsigned int h = 2166136261u;
+		for (int i = 0; i < WeldedWordCount; i++)
+		{
+			unsigned int k = words[i] * 0xcc9e2d51u;
+			k = (k << 15) | (k >> 17);
+			h = (h ^ (k * 0x1b873593u)) * 16777619u;
+		}
+		return h ^ (h >> 16);
+	}
+
+	// Collapses identical vertices in place and rewrites the indices
+	// to match - returns the number of unique vertices that remain
+	size_t WeldVertices(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+	{
+		// Open addressing table, kept at most half full
+		size_t tableSize = 1;
+		while (tableSize < verts.size() * 2)
+			tableSize <<= 1;
+		const unsigned int Empty = 0xFFFFFFFFu;
+		std::vector<unsigned int> table(tableSize, Empty);
+
+		size_t uniqueCount = 0;
+		for (size_t i = 0; i < verts.size(); i++)
+		{
+			size_t slot = HashVertex(verts[i]) & (tableSize - 1);
+			while (table[slot] != Empty &&
+				memcmp(&verts[table[slot]], &verts[i], WeldedWordCount * sizeof(unsigned int)) != 0)
+			{
+				slot = (slot + 1) & (tableSize - 1);
+			}
+
+			// First time we've seen this vertex?  Move it down into
+			// the compacted part of the array (never overwrites unread data)
+			if (table[slot] == Empty)
+			{
+				verts[uniqueCount] = verts[i];
+				table[slot] = (unsigned int)uniqueCount++;
+			}
+			indices[i] = table[slot];
+		}
+
+		verts.resize(uniqueCount);
+		return uniqueCount;
+	}
+
+	// Sorts the (already welded) triangles into one contiguous range
+	// per material, keeping their file order within each range
+	void GroupByMaterial(const std::vector<ObjChunk>& chunks, std::vector<unsigned int>& indices, std::vector<ObjSubmesh>& submeshes)
+	{
+		submeshes.clear();
+		std::vector<int> triangleSubmesh(indices.size() / 3);
+
+		// Walk the group events in file order, handing each run of
+		// triangles between them to its material's submesh
+		std::string material;
+		std::string groupName;
+		int current = -1;
+		size_t chunkFirstTriangle = 0;
+		auto assignRun = [&](size_t first, size_t last)
+		{
+			if (first >= last)
+				return;
+
+			// Submeshes only exist once a material actually has faces
+			if (current < 0)
+			{
+				for (size_t i = 0; i < submeshes.size() && current < 0; i++)
+				{
+					if (submeshes[i].material == material)
+						current = (int)i;
+				}
+				if (current < 0)
+				{
+					current = (int)submeshes.size();
+					submeshes.push_back({ groupName, material, 0, 0 });
+				}
+			}
+
+			std::fill(triangleSubmesh.begin() + chunkFirstTriangle + first, triangleSubmesh.begin() + chunkFirstTriangle + last, current);
+			submeshes[current].indexCount += (int)(last - first) * 3;
+		};
+
+		for (const ObjChunk& chunk : chunks)
+		{
+			size_t chunkTriangles = chunk.corners.size() / 3;
+			size_t runStart = 0;
+			for (const ObjGroupEvent& e : chunk.events)
+			{
+				assignRun(runStart, e.triangle);
+				runStart = e.triangle;
+				if (e.material)
+				{
+					material = e.name;
+					current = -1;
+				}
+				else
+				{
+					groupName = e.name;
+				}
+			}
+			assignRun(runStart, chunkTriangles);
+			chunkFirstTriangle += chunkTriangles;
+		}
+
+		// Counting sort (stable) by submesh
+		int offset = 0;
+		for (ObjSubmesh& submesh : submeshes)
+		{
+			submesh.firstIndex = offset;
+			offset += submesh.indexCount;
+		}
+		if (submeshes.size() <= 1)
+			return;
+
+		std::vector<unsigned int> sorted(indices.size());
+		std::vector<int> fill(submeshes.size());
+		for (size_t i = 0; i < submeshes.size(); i++)
+			fill[i] = submeshes[i].firstIndex;
+		for (size_t t = 0; t < triangleSubmesh.size(); t++)
+		{
+			int& write = fill[triangleSubmesh[t]];
+			sorted[write + 0] = indices[t * 3 + 0];
+			sorted[write + 1] = indices[t * 3 + 1];
+			sorted[write + 2] = indices[t * 3 + 2];
+			write += 3;
+		}
+		indices.swap(sorted);
+	}
+
+	// Attributes per cache page, and pages kept resident per attribute
+	// type (256 pages of 256 normals is 768 KB).  Small pages keep
+	// the cost of re-parsing an evicted one down.
+	const int AttributePageSize = 256;
+	const int AttributeCachePages = 256;
+
+	// Which attribute a line declares: 0 = position, 1 = uv, 2 = normal,
+	// -1 = not an attribute.  Also skips over the keyword.
+	int ParseAttributeKeyword(const char*& p, const char* end)
+	{
+		if (end - p < 2 || p[0] != 'v')
+			return -1;
+
+		int type = -1;
+		if (p[1] == ' ' || p[1] == '\t')
+			type = 0;
+		else if (end - p >= 3 && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+			type = 1;
+		else if (end - p >= 3 && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+			type = 2;
+
+		if (type >= 0)
+			p += (type == 0) ? 1 : 2;
+		return type;
+	}
+
+	// --------------------------------------------------------
+	// Every position (or uv, or normal) seen so far in a streamed file,
+	// without keeping them all in memory
+	//
+	// - Attributes are grouped into pages of AttributePageSize, and
+	//   only the file offset of each page's first line is kept
+	// - Up to AttributeCachePages decoded pages stay resident (least
+	//   recently used goes first); an evicted page is re-parsed from
+	//   the mapped file the next time a face needs it
+	// - The page still being filled is never evicted
+	// --------------------------------------------------------
+	class AttributeStore
+	{
+	private:
+		struct Slot
+		{
+			long long page;
+			unsigned long long lastUse;
+			std::vector<float> values;
+		};
+
+		int type;
+		int components;
+		const char* fileBegin;
+		const char* fileEnd;
+		long long count;
+		std::vector<size_t> pageOffsets;
+		std::vector<int> pageSlots;
+		Slot slots[AttributeCachePages];
+		unsigned long long useClock;
+
+		int AcquireSlot(long long page)
+		{
+			long long tailPage = (count - 1) / AttributePageSize;
+			int best = -1;
+			for (int s = 0; s < AttributeCachePages; s++)
+			{
+				if (slots[s].page < 0)
+				{
+					best = s;
+					break;
+				}
+				if (slots[s].page != tailPage && (best < 0 || slots[s].lastUse < slots[best].lastUse))
+					best = s;
+			}
+
+			Slot& slot = slots[best];
+			if (slot.page >= 0)
+				pageSlots[slot.page] = -1;
+			if (slot.values.empty())
+				slot.values.resize(AttributePageSize * components);
+			slot.page = page;
+			pageSlots[page] = best;
+			return best;
+		}
+
+		// Re-parses an evicted page, starting from its first line
+		void DecodePage(long long page, int slotIndex)
+		{
+			float* out = slots[slotIndex].values.data();
+			long long remaining = std::min((long long)AttributePageSize, count - page * AttributePageSize);
+			const char* p = fileBegin + pageOffsets[page];
+			while (remaining > 0 && p < fileEnd)
+			{
+				p = SkipSpaces(p, fileEnd);
+				if (ParseAttributeKeyword(p, fileEnd) == type)
+				{
+					for (int c = 0; c < components; c++)
+						p = ParseFloat(p, fileEnd, *out++);
+					remaining--;
+				}
+				p = SkipLine(p, fileEnd);
+			}
+		}
+
+	public:
+		AttributeStore(int type, int components, const char* fileBegin, const char* fileEnd) :
+			type(type), components(components), fileBegin(fileBegin), fileEnd(fileEnd), count(0), useClock(0)
+		{
+			for (Slot& slot : slots)
+			{
+				slot.page = -1;
+				slot.lastUse = 0;
+			}
+		}
+
+		long long GetCount() const { return count; }
+
+		// Adds the attribute declared on the line starting at "line"
+		void Append(const char* line, const float* values)
+		{
+			long long page = count / AttributePageSize;
+			int slotIndex;
+			if (count % AttributePageSize == 0)
+			{
+				pageOffsets.push_back(line - fileBegin);
+				pageSlots.push_back(-1);
+				count++;
+				slotIndex = AcquireSlot(page);
+			}
+			else
+			{
+				slotIndex = pageSlots[page];
+				count++;
+			}
+
+			Slot& slot = slots[slotIndex];
+			slot.lastUse = ++useClock;
+			memcpy(&slot.values[((count - 1) % AttributePageSize) * components], values, components * sizeof(float));
+		}
+
+		// 0-based index, must be less than GetCount()
+		const float* Get(long long index)
+		{
+			long long page = index / AttributePageSize;
+			int slotIndex = pageSlots[page];
+			if (slotIndex < 0)
+			{
+				slotIndex = AcquireSlot(page);
+				DecodePage(page, slotIndex);
+			}
+
+			Slot& slot = slots[slotIndex];
+			slot.lastUse = ++useClock;
+			return &slot.values[(index % AttributePageSize) * components];
+		}
+
+		size_t GetMemoryUsage() const
+		{
+			size_t bytes = pageOffsets.capacity() * sizeof(size_t) + pageSlots.capacity() * sizeof(int);
+			for (const Slot& slot : slots)
+				bytes += slot.values.capacity() * sizeof(float);
+			return bytes;
+		}
+	};
+
+	// Reads a face corner, with any attribute allowed to be missing
+	// or negative - returns null if there isn't one
+	const char* ParseStreamCorner(const char* p, const char* end, ObjCorner& corner)
+	{
+		p = SkipSpaces(p, end);
+		if (p == end || ((*p < '0' || *p > '9') && *p != '-'))
+			return nullptr;
+
+		corner = { 0, 0, 0 };
+		p = ParseInt(p, end, corner.position);
+		if (p < end && *p == '/')
+			p = ParseInt(p + 1, end, corner.uv);
+		if (p < end && *p == '/')
+			p = ParseInt(p + 1, end, corner.normal);
+		return p;
+	}
+
+	// Turns a 1-based or negative (relative) OBJ index into a 0-based
+	// one - returns -1 if it doesn't refer to an existing attribute
+	long long ResolveIndex(int index, long long count)
+	{
+		long long resolved = (index > 0) ? (long long)index - 1 : count + index;
+		return (index != 0 && resolved >= 0 && resolved < count) ? resolved : -1;
+	}
+
+	// 2D cross product of (b - a) and (c - b)
+	float Turn(const XMFLOAT2& a, const XMFLOAT2& b, const XMFLOAT2& c)
+	{
+		return (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+	}
+
+	bool InsideTriangle(const XMFLOAT2& p, const XMFLOAT2& a, const XMFLOAT2& b, const XMFLOAT2& c, float winding)
+	{
+		return Turn(a, b, p) * winding >= 0.0f &&
+			Turn(b, c, p) * winding >= 0.0f &&
+			Turn(c, a, p) * winding >= 0.0f;
+	}
+
+	// --------------------------------------------------------
+	// Splits a polygon into triangles by ear clipping
+	//
+	// - The polygon is projected onto the plane of its (Newell)
+	//   normal's dominant axis, so it can be concave but should
+	//   be roughly planar
+	// - Triangles are written as corner indices, in the
+	//   polygon's own winding
+	// - If no ear can be found (self-intersecting or degenerate
+	//   input) the current corner is clipped anyway, so it
+	//   always produces count - 2 triangles
+	// --------------------------------------------------------
+	void Triangulate(
+		const std::vector<XMFLOAT3>& polygon,
+		const XMFLOAT3& normal,
+		std::vector<XMFLOAT2>& projected,
+		std::vector<int>& links,
+		std::vector<int>& triangles)
+	{
+		int count = (int)polygon.size();
+		triangles.clear();
+		if (count == 3)
+		{
+			triangles.insert(triangles.end(), { 0, 1, 2 });
+			return;
+		}
+
+		// Drop the normal's largest axis
+		float ax = fabsf(normal.x), ay = fabsf(normal.y), az = fabsf(normal.z);
+		projected.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			const XMFLOAT3& v = polygon[i];
+			if (ax >= ay && ax >= az)
+				projected[i] = XMFLOAT2(v.y, v.z);
+			else if (ay >= az)
+				projected[i] = XMFLOAT2(v.z, v.x);
+			else
+				projected[i] = XMFLOAT2(v.x, v.y);
+		}
+
+		// Which way round the projected polygon goes
+		float area = 0.0f;
+		for (int i = 0, j = count - 1; i < count; j = i++)
+			area += projected[j].x * projected[i].y - projected[i].x * projected[j].y;
+		float winding = (area < 0.0f) ? -1.0f : 1.0f;
+
+		// Doubly linked ring of the corners still left
+		links.resize(count * 2);
+		int* prev = links.data();
+		int* next = links.data() + count;
+		for (int i = 0; i < count; i++)
+		{
+			prev[i] = (i + count - 1) % count;
+			next[i] = (i + 1) % count;
+		}
+
+		int remaining = count;
+		int current = 0;
+		int misses = 0;
+		while (remaining > 3)
+		{
+			int a = prev[current];
+			int c = next[current];
+
+			// An ear is a convex corner with no other corner inside it
+			bool ear = Turn(projected[a], projected[current], projected[c]) * winding > 0.0f;
+			for (int j = next[c]; ear && j != a; j = next[j])
+				ear = !InsideTriangle(projected[j], projected[a], projected[current], projected[c], winding);
+
+			if (ear || misses >= remaining)
+			{
+				triangles.insert(triangles.end(), { a, current, c });
+				next[a] = c;
+				prev[c] = a;
+				remaining--;
+				misses = 0;
+				current = a;
+			}
+			else
+			{
+				current = c;
+				misses++;
+			}
+		}
+		triangles.insert(triangles.end(), { prev[current], current, next[current] });
+	}
+
+	// Fills in the triangles of a chunk's big faces (see ObjPolygon),
+	// now that every position in the whole file is known
+	void TriangulatePolygons(ObjChunk& chunk, const std::vector<XMFLOAT3>& positions)
+	{
+		std::vector<XMFLOAT3> polygon;
+		std::vector<XMFLOAT2> projected;
+		std::vector<int> links;
+		std::vector<int> triangles;
+		for (const ObjPolygon& face : chunk.polygons)
+		{
+			const ObjCorner* corners = chunk.polygonCorners.data() + face.firstPolygonCorner;
+
+			// Positions (missing ones at the origin, like ResolveChunk),
+			// plus the polygon's normal (Newell's method)
+			polygon.resize(face.count);
+			for (size_t i = 0; i < face.count; i++)
+			{
+				int position = corners[i].position;
+				polygon[i] = (position > 0 && position <= (int)positions.size()) ? positions[position - 1] : XMFLOAT3(0, 0, 0);
+			}
+
+			XMVECTOR faceNormal = XMVectorZero();
+			for (size_t i = 0, j = face.count - 1; i < face.count; j = i++)
+				faceNormal = XMVectorAdd(faceNormal, XMVector3Cross(XMLoadFloat3(&polygon[j]), XMLoadFloat3(&polygon[i])));
+			XMFLOAT3 faceNormalFloat;
+			XMStoreFloat3(&faceNormalFloat, faceNormal);
+
+			// Flip each triangle's winding for left-handed space
+			Triangulate(polygon, faceNormalFloat, projected, links, triangles);
+			ObjCorner* out = chunk.corners.data() + face.firstCorner;
+			for (size_t t = 0; t < triangles.size(); t += 3)
+			{
+				*out++ = corners[triangles[t]];
+				*out++ = corners[triangles[t + 2]];
+				*out++ = corners[triangles[t + 1]];
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// Collects triangles into fixed-size batches for ObjLoader::Stream()
+	//
+	// - Identical vertices are welded within a batch
+	// - A batch is handed off once the next triangle wouldn't fit
+	// --------------------------------------------------------
+	class ChunkBuilder
+	{
+	private:
+		const ObjChunkCallback& onChunk;
+		int maxVertices;
+		int maxIndices;
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		std::vector<unsigned int> table;
+		int chunkCount;
+		bool stopped;
+
+		static constexpr unsigned int Empty = 0xFFFFFFFFu;
+
+		unsigned int AddVertex(const Vertex& v)
+		{
+			size_t mask = table.size() - 1;
+			size_t slot = HashVertex(v) & mask;
+			while (table[slot] != Empty &&
+				memcmp(&verts[table[slot]], &v, WeldedWordCount * sizeof(unsigned int)) != 0)
+			{
+				slot = (slot + 1) & mask;
+			}
+
+			if (table[slot] == Empty)
+			{
+				table[slot] = (unsigned int)verts.size();
+				verts.push_back(v);
+			}
+			return table[slot];
+		}
+
+	public:
+		ChunkBuilder(const ObjChunkCallback& onChunk, int maxVertices) :
+			onChunk(onChunk), maxVertices(std::max(3, maxVertices)), maxIndices(std::max(3, maxVertices) * 6), chunkCount(0), stopped(false)
+		{
+			size_t tableSize = 1;
+			while (tableSize < (size_t)this->maxVertices * 2)
+				tableSize <<= 1;
+			table.assign(tableSize, Empty);
+			verts.reserve(this->maxVertices);
+			indices.reserve(maxIndices);
+		}
+
+		int GetChunkCount() const { return chunkCount; }
+		bool IsStopped() const { return stopped; }
+
+		void AddTriangle(const Vertex& a, const Vertex& b, const Vertex& c)
+		{
+			if ((int)verts.size() + 3 > maxVertices || (int)indices.size() + 3 > maxIndices)
+				Flush();
+
+			indices.push_back(AddVertex(a));
+			indices.push_back(AddVertex(b));
+			indices.push_back(AddVertex(c));
+		}
+
+		void Flush()
+		{
+			if (indices.empty() || stopped)
+				return;
+
+			ObjStreamChunk chunk = { chunkCount++, verts.data(), (int)verts.size(), indices.data(), (int)indices.size() };
+			stopped = !onChunk(chunk);
+
+			verts.clear();
+			indices.clear();
+			std::fill(table.begin(), table.end(), Empty);
+		}
+
+		size_t GetMemoryUsage() const
+		{
+			return verts.capacity() * sizeof(Vertex) +
+				indices.capacity() * sizeof(unsigned int) +
+				table.capacity() * sizeof(unsigned int);
+		}
+	};
+}
+
+bool ObjLoader::Load(const char* fileName, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, std::vector<ObjSubmesh>* submeshes, std::vector<std::string>* materialLibraries)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(fileName);
+	if (!file.IsOpen())
+		return false;
+
+	const char* data = file.GetData();
+	size_t size = file.GetSize();
+
+	// Decide how many chunks to split the file into
+	JobSystem& jobs = JobSystem::GetDefault();
+	size_t threadCount = (size_t)jobs.GetThreadCount();
+	size_t chunkCount = std::max((size_t)1, std::min(threadCount, size / MinBytesPerChunk));
+
+	// Chunk boundaries always land just after a newline
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkStart = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = data + size;
+		if (i + 1 < chunkCount)
+			chunkEnd = std::max(chunkStart, SkipLine(data + size * (i + 1) / chunkCount, data + size));
+
+		chunks[i].begin = chunkStart;
+		chunks[i].end = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	// Parse every chunk, one job each
+	jobs.ParallelFor((int)chunkCount, 1, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			ParseChunk(chunks[i]);
+	});
+
+	// Merge the attribute lists in file order
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	size_t cornerCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+		cornerCount += chunk.corners.size();
+	}
+
+	// Build the final vertices, each chunk writing its own slice
+	verts.resize(cornerCount);
+	std::vector<size_t> offsets(chunkCount, 0);
+	for (size_t i = 1; i < chunkCount; i++)
+		offsets[i] = offsets[i - 1] + chunks[i - 1].corners.size();
+	jobs.ParallelFor((int)chunkCount, 1, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			TriangulatePolygons(chunks[i], positions);
+			ResolveChunk(chunks[i], positions, normals, uvs, verts.data() + offsets[i]);
+		}
+	});
+
+	// Weld identical corners together so the index buffer actually
+	// shares vertices between triangles
+	indices.resize(cornerCount);
+	size_t uniqueCount = WeldVertices(verts, indices);
+
+	// Material groups and libraries come from the group events the
+	// chunks already recorded - no extra pass over the file
+	if (submeshes != nullptr)
+		GroupByMaterial(chunks, indices, *submeshes);
+	if (materialLibraries != nullptr)
+	{
+		materialLibraries->clear();
+		for (const ObjChunk& chunk : chunks)
+		{
+			for (const std::string& library : chunk.materialLibraries)
+				materialLibraries->push_back(ResolvePath(fileName, library));
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	double megabytes = size / (1024.0 * 1024.0);
+	printf("Parsed %s: %.2f MB in %.2f ms (%.1f MB/s, %d chunks)\n",
+		fileName, megabytes, seconds * 1000.0, seconds > 0 ? megabytes / seconds : 0.0, (int)chunkCount);
+	printf("  Welded %d face corners into %d vertices (%.2fx dedupe)\n",
+		(int)cornerCount, (int)uniqueCount, uniqueCount > 0 ? (double)cornerCount / uniqueCount : 0.0);
+	if (submeshes != nullptr && submeshes->size() > 1)
+		printf("  Grouped into %d submeshes by material\n", (int)submeshes->size());
+
+	return true;
+}
+
+bool ObjLoader::Stream(const char* fileName, const ObjChunkCallback& onChunk, int maxChunkVertices, ObjStreamStats* stats)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile file(fileName);
+	if (!file.IsOpen())
+		return false;
+
+	const char* p = file.GetData();
+	const char* end = p + file.GetSize();
+
+	AttributeStore positions(0, 3, p, end);
+	AttributeStore uvs(1, 2, p, end);
+	AttributeStore normals(2, 3, p, end);
+	AttributeStore* stores[3] = { &positions, &uvs, &normals };
+	ChunkBuilder builder(onChunk, maxChunkVertices);
+
+	// Scratch space for the current face, reused from face to face
+	std::vector<ObjCorner> corners;
+	std::vector<XMFLOAT3> polygon;
+	std::vector<Vertex> faceVerts;
+	std::vector<XMFLOAT2> projected;
+	std::vector<int> links;
+	std::vector<int> triangles;
+
+	ObjStreamStats totals = {};
+	while (p < end && !builder.IsStopped())
+	{
+		const char* line = SkipSpaces(p, end);
+		p = line;
+
+		int type = ParseAttributeKeyword(p, end);
+		if (type >= 0)
+		{
+			float values[3] = {};
+			p = ParseFloat(p, end, values[0]);
+			p = ParseFloat(p, end, values[1]);
+			if (type != 1)
+				p = ParseFloat(p, end, values[2]);
+			stores[type]->Append(line, values);
+		}
+		else if (end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			// Gather every corner on the line, resolving relative indices
+			corners.clear();
+			bool valid = true;
+			ObjCorner corner;
+			const char* next = p + 1;
+			while ((next = ParseStreamCorner(next, end, corner)) != nullptr)
+			{
+				p = next;
+				long long position = ResolveIndex(corner.position, positions.GetCount());
+				long long uv = ResolveIndex(corner.uv, uvs.GetCount());
+				long long normal = ResolveIndex(corner.normal, normals.GetCount());
+				valid = valid && position >= 0;
+
+				// Stored as 0-based, -1 when missing
+				corner.position = (int)position;
+				corner.uv = (int)uv;
+				corner.normal = (int)normal;
+				corners.push_back(corner);
+			}
+
+			totals.faceCount++;
+			if (!valid || corners.size() < 3)
+			{
+				totals.skippedFaceCount++;
+				p = SkipLine(p, end);
+				continue;
+			}
+
+			// Positions, plus the polygon's normal (Newell's method)
+			polygon.resize(corners.size());
+			for (size_t i = 0; i < corners.size(); i++)
+				memcpy(&polygon[i], positions.Get(corners[i].position), sizeof(XMFLOAT3));
+
+			XMVECTOR faceNormal = XMVectorZero();
+			for (size_t i = 0, j = corners.size() - 1; i < corners.size(); j = i++)
+			{
+				XMVECTOR a = XMLoadFloat3(&polygon[j]);
+				XMVECTOR b = XMLoadFloat3(&polygon[i]);
+				faceNormal = XMVectorAdd(faceNormal, XMVector3Cross(a, b));
+			}
+			XMFLOAT3 faceNormalFloat;
+			XMStoreFloat3(&faceNormalFloat, faceNormal);
+
+			// Final vertices for each corner, converted to left-handed
+			// space the same way Load() does
+			faceVerts.resize(corners.size());
+			XMFLOAT3 flatNormal(0, 0, 0);
+			if (XMVectorGetX(XMVector3LengthSq(faceNormal)) > 0.0f)
+				XMStoreFloat3(&flatNormal, XMVector3Normalize(faceNormal));
+			for (size_t i = 0; i < corners.size(); i++)
+			{
+				Vertex v = {};
+				v.Position = polygon[i];
+				v.Normal = flatNormal;
+				if (corners[i].uv >= 0)
+					memcpy(&v.UV, uvs.Get(corners[i].uv), sizeof(XMFLOAT2));
+				if (corners[i].normal >= 0)
+					memcpy(&v.Normal, normals.Get(corners[i].normal), sizeof(XMFLOAT3));
+
+				v.UV.y = 1.0f - v.UV.y;
+				v.Position.z *= -1.0f;
+				v.Normal.z *= -1.0f;
+				faceVerts[i] = v;
+			}
+
+			// Flip each triangle's winding for left-handed space
+			Triangulate(polygon, faceNormalFloat, projected, links, triangles);
+			for (size_t t = 0; t < triangles.size(); t += 3)
+				builder.AddTriangle(faceVerts[triangles[t]], faceVerts[triangles[t + 2]], faceVerts[triangles[t + 1]]);
+			totals.triangleCount += triangles.size() / 3;
+		}
+
+		p = SkipLine(p, end);
+	}
+	builder.Flush();
+
+	totals.positionCount = positions.GetCount();
+	totals.uvCount = uvs.GetCount();
+	totals.normalCount = normals.GetCount();
+	totals.chunkCount = builder.GetChunkCount();
+	totals.workingSetBytes =
+		positions.GetMemoryUsage() + uvs.GetMemoryUsage() + normals.GetMemoryUsage() +
+		builder.GetMemoryUsage() +
+		corners.capacity() * sizeof(ObjCorner) +
+		polygon.capacity() * sizeof(XMFLOAT3) +
+		faceVerts.capacity() * sizeof(Vertex) +
+		projected.capacity() * sizeof(XMFLOAT2) +
+		(links.capacity() + triangles.capacity()) * sizeof(int);
+	if (stats)
+		*stats = totals;
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	double megabytes = file.GetSize() / (1024.0 * 1024.0);
+	printf("Streamed %s: %.2f MB in %.2f ms (%.1f MB/s)\n",
+		fileName, megabytes, seconds * 1000.0, seconds > 0 ? megabytes / seconds : 0.0);
+	printf("  %lld triangles in %d chunks, %.2f MB working set\n",
+		totals.triangleCount, totals.chunkCount, totals.workingSetBytes / (1024.0 * 1024.0));
+
+	return true;
+}
+
+bool ObjLoader::LoadMaterials(const char* fileName, std::vector<ObjMaterial>& materials)
+{
+	MappedFile file(fileName);
+	if (!file.IsOpen())
+		return false;
+
+	const char* p = file.GetData();
+	const char* end = p + file.GetSize();
+	size_t firstMaterial = materials.size();
+	std::vector<bool> hasRoughness;
+
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		const char* rest;
+		if ((rest = MatchKeyword(p, end, "newmtl")) != nullptr)
+		{
+			// Defaults: white, opaque, rough and non-metallic
+			ObjMaterial m = {};
+			m.name = ParseName(rest, end);
+			m.diffuseColor = XMFLOAT3(1, 1, 1);
+			m.opacity = 1.0f;
+			m.roughness = 1.0f;
+			materials.push_back(m);
+			hasRoughness.push_back(false);
+		}
+		else if (materials.size() > firstMaterial)
+		{
+			// Everything else belongs to the latest "newmtl"
+			ObjMaterial& m = materials.back();
+			if ((rest = MatchKeyword(p, end, "Kd")) != nullptr)
+			{
+				rest = ParseFloat(rest, end, m.diffuseColor.x);
+				rest = ParseFloat(rest, end, m.diffuseColor.y);
+				ParseFloat(rest, end, m.diffuseColor.z);
+			}
+			else if ((rest = MatchKeyword(p, end, "d")) != nullptr)
+				ParseFloat(rest, end, m.opacity);
+			else if ((rest = MatchKeyword(p, end, "Tr")) != nullptr)
+			{
+				float transparency;
+				ParseFloat(rest, end, transparency);
+				m.opacity = 1.0f - transparency;
+			}
+			else if ((rest = MatchKeyword(p, end, "Ns")) != nullptr)
+				ParseFloat(rest, end, m.specularExponent);
+			else if ((rest = MatchKeyword(p, end, "Pr")) != nullptr)
+			{
+				ParseFloat(rest, end, m.roughness);
+				hasRoughness.back() = true;
+			}
+			else if ((rest = MatchKeyword(p, end, "Pm")) != nullptr)
+				ParseFloat(rest, end, m.metalness);
+			else if ((rest = MatchKeyword(p, end, "map_Kd")) != nullptr)
+				m.diffuseMap = ResolvePath(fileName, ParseLastWord(rest, end));
+			else if ((rest = MatchKeyword(p, end, "norm")) != nullptr ||
+				(rest = MatchKeyword(p, end, "map_Bump")) != nullptr ||
+				(rest = MatchKeyword(p, end, "map_bump")) != nullptr ||
+				(rest = MatchKeyword(p, end, "bump")) != nullptr)
+				m.normalMap = ResolvePath(fileName, ParseLastWord(rest, end));
+			else if ((rest = MatchKeyword(p, end, "map_Pr")) != nullptr)
+				m.roughnessMap = ResolvePath(fileName, ParseLastWord(rest, end));
+			else if ((rest = MatchKeyword(p, end, "map_Pm")) != nullptr)
+				m.metalnessMap = ResolvePath(fileName, ParseLastWord(rest, end));
+		}
+
+		p = SkipLine(p, end);
+	}
+
+	// Without a PBR roughness, convert the Blinn-Phong exponent
+	// (the usual Beckmann equivalence, sqrt(2 / (Ns + 2)))
+	for (size_t i = firstMaterial; i < materials.size(); i++)
+	{
+		if (!hasRoughness[i - firstMaterial])
+			materials[i].roughness = sqrtf(2.0f / (std::max(materials[i].specularExponent, 0.0f) + 2.0f));
+	}
+
+	return true;
+}
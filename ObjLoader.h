@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Vertex.h"
+#include <DirectXMath.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Default chunk size for ObjLoader::Stream() - small enough
+// for 16-bit indices
+const int ObjStreamChunkVertices = 65536;
+
+// --------------------------------------------------------
+// One fixed-size batch of triangles from ObjLoader::Stream()
+//
+// - Indices are local to the chunk (0 to vertexCount - 1)
+// - The pointers are only valid during the callback
+// --------------------------------------------------------
+struct ObjStreamChunk
+{
+	int chunkIndex;
+	const Vertex* verts;
+	int vertexCount;
+	const unsigned int* indices;
+	int indexCount;
+};
+
+// Totals from one streamed import
+struct ObjStreamStats
+{
+	long long positionCount;
+	long long uvCount;
+	long long normalCount;
+	long long faceCount;
+	long long triangleCount;
+	long long skippedFaceCount;   // Faces using positions that don't exist
+	int chunkCount;
+	size_t workingSetBytes;       // Peak size of the importer's own buffers
+};
+
+// --------------------------------------------------------
+// One material group of a loaded OBJ
+//
+// - Every face using the same "usemtl" material ends up in the
+//   same submesh, wherever it appears in the file
+// - name is the "o"/"g" group that was active when the material
+//   was first used (empty if there wasn't one)
+// - Its triangles are indices[firstIndex ... firstIndex + indexCount)
+// --------------------------------------------------------
+struct ObjSubmesh
+{
+	std::string name;
+	std::string material;
+	int firstIndex;
+	int indexCount;
+};
+
+// --------------------------------------------------------
+// One "newmtl" entry from an MTL file
+//
+// - Texture paths are already resolved relative to the MTL
+//   file's folder (empty if the map isn't given)
+// - roughness/metalness come from the PBR extension ("Pr"/"Pm");
+//   without them, roughness is derived from the "Ns" exponent
+// --------------------------------------------------------
+struct ObjMaterial
+{
+	std::string name;
+	DirectX::XMFLOAT3 diffuseColor;   // Kd
+	float opacity;                    // d (or 1 - Tr)
+	float specularExponent;           // Ns
+	float roughness;                  // Pr
+	float metalness;                  // Pm
+	std::string diffuseMap;           // map_Kd
+	std::string normalMap;            // norm, map_Bump or bump
+	std::string roughnessMap;         // map_Pr
+	std::string metalnessMap;         // map_Pm
+};
+
+// Return false to stop the import early
+typedef std::function<bool(const ObjStreamChunk&)> ObjChunkCallback;
+
+// --------------------------------------------------------
+// Fast OBJ file parser
+//
+// - The file is memory-mapped rather than read line by line
+// - It's split into line-aligned chunks, and each chunk is
+//   parsed as its own job (see JobSystem) with std::from_chars
+// - The per-chunk results are then merged, in file order, and
+//   identical (position, uv, normal) corners are welded into a
+//   single vertex so the index buffer does real work
+//
+// Load() keeps the whole mesh in memory.  Stream() is for files
+// too big for that (see below).
+// --------------------------------------------------------
+class ObjLoader
+{
+public:
+	// submeshes (optional) gets the file's material groups, with the
+	// indices sorted so each group is one contiguous range - a file
+	// without "usemtl" is a single submesh with no material
+	// materialLibraries (optional) gets every "mtllib" file named,
+	// resolved relative to the OBJ's folder
+	// - Faces of any size are fine: triangles and quads are fanned,
+	//   bigger ones are ear clipped exactly like Stream() does
+	static bool Load(
+		const char* fileName,
+		std::vector<Vertex>& verts,
+		std::vector<unsigned int>& indices,
+		std::vector<ObjSubmesh>* submeshes = nullptr,
+		std::vector<std::string>* materialLibraries = nullptr);
+
+	// Appends every material in an MTL file - returns false if it
+	// can't be opened
+	static bool LoadMaterials(
+		const char* fileName,
+		std::vector<ObjMaterial>& materials);
+
+	// Single pass, bounded memory import of arbitrarily large files
+	// - Faces may be any polygon (ear clipped, so concave is fine) and
+	//   use any of "v", "v/vt", "v//vn" or "v/vt/vn", with negative
+	//   (relative) indices allowed anywhere
+	// - Corners without a normal get the polygon's flat normal
+	// - Geometry is handed to onChunk in batches of at most
+	//   maxChunkVertices vertices and 6x that many indices, welded
+	//   within the batch
+	// - Attributes live in a small cache of fixed-size pages; pages
+	//   that get evicted are re-parsed from the file on demand, so
+	//   memory only grows by a file offset and a slot index per 256
+	//   attributes of each type
+	static bool Stream(
+		const char* fileName,
+		const ObjChunkCallback& onChunk,
+		int maxChunkVertices = ObjStreamChunkVertices,
+		ObjStreamStats* stats = nullptr);
+};
@@ -0,0 +1,369 @@
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Bits [first, last] of a tile row, counted from the tile's left edge
+	uint32_t RowBits(int first, int last)
+	{
+		if (first > last)
+			return 0;
+		int count = last - first + 1;
+		uint32_t bits = count >= 32 ? 0xFFFFFFFFu : (1u << count) - 1;
+		return bits << first;
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+{
+	tilesX = std::max(1, (width + TileWidth - 1) / TileWidth);
+	tilesY = std::max(1, (height + TileHeight - 1) / TileHeight);
+	this->width = tilesX * TileWidth;
+	this->height = tilesY * TileHeight;
+	tiles.resize((size_t)tilesX * tilesY);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	Begin(viewProjection);
+}
+
+void OcclusionBuffer::Begin(const XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	triangles.clear();
+	for (Tile& tile : tiles)
+	{
+		for (int r = 0; r < TileHeight; r++)
+			tile.mask[r] = 0;
+		tile.zMax0 = 1.0f;
+		tile.zMax1 = 0.0f;
+	}
+}
+
+void OcclusionBuffer::AddOccluder(
+	const XMFLOAT3* positions,
+	int vertexCount,
+	const unsigned int* indices,
+	int indexCount,
+	const XMFLOAT4X4& world)
+{
+	// Every vertex to clip space once
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProjection));
+	clipScratch.resize(vertexCount);
+	for (int i = 0; i < vertexCount; i++)
+		XMStoreFloat4(&clipScratch[i], XMVector3Transform(XMLoadFloat3(&positions[i]), worldViewProjection));
+
+	float screenWidth = (float)width;
+	float screenHeight = (float)height;
+	for (int t = 0; t + 2 < indexCount; t += 3)
+	{
+		const XMFLOAT4* clip[3] = { &clipScratch[indices[t]], &clipScratch[indices[t + 1]], &clipScratch[indices[t + 2]] };
+
+		// Anything crossing the near plane is dropped rather than clipped,
+		// as is anything entirely past one side of the frustum
+		bool nearClipped = false;
+		int outsideMask = 0x3F;
+		for (int v = 0; v < 3; v++)
+		{
+			const XMFLOAT4& c = *clip[v];
+			nearClipped = nearClipped || c.z < 0.0f || c.w <= 0.0f;
+			outsideMask &= (c.x < -c.w ? 1 : 0) | (c.x > c.w ? 2 : 0) | (c.y < -c.w ? 4 : 0)
+				| (c.y > c.w ? 8 : 0) | (c.z > c.w ? 16 : 0);
+		}
+		if (nearClipped || outsideMask != 0)
+			continue;
+
+		// Screen space, y down
+		float x[3], y[3], z[3];
+		for (int v = 0; v < 3; v++)
+		{
+			float invW = 1.0f / clip[v]->w;
+			x[v] = (clip[v]->x * invW * 0.5f + 0.5f) * screenWidth;
+			y[v] = (0.5f - clip[v]->y * invW * 0.5f) * screenHeight;
+			z[v] = clip[v]->z * invW;
+		}
+
+		// Clockwise triangles face the camera
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (area <= 0.0f)
+			continue;
+
+		Triangle tri;
+		tri.minX = std::min(x[0], std::min(x[1], x[2]));
+		tri.maxX = std::max(x[0], std::max(x[1], x[2]));
+		tri.minY = std::min(y[0], std::min(y[1], y[2]));
+		tri.maxY = std::max(y[0], std::max(y[1], y[2]));
+		tri.zMin = std::min(z[0], std::min(z[1], z[2]));
+		tri.zMax = std::max(z[0], std::max(z[1], z[2]));
+
+		// Inside is a * x + b * y + c >= 0 for every edge, so each edge
+		// bounds x from the left (a > 0) or the right (a < 0) on every row
+		for (int e = 0; e < 3; e++)
+		{
+			int p = e, q = (e + 1) % 3;
+			float a = y[p] - y[q];
+			float b = x[q] - x[p];
+			float c = -(a * x[p] + b * y[p]);
+			if (fabsf(a) <= 1e-6f * fabsf(b))
+			{
+				tri.edgeKind[e] = 0;
+				tri.edgeSlope[e] = b;
+				tri.edgeOffset[e] = c;
+			}
+			else
+			{
+				tri.edgeKind[e] = a > 0.0f ? 1 : -1;
+				tri.edgeSlope[e] = -b / a;
+				tri.edgeOffset[e] = -c / a;
+			}
+		}
+
+		// Depth as a plane over the screen
+		tri.zStepX = ((z[1] - z[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (z[2] - z[0])) / area;
+		tri.zStepY = ((x[1] - x[0]) * (z[2] - z[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+		tri.zOrigin = z[0] - tri.zStepX * x[0] - tri.zStepY * y[0];
+		triangles.push_back(tri);
+	}
+}
+
+void OcclusionBuffer::Rasterize(int threadCount)
+{
+	// Any split into rows of tiles keeps jobs off each other's tiles
+	int jobCount = std::max(1, threadCount);
+	JobSystem::GetDefault().ParallelFor(tilesY, (tilesY + jobCount - 1) / jobCount, [this](int begin, int end) { RasterizeBand(begin, end); });
+}
+
+void OcclusionBuffer::RasterizeBand(int firstTileRow, int endTileRow)
+{
+	const XMVECTOR rowOffsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+	const XMVECTOR one = XMVectorReplicate(1.0f);
+
+	for (const Triangle& tri : triangles)
+	{
+		// Pixels that could be entirely inside, clamped to the band
+		int pixelX0 = std::max(0, (int)ceilf(tri.minX));
+		int pixelX1 = std::min(width - 1, (int)floorf(tri.maxX) - 1);
+		int pixelY0 = std::max(firstTileRow * TileHeight, (int)ceilf(tri.minY));
+		int pixelY1 = std::min(endTileRow * TileHeight - 1, (int)floorf(tri.maxY) - 1);
+		if (pixelX0 > pixelX1 || pixelY0 > pixelY1)
+			continue;
+
+		for (int tileY = pixelY0 / TileHeight; tileY <= pixelY1 / TileHeight; tileY++)
+		{
+			// Each row's span, four rows at once - an edge is a straight
+			// line, so it's tightest at the row's top or bottom
+			float rowTop = (float)(tileY * TileHeight);
+			XMVECTOR rowY0 = XMVectorAdd(XMVectorReplicate(rowTop), rowOffsets);
+			XMVECTOR rowY1 = XMVectorAdd(rowY0, one);
+			XMVECTOR left = XMVectorReplicate(tri.minX);
+			XMVECTOR right = XMVectorReplicate(tri.maxX);
+			for (int e = 0; e < 3; e++)
+			{
+				XMVECTOR slope = XMVectorReplicate(tri.edgeSlope[e]);
+				XMVECTOR offset = XMVectorReplicate(tri.edgeOffset[e]);
+				XMVECTOR bound0 = XMVectorMultiplyAdd(slope, rowY0, offset);
+				XMVECTOR bound1 = XMVectorMultiplyAdd(slope, rowY1, offset);
+				if (tri.edgeKind[e] > 0)
+					left = XMVectorMax(left, XMVectorMax(bound0, bound1));
+				else if (tri.edgeKind[e] < 0)
+					right = XMVectorMin(right, XMVectorMin(bound0, bound1));
+				else
+				{
+					// Horizontal edges don't bound x, they rule out whole rows
+					XMVECTOR outside = XMVectorOrInt(XMVectorLess(bound0, XMVectorZero()), XMVectorLess(bound1, XMVectorZero()));
+					right = XMVectorSelect(right, XMVectorReplicate(-FLT_MAX), outside);
+				}
+			}
+
+			// First and last pixels entirely inside
+			XMFLOAT4 firstPixel, lastPixel;
+			XMStoreFloat4(&firstPixel, XMVectorCeiling(left));
+			XMStoreFloat4(&lastPixel, XMVectorSubtract(XMVectorFloor(right), one));
+			int rowFirst[TileHeight], rowLast[TileHeight];
+			for (int r = 0; r < TileHeight; r++)
+			{
+				int pixelY = tileY * TileHeight + r;
+				bool rowInside = pixelY >= pixelY0 && pixelY <= pixelY1;
+				rowFirst[r] = rowInside ? (int)std::max((&firstPixel.x)[r], (float)pixelX0) : 1;
+				rowLast[r] = rowInside ? (int)std::min((&lastPixel.x)[r], (float)pixelX1) : 0;
+			}
+
+			// The triangle's depth range over each tile (corners of the
+			// plane, kept within the triangle's own range)
+			float rowBottom = rowTop + TileHeight;
+			float depthY0 = tri.zStepY * rowTop, depthY1 = tri.zStepY * rowBottom;
+			for (int tileX = pixelX0 / TileWidth; tileX <= pixelX1 / TileWidth; tileX++)
+			{
+				int tileLeft = tileX * TileWidth;
+				uint32_t coverage[TileHeight];
+				uint32_t any = 0;
+				for (int r = 0; r < TileHeight; r++)
+				{
+					coverage[r] = RowBits(std::max(rowFirst[r], tileLeft) - tileLeft, std::min(rowLast[r], tileLeft + TileWidth - 1) - tileLeft);
+					any |= coverage[r];
+				}
+				if (any == 0)
+					continue;
+
+				float depthX0 = tri.zStepX * tileLeft, depthX1 = tri.zStepX * (tileLeft + TileWidth);
+				float tileZMax = std::min(tri.zMax, tri.zOrigin + std::max(depthX0, depthX1) + std::max(depthY0, depthY1));
+				float tileZMin = std::max(tri.zMin, tri.zOrigin + std::min(depthX0, depthX1) + std::min(depthY0, depthY1));
+
+				// Behind everything already there, so it changes nothing
+				Tile& tile = tiles[(size_t)tileY * tilesX + tileX];
+				if (tileZMin >= tile.zMax0)
+					continue;
+
+				// If the working layer is closer to the tile's depth than to
+				// this triangle, it's dropped and starts over from here
+				if (tile.zMax1 - tileZMax > tile.zMax0 - tile.zMax1)
+				{
+					tile.zMax1 = 0.0f;
+					for (int r = 0; r < TileHeight; r++)
+						tile.mask[r] = 0;
+				}
+				tile.zMax1 = std::max(tile.zMax1, tileZMax);
+				uint32_t full = 0xFFFFFFFFu;
+				for (int r = 0; r < TileHeight; r++)
+				{
+					tile.mask[r] |= coverage[r];
+					full &= tile.mask[r];
+				}
+
+				// Fully covered - the working layer is now the tile's depth
+				if (full == 0xFFFFFFFFu)
+				{
+					tile.zMax0 = std::min(tile.zMax0, tile.zMax1);
+					tile.zMax1 = 0.0f;
+					for (int r = 0; r < TileHeight; r++)
+						tile.mask[r] = 0;
+				}
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::ProjectBox(const AABB& box, int& x0, int& y0, int& x1, int& y1, float& nearestZ) const
+{
+	// One corner in clip space, then the box's edges along each axis,
+	// so the other seven corners are only sums
+	XMMATRIX m = XMLoadFloat4x4(&viewProjection);
+	XMVECTOR origin = XMVector3Transform(XMLoadFloat3(&box.min), m);
+	XMVECTOR edgeX = XMVectorScale(m.r[0], box.max.x - box.min.x);
+	XMVECTOR edgeY = XMVectorScale(m.r[1], box.max.y - box.min.y);
+	XMVECTOR edgeZ = XMVectorScale(m.r[2], box.max.z - box.min.z);
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	nearestZ = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMVECTOR p = origin;
+		if (corner & 1)
+			p = XMVectorAdd(p, edgeX);
+		if (corner & 2)
+			p = XMVectorAdd(p, edgeY);
+		if (corner & 4)
+			p = XMVectorAdd(p, edgeZ);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, p);
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return false;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		float y = (0.5f - clip.y * invW * 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestZ = std::min(nearestZ, clip.z * invW);
+	}
+
+	// Every pixel the rectangle touches
+	x0 = std::max(0, (int)floorf(minX));
+	y0 = std::max(0, (int)floorf(minY));
+	x1 = std::min(width - 1, (int)ceilf(maxX) - 1);
+	y1 = std::min(height - 1, (int)ceilf(maxY) - 1);
+	return true;
+}
+
+bool OcclusionBuffer::IsVisible(const AABB& worldBox) const
+{
+	int x0, y0, x1, y1;
+	float nearestZ;
+	if (!ProjectBox(worldBox, x0, y0, x1, y1, nearestZ))
+		return true;
+	if (x0 > x1 || y0 > y1 || nearestZ > 1.0f)
+		return false;
+
+	// Visible if it's in front of what's known about any tile it touches
+	for (int tileY = y0 / TileHeight; tileY <= y1 / TileHeight; tileY++)
+	{
+		for (int tileX = x0 / TileWidth; tileX <= x1 / TileWidth; tileX++)
+		{
+			const Tile& tile = tiles[(size_t)tileY * tilesX + tileX];
+			if (nearestZ > tile.zMax0)
+				continue;
+			if (nearestZ <= tile.zMax1)
+				return true;
+
+			// Between the two layers - hidden only if every pixel it
+			// touches here is in the working layer
+			int tileLeft = tileX * TileWidth;
+			for (int r = 0; r < TileHeight; r++)
+			{
+				int pixelY = tileY * TileHeight + r;
+				if (pixelY < y0 || pixelY > y1)
+					continue;
+				uint32_t touched = RowBits(std::max(x0, tileLeft) - tileLeft, std::min(x1, tileLeft + TileWidth - 1) - tileLeft);
+				if ((touched & ~tile.mask[r]) != 0)
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+int OcclusionBuffer::TestBoxes(const AABB* boxes, int count, unsigned char* visible, int threadCount) const
+{
+	int jobCount = std::max(1, threadCount);
+	std::atomic<int> visibleCount(0);
+	JobSystem::GetDefault().ParallelFor(count, (count + jobCount - 1) / jobCount, [&](int begin, int end)
+	{
+		int rangeVisible = 0;
+		for (int i = begin; i < end; i++)
+		{
+			visible[i] = IsVisible(boxes[i]);
+			rangeVisible += visible[i];
+		}
+		visibleCount.fetch_add(rangeVisible, std::memory_order_relaxed);
+	});
+	return visibleCount.load();
+}
+
+int OcclusionBuffer::GetWidth() const
+{
+	return width;
+}
+
+int OcclusionBuffer::GetHeight() const
+{
+	return height;
+}
+
+int OcclusionBuffer::GetTriangleCount() const
+{
+	return (int)triangles.size();
+}
+
+float OcclusionBuffer::GetPixelDepth(int x, int y) const
+{
+	const Tile& tile = tiles[(size_t)(y / TileHeight) * tilesX + x / TileWidth];
+	bool covered = (tile.mask[y % TileHeight] >> (x % TileWidth)) & 1;
+	return covered ? std::min(tile.zMax0, tile.zMax1) : tile.zMax0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Bounds.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// A small CPU depth buffer for occlusion culling, in the
+// style of masked occlusion culling (Hasselgren et al.)
+//
+// - The screen is split into tiles of 32x4 pixels.  A tile
+//   doesn't keep per-pixel depth: it has a coverage bit per
+//   pixel and two depths - the farthest depth anywhere in
+//   the tile (zMax0) and the farthest depth of the pixels
+//   whose bits are set (zMax1).  Once every bit is set,
+//   zMax1 becomes the whole tile's depth.
+// - Triangles are set up once, then rasterized four rows at
+//   a time (one SIMD lane per row) into horizontal bands of
+//   tiles, one band per job, so jobs never share a tile
+// - Rasterizing is conservative: near-clipped triangles are
+//   dropped and pixels only count if they're entirely
+//   covered, so an object is only ever culled if it's
+//   really hidden behind the triangles as given, at any
+//   resolution.  The price is that pixels along the seams
+//   between an occluder's triangles are never filled.
+// - That says nothing about how well those triangles match
+//   what's drawn: a simplified LOD (see Mesh::
+//   GetOccluderIndices()) can bulge past the real surface,
+//   or cover a gap the real mesh leaves open (the inside of
+//   a helix, say), and hide something that's visible
+// - Only front faces (clockwise on screen, like D3D's
+//   default rasterizer state) are drawn
+// - Depth is post-projection z/w, 0 at the near plane
+// --------------------------------------------------------
+class OcclusionBuffer
+{
+public:
+	static const int TileWidth = 32;
+	static const int TileHeight = 4;
+
+private:
+	struct Tile
+	{
+		uint32_t mask[TileHeight];  // one bit per pixel, a row per entry
+		float zMax0;
+		float zMax1;
+	};
+
+	// A triangle ready to rasterize: x bounds of each edge as a
+	// function of y, and its depth as a plane over the screen
+	struct Triangle
+	{
+		float edgeSlope[3];
+		float edgeOffset[3];
+		int edgeKind[3];       // +1 left bound, -1 right bound, 0 horizontal
+		float minX, maxX, minY, maxY;
+		float zMin, zMax;
+		float zStepX, zStepY, zOrigin;
+	};
+
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+	std::vector<Tile> tiles;
+	std::vector<Triangle> triangles;
+	std::vector<DirectX::XMFLOAT4> clipScratch;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	void RasterizeBand(int firstTileRow, int endTileRow);
+
+	// Pixel rectangle and nearest depth of a world space box - false if
+	// the box crosses the near plane (and so can't be tested)
+	bool ProjectBox(const AABB& box, int& x0, int& y0, int& x1, int& y1, float& nearestZ) const;
+
+public:
+	// Rounded up to whole tiles
+	OcclusionBuffer(int width = 320, int height = 192);
+
+	// Starts a frame - clears the buffer and the queued occluders
+	void Begin(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Queues an occluder's triangles (object space positions, placed
+	// with "world") - anything off screen or behind the camera is
+	// dropped here
+	void AddOccluder(
+		const DirectX::XMFLOAT3* positions,
+		int vertexCount,
+		const unsigned int* indices,
+		int indexCount,
+		const DirectX::XMFLOAT4X4& world);
+
+	// Rasterizes everything queued, split into as many as threadCount
+	// jobs, each a band of tile rows
+	void Rasterize(int threadCount = 1);
+
+	// After Rasterize() - false only if the box is hidden behind the
+	// occluders (or entirely off screen)
+	bool IsVisible(const AABB& worldBox) const;
+
+	// IsVisible() for count boxes, split into as many as threadCount
+	// jobs - returns how many are visible
+	int TestBoxes(const AABB* boxes, int count, unsigned char* visible, int threadCount = 1) const;
+
+	int GetWidth() const;
+	int GetHeight() const;
+	int GetTriangleCount() const;
+
+	// The depth every pixel of the buffer is known to be in front of
+	// (1 where nothing has been drawn) - for checking and debugging
+	float GetPixelDepth(int x, int y) const;
+};
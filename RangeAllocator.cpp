@@ -0,0 +1,154 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(int capacity)
+{
+	this->capacity = capacity;
+	usedSize = 0;
+	if (capacity > 0)
+		freeBlocks[0] = capacity;
+}
+
+int RangeAllocator::Allocate(int size)
+{
+	if (size <= 0)
+		return -1;
+
+	// Smallest free block that fits (the lowest one on ties)
+	auto best = freeBlocks.end();
+	for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+	{
+		if (it->second >= size && (best == freeBlocks.end() || it->second < best->second))
+		{
+			best = it;
+			if (best->second == size)
+				break;
+		}
+	}
+	if (best == freeBlocks.end())
+		return -1;
+
+	// Carve the allocation off the front of the block
+	int offset = best->first;
+	int remaining = best->second - size;
+	freeBlocks.erase(best);
+	if (remaining > 0)
+		freeBlocks[offset + size] = remaining;
+
+	int id;
+	if (!freeIds.empty())
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	else
+	{
+		id = (int)allocations.size();
+		allocations.push_back(Allocation());
+	}
+	allocations[id] = { offset, size, true };
+	usedSize += size;
+	return id;
+}
+
+void RangeAllocator::Free(int id)
+{
+	if (id < 0 || id >= (int)allocations.size() || !allocations[id].live)
+		return;
+
+	int offset = allocations[id].offset;
+	int size = allocations[id].size;
+	allocations[id].live = false;
+	freeIds.push_back(id);
+	usedSize -= size;
+
+	// Merge with the free blocks on either side
+	auto next = freeBlocks.lower_bound(offset);
+	if (next != freeBlocks.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = freeBlocks.erase(next);
+	}
+	if (next != freeBlocks.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+	freeBlocks[offset] = size;
+}
+
+int RangeAllocator::GetOffset(int id) const
+{
+	return allocations[id].offset;
+}
+
+int RangeAllocator::GetSize(int id) const
+{
+	return allocations[id].size;
+}
+
+void RangeAllocator::Compact(std::vector<RangeMove>& moves)
+{
+	moves.clear();
+
+	// Walk the live allocations in address order - every one only
+	// ever moves down, onto space earlier moves have already vacated
+	std::vector<int> order;
+	for (int id = 0; id < (int)allocations.size(); id++)
+	{
+		if (allocations[id].live)
+			order.push_back(id);
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b) { return allocations[a].offset < allocations[b].offset; });
+
+	int offset = 0;
+	for (int id : order)
+	{
+		Allocation& a = allocations[id];
+		if (a.offset != offset)
+		{
+			moves.push_back({ id, a.offset, offset, a.size });
+			a.offset = offset;
+		}
+		offset += a.size;
+	}
+
+	freeBlocks.clear();
+	if (offset < capacity)
+		freeBlocks[offset] = capacity - offset;
+}
+
+void RangeAllocator::Grow(int newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	// Extend the last free block if it runs to the end
+	int added = newCapacity - capacity;
+	auto last = freeBlocks.empty() ? freeBlocks.end() : std::prev(freeBlocks.end());
+	if (last != freeBlocks.end() && last->first + last->second == capacity)
+		last->second += added;
+	else
+		freeBlocks[capacity] = added;
+	capacity = newCapacity;
+}
+
+RangeAllocatorStats RangeAllocator::GetStats() const
+{
+	RangeAllocatorStats stats = {};
+	stats.capacity = capacity;
+	stats.usedSize = usedSize;
+	stats.freeSize = capacity - usedSize;
+	stats.allocationCount = (int)(allocations.size() - freeIds.size());
+	stats.freeBlockCount = (int)freeBlocks.size();
+	for (const auto& block : freeBlocks)
+		stats.largestFreeBlock = std::max(stats.largestFreeBlock, block.second);
+	stats.fragmentation = stats.freeSize > 0 ? 1.0f - (float)stats.largestFreeBlock / stats.freeSize : 0.0f;
+	return stats;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+// Space usage of a RangeAllocator at one point in time
+// - fragmentation is 1 - largestFreeBlock / freeSize: 0 when all of
+//   the free space is one block, approaching 1 as it gets splintered
+struct RangeAllocatorStats
+{
+	int capacity;
+	int usedSize;
+	int freeSize;
+	int allocationCount;
+	int freeBlockCount;
+	int largestFreeBlock;
+	float fragmentation;
+};
+
+// One allocation relocated by RangeAllocator::Compact()
+struct RangeMove
+{
+	int id;
+	int oldOffset;
+	int newOffset;
+	int size;
+};
+
+// --------------------------------------------------------
+// Suballocates ranges out of [0, capacity)
+//
+// - Pure bookkeeping: it never touches the memory it manages,
+//   so it works for GPU buffers (and can be tested on the CPU)
+// - Allocations are referred to by id, which stays the same
+//   when Compact() moves them
+// - Best fit from an offset-sorted free list; freed ranges are
+//   merged with free neighbors right away
+// --------------------------------------------------------
+class RangeAllocator
+{
+private:
+	struct Allocation
+	{
+		int offset;
+		int size;
+		bool live;
+	};
+
+	int capacity;
+	int usedSize;
+	std::map<int, int> freeBlocks;      // offset -> size
+	std::vector<Allocation> allocations;
+	std::vector<int> freeIds;
+
+public:
+	RangeAllocator(int capacity);
+
+	// Returns an id, or -1 if no free block is big enough
+	int Allocate(int size);
+	void Free(int id);
+
+	int GetOffset(int id) const;
+	int GetSize(int id) const;
+
+	// Slides every allocation down to the start (keeping their order),
+	// leaving one free block at the end - fills "moves" with the
+	// copies the caller needs to make, in an order that's safe to
+	// perform one after another within the same memory
+	void Compact(std::vector<RangeMove>& moves);
+
+	// Adds more space at the end
+	void Grow(int newCapacity);
+
+	RangeAllocatorStats GetStats() const;
+};
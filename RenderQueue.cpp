@@ -0,0 +1,417 @@
+#include "RenderQueue.h"
+#include "GeometryPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// What's currently bound, so redundant changes can be skipped
+	// - the Set functions return whether the state has to be set
+	struct StateTracker
+	{
+		bool skipRedundant;
+		SimpleVertexShader* vertexShader;
+		SimplePixelShader* pixelShader;
+		Material* material;
+		const void* geometry;
+		ID3D11Buffer* objectConstants;
+		bool instanceBufferBound;
+
+		StateTracker(bool skipRedundant)
+		{
+			this->skipRedundant = skipRedundant;
+			vertexShader = nullptr;
+			pixelShader = nullptr;
+			material = nullptr;
+			geometry = nullptr;
+			objectConstants = nullptr;
+			instanceBufferBound = false;
+		}
+
+		bool SetShaders(SimpleVertexShader* vs, SimplePixelShader* ps)
+		{
+			if (skipRedundant && vs == vertexShader && ps == pixelShader)
+				return false;
+
+			// SetShader() binds the shaders' own constant buffers, so the
+			// material constants and the per-object buffer need setting again
+			vertexShader = vs;
+			pixelShader = ps;
+			material = nullptr;
+			objectConstants = nullptr;
+			return true;
+		}
+
+		bool SetMaterial(Material* value)
+		{
+			if (skipRedundant && value == material)
+				return false;
+			material = value;
+			return true;
+		}
+
+		bool SetGeometry(const Mesh* mesh)
+		{
+			// Pooled meshes were never rebound per draw, even before
+			const void* source = RenderQueue::GetGeometrySource(mesh);
+			if ((skipRedundant || mesh->IsPooled()) && source == geometry)
+				return false;
+			geometry = source;
+			return true;
+		}
+
+		// Slot 1 holds the same buffer all frame
+		bool SetInstanceBuffer()
+		{
+			if (skipRedundant && instanceBufferBound)
+				return false;
+			instanceBufferBound = true;
+			return true;
+		}
+
+		bool SetObjectConstants(ID3D11Buffer* buffer)
+		{
+			if (skipRedundant && buffer == objectConstants)
+				return false;
+			objectConstants = buffer;
+			return true;
+		}
+	};
+
+	SimpleVertexShader* GetPacketVertexShader(const DrawPacket& packet)
+	{
+		return packet.instanceCount > 0 ? packet.material->GetInstancedVertexShader() : packet.material->GetVertexShader();
+	}
+}
+
+RenderQueue::RenderQueue()
+{
+	lastStats = {};
+	lastUnfilteredStats = {};
+}
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, uint32_t shader, uint32_t material, uint32_t geometry, float depth)
+{
+	// The top half of a non-negative float's bits sorts the same way
+	// the float does (to about 1% precision)
+	depth = depth > 0.0f ? depth : 0.0f;
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	uint64_t quantizedDepth = depthBits >> 16;
+
+	uint64_t key = (uint64_t)(pass & 0xF) << 60;
+	if (pass == TransparentPass)
+	{
+		return key
+			| (0xFFFF - quantizedDepth) << 44
+			| (uint64_t)(shader & 0xFFF) << 32
+			| (uint64_t)(material & 0xFFFF) << 16
+			| (uint64_t)(geometry & 0xFFFF);
+	}
+	return key
+		| (uint64_t)(shader & 0xFFF) << 48
+		| (uint64_t)(material & 0xFFFF) << 32
+		| (uint64_t)(geometry & 0xFFFF) << 16
+		| quantizedDepth;
+}
+
+const void* RenderQueue::GetGeometrySource(const Mesh* mesh)
+{
+	return mesh->IsPooled() ? (const void*)mesh->GetPool() : (const void*)mesh;
+}
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+uint32_t RenderQueue::GetShaderId(SimpleVertexShader* vs, SimplePixelShader* ps)
+{
+	std::pair<SimpleVertexShader*, SimplePixelShader*> shaderPair(vs, ps);
+	uint32_t shader = (uint32_t)(std::find(shaders.begin(), shaders.end(), shaderPair) - shaders.begin());
+	if (shader == shaders.size())
+		shaders.push_back(shaderPair);
+	return shader;
+}
+
+void RenderQueue::AddPacket(DrawPacket packet, RenderPass pass, bool instanced, float depth)
+{
+	// Ids are handed out the first time something is seen
+	Material* material = packet.material;
+	auto foundMaterial = materialIds.find(material);
+	if (foundMaterial == materialIds.end())
+	{
+		MaterialIds ids;
+		ids.shader = GetShaderId(material->GetVertexShader(), material->GetPixelShader());
+		ids.instancedShader = GetShaderId(material->GetInstancedVertexShader(), material->GetPixelShader());
+		ids.material = (uint32_t)materialIds.size();
+		foundMaterial = materialIds.insert({ material, ids }).first;
+	}
+
+	const void* source = GetGeometrySource(packet.mesh);
+	auto foundGeometry = geometryIds.find(source);
+	if (foundGeometry == geometryIds.end())
+		foundGeometry = geometryIds.insert({ source, (uint32_t)geometryIds.size() }).first;
+
+	const MaterialIds& ids = foundMaterial->second;
+	packet.key = MakeKey(pass, instanced ? ids.instancedShader : ids.shader, ids.material, foundGeometry->second, depth);
+	packets.push_back(packet);
+}
+
+void RenderQueue::Add(
+	RenderPass pass,
+	Mesh* mesh,
+	Material* material,
+	ID3D11Buffer* objectConstants,
+	unsigned int indexCount,
+	unsigned int firstIndex,
+	float depth)
+{
+	AddPacket({ 0, mesh, material, objectConstants, indexCount, firstIndex, 0, 0 }, pass, false, depth);
+}
+
+void RenderQueue::AddInstanced(
+	RenderPass pass,
+	Mesh* mesh,
+	Material* material,
+	unsigned int indexCount,
+	unsigned int firstIndex,
+	unsigned int firstInstance,
+	unsigned int instanceCount,
+	float depth)
+{
+	AddPacket({ 0, mesh, material, nullptr, indexCount, firstIndex, firstInstance, instanceCount }, pass, true, depth);
+}
+
+void RenderQueue::Sort()
+{
+	int count = (int)packets.size();
+	keys.resize(count);
+	keyScratch.resize(count);
+	order.resize(count);
+	orderScratch.resize(count);
+	for (int i = 0; i < count; i++)
+		keys[i] = packets[i].key;
+
+	RadixSort(keys.data(), order.data(), keyScratch.data(), orderScratch.data(), count);
+
+	sortedPackets.resize(count);
+	for (int i = 0; i < count; i++)
+		sortedPackets[i] = packets[order[i]];
+	packets.swap(sortedPackets);
+}
+
+void RenderQueue::RadixSort(uint64_t* keys, uint32_t* order, uint64_t* keyScratch, uint32_t* orderScratch, int count)
+{
+	for (int i = 0; i < count; i++)
+		order[i] = (uint32_t)i;
+	if (count < 2)
+		return;
+
+	// Every byte's histogram in one read of the keys
+	static const int Passes = 8;
+	uint32_t histograms[Passes][256] = {};
+	for (int i = 0; i < count; i++)
+	{
+		uint64_t key = keys[i];
+		for (int p = 0; p < Passes; p++)
+			histograms[p][(key >> (p * 8)) & 0xFF]++;
+	}
+
+	uint64_t* sourceKeys = keys;
+	uint32_t* sourceOrder = order;
+	uint64_t* destKeys = keyScratch;
+	uint32_t* destOrder = orderScratch;
+	for (int p = 0; p < Passes; p++)
+	{
+		// A byte every key shares can't change the order
+		uint32_t* histogram = histograms[p];
+		if (histogram[(sourceKeys[0] >> (p * 8)) & 0xFF] == (uint32_t)count)
+			continue;
+
+		uint32_t offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			uint32_t bucketCount = histogram[b];
+			histogram[b] = offset;
+			offset += bucketCount;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			uint64_t key = sourceKeys[i];
+			uint32_t position = histogram[(key >> (p * 8)) & 0xFF]++;
+			destKeys[position] = key;
+			destOrder[position] = sourceOrder[i];
+		}
+		std::swap(sourceKeys, destKeys);
+		std::swap(sourceOrder, destOrder);
+	}
+
+	// An odd number of passes leaves the result in the scratch arrays
+	if (sourceKeys != keys)
+	{
+		memcpy(keys, sourceKeys, count * sizeof(uint64_t));
+		memcpy(order, sourceOrder, count * sizeof(uint32_t));
+	}
+}
+
+RenderQueueStats RenderQueue::CountStateChanges(const DrawPacket* packets, int count, bool skipRedundant)
+{
+	RenderQueueStats stats = {};
+	StateTracker state(skipRedundant);
+	for (int i = 0; i < count; i++)
+	{
+		const DrawPacket& packet = packets[i];
+		bool instanced = packet.instanceCount > 0;
+		if (instanced && !skipRedundant)
+		{
+			// Each instance drawn on its own, with everything set for it
+			stats.draws += packet.instanceCount;
+			stats.instances += packet.instanceCount;
+			stats.shaderChanges += packet.instanceCount;
+			stats.materialChanges += packet.instanceCount;
+			stats.constantBufferChanges += packet.instanceCount;
+			if (state.SetGeometry(packet.mesh))
+				stats.geometryChanges += packet.mesh->IsPooled() ? 1 : packet.instanceCount;
+			continue;
+		}
+
+		if (state.SetShaders(GetPacketVertexShader(packet), packet.material->GetPixelShader()))
+			stats.shaderChanges++;
+		if (state.SetMaterial(packet.material))
+			stats.materialChanges++;
+		if (state.SetGeometry(packet.mesh))
+			stats.geometryChanges++;
+		if (instanced ? state.SetInstanceBuffer() : state.SetObjectConstants(packet.objectConstants))
+		{
+			if (instanced)
+				stats.geometryChanges++;
+			else
+				stats.constantBufferChanges++;
+		}
+		stats.draws++;
+		stats.instances += instanced ? packet.instanceCount : 1;
+	}
+	return stats;
+}
+
+void RenderQueue::Submit(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* cam, ID3D11Buffer* instanceBuffer)
+{
+	RenderQueueStats stats = {};
+	StateTracker state(true);
+	DirectX::XMFLOAT3 cameraPosition = cam->GetTransform()->GetPosition();
+	for (const DrawPacket& packet : packets)
+	{
+		bool instanced = packet.instanceCount > 0;
+		if (instanced && instanceBuffer == nullptr)
+			continue;
+
+		Material* material = packet.material;
+		SimpleVertexShader* vs = GetPacketVertexShader(packet);
+		SimplePixelShader* ps = material->GetPixelShader();
+		if (state.SetShaders(vs, ps))
+		{
+			vs->SetShader();
+			ps->SetShader();
+
+			// The instanced shaders' only constants are per frame
+			if (instanced)
+			{
+				vs->SetMatrix4x4("viewProj", cam->GetViewProjectionMatrix());
+				vs->CopyBufferData("PerFrame");
+			}
+			stats.shaderChanges++;
+		}
+
+		if (state.SetMaterial(material))
+		{
+			// Instances carry their own tint
+			if (!instanced)
+			{
+				vs->SetFloat4("colorTint", material->GetColorTint());
+				vs->CopyBufferData("PerMaterial");
+			}
+
+			ps->SetFloat3("cameraPosition", cameraPosition);
+			ps->SetFloat("specularValue", material->GetSpecularity());
+			ps->SetSamplerState("samplerOptions", material->GetSamplerState());
+			ps->SetShaderResourceView("Albedo", material->GetSRV());
+			ps->SetShaderResourceView("RoughnessMap", material->GetRoughnessSRV());
+			ps->SetShaderResourceView("MetalnessMap", material->GetMetalnessSRV());
+			if (material->GetNormalSRV() != nullptr)
+			{
+				ps->SetShaderResourceView("NormalMap", material->GetNormalSRV());
+			}
+			ps->CopyAllBufferData();
+			stats.materialChanges++;
+		}
+
+		// Meshes in a GeometryPool share its buffers
+		Mesh* mesh = packet.mesh;
+		if (state.SetGeometry(mesh))
+		{
+			if (mesh->IsPooled())
+				mesh->GetPool()->Bind(context);
+			else
+			{
+				UINT stride = mesh->GetVertexStride();
+				UINT offset = 0;
+				context->IASetVertexBuffers(0, 1, mesh->GetVertexBuffer().GetAddressOf(), &stride, &offset);
+				context->IASetIndexBuffer(mesh->GetIndexBuffer().Get(), mesh->GetIndexFormat(), 0);
+			}
+			stats.geometryChanges++;
+		}
+
+		if (instanced)
+		{
+			if (state.SetInstanceBuffer())
+			{
+				UINT stride = sizeof(InstanceData);
+				UINT offset = 0;
+				context->IASetVertexBuffers(1, 1, &instanceBuffer, &stride, &offset);
+				stats.geometryChanges++;
+			}
+
+			context->DrawIndexedInstanced(
+				packet.indexCount,
+				packet.instanceCount,
+				mesh->GetFirstIndex() + packet.firstIndex,
+				mesh->GetBaseVertex(),
+				packet.firstInstance);
+			stats.draws++;
+			stats.instances += packet.instanceCount;
+			continue;
+		}
+
+		// SetShader() bound the shader's own (unused) per-object buffer
+		if (state.SetObjectConstants(packet.objectConstants))
+		{
+			context->VSSetConstantBuffers(0, 1, &packet.objectConstants);
+			stats.constantBufferChanges++;
+		}
+
+		context->DrawIndexed(packet.indexCount, mesh->GetFirstIndex() + packet.firstIndex, mesh->GetBaseVertex());
+		stats.draws++;
+		stats.instances++;
+	}
+
+	lastStats = stats;
+	lastUnfilteredStats = CountStateChanges(packets.data(), (int)packets.size(), false);
+}
+
+const std::vector<DrawPacket>& RenderQueue::GetPackets() const
+{
+	return packets;
+}
+
+const RenderQueueStats& RenderQueue::GetLastStats() const
+{
+	return lastStats;
+}
+
+const RenderQueueStats& RenderQueue::GetLastUnfilteredStats() const
+{
+	return lastUnfilteredStats;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "DXCore.h"
+
+#include "BufferStructs.h"
+#include "Camera.h"
+#include "Material.h"
+#include "Mesh.h"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Where a draw falls in the frame - lower passes draw first
+enum RenderPass { OpaquePass = 0, TransparentPass = 1 };
+
+// --------------------------------------------------------
+// Everything needed to issue one draw, without going back
+// to the entity it came from
+// --------------------------------------------------------
+struct DrawPacket
+{
+	uint64_t key;
+	Mesh* mesh;
+	Material* material;
+	ID3D11Buffer* objectConstants;
+	unsigned int indexCount;
+	unsigned int firstIndex;
+
+	// Instanced draws (instanceCount > 0) read their instances from
+	// the queue's instance buffer instead of objectConstants
+	unsigned int firstInstance;
+	unsigned int instanceCount;
+};
+
+// How many times each kind of state was set during a submission
+struct RenderQueueStats
+{
+	int draws;
+	int instances;              // objects drawn (instanced or not)
+	int shaderChanges;          // vertex and pixel shader, set together
+	int materialChanges;        // textures, sampler and material constants
+	int geometryChanges;        // vertex and index buffers
+	int constantBufferChanges;  // per-object constant buffers
+
+	int GetTotal() const { return shaderChanges + materialChanges + geometryChanges + constantBufferChanges; }
+};
+
+// --------------------------------------------------------
+// A frame's draws, sorted to keep state changes down
+//
+// - Each packet's 64-bit key packs, from the top:
+//     pass (4 bits) | shader (12) | material (16) | geometry (16) | depth (16)
+//   so opaque draws group by shader, then material, then
+//   buffers, and run front to back within a group.  The
+//   transparent pass puts (inverted) depth right after the
+//   pass instead, so it draws back to front
+// - Shaders, materials and geometry get small ids the first
+//   time the queue sees them - ids past a field's range wrap,
+//   which only costs sorting quality, never correctness
+// - Submit() compares the actual state against what's bound
+//   and only sets what changed
+// - Instanced draws use their material's instanced vertex
+//   shader, so they sort as a shader of their own
+// --------------------------------------------------------
+class RenderQueue
+{
+	struct MaterialIds
+	{
+		uint32_t shader;
+		uint32_t instancedShader;
+		uint32_t material;
+	};
+
+	std::vector<DrawPacket> packets;
+
+	// Scratch space for sorting, kept between frames
+	std::vector<DrawPacket> sortedPackets;
+	std::vector<uint64_t> keys, keyScratch;
+	std::vector<uint32_t> order, orderScratch;
+
+	std::unordered_map<const void*, MaterialIds> materialIds;
+	std::vector<std::pair<SimpleVertexShader*, SimplePixelShader*>> shaders;
+	std::unordered_map<const void*, uint32_t> geometryIds;
+	uint32_t GetShaderId(SimpleVertexShader* vs, SimplePixelShader* ps);
+	void AddPacket(DrawPacket packet, RenderPass pass, bool instanced, float depth);
+
+	RenderQueueStats lastStats;
+	RenderQueueStats lastUnfilteredStats;
+
+public:
+	RenderQueue();
+
+	// Packs a key - depth is the draw's distance from the camera
+	// (anything non-negative; only its order matters)
+	static uint64_t MakeKey(RenderPass pass, uint32_t shader, uint32_t material, uint32_t geometry, float depth);
+
+	// What a mesh's buffers are bound as - the pool for pooled meshes,
+	// since they all share its buffers
+	static const void* GetGeometrySource(const Mesh* mesh);
+
+	void Clear();
+
+	// Queues one draw of indexCount indices of the mesh, starting at
+	// firstIndex (relative to the mesh's own first index)
+	void Add(
+		RenderPass pass,
+		Mesh* mesh,
+		Material* material,
+		ID3D11Buffer* objectConstants,
+		unsigned int indexCount,
+		unsigned int firstIndex,
+		float depth);
+
+	// Queues one DrawIndexedInstanced() of instances [firstInstance,
+	// firstInstance + instanceCount) from the buffer given to Submit() -
+	// the material needs an instanced vertex shader
+	void AddInstanced(
+		RenderPass pass,
+		Mesh* mesh,
+		Material* material,
+		unsigned int indexCount,
+		unsigned int firstIndex,
+		unsigned int firstInstance,
+		unsigned int instanceCount,
+		float depth);
+
+	// Orders the packets by key (stable, so equal keys keep the order
+	// they were added in)
+	void Sort();
+
+	// Sorts count keys in place with an LSD radix sort, a byte at a
+	// time (skipping bytes every key shares) - order[i] ends up as the
+	// original position of the i-th sorted key.  The scratch arrays
+	// need count entries.
+	static void RadixSort(
+		uint64_t* keys,
+		uint32_t* order,
+		uint64_t* keyScratch,
+		uint32_t* orderScratch,
+		int count);
+
+	// The state changes submitting these packets in this order would
+	// make - if skipRedundant is false, everything but a shared pool's
+	// buffers is set for every object, and instances are drawn one by
+	// one (the way drawing each entity on its own works)
+	static RenderQueueStats CountStateChanges(const DrawPacket* packets, int count, bool skipRedundant);
+
+	// Draws everything in order
+	// - per-frame data (lights) has to be in the pixel shaders already
+	// - instanceBuffer (InstanceData) is only needed for instanced draws
+	void Submit(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		Camera* cam,
+		ID3D11Buffer* instanceBuffer = nullptr);
+
+	const std::vector<DrawPacket>& GetPackets() const;
+
+	// The last Submit(), and what it would have cost without skipping
+	// redundant state
+	const RenderQueueStats& GetLastStats() const;
+	const RenderQueueStats& GetLastUnfilteredStats() const;
+};
@@ -0,0 +1,402 @@
+#include "RenderSystem.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// Below this, another culling job costs more than it saves
+	const int MinObjectsPerCullJob = 65536;
+
+	// Same for rasterizing occluders
+	const int MinTrianglesPerRasterJob = 4096;
+}
+
+RenderSystem::RenderSystem()
+{
+	lastCandidateCount = 0;
+	lastVisibleCount = 0;
+	lastOccludedCount = 0;
+	lastOcclusionMilliseconds = 0.0f;
+	reinsertedSinceBuild = 0;
+}
+
+bool RenderSystem::IsInstanced(const MeshRenderer& renderer)
+{
+	if (renderer.material == nullptr || renderer.material->GetInstancedVertexShader() == nullptr)
+		return false;
+	for (Material* material : renderer.submeshMaterials)
+	{
+		if (material->GetInstancedVertexShader() == nullptr)
+			return false;
+	}
+	return true;
+}
+
+void RenderSystem::UpdateObjectConstants(EntityWorld& world, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* cam)
+{
+	// Gather everything whose constants are out of date for this camera
+	unsigned int cameraVersion = cam->GetVersion();
+	staleConstants.clear();
+	staleHandles.clear();
+	world.ForEachChunk<Transform, MeshRenderer, ObjectConstants>(
+		[&](int count, const EntityId* ids, Transform* transforms, MeshRenderer* renderers, ObjectConstants* constants)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (IsInstanced(renderers[i]))
+				continue;
+
+			if (constants[i].buffer.Get() == nullptr
+				|| constants[i].transformVersion != transforms[i].GetVersion()
+				|| constants[i].cameraVersion != cameraVersion)
+			{
+				staleConstants.push_back(&constants[i]);
+				staleHandles.push_back(transforms[i].GetHandle());
+			}
+		}
+	});
+	if (staleConstants.empty())
+		return;
+
+	TransformSystem& transforms = TransformSystem::GetDefault();
+	objectMatrices.resize(staleConstants.size());
+	transforms.ComputeObjectMatrices(staleHandles.data(), (int)staleHandles.size(), cam->GetViewProjectionMatrix(), objectMatrices.data());
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	for (size_t i = 0; i < staleConstants.size(); i++)
+	{
+		ObjectConstants& constants = *staleConstants[i];
+
+		// Made on first use, since entities are created without a device
+		if (constants.buffer.Get() == nullptr)
+		{
+			if (device.Get() == nullptr)
+				context->GetDevice(device.GetAddressOf());
+
+			D3D11_BUFFER_DESC desc = {};
+			desc.ByteWidth = sizeof(VertexShaderPerObjectData);
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+			device->CreateBuffer(&desc, 0, constants.buffer.GetAddressOf());
+		}
+
+		context->UpdateSubresource(constants.buffer.Get(), 0, 0, &objectMatrices[i], 0, 0);
+		constants.transformVersion = transforms.GetVersion(staleHandles[i]);
+		constants.cameraVersion = cameraVersion;
+	}
+}
+
+void RenderSystem::UpdateBounds(EntityWorld& world)
+{
+	int indexedCount = 0;
+	newBoxes.clear();
+	newEntities.clear();
+	newBounds.clear();
+	world.ForEachChunk<Transform, MeshRenderer, WorldBounds>(
+		[&](int count, const EntityId* ids, Transform* transforms, MeshRenderer* renderers, WorldBounds* bounds)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			WorldBounds& b = bounds[i];
+			unsigned int version = transforms[i].GetVersion();
+			bool changed = !b.valid || b.version != version;
+			if (changed)
+			{
+				// A mesh that's still loading has no bounds yet, so nothing is kept
+				DirectX::XMFLOAT4X4 worldMatrix = transforms[i].GetWorldMatrix();
+				Mesh* mesh = renderers[i].mesh;
+				b.box = mesh->GetWorldBounds(worldMatrix);
+				b.sphere = mesh->GetWorldBoundingSphere(worldMatrix);
+				b.version = version;
+				b.valid = mesh->IsResident();
+			}
+
+			// Only boxes that changed can have left their fat boxes
+			if (!b.valid)
+			{
+				if (b.proxy != AABBTree::NullNode)
+				{
+					spatialIndex.Remove(b.proxy);
+					indexedEntities[b.proxy] = InvalidEntity;
+					b.proxy = AABBTree::NullNode;
+				}
+			}
+			else if (b.proxy == AABBTree::NullNode)
+			{
+				newBoxes.push_back(b.box);
+				newEntities.push_back(ids[i]);
+				newBounds.push_back(&b);
+			}
+			else
+			{
+				if (changed)
+					reinsertedSinceBuild += spatialIndex.Move(b.proxy, b.box);
+				indexedCount++;
+			}
+		}
+	});
+
+	// Anything indexed that wasn't seen belongs to an entity that's gone
+	// (or lost its WorldBounds)
+	if (spatialIndex.GetProxyCount() > indexedCount)
+	{
+		for (size_t proxy = 0; proxy < indexedEntities.size(); proxy++)
+		{
+			EntityId id = indexedEntities[proxy];
+			if (id == InvalidEntity)
+				continue;
+			WorldBounds* bounds = world.Get<WorldBounds>(id);
+			if (bounds == nullptr || bounds->proxy != (int)proxy)
+			{
+				spatialIndex.Remove((int)proxy);
+				indexedEntities[proxy] = InvalidEntity;
+			}
+		}
+	}
+
+	// Then the new ones, all at once if there's nothing to add them to
+	int newCount = (int)newBoxes.size();
+	newProxies.resize(newCount);
+	if (newCount > 0 && spatialIndex.GetProxyCount() == 0)
+	{
+		std::vector<int> userData(newCount, 0);
+		for (int i = 0; i < newCount; i++)
+			userData[i] = (int)newEntities[i].index;
+		spatialIndex.Build(newBoxes.data(), userData.data(), newCount, newProxies.data());
+		indexedEntities.assign(newCount, InvalidEntity);
+		reinsertedSinceBuild = 0;
+	}
+	else
+	{
+		for (int i = 0; i < newCount; i++)
+			newProxies[i] = spatialIndex.Insert(newBoxes[i], (int)newEntities[i].index);
+		reinsertedSinceBuild += newCount;
+	}
+
+	for (int i = 0; i < newCount; i++)
+	{
+		int proxy = newProxies[i];
+		if (proxy >= (int)indexedEntities.size())
+			indexedEntities.resize(proxy + 1, InvalidEntity);
+		indexedEntities[proxy] = newEntities[i];
+		newBounds[i]->proxy = proxy;
+	}
+
+	// Trees made one insertion at a time are a lot slower to query
+	if (reinsertedSinceBuild > 16 && reinsertedSinceBuild > spatialIndex.GetProxyCount() / 2)
+	{
+		spatialIndex.Rebuild();
+		reinsertedSinceBuild = 0;
+	}
+}
+
+void RenderSystem::Draw(EntityWorld& world, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* cam, float screenHeight)
+{
+	DirectX::XMFLOAT3 cameraPosition = cam->GetTransform()->GetPosition();
+	float projectionScale = cam->GetProjectionMatrix()._22;
+
+	DirectX::XMFLOAT4 planes[6];
+	cam->GetFrustumPlanes(planes);
+
+	auto addCandidate = [&](Transform* transform, MeshRenderer* renderer, ObjectConstants* constants, const WorldBounds* bounds, bool occluder)
+	{
+		// The mesh may still be loading in the background
+		if (!renderer->mesh->IsResident() || (!IsInstanced(*renderer) && constants->buffer.Get() == nullptr))
+			return;
+
+		candidates.push_back({ transform, renderer, constants, bounds, occluder });
+		if (bounds != nullptr)
+			culler.Add(bounds->box);
+		else
+			culler.AddUnbounded();
+	};
+
+	// Everything without bounds can't be culled, so it's always a
+	// candidate.  Entities with WorldBounds whose mesh is resident are all
+	// in the spatial index, which narrows them down to the ones whose fat
+	// boxes touch the frustum - the culler then tests their own boxes.
+	// Whether an entity has WorldBounds depends on its archetype, so it's
+	// the same for a whole chunk.
+	candidates.clear();
+	culler.Clear();
+	world.ForEachChunk<Transform, MeshRenderer, ObjectConstants>(
+		[&](int count, const EntityId* ids, Transform* transforms, MeshRenderer* renderers, ObjectConstants* constants)
+	{
+		if (world.Has<WorldBounds>(ids[0]))
+			return;
+		bool occluder = world.Has<Occluder>(ids[0]);
+		for (int i = 0; i < count; i++)
+			addCandidate(&transforms[i], &renderers[i], &constants[i], nullptr, occluder);
+	});
+	lastCandidateCount = (int)candidates.size() + spatialIndex.GetProxyCount();
+	spatialIndex.QueryFrustum(planes, [&](int proxy)
+	{
+		EntityId id = indexedEntities[proxy];
+		Transform* transform = world.Get<Transform>(id);
+		MeshRenderer* renderer = world.Get<MeshRenderer>(id);
+		ObjectConstants* constants = world.Get<ObjectConstants>(id);
+		if (transform != nullptr && renderer != nullptr && constants != nullptr)
+			addCandidate(transform, renderer, constants, world.Get<WorldBounds>(id), world.Has<Occluder>(id));
+		return true;
+	});
+
+	int threadCount = std::max(1, std::min(JobSystem::GetDefault().GetThreadCount(), culler.GetCount() / MinObjectsPerCullJob));
+	candidateVisible.resize(candidates.size());
+	lastVisibleCount = culler.Cull(planes, candidateVisible.data(), threadCount);
+	CullOccluded(cam);
+
+	queue.Clear();
+	instances.Clear();
+	for (size_t c = 0; c < candidates.size(); c++)
+	{
+		if (!candidateVisible[c])
+			continue;
+
+		Transform& transform = *candidates[c].transform;
+		const MeshRenderer& renderer = *candidates[c].renderer;
+		const ObjectConstants& constants = *candidates[c].constants;
+		Mesh* mesh = renderer.mesh;
+		bool instanced = IsInstanced(renderer);
+
+		// Pick a level of detail from how big an object space unit
+		// ends up on screen (proj._22 is 1 / tan(fov / 2)) - position and
+		// scale come from the world matrix, so parents are included
+		const DirectX::XMFLOAT4X4& worldFloat = transform.GetSystem()->GetWorldMatrix(transform.GetHandle());
+		DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&worldFloat);
+		float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(
+			DirectX::XMVectorSubtract(worldMatrix.r[3], DirectX::XMLoadFloat3(&cameraPosition))));
+		float maxScale = fmaxf(DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[0])),
+			fmaxf(DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[1])), DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[2]))));
+		float pixelsPerUnit = maxScale * projectionScale * screenHeight * 0.5f / fmaxf(distance, 0.001f);
+		int lodIndex = mesh->SelectLod(pixelsPerUnit);
+
+		// The world matrix stays put until the frame's instances are packed
+		auto addDraw = [&](Material* material, const MeshLod& range)
+		{
+			if (instanced)
+				instances.Add(mesh, material, range.indexCount, range.firstIndex, &worldFloat, distance);
+			else
+				queue.Add(OpaquePass, mesh, material, constants.buffer.Get(), range.indexCount, range.firstIndex, distance);
+		};
+
+		// One material for everything
+		const std::vector<Material*>& submeshMaterials = renderer.submeshMaterials;
+		if (submeshMaterials.size() <= 1 || (int)submeshMaterials.size() != mesh->GetSubmeshCount())
+		{
+			addDraw(renderer.material, mesh->GetLod(lodIndex));
+			continue;
+		}
+
+		// Otherwise one draw per material group, all from the same LOD
+		for (int s = 0; s < mesh->GetSubmeshCount(); s++)
+		{
+			const MeshLod& range = mesh->GetSubmeshLod(lodIndex, s);
+			if (range.indexCount > 0)
+				addDraw(submeshMaterials[s], range);
+		}
+	}
+
+	// One draw per group, all reading from the same instance buffer
+	instances.Build();
+	if (instances.Upload(context))
+	{
+		for (const InstanceGroup& group : instances.GetGroups())
+		{
+			queue.AddInstanced(OpaquePass, group.mesh, group.material, group.indexCount, group.firstIndex,
+				group.firstInstance, group.instanceCount, group.depth);
+		}
+	}
+
+	queue.Sort();
+	queue.Submit(context, cam, instances.GetBuffer());
+}
+
+void RenderSystem::CullOccluded(Camera* cam)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	lastOccludedCount = 0;
+
+	// Occluders in the frustum, each as its coarse triangles (meshes
+	// too detailed to have any are skipped)
+	occlusion.Begin(cam->GetViewProjectionMatrix());
+	for (size_t c = 0; c < candidates.size(); c++)
+	{
+		if (!candidateVisible[c] || !candidates[c].occluder)
+			continue;
+		const Transform& transform = *candidates[c].transform;
+		const Mesh* mesh = candidates[c].renderer->mesh;
+		const std::vector<DirectX::XMFLOAT3>& positions = mesh->GetOccluderPositions();
+		const std::vector<unsigned int>& indices = mesh->GetOccluderIndices();
+		if (indices.empty())
+			continue;
+		occlusion.AddOccluder(positions.data(), (int)positions.size(), indices.data(), (int)indices.size(),
+			transform.GetSystem()->GetWorldMatrix(transform.GetHandle()));
+	}
+
+	// Then everything still visible with bounds against them
+	if (occlusion.GetTriangleCount() > 0)
+	{
+		int jobThreads = JobSystem::GetDefault().GetThreadCount();
+		occlusion.Rasterize(std::max(1, std::min(jobThreads, occlusion.GetTriangleCount() / MinTrianglesPerRasterJob)));
+
+		occludeeBoxes.clear();
+		occludeeCandidates.clear();
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			if (candidateVisible[c] && candidates[c].bounds != nullptr)
+			{
+				occludeeBoxes.push_back(candidates[c].bounds->box);
+				occludeeCandidates.push_back((int)c);
+			}
+		}
+
+		int testCount = (int)occludeeBoxes.size();
+		occludeeVisible.resize(testCount);
+		int testThreads = std::max(1, std::min(jobThreads, testCount / MinObjectsPerCullJob));
+		lastOccludedCount = testCount - occlusion.TestBoxes(occludeeBoxes.data(), testCount, occludeeVisible.data(), testThreads);
+		for (int i = 0; i < testCount; i++)
+		{
+			if (!occludeeVisible[i])
+				candidateVisible[occludeeCandidates[i]] = 0;
+		}
+	}
+
+	lastOcclusionMilliseconds = (float)std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+const RenderQueue& RenderSystem::GetQueue() const
+{
+	return queue;
+}
+
+int RenderSystem::GetLastCandidateCount() const
+{
+	return lastCandidateCount;
+}
+
+int RenderSystem::GetLastVisibleCount() const
+{
+	return lastVisibleCount;
+}
+
+int RenderSystem::GetLastOccludedCount() const
+{
+	return lastOccludedCount;
+}
+
+float RenderSystem::GetLastOcclusionMilliseconds() const
+{
+	return lastOcclusionMilliseconds;
+}
+
+const AABBTree& RenderSystem::GetSpatialIndex() const
+{
+	return spatialIndex;
+}
+
+EntityId RenderSystem::GetIndexedEntity(int proxy) const
+{
+	return indexedEntities[proxy];
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "DXCore.h"
+
+#include "AABBTree.h"
+#include "Bounds.h"
+#include "BufferStructs.h"
+#include "Camera.h"
+#include "EntityWorld.h"
+#include "FrustumCuller.h"
+#include "InstanceBatcher.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "OcclusionBuffer.h"
+#include "RenderQueue.h"
+#include "Transform.h"
+#include <vector>
+
+// --------------------------------------------------------
+// Components for anything drawn with a mesh
+//
+// - Drawn entities have a Transform (in the default
+//   TransformSystem), a MeshRenderer and ObjectConstants;
+//   WorldBounds and Occluder are optional
+// --------------------------------------------------------
+struct MeshRenderer
+{
+	Mesh* mesh;
+	Material* material;
+
+	// One per submesh of the mesh, if it was given them (see
+	// MaterialLibrary) - if the counts don't match (say the mesh is
+	// still loading), material is used for the whole thing
+	std::vector<Material*> submeshMaterials;
+};
+
+// The entity's own vertex shader constants, only re-uploaded when
+// the transform's or the camera's version moves on
+struct ObjectConstants
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	unsigned int transformVersion;
+	unsigned int cameraVersion;
+};
+
+// World space bounds, kept until the transform (or the mesh's
+// residency) changes
+struct WorldBounds
+{
+	AABB box;
+	Sphere sphere;
+	unsigned int version;
+	bool valid;
+
+	// Where the box is in the RenderSystem's spatial index
+	int proxy = AABBTree::NullNode;
+};
+
+// Marks an entity whose mesh hides what's behind it - its occluder
+// triangles (see Mesh::GetOccluderIndices()) are drawn into the
+// occlusion buffer every frame it's in the frustum
+struct Occluder
+{
+};
+
+// --------------------------------------------------------
+// Per-frame work over every MeshRenderer in an EntityWorld
+// --------------------------------------------------------
+class RenderSystem
+{
+	// Scratch space for the entities whose constants need redoing,
+	// kept around to save reallocating every frame
+	std::vector<ObjectConstants*> staleConstants;
+	std::vector<int> staleHandles;
+	std::vector<VertexShaderPerObjectData> objectMatrices;
+
+	RenderQueue queue;
+	InstanceBatcher instances;
+
+	// Everything that could be drawn this frame (what the spatial index
+	// found near the frustum, plus everything without bounds), and
+	// whether each one is inside it (and not hidden by an occluder)
+	struct DrawCandidate
+	{
+		Transform* transform;
+		MeshRenderer* renderer;
+		ObjectConstants* constants;
+		const WorldBounds* bounds;
+		bool occluder;
+	};
+	std::vector<DrawCandidate> candidates;
+	std::vector<unsigned char> candidateVisible;
+	FrustumCuller culler;
+	int lastCandidateCount;
+	int lastVisibleCount;
+
+	// Occluders drawn on the CPU, and the boxes tested against them
+	OcclusionBuffer occlusion;
+	std::vector<AABB> occludeeBoxes;
+	std::vector<int> occludeeCandidates;
+	std::vector<unsigned char> occludeeVisible;
+	int lastOccludedCount;
+	float lastOcclusionMilliseconds;
+
+	// Rasterizes this frame's occluders and hides every candidate that
+	// ends up behind them
+	void CullOccluded(Camera* cam);
+
+	// Every valid WorldBounds, with the entity each proxy belongs to
+	// (InvalidEntity for proxies no longer in use)
+	AABBTree spatialIndex;
+	std::vector<EntityId> indexedEntities;
+	int reinsertedSinceBuild;
+	std::vector<AABB> newBoxes;
+	std::vector<EntityId> newEntities;
+	std::vector<WorldBounds*> newBounds;
+	std::vector<int> newProxies;
+
+public:
+	RenderSystem();
+
+	// Whether every material the entity uses has an instanced vertex
+	// shader - if so it's drawn with the other entities sharing its
+	// mesh and material, and never needs its ObjectConstants
+	static bool IsInstanced(const MeshRenderer& renderer);
+
+	// Per-object matrices for every entity that moved (or all of them,
+	// if the camera did) in one batch - everything else keeps what it
+	// uploaded last time.  Instanced entities are skipped.
+	void UpdateObjectConstants(EntityWorld& world, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* cam);
+
+	// Refreshes the WorldBounds of anything that moved, and its place in
+	// the spatial index - if the index is empty (the first frame, say)
+	// everything is built in one go instead of inserted one at a time,
+	// and once half the index has been inserted or re-inserted since,
+	// it's rebuilt the same way
+	void UpdateBounds(EntityWorld& world);
+
+	// Queues a draw for every resident mesh whose WorldBounds are in the
+	// camera's frustum and not hidden behind an Occluder (entities
+	// without bounds are always drawn) - the spatial index finds them,
+	// so UpdateBounds() has to have run first this frame.
+	// screenHeight, in pixels, is used to pick each one's level of
+	// detail.  Then sorts and submits them, only setting state that
+	// changes between draws.
+	// Instanced entities are grouped by mesh, material and LOD, with
+	// one DrawIndexedInstanced() per group.
+	void Draw(EntityWorld& world, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* cam, float screenHeight);
+
+	// Last frame's draws, as submitted
+	const RenderQueue& GetQueue() const;
+
+	// How many entities last frame's Draw() could have drawn (those
+	// with a resident mesh), and how many of them were inside the frustum
+	int GetLastCandidateCount() const;
+	int GetLastVisibleCount() const;
+
+	// How many of those were then hidden behind occluders, and what
+	// finding them cost (rasterizing and testing, on the CPU)
+	int GetLastOccludedCount() const;
+	float GetLastOcclusionMilliseconds() const;
+
+	// Every entity with valid WorldBounds, for frustum, box, sphere and
+	// ray queries - GetIndexedEntity() turns a proxy back into its entity
+	const AABBTree& GetSpatialIndex() const;
+	EntityId GetIndexedEntity(int proxy) const;
+};
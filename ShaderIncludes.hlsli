@@ -216,6 +216,28 @@ struct VertexShaderInput
 	float3 tangent		: TANGENT;
 };
 
+// Compact version of the vertex above - must match PackedVertex in Vertex.h
+// - Normal and tangent are octahedral encoded (R16G16_SNORM in the buffer)
+// - UV is two half floats (R16G16_FLOAT in the buffer)
+// - Needs an explicit input layout, since reflection would assume 32-bit floats
+struct PackedVertexShaderInput
+{
+	float3 position		: POSITION;
+	float2 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float2 tangent		: TANGENT;
+};
+
+// Turns an octahedral-encoded direction back into a unit vector
+// - Matches VertexPacking::DecodeOctahedral() on the CPU
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
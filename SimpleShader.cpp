@@ -646,7 +646,10 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
-	this->CleanUp();
+	// - The input layout is left alone, so a custom one
+	//   passed to the constructor actually gets used
+	ISimpleShader::CleanUp();
+	if (shader) { shader->Release(); shader = 0; }
 
 	// Create the shader from the blob
 	HRESULT result = device->CreateVertexShader(
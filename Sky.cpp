@@ -55,6 +55,10 @@ Sky::~Sky()
 
 void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Camera* camera)
 {
+	// The cube may still be loading in the background
+	if (!mesh->IsResident())
+		return;
+
 	 // change render states
 	deviceContext->RSSetState(rasterizerState.Get());
 	deviceContext->OMSetDepthStencilState(depthStencilState.Get(), 0);
@@ -72,15 +76,22 @@ void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Camera
 	vertexShader->CopyAllBufferData();
 
 	// render skybox
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	deviceContext->IASetVertexBuffers(0, 1, mesh->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-	deviceContext->IASetIndexBuffer(mesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+	if (mesh->IsPooled())
+	{
+		mesh->GetPool()->Bind(deviceContext);
+	}
+	else
+	{
+		UINT stride = mesh->GetVertexStride();
+		UINT offset = 0;
+		deviceContext->IASetVertexBuffers(0, 1, mesh->GetVertexBuffer().GetAddressOf(), &stride, &offset);
+		deviceContext->IASetIndexBuffer(mesh->GetIndexBuffer().Get(), mesh->GetIndexFormat(), 0);
+	}
 
 	deviceContext->DrawIndexed(
 		mesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,
-		0);
+		mesh->GetFirstIndex(),
+		mesh->GetBaseVertex());
 	deviceContext->RSSetState(0);
 	deviceContext->OMSetDepthStencilState(0, 0);
 }
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "Tests.h"
+#include "../AABBTree.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	bool Overlaps(const AABB& a, const AABB& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y
+			&& a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	bool TouchesSphere(const AABB& box, const Sphere& sphere)
+	{
+		const XMFLOAT3& c = sphere.center;
+		float dx = fmaxf(fmaxf(box.min.x - c.x, 0.0f), c.x - box.max.x);
+		float dy = fmaxf(fmaxf(box.min.y - c.y, 0.0f), c.y - box.max.y);
+		float dz = fmaxf(fmaxf(box.min.z - c.z, 0.0f), c.z - box.max.z);
+		return dx * dx + dy * dy + dz * dz <= sphere.radius * sphere.radius;
+	}
+
+	// Rejected only if it's entirely behind one plane, like the tree
+	bool InsideFrustum(const AABB& box, const XMFLOAT4 planes[6])
+	{
+		XMFLOAT3 center((box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f);
+		XMFLOAT3 extents(box.max.x - center.x, box.max.y - center.y, box.max.z - center.z);
+		for (int p = 0; p < 6; p++)
+		{
+			float distance = planes[p].x * center.x + planes[p].y * center.y + planes[p].z * center.z + planes[p].w;
+			float radius = fabsf(planes[p].x) * extents.x + fabsf(planes[p].y) * extents.y + fabsf(planes[p].z) * extents.z;
+			if (distance + radius < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	// Where the ray enters the box (0 if it starts inside), or infinity
+	float RayEntry(const AABB& box, const XMFLOAT3& origin, const XMFLOAT3& direction)
+	{
+		XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float tx0 = (box.min.x - origin.x) * inverse.x, tx1 = (box.max.x - origin.x) * inverse.x;
+		float ty0 = (box.min.y - origin.y) * inverse.y, ty1 = (box.max.y - origin.y) * inverse.y;
+		float tz0 = (box.min.z - origin.z) * inverse.z, tz1 = (box.max.z - origin.z) * inverse.z;
+		float tNear = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), fmaxf(fminf(tz0, tz1), 0.0f));
+		float tFar = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), fmaxf(tz0, tz1));
+		return tNear <= tFar ? tNear : INFINITY;
+	}
+
+	void MoveBox(AABB& box, float x, float y, float z)
+	{
+		box.min = XMFLOAT3(box.min.x + x, box.min.y + y, box.min.z + z);
+		box.max = XMFLOAT3(box.max.x + x, box.max.y + y, box.max.z + z);
+	}
+}
+
+void Tests::RunAABBTreeTests()
+{
+	printf("--- AABBTree ---\n");
+
+	// Small boxes spread through a space, like a scene's props - packed
+	// closer than in the benchmark, so every query has a few results
+	const int ObjectCount = 20000;
+	std::mt19937 rng(2323);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	std::vector<AABB> boxes(ObjectCount);
+	std::vector<int> userData(ObjectCount);
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		XMFLOAT3 center(position(rng), position(rng), position(rng));
+		XMFLOAT3 half(size(rng), size(rng), size(rng));
+		boxes[i].min = XMFLOAT3(center.x - half.x, center.y - half.y, center.z - half.z);
+		boxes[i].max = XMFLOAT3(center.x + half.x, center.y + half.y, center.z + half.z);
+		userData[i] = i;
+	}
+
+	// One at a time
+	AABBTree tree;
+	std::vector<int> proxies(ObjectCount);
+	for (int i = 0; i < ObjectCount; i++)
+		proxies[i] = tree.Insert(boxes[i], userData[i]);
+	Check(tree.Validate() && tree.GetProxyCount() == ObjectCount,
+		"Inserted one at a time: valid, height %d", tree.GetHeight());
+
+	// Every object drifting a little (which should mostly stay in its
+	// fat box), then a tenth of them jumping somewhere else entirely
+	std::uniform_real_distribution<float> drift(-0.03f, 0.03f);
+	int reinserted = 0;
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		MoveBox(boxes[i], drift(rng), drift(rng), drift(rng));
+		reinserted += tree.Move(proxies[i], boxes[i]);
+	}
+	int jumpCount = ObjectCount / 10;
+	int jumped = 0;
+	for (int i = 0; i < jumpCount; i++)
+	{
+		int index = (int)(rng() % ObjectCount);
+		MoveBox(boxes[index], position(rng) * 0.1f, position(rng) * 0.1f, position(rng) * 0.1f);
+		jumped += tree.Move(proxies[index], boxes[index]);
+	}
+	int outsideFatBox = 0;
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		const AABB& fat = tree.GetFatAABB(proxies[i]);
+		if (boxes[i].min.x < fat.min.x || boxes[i].min.y < fat.min.y || boxes[i].min.z < fat.min.z ||
+			boxes[i].max.x > fat.max.x || boxes[i].max.y > fat.max.y || boxes[i].max.z > fat.max.z)
+			outsideFatBox++;
+	}
+	Check(tree.Validate() && outsideFatBox == 0 && reinserted < ObjectCount / 2 && jumped > jumpCount / 2,
+		"Moves: valid, every box inside its fat box, %d of %d small moves and %d of %d big ones reinserted",
+		reinserted, ObjectCount, jumped, jumpCount);
+
+	// All at once, from where everything ended up
+	AABBTree built;
+	std::vector<int> builtProxies(ObjectCount);
+	built.Build(boxes.data(), userData.data(), ObjectCount, builtProxies.data());
+	int wrongUserData = 0;
+	for (int i = 0; i < ObjectCount; i++)
+		wrongUserData += built.GetUserData(builtProxies[i]) != i;
+	Check(built.Validate() && built.GetProxyCount() == ObjectCount && wrongUserData == 0 && built.GetAreaRatio() < tree.GetAreaRatio(),
+		"Built at once: valid, every proxy's user data kept, SAH cost %.1f (inserted %.1f)", built.GetAreaRatio(), tree.GetAreaRatio());
+
+	// Queries on both trees, each checked against every fat box
+	const int QueryCount = 20;
+	const float RayLength = 300.0f;
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f);
+	const AABBTree* trees[2] = { &tree, &built };
+	const std::vector<int>* treeProxies[2] = { &proxies, &builtProxies };
+	const char* treeNames[2] = { "inserted", "built" };
+	for (int t = 0; t < 2; t++)
+	{
+		const AABBTree& queried = *trees[t];
+		const std::vector<int>& p = *treeProxies[t];
+		int wrong[4] = {};
+		long long found[4] = {};
+		for (int q = 0; q < QueryCount; q++)
+		{
+			// A camera somewhere, looking any which way
+			XMFLOAT3 eye(position(rng) * 0.5f, position(rng) * 0.5f, position(rng) * 0.5f);
+			XMMATRIX view = XMMatrixInverse(nullptr, XMMatrixMultiply(
+				XMMatrixRotationRollPitchYaw(unit(rng), angle(rng), 0.0f), XMMatrixTranslation(eye.x, eye.y, eye.z)));
+			XMFLOAT4 planes[6];
+			XMFLOAT4X4 viewProjection;
+			XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+			Bounds::GetFrustumPlanes(viewProjection, planes);
+
+			// Boxes and spheres a few units across, and a ray
+			XMFLOAT3 c(position(rng), position(rng), position(rng));
+			AABB region = { XMFLOAT3(c.x - 10, c.y - 10, c.z - 10), XMFLOAT3(c.x + 10, c.y + 10, c.z + 10) };
+			Sphere sphere = { c, 10.0f };
+			XMFLOAT3 rayOrigin(position(rng), position(rng), position(rng));
+			XMFLOAT3 rayDirection;
+			XMStoreFloat3(&rayDirection, XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f)));
+
+			// Each object reported at most once, and exactly when it should be
+			std::vector<unsigned char> hits[4];
+			for (std::vector<unsigned char>& h : hits)
+				h.assign(ObjectCount, 0);
+			queried.QueryFrustum(planes, [&](int proxy) { hits[0][queried.GetUserData(proxy)]++; return true; });
+			queried.QueryAABB(region, [&](int proxy) { hits[1][queried.GetUserData(proxy)]++; return true; });
+			queried.QuerySphere(sphere, [&](int proxy) { hits[2][queried.GetUserData(proxy)]++; return true; });
+			queried.RayCast(rayOrigin, rayDirection, RayLength, [&](int proxy, float)
+			{
+				hits[3][queried.GetUserData(proxy)]++;
+				return RayLength;
+			});
+
+			float expectedNearest = INFINITY;
+			for (int i = 0; i < ObjectCount; i++)
+			{
+				const AABB& fat = queried.GetFatAABB(p[i]);
+				float entry = RayEntry(fat, rayOrigin, rayDirection);
+				bool expected[4] = { InsideFrustum(fat, planes), Overlaps(fat, region), TouchesSphere(fat, sphere), entry <= RayLength };
+				if (expected[3])
+					expectedNearest = fminf(expectedNearest, entry);
+				for (int k = 0; k < 4; k++)
+				{
+					wrong[k] += hits[k][i] != (expected[k] ? 1 : 0);
+					found[k] += hits[k][i];
+				}
+			}
+
+			// Shortening the ray to each hit finds the nearest one
+			float nearest = INFINITY;
+			queried.RayCast(rayOrigin, rayDirection, RayLength, [&](int, float distance)
+			{
+				nearest = fminf(nearest, distance);
+				return nearest;
+			});
+			wrong[3] += nearest != expectedNearest;
+		}
+
+		const char* queryNames[4] = { "Frustum", "Box", "Sphere", "Ray" };
+		for (int k = 0; k < 4; k++)
+		{
+			Check(wrong[k] == 0 && found[k] > 0, "%s queries on the %s tree: %lld results, %d wrong",
+				queryNames[k], treeNames[t], found[k], wrong[k]);
+		}
+	}
+
+	// Returning false stops a query at its first result
+	int calls = 0;
+	AABB everything = { XMFLOAT3(-1000, -1000, -1000), XMFLOAT3(1000, 1000, 1000) };
+	built.QueryAABB(everything, [&](int) { calls++; return false; });
+	Check(calls == 1, "A query stops when its callback returns false");
+
+	// Rebuilding the inserted tree in place keeps every proxy
+	float insertedCost = tree.GetAreaRatio();
+	tree.Rebuild();
+	wrongUserData = 0;
+	for (int i = 0; i < ObjectCount; i++)
+		wrongUserData += tree.GetUserData(proxies[i]) != i;
+	Check(tree.Validate() && tree.GetProxyCount() == ObjectCount && wrongUserData == 0 && tree.GetAreaRatio() < insertedCost,
+		"Rebuild() keeps every proxy, SAH cost %.1f (from %.1f)", tree.GetAreaRatio(), insertedCost);
+
+	// Emptying it again leaves nothing behind, and freed nodes are reused
+	for (int i = 0; i < ObjectCount; i++)
+		tree.Remove(proxies[i]);
+	bool empty = tree.Validate() && tree.GetProxyCount() == 0 && tree.GetHeight() == 0;
+	int reused = tree.Insert(boxes[0], 0);
+	Check(empty && tree.GetProxyCount() == 1 && tree.GetUserData(reused) == 0, "Removing everything empties the tree");
+}
@@ -0,0 +1,103 @@
+#include "Tests.h"
+#include "../Bounds.h"
+#include "../ObjLoader.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Scalar reference box
+	AABB ReferenceAABB(const Vertex* verts, int vertexCount)
+	{
+		AABB box = { verts[0].Position, verts[0].Position };
+		for (int i = 0; i < vertexCount; i++)
+		{
+			const XMFLOAT3& p = verts[i].Position;
+			box.min = XMFLOAT3(fminf(box.min.x, p.x), fminf(box.min.y, p.y), fminf(box.min.z, p.z));
+			box.max = XMFLOAT3(fmaxf(box.max.x, p.x), fmaxf(box.max.y, p.y), fmaxf(box.max.z, p.z));
+		}
+		return box;
+	}
+}
+
+void Tests::RunBoundsTests()
+{
+	printf("--- Bounds ---\n");
+
+	AABB empty = Bounds::ComputeAABB(nullptr, 0);
+	Check(empty.min.x == 0 && empty.min.y == 0 && empty.min.z == 0 && empty.max.x == 0 && empty.max.y == 0 && empty.max.z == 0,
+		"No vertices: empty box at the origin");
+
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Check(ObjLoader::Load(path.c_str(), verts, indices) && !verts.empty(), "%s: loaded", name.c_str()))
+			continue;
+
+		// The whole mesh, and short prefixes for the SIMD loop's tail
+		AABB box = Bounds::ComputeAABB(verts.data(), (int)verts.size());
+		AABB reference = ReferenceAABB(verts.data(), (int)verts.size());
+		bool boxMatches = memcmp(&box, &reference, sizeof(AABB)) == 0;
+		for (int count = 1; count <= 8 && count <= (int)verts.size(); count++)
+		{
+			AABB prefix = Bounds::ComputeAABB(verts.data(), count);
+			AABB prefixReference = ReferenceAABB(verts.data(), count);
+			boxMatches = boxMatches && memcmp(&prefix, &prefixReference, sizeof(AABB)) == 0;
+		}
+		Check(boxMatches, "%s: box matches a scalar pass (and for the first 1 to 8 vertices)", name.c_str());
+
+		// Every vertex inside the transformed box and sphere, for a spread
+		// of rotations, non-uniform scales and translations
+		Sphere sphere = Bounds::ComputeSphere(verts.data(), (int)verts.size(), box);
+		const int TransformCount = 64;
+		const float Epsilon = 1e-4f;
+		int outside = 0;
+		double boxVolumeRatio = 0.0;
+		for (int t = 0; t < TransformCount; t++)
+		{
+			XMMATRIX world =
+				XMMatrixScaling(0.5f + (t % 4), 1.0f + (t % 3) * 0.5f, 2.0f - (t % 5) * 0.3f) *
+				XMMatrixRotationRollPitchYaw(t * 0.7f, t * 1.3f, t * 0.4f) *
+				XMMatrixTranslation(t * 1.5f, -t * 0.5f, t * 0.25f);
+			XMFLOAT4X4 worldFloat;
+			XMStoreFloat4x4(&worldFloat, world);
+
+			AABB worldBox = Bounds::TransformAABB(box, worldFloat);
+			Sphere worldSphere = Bounds::TransformSphere(sphere, worldFloat);
+			float tolerance = Epsilon * (1.0f + worldSphere.radius);
+
+			AABB tight = {};
+			for (size_t i = 0; i < verts.size(); i++)
+			{
+				XMFLOAT3 p;
+				XMStoreFloat3(&p, XMVector3Transform(XMLoadFloat3(&verts[i].Position), world));
+				tight = (i == 0) ? AABB{ p, p } : AABB{
+					XMFLOAT3(fminf(tight.min.x, p.x), fminf(tight.min.y, p.y), fminf(tight.min.z, p.z)),
+					XMFLOAT3(fmaxf(tight.max.x, p.x), fmaxf(tight.max.y, p.y), fmaxf(tight.max.z, p.z)) };
+
+				bool inBox =
+					p.x >= worldBox.min.x - tolerance && p.x <= worldBox.max.x + tolerance &&
+					p.y >= worldBox.min.y - tolerance && p.y <= worldBox.max.y + tolerance &&
+					p.z >= worldBox.min.z - tolerance && p.z <= worldBox.max.z + tolerance;
+				float dx = p.x - worldSphere.center.x, dy = p.y - worldSphere.center.y, dz = p.z - worldSphere.center.z;
+				bool inSphere = sqrtf(dx * dx + dy * dy + dz * dz) <= worldSphere.radius + tolerance;
+				if (!inBox || !inSphere)
+					outside++;
+			}
+
+			// How much looser the transformed box is than a tight one
+			double tightVolume = (double)(tight.max.x - tight.min.x) * (tight.max.y - tight.min.y) * (tight.max.z - tight.min.z);
+			double boxVolume = (double)(worldBox.max.x - worldBox.min.x) * (worldBox.max.y - worldBox.min.y) * (worldBox.max.z - worldBox.min.z);
+			boxVolumeRatio += tightVolume > 0 ? boxVolume / tightVolume : 1.0;
+		}
+
+		Check(outside == 0, "%s: %d transforms, %d vertices outside the box or sphere (box %.2fx the tight volume)",
+			name.c_str(), TransformCount, outside, boxVolumeRatio / TransformCount);
+	}
+}
@@ -0,0 +1,144 @@
+#include "Tests.h"
+#include "../EntityWorld.h"
+#include "../Transform.h"
+#include "../TransformSystem.h"
+
+#include <cstdio>
+
+namespace
+{
+	// Stand-ins for the render components, so the suite doesn't need
+	// RenderSystem (or Direct3D)
+	struct Index
+	{
+		int value;
+	};
+
+	struct Tag
+	{
+		int value;
+	};
+
+	// Counts live instances, so moves between archetypes and chunks
+	// can be checked for leaks and double destroys
+	struct Counted
+	{
+		static int live;
+		int value;
+
+		Counted(int v) : value(v) { live++; }
+		Counted(Counted&& other) : value(other.value) { live++; }
+		Counted(const Counted& other) : value(other.value) { live++; }
+		~Counted() { live--; }
+	};
+	int Counted::live = 0;
+}
+
+void Tests::RunEntityWorldTests()
+{
+	printf("--- EntityWorld ---\n");
+
+	// Destroy every third entity and tag every fifth from inside a query,
+	// through a command buffer, plus one created entity that's given
+	// components before it exists
+	{
+		const int EntityCount = 10000;
+		TransformSystem system(EntityCount);
+		EntityWorld world;
+		std::vector<EntityId> ids(EntityCount);
+		for (int i = 0; i < EntityCount; i++)
+		{
+			Transform transform(&system);
+			transform.SetPosition((float)i, 0.0f, 0.0f);
+			ids[i] = world.Create(std::move(transform), Index{ i });
+		}
+
+		EntityCommandBuffer commands;
+		world.ForEach<Transform, Index>([&](EntityId id, Transform&, Index& index)
+		{
+			if (index.value % 3 == 0)
+				commands.Destroy(id);
+			else if (index.value % 5 == 0)
+				commands.Add(id, Tag{ index.value });
+		});
+		EntityId created = commands.Create();
+		commands.Add(created, Index{ 12345 });
+		commands.Add(created, Tag{ 12345 });
+		commands.Remove<Tag>(created);
+		int countDuringQuery = world.GetCount();
+		commands.Playback(world);
+
+		Check(countDuringQuery == EntityCount && commands.IsEmpty(),
+			"Nothing changes until playback, which empties the buffer");
+
+		// Every survivor still has its own transform, which still knows
+		// where its owner lives after being moved between chunks
+		int expected = 0;
+		int tagged = 0;
+		int wrong = 0;
+		for (int i = 0; i < EntityCount; i++)
+		{
+			if (i % 3 == 0)
+			{
+				if (world.IsAlive(ids[i]) || world.Get<Transform>(ids[i]) != nullptr)
+					wrong++;
+				continue;
+			}
+			expected++;
+			Transform* transform = world.Get<Transform>(ids[i]);
+			Tag* tag = world.Get<Tag>(ids[i]);
+			bool ok = transform != nullptr
+				&& transform->GetPosition().x == (float)i
+				&& system.GetOwner(transform->GetHandle()) == transform
+				&& world.Get<Index>(ids[i])->value == i
+				&& (i % 5 == 0 ? tag != nullptr && tag->value == i : tag == nullptr);
+			if (!ok)
+				wrong++;
+			if (tag != nullptr)
+				tagged++;
+		}
+		Check(wrong == 0, "Destroyed entities are gone, survivors keep their components (%d wrong)", wrong);
+		Check(system.GetCount() == expected && world.GetCount() == expected + 1 &&
+			world.Count<Transform>() == expected && world.Count<Tag>() == tagged && world.Count<Index>() == expected + 1,
+			"Counts: %d alive, %d tagged, %d transforms in the system", world.GetCount(), tagged, system.GetCount());
+
+		// The created entity (in a slot freed by the destroys, so the old
+		// id must still read as dead) got its components, minus the removed one
+		int createdCount = 0;
+		world.ForEach<Index>([&](EntityId id, Index& index)
+		{
+			if (index.value == 12345)
+				createdCount += world.Has<Transform>(id) || world.Has<Tag>(id) ? 100 : 1;
+		});
+		Check(!world.IsAlive(ids[0]) && createdCount == 1,
+			"The created entity has only its remaining component, and the old id in its slot is dead");
+	}
+
+	// Components moved between archetypes and chunks, and destroyed
+	// with their entities or the world, are never leaked or destroyed twice
+	{
+		const int EntityCount = 5000;
+		std::vector<EntityId> ids(EntityCount);
+		{
+			EntityWorld world;
+			for (int i = 0; i < EntityCount; i++)
+				ids[i] = world.Create(Counted(i));
+			for (int i = 0; i < EntityCount; i += 2)
+				world.Add(ids[i], Tag{ i });
+			for (int i = 0; i < EntityCount; i += 7)
+				world.Destroy(ids[i]);
+
+			int wrong = 0;
+			for (int i = 0; i < EntityCount; i++)
+			{
+				Counted* counted = world.Get<Counted>(ids[i]);
+				if (i % 7 == 0 ? counted != nullptr : counted == nullptr || counted->value != i)
+					wrong++;
+			}
+			Check(wrong == 0 && Counted::live == world.Count<Counted>(),
+				"Components survive archetype moves and destroys (%d wrong, %d live for %d entities)",
+				wrong, Counted::live, world.Count<Counted>());
+		}
+		Check(Counted::live == 0, "Destroying the world destroys every component (%d left)", Counted::live);
+	}
+}
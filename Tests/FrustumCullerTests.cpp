@@ -0,0 +1,122 @@
+#include "Tests.h"
+#include "../FrustumCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+void Tests::RunFrustumCullerTests()
+{
+	printf("--- FrustumCuller ---\n");
+
+	// Boxes of all sizes scattered around a camera at the origin,
+	// turned a little to the side
+	const int ObjectCount = 100000;
+	std::mt19937 rng(2222);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.1f, 10.0f);
+	std::vector<AABB> boxes(ObjectCount);
+	for (AABB& box : boxes)
+	{
+		XMFLOAT3 center(position(rng), position(rng), position(rng));
+		XMFLOAT3 half(size(rng), size(rng), size(rng));
+		box.min = XMFLOAT3(center.x - half.x, center.y - half.y, center.z - half.z);
+		box.max = XMFLOAT3(center.x + half.x, center.y + half.y, center.z + half.z);
+	}
+	XMMATRIX view = XMMatrixInverse(nullptr, XMMatrixRotationRollPitchYaw(0.0f, 0.3f, 0.0f));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 400.0f);
+	XMFLOAT4 planes[6];
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+	Bounds::GetFrustumPlanes(viewProjection, planes);
+
+	// Box at a time: the corner furthest along each plane's normal has
+	// to be behind it.  The smallest of those distances says how close
+	// a box is to changing sides, so float rounding there is forgiven.
+	std::vector<unsigned char> expected(ObjectCount);
+	std::vector<float> margins(ObjectCount);
+	int expectedVisible = 0;
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		float margin = FLT_MAX;
+		for (int p = 0; p < 6; p++)
+		{
+			float x = planes[p].x >= 0.0f ? boxes[i].max.x : boxes[i].min.x;
+			float y = planes[p].y >= 0.0f ? boxes[i].max.y : boxes[i].min.y;
+			float z = planes[p].z >= 0.0f ? boxes[i].max.z : boxes[i].min.z;
+			margin = std::min(margin, planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w);
+		}
+		margins[i] = margin;
+		expected[i] = margin >= 0.0f;
+		expectedVisible += expected[i];
+	}
+
+	// Counts results that disagree with the reference (or go past count),
+	// and checks the returned count against the flags
+	auto countWrong = [&](const std::vector<unsigned char>& visible, int visibleCount, int count)
+	{
+		int wrong = 0;
+		int counted = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (visible[i] != expected[i] && fabsf(margins[i]) > 1e-3f)
+				wrong++;
+			counted += visible[i];
+		}
+		return wrong + (counted == visibleCount ? 0 : 1);
+	};
+
+	FrustumCuller culler;
+	culler.Reserve(ObjectCount);
+	for (const AABB& box : boxes)
+		culler.Add(box);
+	for (int threads : { 1, 4 })
+	{
+		std::vector<unsigned char> visible(ObjectCount, 2);
+		int visibleCount = culler.Cull(planes, visible.data(), threads);
+		int wrong = countWrong(visible, visibleCount, ObjectCount);
+		Check(wrong == 0 && visibleCount > 0 && visibleCount < ObjectCount,
+			"%d thread%s: %d of %d visible, matching box at a time (%d wrong)",
+			threads, threads == 1 ? "" : "s", visibleCount, ObjectCount, wrong);
+	}
+
+	// Every count around a group of four (so partial groups and
+	// ranges are covered), split as many ways as there are groups, and
+	// nothing written past the end
+	int edgeFailures = 0;
+	for (int count = 0; count <= 17; count++)
+	{
+		FrustumCuller small;
+		for (int i = 0; i < count; i++)
+			small.Add(boxes[i]);
+		for (int threads = 1; threads <= 5; threads++)
+		{
+			std::vector<unsigned char> smallVisible(count + 1, 2);
+			int smallCount = small.Cull(planes, smallVisible.data(), threads);
+			if (countWrong(smallVisible, smallCount, count) != 0 || smallVisible[count] != 2)
+				edgeFailures++;
+		}
+	}
+	Check(edgeFailures == 0, "0 to 17 boxes on 1 to 5 threads (%d wrong)", edgeFailures);
+
+	// Refilling after Clear() starts over from index 0
+	culler.Clear();
+	int first = culler.Add(boxes[0]);
+	Check(first == 0 && culler.GetCount() == 1, "Clear() empties the culler");
+
+	// Unbounded boxes are never culled, even alongside ones that are
+	FrustumCuller unbounded;
+	AABB behind;
+	behind.min = XMFLOAT3(-1.0f, -1.0f, -20.0f);
+	behind.max = XMFLOAT3(1.0f, 1.0f, -10.0f);
+	unbounded.Add(behind);
+	unbounded.AddUnbounded();
+	unsigned char unboundedVisible[2] = { 2, 2 };
+	int unboundedCount = unbounded.Cull(planes, unboundedVisible);
+	Check(unboundedCount == 1 && unboundedVisible[0] == 0 && unboundedVisible[1] == 1,
+		"Unbounded boxes are always visible, a box behind the camera isn't");
+}
@@ -0,0 +1,124 @@
+#include "Tests.h"
+#include "../InstanceBatcher.h"
+#include "../RenderQueue.h"
+#include "../Transform.h"
+#include "../TransformSystem.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace DirectX;
+
+void Tests::RunInstanceBatcherTests()
+{
+	printf("--- InstanceBatcher ---\n");
+
+	// Stand-in shaders and meshes, since nothing is submitted - and
+	// enough objects for Build() to split the packing into jobs
+	const int EntityCount = 50000;
+	const int MeshCount = 8, MaterialCount = 6, LodCount = 3;
+	char shaderStandIns[3];
+	std::vector<Material*> materials;
+	for (int m = 0; m < MaterialCount; m++)
+	{
+		materials.push_back(new Material(
+			XMFLOAT4(1.0f, 0.5f + m * 0.1f, 1.0f, 1.0f), 0.5f,
+			(SimplePixelShader*)&shaderStandIns[0],
+			(SimpleVertexShader*)&shaderStandIns[1],
+			nullptr, nullptr, nullptr, nullptr, nullptr));
+		materials.back()->SetInstancedVertexShader((SimpleVertexShader*)&shaderStandIns[2]);
+	}
+	std::vector<Mesh*> meshes;
+	for (int m = 0; m < MeshCount; m++)
+		meshes.push_back(new Mesh());
+
+	// Objects scattered around, each with a mesh, material and LOD
+	struct Object { int mesh; int material; unsigned int indexCount; float depth; int handle; };
+	TransformSystem system(EntityCount);
+	std::vector<Transform*> transforms(EntityCount);
+	std::vector<Object> objects(EntityCount);
+	std::mt19937 rng(2121);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	for (int i = 0; i < EntityCount; i++)
+	{
+		transforms[i] = new Transform(&system);
+		transforms[i]->SetPosition(position(rng), position(rng), position(rng));
+		transforms[i]->SetRotation(0.0f, position(rng), 0.0f);
+		objects[i] = { (int)(rng() % MeshCount), (int)(rng() % MaterialCount), 36u << (rng() % LodCount), position(rng) + 100.0f, transforms[i]->GetHandle() };
+	}
+	system.Update();
+
+	InstanceBatcher batcher;
+	for (int i = 0; i < EntityCount; i++)
+	{
+		const Object& o = objects[i];
+		batcher.Add(meshes[o.mesh], materials[o.material], o.indexCount, 0, &system.GetWorldMatrix(o.handle), o.depth);
+	}
+	batcher.Build();
+
+	const std::vector<InstanceGroup>& groups = batcher.GetGroups();
+	const std::vector<InstanceData>& instances = batcher.GetInstances();
+	bool tiled = true;
+	int nextInstance = 0;
+	for (const InstanceGroup& group : groups)
+	{
+		tiled = tiled && group.firstInstance == nextInstance && group.instanceCount > 0;
+		nextInstance += group.instanceCount;
+	}
+	Check((int)instances.size() == EntityCount && nextInstance == EntityCount && tiled && (int)groups.size() <= MeshCount * MaterialCount * LodCount,
+		"%d instances in %d groups, packed back to back", (int)instances.size(), (int)groups.size());
+
+	// Every object in the slice of the group matching it, in the order
+	// they were added, with its own matrix and its material's tint
+	std::vector<int> cursors(groups.size());
+	for (size_t g = 0; g < groups.size(); g++)
+		cursors[g] = groups[g].firstInstance;
+	int misplaced = 0;
+	int wrongData = 0;
+	for (int i = 0; i < EntityCount; i++)
+	{
+		const Object& o = objects[i];
+		int g = 0;
+		while (g < (int)groups.size() && !(groups[g].mesh == meshes[o.mesh] && groups[g].material == materials[o.material] && groups[g].indexCount == o.indexCount))
+			g++;
+		if (g == (int)groups.size() || cursors[g] >= groups[g].firstInstance + groups[g].instanceCount)
+		{
+			misplaced++;
+			continue;
+		}
+
+		const InstanceData& data = instances[cursors[g]++];
+		XMFLOAT4 tint = materials[o.material]->GetColorTint();
+		if (memcmp(&data.worldMatrix, &system.GetWorldMatrix(o.handle), sizeof(XMFLOAT4X4)) != 0 ||
+			memcmp(&data.colorTint, &tint, sizeof(XMFLOAT4)) != 0 ||
+			groups[g].depth > o.depth)
+			wrongData++;
+	}
+	Check(misplaced == 0, "Each object lands in its group's slice, in the order added (%d misplaced)", misplaced);
+	Check(wrongData == 0, "Each instance has its object's matrix and its material's tint (%d wrong)", wrongData);
+
+	// Queued as instanced draws, every object is still drawn once
+	RenderQueue queue;
+	for (const InstanceGroup& group : groups)
+	{
+		queue.AddInstanced(OpaquePass, group.mesh, group.material, group.indexCount, group.firstIndex,
+			group.firstInstance, group.instanceCount, group.depth);
+	}
+	queue.Sort();
+	RenderQueueStats stats = RenderQueue::CountStateChanges(queue.GetPackets().data(), (int)queue.GetPackets().size(), true);
+	Check(stats.draws == (int)groups.size() && stats.instances == EntityCount,
+		"Queued: %d draws for %d objects", stats.draws, stats.instances);
+
+	// Cleared, nothing from the last frame is left over
+	batcher.Clear();
+	batcher.Build();
+	Check(batcher.GetGroups().empty() && batcher.GetInstances().empty(), "Clear() empties the batcher");
+
+	for (Transform* t : transforms)
+		delete t;
+	for (Material* m : materials)
+		delete m;
+	for (Mesh* m : meshes)
+		delete m;
+}
@@ -0,0 +1,284 @@
+#include "Tests.h"
+#include "../JobSystem.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+
+void Tests::RunJobSystemTests()
+{
+	printf("--- JobSystem ---\n");
+
+	// ParallelFor(), lots of tiny jobs and ParallelFor()s inside a
+	// ParallelFor(), from no workers up to more than the cores
+	const int ElementCount = 1 << 18;
+	auto work = [](int i)
+	{
+		float x = (float)(i % 1000) * 0.001f;
+		for (int k = 0; k < 4; k++)
+			x = sqrtf(x * x + 1.0f) * 0.5f;
+		return x;
+	};
+	std::vector<float> expected(ElementCount);
+	long long expectedSum = 0;
+	for (int i = 0; i < ElementCount; i++)
+	{
+		expected[i] = work(i);
+		expectedSum += (long long)(expected[i] * 1000.0f);
+	}
+
+	for (int workerCount : { 0, 1, 3, 7 })
+	{
+		JobSystem jobs(workerCount);
+
+		std::vector<float> results(ElementCount, -1.0f);
+		jobs.ParallelFor(ElementCount, 1024, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				results[i] = work(i);
+		});
+
+		const int TinyJobCount = 20000;
+		std::atomic<int> ran(0);
+		JobCounter counter;
+		for (int i = 0; i < TinyJobCount; i++)
+			jobs.Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		jobs.Wait(counter);
+
+		const int OuterCount = 32;
+		std::atomic<long long> nestedSum(0);
+		jobs.ParallelFor(OuterCount, 1, [&](int outerBegin, int outerEnd)
+		{
+			for (int o = outerBegin; o < outerEnd; o++)
+			{
+				int first = (int)((long long)ElementCount * o / OuterCount);
+				int last = (int)((long long)ElementCount * (o + 1) / OuterCount);
+				jobs.ParallelFor(last - first, 256, [&](int begin, int end)
+				{
+					long long sum = 0;
+					for (int i = first + begin; i < first + end; i++)
+						sum += (long long)(work(i) * 1000.0f);
+					nestedSum.fetch_add(sum, std::memory_order_relaxed);
+				});
+			}
+		});
+
+		// Ranges cover everything once, in order
+		const int RangeCount = 5;
+		std::vector<int> rangeBegins(RangeCount, -1), rangeEnds(RangeCount, -1);
+		jobs.ParallelRanges(ElementCount, RangeCount, [&](int range, int begin, int end)
+		{
+			rangeBegins[range] = begin;
+			rangeEnds[range] = end;
+		});
+		bool rangesMatch = rangeBegins[0] == 0 && rangeEnds[RangeCount - 1] == ElementCount;
+		for (int r = 1; r < RangeCount; r++)
+			rangesMatch = rangesMatch && rangeBegins[r] == rangeEnds[r - 1];
+
+		Check(results == expected && ran.load() == TinyJobCount && nestedSum.load() == expectedSum && rangesMatch,
+			"%d worker%s: ParallelFor, %d tiny jobs, nested ParallelFor and ParallelRanges match one thread",
+			workerCount, workerCount == 1 ? "" : "s", TinyJobCount);
+
+		// A count that isn't a multiple of the grain still never
+		// produces a piece smaller than it
+		const int PieceCount = 100003;
+		const int PieceGrain = 1000;
+		std::atomic<int> smallestPiece(PieceCount);
+		std::atomic<int> covered(0);
+		jobs.ParallelFor(PieceCount, PieceGrain, [&](int begin, int end)
+		{
+			int size = end - begin;
+			int smallest = smallestPiece.load();
+			while (size < smallest && !smallestPiece.compare_exchange_weak(smallest, size))
+				;
+			covered.fetch_add(size);
+		});
+		Check(smallestPiece.load() >= PieceGrain && covered.load() == PieceCount,
+			"%d worker%s: ParallelFor pieces no smaller than the grain (smallest %d of %d)",
+			workerCount, workerCount == 1 ? "" : "s", smallestPiece.load(), PieceGrain);
+	}
+
+	// One owner pushing and popping while three thieves steal - every
+	// item has to come out exactly once
+	{
+		const int ItemCount = 200000;
+		std::unique_ptr<WorkStealingQueue> queue(new WorkStealingQueue());
+		std::vector<Job> items(ItemCount);
+		std::vector<std::atomic<int>> taken(ItemCount);
+		for (std::atomic<int>& t : taken)
+			t.store(0);
+		auto take = [&](Job* job)
+		{
+			taken[job - items.data()].fetch_add(1);
+		};
+		std::atomic<bool> ownerDone(false);
+		std::vector<std::thread> thieves;
+		for (int t = 0; t < 3; t++)
+		{
+			thieves.emplace_back([&]()
+			{
+				while (!ownerDone.load() || !queue->IsEmpty())
+				{
+					Job* job = queue->Steal();
+					if (job != nullptr)
+						take(job);
+				}
+			});
+		}
+		std::mt19937 rng(2525);
+		int pushed = 0;
+		while (pushed < ItemCount)
+		{
+			int burst = std::min(ItemCount - pushed, 1 + (int)(rng() % 64));
+			for (int i = 0; i < burst; i++)
+			{
+				if (queue->Push(&items[pushed]))
+					pushed++;
+			}
+			int pops = (int)(rng() % 48);
+			for (int i = 0; i < pops; i++)
+			{
+				Job* job = queue->Pop();
+				if (job != nullptr)
+					take(job);
+			}
+		}
+		while (Job* job = queue->Pop())
+			take(job);
+		ownerDone.store(true);
+		for (std::thread& t : thieves)
+			t.join();
+		int wrong = 0;
+		for (std::atomic<int>& t : taken)
+			wrong += t.load() != 1;
+		Check(wrong == 0, "Owner vs 3 thieves: %d items, each taken once (%d wrong)", ItemCount, wrong);
+	}
+
+	// The rest on more workers than cores, so threads get switched out
+	// at the worst moments
+	JobSystem jobs(6);
+
+	// Every job spawning two more, down to a depth of 12
+	const int SpawnDepth = 12;
+	std::atomic<int> spawned(0);
+	JobCounter spawnCounter;
+	std::function<void(int)> spawn = [&](int depth)
+	{
+		spawned.fetch_add(1, std::memory_order_relaxed);
+		if (depth == 0)
+			return;
+		jobs.Run([&spawn, depth]() { spawn(depth - 1); }, &spawnCounter);
+		jobs.Run([&spawn, depth]() { spawn(depth - 1); }, &spawnCounter);
+	};
+	jobs.Run([&spawn]() { spawn(SpawnDepth); }, &spawnCounter);
+	jobs.Wait(spawnCounter);
+	Check(spawned.load() == (1 << (SpawnDepth + 1)) - 1, "Jobs spawning jobs: %d ran", spawned.load());
+
+	// A chain of stages, each job in one only starting after every job
+	// in the one before has finished
+	{
+		const int StageCount = 200;
+		const int JobsPerStage = 8;
+		std::vector<std::unique_ptr<JobCounter>> stages;
+		std::vector<std::atomic<int>> finished(StageCount);
+		for (std::atomic<int>& f : finished)
+			f.store(0);
+		std::atomic<int> outOfOrder(0);
+		for (int s = 0; s < StageCount; s++)
+		{
+			stages.emplace_back(new JobCounter());
+			JobCounter* after = s > 0 ? stages[s - 1].get() : nullptr;
+			for (int j = 0; j < JobsPerStage; j++)
+			{
+				jobs.Run([&finished, &outOfOrder, s]()
+				{
+					if (s > 0 && finished[s - 1].load() != JobsPerStage)
+						outOfOrder.fetch_add(1);
+					finished[s].fetch_add(1);
+				}, stages[s].get(), after);
+			}
+		}
+		jobs.Wait(*stages.back());
+		int unfinished = 0;
+		for (std::atomic<int>& f : finished)
+			unfinished += f.load() != JobsPerStage;
+		Check(outOfOrder.load() == 0 && unfinished == 0,
+			"%d dependent stages of %d jobs, in order (%d out of order)", StageCount, JobsPerStage, outOfOrder.load());
+	}
+
+	// Outside threads all queueing (and waiting) at once, alongside
+	// a ParallelFor from this one
+	{
+		const int ProducerCount = 4;
+		const int JobsPerProducer = 5000;
+		std::atomic<int> produced(0);
+		std::vector<std::thread> producers;
+		for (int p = 0; p < ProducerCount; p++)
+		{
+			producers.emplace_back([&]()
+			{
+				JobCounter counter;
+				for (int i = 0; i < JobsPerProducer; i++)
+					jobs.Run([&produced]() { produced.fetch_add(1, std::memory_order_relaxed); }, &counter);
+				jobs.Wait(counter);
+			});
+		}
+		std::atomic<int> covered(0);
+		jobs.ParallelFor(ElementCount, 64, [&](int begin, int end) { covered.fetch_add(end - begin); });
+		for (std::thread& t : producers)
+			t.join();
+		Check(produced.load() == ProducerCount * JobsPerProducer && covered.load() == ElementCount,
+			"%d outside threads x %d jobs, plus a ParallelFor", ProducerCount, JobsPerProducer);
+	}
+
+	// A background job is never picked up by a thread waiting on other
+	// work - here the only worker is busy, so everything this thread
+	// waits on runs here, and the background job has to wait for it
+	{
+		JobSystem single(1);
+		std::atomic<bool> busy(false), release(false), backgroundRan(false);
+		std::thread::id backgroundThread;
+		JobCounter blocker, background, frame;
+		single.Run([&]()
+		{
+			busy.store(true);
+			while (!release.load())
+				std::this_thread::yield();
+		}, &blocker);
+		while (!busy.load())
+			std::this_thread::yield();
+
+		single.RunBackground([&]()
+		{
+			backgroundThread = std::this_thread::get_id();
+			backgroundRan.store(true);
+		}, &background);
+		std::atomic<int> frameWork(0);
+		for (int i = 0; i < 100; i++)
+			single.Run([&frameWork]() { frameWork.fetch_add(1); }, &frame);
+		single.Wait(frame);
+		single.ParallelFor(1000, 10, [&](int begin, int end) { frameWork.fetch_add(end - begin); });
+		bool ranDuringFrame = backgroundRan.load();
+
+		release.store(true);
+		single.Wait(background);
+		single.Wait(blocker);
+		Check(!ranDuringFrame && frameWork.load() == 1100 && backgroundRan.load() && backgroundThread != std::this_thread::get_id(),
+			"Background jobs are left to idle workers, not threads waiting on other jobs");
+	}
+
+	// With no workers, waiting on one has to ask to run it
+	{
+		JobSystem none(0);
+		std::atomic<int> ran(0);
+		JobCounter background;
+		none.RunBackground([&ran]() { ran.fetch_add(1); }, &background);
+		bool ranEarly = none.TryRunJob();
+		none.Wait(background, true);
+		Check(!ranEarly && ran.load() == 1, "Without workers, Wait(counter, true) runs background jobs");
+	}
+}
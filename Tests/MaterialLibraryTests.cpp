@@ -0,0 +1,266 @@
+#include "Tests.h"
+#include "../MaterialLibrary.h"
+#include "../MeshCache.h"
+#include "../ObjLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace
+{
+	std::string GetTempPath(const char* fileName)
+	{
+		return (std::filesystem::temp_directory_path() / fileName).string();
+	}
+
+	// Copies an OBJ, switching between the "red" and "blue" materials
+	// every few faces so each material's faces are scattered through
+	// the file - returns false if either file couldn't be opened
+	bool WriteInterleavedCopy(const std::string& source, const std::string& copy, const char* mtlName, int expectedTriangles[2])
+	{
+		const int FacesPerRun = 37;
+		std::ifstream in(source);
+		std::ofstream out(copy, std::ios::binary);
+		if (!in.is_open() || !out.is_open())
+			return false;
+
+		out << "mtllib " << mtlName << "\n";
+		expectedTriangles[0] = 0;
+		expectedTriangles[1] = 0;
+		int faces = 0;
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (line.size() > 1 && line[0] == 'f' && line[1] == ' ')
+			{
+				int run = faces++ / FacesPerRun;
+				if (faces % FacesPerRun == 1)
+					out << "g part" << run << "\nusemtl " << (run % 2 == 0 ? "red" : "blue") << "\n";
+
+				int corners = 0;
+				for (size_t p = 1; p < line.size(); )
+				{
+					while (p < line.size() && (line[p] == ' ' || line[p] == '\t'))
+						p++;
+					if (p >= line.size() || line[p] == '\r')
+						break;
+					corners++;
+					while (p < line.size() && line[p] != ' ' && line[p] != '\t' && line[p] != '\r')
+						p++;
+				}
+				expectedTriangles[run % 2] += std::max(corners - 2, 0);
+			}
+			out << line << "\n";
+		}
+		return true;
+	}
+
+	void WriteFile(const std::string& fileName, const char* contents)
+	{
+		std::ofstream file(fileName, std::ios::binary);
+		file << contents;
+	}
+
+	void RemoveFiles(std::initializer_list<std::string> fileNames)
+	{
+		std::error_code error;
+		for (const std::string& fileName : fileNames)
+			std::filesystem::remove(fileName, error);
+	}
+
+	// Size of the texture behind a shader resource view (0 if there isn't one)
+	UINT GetTextureWidth(ID3D11ShaderResourceView* srv)
+	{
+		if (srv == nullptr)
+			return 0;
+		Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		srv->GetResource(resource.GetAddressOf());
+		if (FAILED(resource.As(&texture)))
+			return 0;
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
+		return desc.Width;
+	}
+}
+
+void Tests::RunMaterialGroupTests()
+{
+	printf("--- OBJ material groups ---\n");
+
+	std::string testFileName = GetTempPath("MaterialGroupTest.obj");
+	std::string mtlFileName = GetTempPath("MaterialGroupTest.mtl");
+	int expectedTriangles[2];
+	if (!Check(WriteInterleavedCopy(GetMeshPath("sphere.obj"), testFileName, "MaterialGroupTest.mtl", expectedTriangles),
+		"sphere.obj copied with interleaved materials"))
+		return;
+	WriteFile(mtlFileName,
+		"newmtl red\nKd 1 0 0\nNs 98\nmap_Kd -s 1 1 1 red albedo.png\n\n"
+		"newmtl blue\n  Kd 0 0 1\n  d 0.5\n  Pr 0.25\n  Pm 1\n  norm blue_normal.png\n");
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	std::vector<ObjSubmesh> submeshes;
+	std::vector<std::string> libraries;
+	ObjLoader::Load(testFileName.c_str(), verts, indices, &submeshes, &libraries);
+
+	if (Check(submeshes.size() == 2, "%d submeshes (2 expected)", (int)submeshes.size()))
+	{
+		Check(submeshes[0].material == "red" && submeshes[1].material == "blue", "Materials in first-use order");
+		Check(submeshes[0].name == "part0" && submeshes[1].name == "part1", "Submesh names from the groups");
+		Check(submeshes[0].firstIndex == 0 && submeshes[1].firstIndex == submeshes[0].indexCount &&
+			submeshes[1].firstIndex + submeshes[1].indexCount == (int)indices.size(), "Ranges cover the indices back to back");
+		Check(submeshes[0].indexCount == expectedTriangles[0] * 3 && submeshes[1].indexCount == expectedTriangles[1] * 3,
+			"Triangles per material: %d + %d (%d + %d expected)",
+			submeshes[0].indexCount / 3, submeshes[1].indexCount / 3, expectedTriangles[0], expectedTriangles[1]);
+	}
+	Check(libraries.size() == 1 && std::filesystem::path(libraries[0]).filename() == "MaterialGroupTest.mtl",
+		"Material library resolved next to the OBJ");
+
+	// Material parameters
+	std::vector<ObjMaterial> materials;
+	if (Check(ObjLoader::LoadMaterials(mtlFileName.c_str(), materials) && materials.size() == 2, "Two materials parsed"))
+	{
+		const ObjMaterial& red = materials[0];
+		const ObjMaterial& blue = materials[1];
+		Check(red.name == "red" && red.diffuseColor.x == 1.0f && red.diffuseColor.z == 0.0f && red.opacity == 1.0f, "red: color");
+		Check(fabsf(red.roughness - sqrtf(2.0f / 100.0f)) < 1e-5f && red.metalness == 0.0f, "red: roughness from Ns");
+		Check(std::filesystem::path(red.diffuseMap).filename() == "albedo.png", "red: albedo map (after its options)");
+		Check(blue.name == "blue" && blue.diffuseColor.z == 1.0f && blue.opacity == 0.5f, "blue: color");
+		Check(blue.roughness == 0.25f && blue.metalness == 1.0f, "blue: roughness and metalness");
+		Check(!blue.normalMap.empty() && blue.diffuseMap.empty(), "blue: normal map only");
+	}
+
+	// Full cook (optimize, tangents, per-submesh LODs), then again from the cache
+	RemoveFiles({ MeshCache::GetCachePath(testFileName.c_str()) });
+	MeshData cooked;
+	MeshData cached;
+	Check(Mesh::LoadData(testFileName.c_str(), false, cooked), "Cold load");
+	Check(Mesh::LoadData(testFileName.c_str(), false, cached), "Cached load");
+
+	int submeshCount = (int)cooked.submeshNames.size();
+	int lodCount = (int)cooked.lods.size();
+	std::vector<unsigned int> lodIndices = cooked.indices.empty() ?
+		std::vector<unsigned int>(cooked.shortIndices.begin(), cooked.shortIndices.end()) : cooked.indices;
+	if (Check(submeshCount == 2 && (int)cooked.submeshLods.size() == lodCount * submeshCount,
+		"Submesh LOD table: %d ranges for %d LODs", (int)cooked.submeshLods.size(), lodCount))
+	{
+		// LOD 0 claims each vertex for a material, and coarser
+		// levels may only use vertices their material owns
+		std::vector<unsigned char> ownerVertex(cooked.verts.size(), 0);
+		int untiledLods = 0;
+		int grownSubmeshes = 0;
+		int borrowedVertices = 0;
+		for (int l = 0; l < lodCount; l++)
+		{
+			const MeshLod* ranges = &cooked.submeshLods[l * submeshCount];
+			if (ranges[0].firstIndex != cooked.lods[l].firstIndex ||
+				ranges[1].firstIndex != ranges[0].firstIndex + ranges[0].indexCount ||
+				ranges[0].indexCount + ranges[1].indexCount != cooked.lods[l].indexCount)
+				untiledLods++;
+
+			for (int s = 0; s < submeshCount; s++)
+			{
+				if (l > 0 && ranges[s].indexCount > cooked.submeshLods[(l - 1) * submeshCount + s].indexCount)
+					grownSubmeshes++;
+
+				for (int i = ranges[s].firstIndex; i < ranges[s].firstIndex + ranges[s].indexCount; i++)
+				{
+					unsigned char& owner = ownerVertex[lodIndices[i]];
+					if (l == 0)
+						owner |= (unsigned char)(1 << s);
+					else if ((owner & (1 << s)) == 0)
+						borrowedVertices++;
+				}
+			}
+		}
+		Check(untiledLods == 0, "Submeshes tile every LOD (%d don't)", untiledLods);
+		Check(grownSubmeshes == 0, "Submeshes never grow from one LOD to the next (%d do)", grownSubmeshes);
+		Check(borrowedVertices == 0, "LODs only use their own submesh's vertices (%d corners don't)", borrowedVertices);
+
+		Check(cached.submeshLods.size() == cooked.submeshLods.size() &&
+			memcmp(cached.submeshLods.data(), cooked.submeshLods.data(), cooked.submeshLods.size() * sizeof(MeshLod)) == 0,
+			"Cache keeps the submesh LODs");
+		Check(cached.submeshNames == cooked.submeshNames && cached.submeshMaterials == cooked.submeshMaterials &&
+			cached.materialLibraries == cooked.materialLibraries, "Cache keeps names, materials and libraries");
+	}
+
+	RemoveFiles({ MeshCache::GetCachePath(testFileName.c_str()), testFileName, mtlFileName });
+}
+
+void Tests::RunMaterialLibraryTests()
+{
+	printf("--- MaterialLibrary ---\n");
+
+	// WARP - a software device, so this runs without a GPU
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	HRESULT created = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0,
+		D3D11_SDK_VERSION, device.GetAddressOf(), nullptr, context.GetAddressOf());
+	if (!Check(SUCCEEDED(created), "WARP device created"))
+		return;
+
+	// The WIC texture loader needs COM
+	HRESULT comInitialized = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	// Both materials use the same real texture, blue's normal map is
+	// missing and "unknown" isn't in the library at all
+	std::string texturePath = std::filesystem::absolute(GetMeshPath("../textures/wood_albedo.png")).lexically_normal().string();
+	std::string objFileName = GetTempPath("MaterialLibraryTest.obj");
+	std::string mtlFileName = GetTempPath("MaterialLibraryTest.mtl");
+	WriteFile(mtlFileName, (
+		"newmtl red\nKd 1 0 0\nmap_Kd " + texturePath + "\n\n"
+		"newmtl blue\nKd 0 0 1\nd 0.5\nmap_Kd " + texturePath + "\nnorm missing_normal.png\n").c_str());
+	WriteFile(objFileName,
+		"mtllib MaterialLibraryTest.mtl\n"
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+		"usemtl blue\nf 1/1/1 2/1/1 3/1/1\n"
+		"usemtl unknown\nf 1/1/1 3/1/1 4/1/1\n");
+
+	{
+		Mesh mesh(objFileName.c_str(), device);
+		MaterialLibrary library(mesh.GetMaterialLibraries(), nullptr, nullptr, nullptr, device, context);
+
+		if (Check(library.GetMaterialCount() == 2, "%d materials from the mesh's MTL file (2 expected)", library.GetMaterialCount()))
+		{
+			Material* red = library.Find("red");
+			Material* blue = library.Find("blue");
+			Check(red == library.GetMaterial(0) && blue == library.GetMaterial(1) && library.Find("unknown") == nullptr,
+				"Find() by name, null for unknown names");
+
+			XMFLOAT4 redTint = red->GetColorTint();
+			XMFLOAT4 blueTint = blue->GetColorTint();
+			Check(redTint.x == 1.0f && redTint.z == 0.0f && redTint.w == 1.0f && blueTint.z == 1.0f && blueTint.w == 0.5f,
+				"Tints from Kd and d");
+
+			bool allTextures = true;
+			for (int m = 0; m < library.GetMaterialCount(); m++)
+			{
+				Material* material = library.GetMaterial(m);
+				allTextures = allTextures && material->GetSRV() != nullptr && material->GetNormalSRV() != nullptr &&
+					material->GetRoughnessSRV() != nullptr && material->GetMetalnessSRV() != nullptr;
+			}
+			Check(allTextures, "Every material has all four textures");
+
+			Check(red->GetSRV() == blue->GetSRV() && GetTextureWidth(red->GetSRV()) > 1,
+				"Shared albedo map loaded once (%u pixels wide)", GetTextureWidth(red->GetSRV()));
+			Check(red->GetNormalSRV() == blue->GetNormalSRV() && GetTextureWidth(blue->GetNormalSRV()) == 1,
+				"Missing normal map falls back to the shared flat normal");
+
+			Material fallback(XMFLOAT4(1, 1, 1, 1), 0.0f, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+			std::vector<Material*> submeshMaterials = library.GetSubmeshMaterials(&mesh, &fallback);
+			Check(submeshMaterials.size() == 2 && submeshMaterials[0] == blue && submeshMaterials[1] == &fallback,
+				"Submesh materials: the named one, then the fallback");
+		}
+	}
+
+	RemoveFiles({ MeshCache::GetCachePath(objFileName.c_str()), objFileName, mtlFileName });
+	if (SUCCEEDED(comInitialized))
+		CoUninitialize();
+}
@@ -0,0 +1,93 @@
+#include "Tests.h"
+#include "../MeshCache.h"
+#include "../ObjLoader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	MeshCacheHeader ReadHeader(const std::string& cachePath)
+	{
+		MeshCacheHeader header = {};
+		std::ifstream in(cachePath, std::ios::binary);
+		in.read((char*)&header, sizeof(header));
+		return header;
+	}
+
+	int64_t GetTimestamp(const std::string& fileName)
+	{
+		return (int64_t)std::filesystem::last_write_time(fileName).time_since_epoch().count();
+	}
+}
+
+void Tests::RunMeshCacheTests()
+{
+	printf("--- MeshCache ---\n");
+
+	// Work on a copy, since the test touches and edits the source
+	std::string sourcePath = (std::filesystem::temp_directory_path() / "MeshCacheTest.obj").string();
+	std::string cachePath = MeshCache::GetCachePath(sourcePath.c_str());
+	std::error_code error;
+	std::filesystem::copy_file(GetMeshPath("sphere.obj"), sourcePath, std::filesystem::copy_options::overwrite_existing, error);
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!Check(!error && ObjLoader::Load(sourcePath.c_str(), verts, indices), "Loaded a copy of sphere.obj"))
+		return;
+
+	MeshLod lod = { 0, (int)indices.size(), 0.0f };
+	std::string name = "sphere";
+	std::string material;
+	bool written = MeshCache::Write(sourcePath.c_str(), &verts[0], (int)verts.size(), &indices[0], (int)indices.size(),
+		&lod, 1, &lod, 1, &name, &material, nullptr, 0);
+
+	{
+		MeshCache cache(sourcePath.c_str());
+		Check(written && cache.IsValid() &&
+			cache.GetVertexCount() == (int)verts.size() &&
+			cache.GetIndexCount() == (int)indices.size() &&
+			memcmp(cache.GetVertices(), &verts[0], verts.size() * sizeof(Vertex)) == 0 &&
+			memcmp(cache.GetIndices(), &indices[0], indices.size() * sizeof(unsigned int)) == 0 &&
+			strcmp(cache.GetSubmeshName(0), "sphere") == 0,
+			"Written cache reads back the same vertices, indices and names");
+	}
+
+	// Touch the source - same bytes, later timestamp
+	std::filesystem::last_write_time(sourcePath, std::filesystem::last_write_time(sourcePath) + std::chrono::hours(1));
+	{
+		MeshCache cache(sourcePath.c_str());
+		Check(cache.IsValid(), "Cache still valid after the source is only touched");
+	}
+	Check(ReadHeader(cachePath).sourceTimestamp == GetTimestamp(sourcePath),
+		"Header's source timestamp updated after the hash matched");
+
+	// Same size, different contents
+	{
+		std::fstream source(sourcePath, std::ios::binary | std::ios::in | std::ios::out);
+		char first = (char)source.get();
+		source.seekp(0);
+		source.put(first == '#' ? ' ' : '#');
+	}
+	std::filesystem::last_write_time(sourcePath, std::filesystem::last_write_time(sourcePath) + std::chrono::hours(1));
+	{
+		MeshCache cache(sourcePath.c_str());
+		Check(!cache.IsValid(), "Cache rejected after the source's contents change");
+	}
+
+	// Different size
+	{
+		std::ofstream source(sourcePath, std::ios::binary | std::ios::app);
+		source << "\n";
+	}
+	{
+		MeshCache cache(sourcePath.c_str());
+		Check(!cache.IsValid(), "Cache rejected after the source's size changes");
+	}
+
+	std::filesystem::remove(sourcePath, error);
+	std::filesystem::remove(cachePath, error);
+}
@@ -0,0 +1,80 @@
+#include "Tests.h"
+#include "../MeshLoader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <thread>
+
+void Tests::RunMeshLoaderTests()
+{
+	printf("--- MeshLoader ---\n");
+
+	// No device - nothing is ever uploaded, so every load is still
+	// pending when the loader goes away
+	std::vector<MeshHandle> handles;
+	{
+		MeshLoader loader(nullptr, 2);
+
+		// Several threads asking for the same files at once
+		const int ThreadCount = 4;
+		std::vector<std::vector<MeshHandle>> perThread(ThreadCount);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < ThreadCount; t++)
+		{
+			threads.push_back(std::thread([&, t]()
+			{
+				for (const std::string& name : GetMeshFileNames())
+					perThread[t].push_back(loader.LoadAsync(GetMeshPath(name.c_str()).c_str()));
+			}));
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		bool shared = true;
+		for (int t = 1; t < ThreadCount; t++)
+			for (size_t i = 0; i < perThread[t].size(); i++)
+				shared = shared && perThread[t][i].mesh == perThread[0][i].mesh;
+		handles = perThread[0];
+
+		Check(shared && loader.GetPendingCount() == (int)handles.size(),
+			"%d threads asking for the same %d files get the same meshes (%d pending)",
+			ThreadCount, (int)handles.size(), loader.GetPendingCount());
+	}
+
+	// Queued and cooked requests alike must be answered, not broken
+	int answered = 0;
+	int broken = 0;
+	for (MeshHandle& handle : handles)
+	{
+		if (handle.ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			continue;
+		try
+		{
+			if (handle.ready.get() == nullptr)
+				answered++;
+		}
+		catch (const std::future_error&)
+		{
+			broken++;
+		}
+	}
+	Check(answered == (int)handles.size() && broken == 0,
+		"Destroying the loader answers every pending load with nullptr (%d of %d, %d broken promises)",
+		answered, (int)handles.size(), broken);
+
+	// The caller owns the meshes
+	for (MeshHandle& handle : handles)
+		delete handle.mesh;
+
+	// A file that can't be loaded is answered with nullptr too, not
+	// with a mesh that looks like it's ready
+	{
+		MeshLoader loader(nullptr, 1);
+		MeshHandle missing = loader.LoadAsync(GetMeshPath("does_not_exist.obj").c_str());
+		loader.WaitAll();
+		Check(missing.ready.get() == nullptr && !missing.mesh->IsResident() && loader.GetPendingCount() == 0,
+			"A load that fails answers with nullptr");
+		delete missing.mesh;
+	}
+}
@@ -0,0 +1,81 @@
+#include "Tests.h"
+#include "../MeshOptimizer.h"
+#include "../ObjLoader.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	typedef std::array<Vertex, 3> Triangle;
+
+	bool VertexLess(const Vertex& a, const Vertex& b)
+	{
+		return memcmp(&a, &b, sizeof(Vertex)) < 0;
+	}
+
+	// Every triangle by value, each rotated to start at its smallest
+	// corner (which keeps the winding), then sorted - equal lists mean
+	// the same triangles, whatever order they're drawn in
+	std::vector<Triangle> GetTriangles(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			Triangle t = { verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end(), VertexLess), t.end());
+			triangles.push_back(t);
+		}
+
+		std::sort(triangles.begin(), triangles.end(), [](const Triangle& a, const Triangle& b) {
+			return memcmp(&a, &b, sizeof(Triangle)) < 0;
+		});
+		return triangles;
+	}
+
+	bool SameBytes(const void* a, const void* b, size_t bytes)
+	{
+		return bytes == 0 || memcmp(a, b, bytes) == 0;
+	}
+}
+
+void Tests::RunMeshOptimizerTests()
+{
+	printf("--- MeshOptimizer ---\n");
+
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Check(ObjLoader::Load(path.c_str(), verts, indices), "%s: loaded", name.c_str()))
+			continue;
+
+		// The same input, optimized twice
+		std::vector<Vertex> firstVerts = verts;
+		std::vector<unsigned int> firstIndices = indices;
+		MeshOptimizer::Optimize(firstVerts, firstIndices, name.c_str());
+
+		std::vector<Vertex> secondVerts = verts;
+		std::vector<unsigned int> secondIndices = indices;
+		MeshOptimizer::Optimize(secondVerts, secondIndices, name.c_str());
+
+		Check(firstVerts.size() == secondVerts.size() && firstIndices.size() == secondIndices.size() &&
+			SameBytes(firstVerts.data(), secondVerts.data(), firstVerts.size() * sizeof(Vertex)) &&
+			SameBytes(firstIndices.data(), secondIndices.data(), firstIndices.size() * sizeof(unsigned int)),
+			"%s: two runs give identical vertices and indices", name.c_str());
+
+		std::vector<Triangle> inputTriangles = GetTriangles(verts, indices);
+		std::vector<Triangle> outputTriangles = GetTriangles(firstVerts, firstIndices);
+		Check(inputTriangles.size() == outputTriangles.size() &&
+			SameBytes(inputTriangles.data(), outputTriangles.data(), inputTriangles.size() * sizeof(Triangle)),
+			"%s: same triangles, with the same winding, as the input", name.c_str());
+
+		VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(indices.data(), (int)indices.size(), (int)verts.size());
+		VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(firstIndices.data(), (int)firstIndices.size(), (int)firstVerts.size());
+		Check(after.acmr <= before.acmr && after.atvr <= before.atvr,
+			"%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", name.c_str(), before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+}
@@ -0,0 +1,49 @@
+#include "Tests.h"
+#include "../MeshSimplifier.h"
+#include "../ObjLoader.h"
+
+#include <cstdio>
+
+void Tests::RunMeshSimplifierTests()
+{
+	printf("--- MeshSimplifier ---\n");
+
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Check(ObjLoader::Load(path.c_str(), verts, indices) && !verts.empty(), "%s: loaded", name.c_str()))
+			continue;
+
+		int fullIndexCount = (int)indices.size();
+		std::vector<MeshLod> lods;
+		MeshSimplifier::GenerateLods(&verts[0], (int)verts.size(), indices, lods);
+
+		// Every level must shrink, never get more accurate than the one
+		// before it, and contain only valid, non-degenerate triangles
+		int badTriangles = 0;
+		bool shrinking = !lods.empty() && lods[0].firstIndex == 0 && lods[0].indexCount == fullIndexCount;
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			const MeshLod& lod = lods[i];
+			for (int n = 0; n < lod.indexCount; n += 3)
+			{
+				unsigned int a = indices[lod.firstIndex + n + 0];
+				unsigned int b = indices[lod.firstIndex + n + 1];
+				unsigned int c = indices[lod.firstIndex + n + 2];
+				if (a >= verts.size() || b >= verts.size() || c >= verts.size() || a == b || b == c || a == c)
+					badTriangles++;
+			}
+			if (i > 0 && (lod.indexCount >= lods[i - 1].indexCount || lod.error < lods[i - 1].error))
+				shrinking = false;
+		}
+
+		// Small meshes (the cube) may have nothing worth removing, but
+		// anything in the hundreds of triangles should get a coarser level
+		Check(fullIndexCount / 3 < 256 || lods.size() > 1, "%s: %d triangles, %d LODs",
+			name.c_str(), fullIndexCount / 3, (int)lods.size());
+		Check(shrinking, "%s: each LOD smaller and coarser than the last, LOD 0 the whole mesh", name.c_str());
+		Check(badTriangles == 0, "%s: %d invalid or degenerate triangles", name.c_str(), badTriangles);
+	}
+}
@@ -0,0 +1,148 @@
+#include "Tests.h"
+#include "../Camera.h"
+#include "../Meshlets.h"
+#include "../ObjLoader.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+namespace
+{
+	// Orientations the mesh is spun through for the culling checks
+	const int CullRotations = 8;
+}
+
+void Tests::RunMeshletTests()
+{
+	printf("--- Meshlets ---\n");
+
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Check(ObjLoader::Load(path.c_str(), verts, indices) && !verts.empty(), "%s: loaded", name.c_str()))
+			continue;
+
+		std::vector<Meshlet> meshlets;
+		std::vector<unsigned int> meshletVertices;
+		std::vector<unsigned char> meshletTriangles;
+		Meshlets::Build(verts.data(), (int)verts.size(), indices.data(), (int)indices.size(), meshlets, meshletVertices, meshletTriangles);
+
+		// Limits, local indices that stay inside the meshlet, and
+		// spheres that hold every vertex
+		int overLimit = 0;
+		int badLocalIndices = 0;
+		int outsideSphere = 0;
+		std::vector<std::array<unsigned int, 3>> built;
+		for (const Meshlet& m : meshlets)
+		{
+			if (m.vertexCount > (unsigned int)MeshletMaxVertices || m.triangleCount > (unsigned int)MeshletMaxTriangles)
+				overLimit++;
+
+			XMVECTOR center = XMLoadFloat3(&m.center);
+			for (unsigned int v = 0; v < m.vertexCount; v++)
+			{
+				XMVECTOR p = XMLoadFloat3(&verts[meshletVertices[m.vertexOffset + v]].Position);
+				if (XMVectorGetX(XMVector3Length(XMVectorSubtract(p, center))) > m.radius * 1.0001f + 1e-6f)
+					outsideSphere++;
+			}
+
+			for (unsigned int t = 0; t < m.triangleCount; t++)
+			{
+				std::array<unsigned int, 3> triangle;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned char local = meshletTriangles[m.triangleOffset + t * 3 + k];
+					if (local >= m.vertexCount)
+						badLocalIndices++;
+					triangle[k] = meshletVertices[m.vertexOffset + std::min((unsigned int)local, m.vertexCount - 1)];
+				}
+				built.push_back(triangle);
+			}
+		}
+
+		// Every triangle (with its winding) in exactly one meshlet
+		std::vector<std::array<unsigned int, 3>> original(indices.size() / 3);
+		for (size_t t = 0; t < original.size(); t++)
+			original[t] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+		std::sort(original.begin(), original.end());
+		std::sort(built.begin(), built.end());
+
+		Check(overLimit == 0 && badLocalIndices == 0,
+			"%s: %d meshlets, %d over the %d vertex / %d triangle limits, %d bad local indices",
+			name.c_str(), (int)meshlets.size(), overLimit, MeshletMaxVertices, MeshletMaxTriangles, badLocalIndices);
+		Check(built == original,
+			"%s: every triangle in exactly one meshlet (%d in meshlets, %d in the mesh)",
+			name.c_str(), (int)built.size(), (int)original.size());
+		Check(outsideSphere == 0, "%s: %d vertices outside their meshlet's sphere", name.c_str(), outsideSphere);
+
+		// The whole mesh sits well inside a wide frustum, so anything
+		// Cull() drops was back-face culled - and that's only allowed
+		// when none of the meshlet's triangles face the camera
+		XMVECTOR boundsMin = XMLoadFloat3(&verts[0].Position);
+		XMVECTOR boundsMax = boundsMin;
+		for (const Vertex& v : verts)
+		{
+			boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&v.Position));
+			boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&v.Position));
+		}
+		XMVECTOR meshCenter = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+		float meshRadius = std::max(XMVectorGetX(XMVector3Length(XMVectorSubtract(boundsMax, meshCenter))), 0.001f);
+
+		Camera camera(0.0f, 0.0f, -4.0f * meshRadius, 0.0f, 0.0f, 0.0f, XM_PIDIV2, 1.0f, 1.0f, 1.0f, 0.001f * meshRadius, 100.0f * meshRadius);
+		XMVECTOR cameraPosition = XMVectorSet(0.0f, 0.0f, -4.0f * meshRadius, 1.0f);
+
+		int frustumCulled = 0;
+		int wronglyCulled = 0;
+		int backfaceCulled = 0;
+		std::vector<int> visible;
+		std::vector<unsigned char> isVisible;
+		for (int r = 0; r < CullRotations; r++)
+		{
+			XMFLOAT4X4 world;
+			XMMATRIX worldMatrix = XMMatrixMultiply(
+				XMMatrixTranslationFromVector(XMVectorNegate(meshCenter)),
+				XMMatrixRotationRollPitchYaw(r * 0.7f, r * 1.3f, r * 0.4f));
+			XMStoreFloat4x4(&world, worldMatrix);
+
+			MeshletCullStats stats = Meshlets::Cull(meshlets.data(), (int)meshlets.size(), world, &camera, visible);
+			frustumCulled += stats.trianglesFrustumCulled;
+			backfaceCulled += stats.trianglesBackfaceCulled;
+
+			isVisible.assign(meshlets.size(), 0);
+			for (int i : visible)
+				isVisible[i] = 1;
+
+			for (size_t i = 0; i < meshlets.size(); i++)
+			{
+				if (isVisible[i])
+					continue;
+
+				const Meshlet& m = meshlets[i];
+				bool frontFacing = false;
+				for (unsigned int t = 0; t < m.triangleCount && !frontFacing; t++)
+				{
+					const unsigned char* local = &meshletTriangles[m.triangleOffset + t * 3];
+					XMVECTOR a = XMVector3Transform(XMLoadFloat3(&verts[meshletVertices[m.vertexOffset + local[0]]].Position), worldMatrix);
+					XMVECTOR b = XMVector3Transform(XMLoadFloat3(&verts[meshletVertices[m.vertexOffset + local[1]]].Position), worldMatrix);
+					XMVECTOR c = XMVector3Transform(XMLoadFloat3(&verts[meshletVertices[m.vertexOffset + local[2]]].Position), worldMatrix);
+
+					// Clockwise front faces: cross(b - a, c - a) points out of the front
+					XMVECTOR n = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+					frontFacing = XMVectorGetX(XMVector3Dot(n, XMVectorSubtract(cameraPosition, a))) > 0.0f;
+				}
+				if (frontFacing)
+					wronglyCulled++;
+			}
+		}
+
+		Check(frustumCulled == 0 && wronglyCulled == 0,
+			"%s: %d meshlets with a front-facing triangle back-face culled over %d views (%d triangles culled, %d frustum culled)",
+			name.c_str(), wronglyCulled, CullRotations, backfaceCulled, frustumCulled);
+	}
+}
@@ -0,0 +1,297 @@
+#include "Tests.h"
+#include "../ObjLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace
+{
+	// The loader ObjLoader replaced (from Mesh's constructor), kept as
+	// the reference: one unindexed triangle list, three vertices per
+	// triangle, with Z and V flipped and the winding reversed
+	// - sscanf rather than sscanf_s so it builds everywhere; with only
+	//   %f and %d conversions the two behave the same
+	bool LoadLegacy(const char* fileName, std::vector<Vertex>& verts)
+	{
+		std::ifstream obj(fileName);
+		if (!obj.is_open())
+			return false;
+
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT2> uvs;
+		char chars[100];
+
+		while (obj.good())
+		{
+			obj.getline(chars, 100);
+
+			if (chars[0] == 'v' && chars[1] == 'n')
+			{
+				XMFLOAT3 norm;
+				sscanf(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+				normals.push_back(norm);
+			}
+			else if (chars[0] == 'v' && chars[1] == 't')
+			{
+				XMFLOAT2 uv;
+				sscanf(chars, "vt %f %f", &uv.x, &uv.y);
+				uvs.push_back(uv);
+			}
+			else if (chars[0] == 'v')
+			{
+				XMFLOAT3 pos;
+				sscanf(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+				positions.push_back(pos);
+			}
+			else if (chars[0] == 'f')
+			{
+				unsigned int i[12];
+				int facesRead = sscanf(
+					chars,
+					"f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u",
+					&i[0], &i[1], &i[2],
+					&i[3], &i[4], &i[5],
+					&i[6], &i[7], &i[8],
+					&i[9], &i[10], &i[11]);
+
+				Vertex v[4] = {};
+				for (int c = 0; c < facesRead / 3; c++)
+				{
+					v[c].Position = positions[i[c * 3] - 1];
+					v[c].UV = uvs[i[c * 3 + 1] - 1];
+					v[c].Normal = normals[i[c * 3 + 2] - 1];
+					v[c].UV.y = 1.0f - v[c].UV.y;
+					v[c].Position.z *= -1.0f;
+					v[c].Normal.z *= -1.0f;
+				}
+
+				verts.push_back(v[0]);
+				verts.push_back(v[2]);
+				verts.push_back(v[1]);
+				if (facesRead == 12)
+				{
+					verts.push_back(v[0]);
+					verts.push_back(v[3]);
+					verts.push_back(v[2]);
+				}
+			}
+		}
+		return true;
+	}
+
+	double TriangleArea(const Vertex& a, const Vertex& b, const Vertex& c)
+	{
+		XMVECTOR n = XMVector3Cross(
+			XMVectorSubtract(XMLoadFloat3(&b.Position), XMLoadFloat3(&a.Position)),
+			XMVectorSubtract(XMLoadFloat3(&c.Position), XMLoadFloat3(&a.Position)));
+		return 0.5 * XMVectorGetX(XMVector3Length(n));
+	}
+
+	bool SameAttributes(const Vertex& a, const Vertex& b)
+	{
+		return
+			memcmp(&a.Position, &b.Position, sizeof(a.Position)) == 0 &&
+			memcmp(&a.Normal, &b.Normal, sizeof(a.Normal)) == 0 &&
+			memcmp(&a.UV, &b.UV, sizeof(a.UV)) == 0;
+	}
+}
+
+void Tests::RunObjLoaderTests()
+{
+	printf("--- ObjLoader ---\n");
+
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+
+		std::vector<Vertex> legacy;
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Check(LoadLegacy(path.c_str(), legacy) && ObjLoader::Load(path.c_str(), verts, indices),
+			"%s: loaded by both parsers", name.c_str()))
+			continue;
+
+		// Welding shares vertices, but every corner of every triangle
+		// should still be bit for bit what the old parser produced
+		bool indicesValid = true;
+		for (unsigned int index : indices)
+			indicesValid = indicesValid && index < verts.size();
+
+		int mismatched = 0;
+		if (indicesValid && indices.size() == legacy.size())
+		{
+			for (size_t i = 0; i < indices.size(); i++)
+				if (!SameAttributes(verts[indices[i]], legacy[i]))
+					mismatched++;
+		}
+
+		Check(indicesValid && indices.size() == legacy.size() && mismatched == 0,
+			"%s: %d triangles (old parser %d), %d mismatched corners, %d -> %d vertices",
+			name.c_str(), (int)indices.size() / 3, (int)legacy.size() / 3, mismatched, (int)legacy.size(), (int)verts.size());
+	}
+
+	// A 100 corner star, starting on one of its inner (reflex) corners
+	// so a fan would overlap itself - every corner has to be kept, and
+	// Load() has to clip it into the same triangles Stream() does
+	const int StarCorners = 100;
+	std::string starFileName = (std::filesystem::temp_directory_path() / "ObjLoaderStar.obj").string();
+	double starArea = 0.0;
+	{
+		std::vector<XMFLOAT2> star(StarCorners);
+		for (int i = 0; i < StarCorners; i++)
+		{
+			float angle = XM_2PI * i / StarCorners;
+			float radius = (i % 2 == 0) ? 0.3f : 1.0f;
+			star[i] = XMFLOAT2(radius * cosf(angle), radius * sinf(angle));
+		}
+		for (int i = 0, j = StarCorners - 1; i < StarCorners; j = i++)
+			starArea += 0.5 * ((double)star[j].x * star[i].y - (double)star[i].x * star[j].y);
+
+		std::ofstream starFile(starFileName, std::ios::binary);
+		for (const XMFLOAT2& v : star)
+			starFile << "v " << v.x << " " << v.y << " 0\n";
+		starFile << "vn 0 0 1\nf";
+		for (int i = 1; i <= StarCorners; i++)
+			starFile << " " << i << "//1";
+		starFile << "\n";
+	}
+
+	std::vector<Vertex> starVerts;
+	std::vector<unsigned int> starIndices;
+	bool starLoaded = ObjLoader::Load(starFileName.c_str(), starVerts, starIndices);
+
+	double loadArea = 0.0;
+	int badTriangles = 0;
+	for (size_t i = 0; starLoaded && i < starIndices.size(); i += 3)
+	{
+		const Vertex& a = starVerts[starIndices[i]];
+		const Vertex& b = starVerts[starIndices[i + 1]];
+		const Vertex& c = starVerts[starIndices[i + 2]];
+		XMVECTOR n = XMVector3Cross(
+			XMVectorSubtract(XMLoadFloat3(&b.Position), XMLoadFloat3(&a.Position)),
+			XMVectorSubtract(XMLoadFloat3(&c.Position), XMLoadFloat3(&a.Position)));
+		if (XMVectorGetX(XMVector3Dot(n, XMLoadFloat3(&a.Normal))) <= 0.0f)
+			badTriangles++;
+		loadArea += TriangleArea(a, b, c);
+	}
+
+	std::vector<unsigned int> streamIndices;
+	std::vector<Vertex> streamVerts;
+	ObjLoader::Stream(starFileName.c_str(), [&](const ObjStreamChunk& chunk)
+	{
+		for (int i = 0; i < chunk.indexCount; i++)
+			streamVerts.push_back(chunk.verts[chunk.indices[i]]);
+		return true;
+	});
+	std::error_code error;
+	std::filesystem::remove(starFileName, error);
+
+	int mismatched = 0;
+	if (streamVerts.size() == starIndices.size())
+	{
+		for (size_t i = 0; i < starIndices.size(); i++)
+			if (!SameAttributes(starVerts[starIndices[i]], streamVerts[i]))
+				mismatched++;
+	}
+
+	Check(starLoaded && starIndices.size() == (StarCorners - 2) * 3 && fabs(loadArea - starArea) < 1e-4 && badTriangles == 0,
+		"Star: %d triangles (%d expected), area %.4f (%.4f expected), %d wound the wrong way",
+		(int)starIndices.size() / 3, StarCorners - 2, loadArea, starArea, badTriangles);
+	Check(streamVerts.size() == starIndices.size() && mismatched == 0,
+		"Star: %d of %d corners differ from Stream()", mismatched, (int)streamVerts.size());
+}
+
+void Tests::RunObjStreamTests()
+{
+	printf("--- ObjLoader::Stream ---\n");
+
+	// A small file using everything Stream() handles: a concave
+	// n-gon that a simple fan gets wrong (it starts at the U's inner
+	// corner), "v//vn", "v/vt", bare "v" and negative indices
+	const char* FeatureTest =
+		"v 2 1 0\nv 1 1 0\nv 1 2 0\nv 0 2 0\nv 0 0 0\nv 3 0 0\nv 3 2 0\nv 2 2 0\n"
+		"vn 0 0 1\nvt 0 0\n"
+		"f 1//1 2//1 3//1 4//-1 5//-1 6//1 7//1 8//1\n"
+		"v 0 0 1\nv 1 0 1\nv 1 1 1\nv 0 1 1\n"
+		"f -4/1 -3/1 -2/-1 -1/-1\n"
+		"f 9 10 11\n"
+		"f 9 10 99\n";
+	const int ExpectedTriangles = 6 + 2 + 1;
+	const double ExpectedArea = 5.0 + 1.0 + 0.5;
+
+	std::string testFileName = (std::filesystem::temp_directory_path() / "ObjStreamTest.obj").string();
+	{
+		std::ofstream testFile(testFileName, std::ios::binary);
+		testFile << FeatureTest;
+	}
+
+	// Tiny chunks, to make sure faces split across them cleanly
+	int triangles = 0;
+	int badTriangles = 0;
+	int largestChunk = 0;
+	double area = 0.0;
+	ObjStreamStats stats = {};
+	bool streamed = ObjLoader::Stream(testFileName.c_str(), [&](const ObjStreamChunk& chunk)
+	{
+		largestChunk = std::max(largestChunk, chunk.vertexCount);
+		for (int i = 0; i < chunk.indexCount; i += 3)
+		{
+			const Vertex& a = chunk.verts[chunk.indices[i]];
+			const Vertex& b = chunk.verts[chunk.indices[i + 1]];
+			const Vertex& c = chunk.verts[chunk.indices[i + 2]];
+			XMVECTOR n = XMVector3Cross(
+				XMVectorSubtract(XMLoadFloat3(&b.Position), XMLoadFloat3(&a.Position)),
+				XMVectorSubtract(XMLoadFloat3(&c.Position), XMLoadFloat3(&a.Position)));
+
+			// Clockwise front faces: the cross product must agree with the normals
+			if (XMVectorGetX(XMVector3Dot(n, XMLoadFloat3(&a.Normal))) <= 0.0f)
+				badTriangles++;
+			area += TriangleArea(a, b, c);
+			triangles++;
+		}
+		return true;
+	}, 4, &stats);
+	std::error_code error;
+	std::filesystem::remove(testFileName, error);
+
+	Check(streamed && triangles == ExpectedTriangles && fabs(area - ExpectedArea) < 1e-4,
+		"Feature file: %d triangles (%d expected), area %.4f (%.4f expected)", triangles, ExpectedTriangles, area, ExpectedArea);
+	Check(badTriangles == 0, "Feature file: %d triangles wound the wrong way", badTriangles);
+	Check(largestChunk <= 4 && stats.skippedFaceCount == 1,
+		"Feature file: largest chunk %d vertices (4 allowed), %lld faces skipped (1 expected)", largestChunk, stats.skippedFaceCount);
+
+	// The test meshes: streamed, they should match a full Load()
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Check(ObjLoader::Load(path.c_str(), verts, indices), "%s: loaded", name.c_str()))
+			continue;
+
+		double loadArea = 0.0;
+		for (size_t i = 0; i < indices.size(); i += 3)
+			loadArea += TriangleArea(verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]]);
+
+		long long streamTriangles = 0;
+		double streamArea = 0.0;
+		ObjLoader::Stream(path.c_str(), [&](const ObjStreamChunk& chunk)
+		{
+			for (int i = 0; i < chunk.indexCount; i += 3)
+				streamArea += TriangleArea(chunk.verts[chunk.indices[i]], chunk.verts[chunk.indices[i + 1]], chunk.verts[chunk.indices[i + 2]]);
+			streamTriangles += chunk.indexCount / 3;
+			return true;
+		});
+
+		Check(streamTriangles == (long long)indices.size() / 3 && fabs(streamArea - loadArea) <= 1e-4 * fmax(1.0, loadArea),
+			"%s: streamed %lld triangles (Load: %d), area %.4f vs. %.4f",
+			name.c_str(), streamTriangles, (int)indices.size() / 3, streamArea, loadArea);
+	}
+}
@@ -0,0 +1,240 @@
+#include "Tests.h"
+#include "../FrustumCuller.h"
+#include "../OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <utility>
+
+using namespace DirectX;
+
+namespace
+{
+	// Box triangles facing outwards (clockwise seen from outside, like
+	// everything D3D draws by default)
+	void AddBox(std::vector<XMFLOAT3>& positions, std::vector<unsigned int>& indices, const XMFLOAT3& center, const XMFLOAT3& half)
+	{
+		unsigned int base = (unsigned int)positions.size();
+		for (int corner = 0; corner < 8; corner++)
+		{
+			positions.push_back(XMFLOAT3(
+				center.x + ((corner & 1) ? half.x : -half.x),
+				center.y + ((corner & 2) ? half.y : -half.y),
+				center.z + ((corner & 4) ? half.z : -half.z)));
+		}
+		const int faces[6][4] = { { 0, 2, 6, 4 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 5, 7, 6 } };
+		for (int f = 0; f < 6; f++)
+		{
+			XMVECTOR faceCenter = XMVectorZero();
+			for (int k = 0; k < 4; k++)
+				faceCenter = XMVectorAdd(faceCenter, XMLoadFloat3(&positions[base + faces[f][k]]));
+			XMVECTOR outward = XMVectorSubtract(XMVectorScale(faceCenter, 0.25f), XMLoadFloat3(&center));
+			for (int t = 0; t < 2; t++)
+			{
+				unsigned int a = base + faces[f][0], b = base + faces[f][t + 1], c = base + faces[f][t + 2];
+				XMVECTOR pa = XMLoadFloat3(&positions[a]);
+				XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&positions[b]), pa), XMVectorSubtract(XMLoadFloat3(&positions[c]), pa));
+				if (XMVectorGetX(XMVector3Dot(normal, outward)) < 0.0f)
+					std::swap(b, c);
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(c);
+			}
+		}
+	}
+}
+
+void Tests::RunOcclusionBufferTests()
+{
+	printf("--- OcclusionBuffer ---\n");
+
+	// Blocks of buildings down the view, with small objects scattered
+	// between and behind them
+	const int ObjectCount = 20000;
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	std::mt19937 rng(2424);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < 64; i++)
+	{
+		XMFLOAT3 half(2.0f + 8.0f * unit(rng), 3.0f + 12.0f * unit(rng), 2.0f + 8.0f * unit(rng));
+		AddBox(positions, indices, XMFLOAT3(-120.0f + 240.0f * unit(rng), half.y - 10.0f, 20.0f + 180.0f * unit(rng)), half);
+	}
+	std::vector<AABB> boxes(ObjectCount);
+	for (AABB& box : boxes)
+	{
+		XMFLOAT3 center(-150.0f + 300.0f * unit(rng), -10.0f + 30.0f * unit(rng), 5.0f + 295.0f * unit(rng));
+		XMFLOAT3 half(0.1f + 0.9f * unit(rng), 0.1f + 0.9f * unit(rng), 0.1f + 0.9f * unit(rng));
+		box.min = XMFLOAT3(center.x - half.x, center.y - half.y, center.z - half.z);
+		box.max = XMFLOAT3(center.x + half.x, center.y + half.y, center.z + half.z);
+	}
+
+	// A camera above the street, looking down +z
+	OcclusionBuffer buffer(320, 192);
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0.0f, 5.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, (float)buffer.GetWidth() / buffer.GetHeight(), 0.1f, 400.0f);
+	XMMATRIX m = XMMatrixMultiply(view, projection);
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, m);
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	// What the GPU would draw: a depth buffer of the same triangles at
+	// four times the resolution, pixel centers only
+	const int Scale = 4;
+	int referenceWidth = buffer.GetWidth() * Scale;
+	int referenceHeight = buffer.GetHeight() * Scale;
+	std::vector<float> referenceDepth((size_t)referenceWidth * referenceHeight, 1.0f);
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		float x[3], y[3], z[3];
+		bool dropped = false;
+		for (int v = 0; v < 3; v++)
+		{
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&positions[indices[t + v]]), m));
+			dropped = dropped || clip.z < 0.0f || clip.w <= 0.0f;
+			x[v] = (clip.x / clip.w * 0.5f + 0.5f) * referenceWidth;
+			y[v] = (0.5f - clip.y / clip.w * 0.5f) * referenceHeight;
+			z[v] = clip.z / clip.w;
+		}
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (dropped || area <= 0.0f)
+			continue;
+
+		int px0 = std::max(0, (int)floorf(std::min(x[0], std::min(x[1], x[2]))));
+		int px1 = std::min(referenceWidth - 1, (int)ceilf(std::max(x[0], std::max(x[1], x[2]))));
+		int py0 = std::max(0, (int)floorf(std::min(y[0], std::min(y[1], y[2]))));
+		int py1 = std::min(referenceHeight - 1, (int)ceilf(std::max(y[0], std::max(y[1], y[2]))));
+		for (int py = py0; py <= py1; py++)
+		{
+			for (int px = px0; px <= px1; px++)
+			{
+				float cx = px + 0.5f, cy = py + 0.5f;
+				float w0 = ((x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1])) / area;
+				float w1 = ((x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2])) / area;
+				float w2 = 1.0f - w0 - w1;
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
+				float& depth = referenceDepth[(size_t)py * referenceWidth + px];
+				depth = std::min(depth, w0 * z[0] + w1 * z[1] + w2 * z[2]);
+			}
+		}
+	}
+
+	// A box is hidden if every pixel center it could cover is closer
+	// than its nearest point - slack forgives float rounding, for boxes
+	// right up against an occluder
+	auto referenceHidden = [&](const AABB& box, float slack)
+	{
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearestZ = FLT_MAX;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector3Transform(XMVectorSet(
+				(corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z, 1.0f), m));
+			if (clip.z < 0.0f || clip.w <= 0.0f)
+				return false;
+			minX = std::min(minX, (clip.x / clip.w * 0.5f + 0.5f) * referenceWidth);
+			maxX = std::max(maxX, (clip.x / clip.w * 0.5f + 0.5f) * referenceWidth);
+			minY = std::min(minY, (0.5f - clip.y / clip.w * 0.5f) * referenceHeight);
+			maxY = std::max(maxY, (0.5f - clip.y / clip.w * 0.5f) * referenceHeight);
+			nearestZ = std::min(nearestZ, clip.z / clip.w);
+		}
+		for (int py = std::max(0, (int)floorf(minY)); py <= std::min(referenceHeight - 1, (int)ceilf(maxY) - 1); py++)
+		{
+			for (int px = std::max(0, (int)floorf(minX)); px <= std::min(referenceWidth - 1, (int)ceilf(maxX) - 1); px++)
+			{
+				if (referenceDepth[(size_t)py * referenceWidth + px] - slack >= nearestZ)
+					return false;
+			}
+		}
+		return true;
+	};
+
+	// Only what's left after frustum culling is tested, as in RenderSystem
+	XMFLOAT4 planes[6];
+	Bounds::GetFrustumPlanes(viewProjection, planes);
+	FrustumCuller culler;
+	for (const AABB& box : boxes)
+		culler.Add(box);
+	std::vector<unsigned char> inFrustum(ObjectCount);
+	culler.Cull(planes, inFrustum.data());
+	std::vector<AABB> tested;
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		if (inFrustum[i])
+			tested.push_back(boxes[i]);
+	}
+	int testCount = (int)tested.size();
+
+	// Rasterized on one thread and on several, the buffer has to come
+	// out the same, and every pixel at least as far as the reference
+	// pixels it covers
+	std::vector<float> singleThreaded((size_t)buffer.GetWidth() * buffer.GetHeight());
+	int differentPixels = 0;
+	int depthsTooNear = 0;
+	for (int threads : { 1, 4 })
+	{
+		buffer.Begin(viewProjection);
+		buffer.AddOccluder(positions.data(), (int)positions.size(), indices.data(), (int)indices.size(), identity);
+		buffer.Rasterize(threads);
+		for (int y = 0; y < buffer.GetHeight(); y++)
+		{
+			for (int x = 0; x < buffer.GetWidth(); x++)
+			{
+				float& depth = singleThreaded[(size_t)y * buffer.GetWidth() + x];
+				if (threads == 1)
+					depth = buffer.GetPixelDepth(x, y);
+				else
+					differentPixels += depth != buffer.GetPixelDepth(x, y);
+			}
+		}
+	}
+	for (int y = 0; y < referenceHeight; y++)
+	{
+		for (int x = 0; x < referenceWidth; x++)
+			depthsTooNear += referenceDepth[(size_t)y * referenceWidth + x] > buffer.GetPixelDepth(x / Scale, y / Scale) + 1e-5f;
+	}
+	Check(differentPixels == 0, "%d triangles rasterize the same on 1 and 4 threads (%d pixels differ)",
+		buffer.GetTriangleCount(), differentPixels);
+	Check(depthsTooNear == 0, "No buffer pixel is nearer than the %dx%d reference (%d are)", referenceWidth, referenceHeight, depthsTooNear);
+
+	// Nothing the reference would show may be culled, on any number of
+	// threads - and a fair share of what the reference hides is caught
+	std::vector<unsigned char> visible(testCount), visibleThreaded(testCount);
+	int visibleCount = buffer.TestBoxes(tested.data(), testCount, visible.data(), 1);
+	int visibleThreadedCount = buffer.TestBoxes(tested.data(), testCount, visibleThreaded.data(), 4);
+	int falseOccluded = 0;
+	int referenceOccluded = 0;
+	for (int i = 0; i < testCount; i++)
+	{
+		if (!visible[i] && !referenceHidden(tested[i], 1e-5f))
+			falseOccluded++;
+		referenceOccluded += referenceHidden(tested[i], 0.0f);
+	}
+	int occluded = testCount - visibleCount;
+	Check(visible == visibleThreaded && visibleCount == visibleThreadedCount,
+		"Testing %d boxes gives the same results on 1 and 4 threads", testCount);
+	Check(falseOccluded == 0 && occluded > referenceOccluded / 2,
+		"%d occluded, none the reference shows (%d wrong), %d hidden in the reference", occluded, falseOccluded, referenceOccluded);
+
+	// A wall across the whole view hides what's behind it, but not
+	// what's in front or what crosses the near plane.  Pixels on the
+	// seam between two triangles are never entirely inside either one,
+	// so the boxes are kept off the wall's diagonals.
+	buffer.Begin(viewProjection);
+	positions.clear();
+	indices.clear();
+	AddBox(positions, indices, XMFLOAT3(0.0f, 5.0f, 50.0f), XMFLOAT3(500.0f, 500.0f, 1.0f));
+	buffer.AddOccluder(positions.data(), (int)positions.size(), indices.data(), (int)indices.size(), identity);
+	buffer.Rasterize();
+	AABB behind = { XMFLOAT3(20.0f, 4.0f, 60.0f), XMFLOAT3(22.0f, 6.0f, 62.0f) };
+	AABB inFront = { XMFLOAT3(7.0f, 4.0f, 20.0f), XMFLOAT3(9.0f, 6.0f, 22.0f) };
+	AABB aroundCamera = { XMFLOAT3(-1.0f, 4.0f, -1.0f), XMFLOAT3(1.0f, 6.0f, 1.0f) };
+	Check(!buffer.IsVisible(behind), "A box behind a wall is hidden");
+	Check(buffer.IsVisible(inFront) && buffer.IsVisible(aroundCamera), "Boxes in front of the wall or around the camera are not");
+}
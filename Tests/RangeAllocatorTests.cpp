@@ -0,0 +1,93 @@
+#include "Tests.h"
+#include "../RangeAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+void Tests::RunRangeAllocatorTests()
+{
+	printf("--- RangeAllocator ---\n");
+
+	// Memory standing in for a GPU buffer: every allocation's bytes
+	// are stamped with its id, so lost or overlapping data shows up
+	const int Capacity = 1 << 20;
+	const int Operations = 200000;
+	RangeAllocator allocator(Capacity);
+	std::vector<int> memory(Capacity, -1);
+	std::vector<int> live;
+	std::mt19937 random(12345);
+
+	int allocations = 0;
+	int overlaps = 0;
+	int outOfRange = 0;
+	int usedSize = 0;
+	for (int op = 0; op < Operations; op++)
+	{
+		// Grow towards ~75% full, then churn
+		bool allocate = live.empty() || (random() % 100) < (usedSize < Capacity * 3 / 4 ? 60 : 45);
+		if (allocate)
+		{
+			int size = 1 + (int)(random() % 2048);
+			int id = allocator.Allocate(size);
+			if (id < 0)
+				continue;
+
+			allocations++;
+			int offset = allocator.GetOffset(id);
+			if (offset < 0 || offset + size > Capacity || allocator.GetSize(id) != size)
+			{
+				outOfRange++;
+				continue;
+			}
+			for (int i = offset; i < offset + size; i++)
+			{
+				overlaps += (memory[i] != -1) ? 1 : 0;
+				memory[i] = id;
+			}
+			live.push_back(id);
+			usedSize += size;
+		}
+		else
+		{
+			int slot = (int)(random() % live.size());
+			int id = live[slot];
+			int offset = allocator.GetOffset(id);
+			for (int i = offset; i < offset + allocator.GetSize(id); i++)
+				memory[i] = -1;
+			usedSize -= allocator.GetSize(id);
+			allocator.Free(id);
+			live[slot] = live.back();
+			live.pop_back();
+		}
+	}
+	RangeAllocatorStats before = allocator.GetStats();
+	Check(outOfRange == 0 && overlaps == 0 && before.usedSize == usedSize,
+		"%d operations, %d allocations: %d out of range, %d overlapping elements, %d used (%d expected)",
+		Operations, allocations, outOfRange, overlaps, before.usedSize, usedSize);
+
+	// Apply the compaction's moves one after another, in place
+	std::vector<RangeMove> moves;
+	allocator.Compact(moves);
+	for (const RangeMove& move : moves)
+		std::copy(memory.begin() + move.oldOffset, memory.begin() + move.oldOffset + move.size, memory.begin() + move.newOffset);
+
+	int lost = 0;
+	for (int id : live)
+	{
+		int offset = allocator.GetOffset(id);
+		for (int i = offset; i < offset + allocator.GetSize(id); i++)
+			lost += (memory[i] != id) ? 1 : 0;
+	}
+	RangeAllocatorStats after = allocator.GetStats();
+	Check(lost == 0, "Compaction: %d moves, %d elements lost", (int)moves.size(), lost);
+	Check(after.freeBlockCount <= 1 && after.fragmentation == 0.0f && after.usedSize == before.usedSize,
+		"Compaction: fragmentation %.3f -> %.3f, %d free block(s) left", before.fragmentation, after.fragmentation, after.freeBlockCount);
+
+	// Freeing everything must coalesce back into a single block
+	for (int id : live)
+		allocator.Free(id);
+	RangeAllocatorStats empty = allocator.GetStats();
+	Check(empty.freeBlockCount == 1 && empty.largestFreeBlock == Capacity && empty.usedSize == 0,
+		"Freeing everything leaves one free block of %d (%d blocks, largest %d)", Capacity, empty.freeBlockCount, empty.largestFreeBlock);
+}
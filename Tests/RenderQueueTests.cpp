@@ -0,0 +1,106 @@
+#include "Tests.h"
+#include "../RenderQueue.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+void Tests::RunRenderQueueTests()
+{
+	printf("--- RenderQueue ---\n");
+
+	const int DrawCount = 20000;
+	std::mt19937 rng(2020);
+
+	// The sort itself, against the standard library, with plenty of ties
+	std::vector<uint64_t> keys(DrawCount), keyScratch(DrawCount);
+	std::vector<uint32_t> order(DrawCount), orderScratch(DrawCount);
+	std::uniform_int_distribution<uint64_t> anyKey(0, 4095);
+	for (int i = 0; i < DrawCount; i++)
+		keys[i] = anyKey(rng) << 52 | anyKey(rng) << 20 | (uint64_t)(i % 7);
+	std::vector<uint64_t> original = keys;
+	std::vector<uint32_t> expected(DrawCount);
+	for (int i = 0; i < DrawCount; i++)
+		expected[i] = (uint32_t)i;
+	std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return original[a] < original[b]; });
+
+	RenderQueue::RadixSort(keys.data(), order.data(), keyScratch.data(), orderScratch.data(), DrawCount);
+	bool sortMatch = order == expected;
+	for (int i = 0; i < DrawCount && sortMatch; i++)
+		sortMatch = keys[i] == original[order[i]];
+	Check(sortMatch, "Radix sort matches std::stable_sort, ties included");
+
+	// A scene's worth of state - shaders and textures are never touched
+	// without a device, so stand-in pointers will do
+	const int ShaderCount = 4, MaterialsPerShader = 16, MeshCount = 32;
+	char shaderStandIns[ShaderCount * 2];
+	std::vector<Material*> materials;
+	for (int s = 0; s < ShaderCount; s++)
+	{
+		for (int m = 0; m < MaterialsPerShader; m++)
+		{
+			materials.push_back(new Material(
+				XMFLOAT4(1, 1, 1, 1), 0.5f,
+				(SimplePixelShader*)&shaderStandIns[s * 2 + 1],
+				(SimpleVertexShader*)&shaderStandIns[s * 2],
+				nullptr, nullptr, nullptr, nullptr, nullptr));
+		}
+	}
+	std::vector<Mesh*> meshes;
+	for (int m = 0; m < MeshCount; m++)
+		meshes.push_back(new Mesh());
+
+	// Every draw its own object, in random order, one in ten transparent
+	std::uniform_int_distribution<int> anyMaterial(0, (int)materials.size() - 1);
+	std::uniform_int_distribution<int> anyMesh(0, MeshCount - 1);
+	std::uniform_real_distribution<float> anyDepth(0.1f, 500.0f);
+	struct QueuedDraw { RenderPass pass; int material; int mesh; float depth; };
+	std::vector<QueuedDraw> draws(DrawCount);
+	for (QueuedDraw& draw : draws)
+		draw = { rng() % 10 == 0 ? TransparentPass : OpaquePass, anyMaterial(rng), anyMesh(rng), anyDepth(rng) };
+
+	RenderQueue queue;
+	for (int i = 0; i < DrawCount; i++)
+		queue.Add(draws[i].pass, meshes[draws[i].mesh], materials[draws[i].material], (ID3D11Buffer*)(uintptr_t)(i + 1), 36, 0, draws[i].depth);
+	RenderQueueStats unsorted = RenderQueue::CountStateChanges(queue.GetPackets().data(), DrawCount, true);
+	queue.Sort();
+
+	// Opaque first, each shader and material in one run, front to back
+	// within a run - then transparent draws from back to front
+	const std::vector<DrawPacket>& packets = queue.GetPackets();
+	int outOfOrder = 0;
+	int wrongDepthOrder = 0;
+	for (int i = 1; i < (int)packets.size(); i++)
+	{
+		const DrawPacket& a = packets[i - 1];
+		const DrawPacket& b = packets[i];
+		bool aTransparent = a.key >> 60 == TransparentPass;
+		bool bTransparent = b.key >> 60 == TransparentPass;
+		float aDepth = draws[(uintptr_t)a.objectConstants - 1].depth;
+		float bDepth = draws[(uintptr_t)b.objectConstants - 1].depth;
+		if (a.key > b.key || (aTransparent && !bTransparent))
+			outOfOrder++;
+
+		// Depth is quantized to 16 bits, so allow for a little slack
+		if (!aTransparent && a.material == b.material && a.mesh == b.mesh && aDepth > bDepth * 1.01f)
+			wrongDepthOrder++;
+		if (aTransparent && bTransparent && aDepth < bDepth * 0.99f)
+			wrongDepthOrder++;
+	}
+	Check((int)packets.size() == DrawCount && outOfOrder == 0,
+		"%d packets sorted by key, opaque before transparent (%d out of order)", (int)packets.size(), outOfOrder);
+	Check(wrongDepthOrder == 0, "Opaque runs front to back, transparent back to front (%d wrong)", wrongDepthOrder);
+
+	RenderQueueStats before = RenderQueue::CountStateChanges(packets.data(), DrawCount, false);
+	RenderQueueStats after = RenderQueue::CountStateChanges(packets.data(), DrawCount, true);
+	Check(before.draws == DrawCount && after.draws == DrawCount &&
+		after.shaderChanges <= before.shaderChanges && after.GetTotal() <= unsorted.GetTotal(),
+		"Sorting cuts state changes: %d unsorted, %d sorted (%d without filtering)", unsorted.GetTotal(), after.GetTotal(), before.GetTotal());
+
+	for (Material* m : materials)
+		delete m;
+	for (Mesh* m : meshes)
+		delete m;
+}
@@ -0,0 +1,71 @@
+#include "Tests.h"
+#include "../Mesh.h"
+#include "../ObjLoader.h"
+
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+namespace
+{
+	// Big enough that Mesh::CalculateTangents() splits the work
+	const int MinTriangles = 200000;
+}
+
+void Tests::RunTangentTests()
+{
+	printf("--- Tangents ---\n");
+
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+		std::vector<Vertex> baseVerts;
+		std::vector<unsigned int> baseIndices;
+		if (!Check(ObjLoader::Load(path.c_str(), baseVerts, baseIndices) && !baseVerts.empty(), "%s: loaded", name.c_str()))
+			continue;
+
+		// Tile copies of the mesh so the multithreaded path runs too
+		int copies = (int)(((size_t)MinTriangles * 3 + baseIndices.size() - 1) / baseIndices.size());
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		for (int c = 0; c < copies; c++)
+		{
+			unsigned int base = (unsigned int)verts.size();
+			for (Vertex v : baseVerts)
+			{
+				v.Position.x += 3.0f * c;
+				verts.push_back(v);
+			}
+			for (unsigned int index : baseIndices)
+				indices.push_back(base + index);
+		}
+
+		std::vector<Vertex> reference = verts;
+		Mesh::CalculateTangentsReference(&reference[0], (int)reference.size(), &indices[0], (int)indices.size());
+		Mesh::CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+
+		// Compare directions wherever the reference produced a real tangent
+		// (it turns degenerate UVs into NaNs, the fast path skips them)
+		const double Tolerance = 0.001;
+		double maxError = 0.0;
+		int compared = 0;
+		int mismatched = 0;
+		for (size_t i = 0; i < verts.size(); i++)
+		{
+			const XMFLOAT3& r = reference[i].Tangent;
+			if (!std::isfinite(r.x) || !std::isfinite(r.y) || !std::isfinite(r.z) || !IsUnitLength(r))
+				continue;
+
+			double error = IsUnitLength(verts[i].Tangent) ? AngleBetween(r, verts[i].Tangent) : XM_PI;
+			maxError = fmax(maxError, error);
+			if (error > Tolerance)
+				mismatched++;
+			compared++;
+		}
+
+		Check(compared > 0 && mismatched == 0,
+			"%s x%d: SIMD vs. reference max difference %.2e rad over %d vertices (%d over %.0e)",
+			name.c_str(), copies, maxError, compared, mismatched, Tolerance);
+	}
+}
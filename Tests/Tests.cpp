@@ -0,0 +1,115 @@
+#include "Tests.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <filesystem>
+
+int Tests::checkCount = 0;
+int Tests::failureCount = 0;
+std::string Tests::meshFolder;
+
+bool Tests::Check(bool passed, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	printf("  ");
+	vprintf(format, args);
+	printf("  [%s]\n", passed ? "PASS" : "FAIL");
+	va_end(args);
+
+	checkCount++;
+	if (!passed)
+		failureCount++;
+	return passed;
+}
+
+int Tests::GetCheckCount()
+{
+	return checkCount;
+}
+
+int Tests::GetFailureCount()
+{
+	return failureCount;
+}
+
+void Tests::SetMeshFolder(const std::string& folder)
+{
+	meshFolder = folder;
+}
+
+std::string Tests::GetMeshPath(const char* fileName)
+{
+	return (std::filesystem::path(meshFolder) / fileName).string();
+}
+
+const std::vector<std::string>& Tests::GetMeshFileNames()
+{
+	static const std::vector<std::string> names = { "helix.obj", "sphere.obj", "cylinder.obj", "cube.obj" };
+	return names;
+}
+
+double Tests::AngleBetween(DirectX::XMFLOAT3 a, DirectX::XMFLOAT3 b)
+{
+	double cx = (double)a.y * b.z - (double)a.z * b.y;
+	double cy = (double)a.z * b.x - (double)a.x * b.z;
+	double cz = (double)a.x * b.y - (double)a.y * b.x;
+	double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+	return atan2(sqrt(cx * cx + cy * cy + cz * cz), dot);
+}
+
+bool Tests::IsUnitLength(DirectX::XMFLOAT3 v)
+{
+	return fabsf(v.x * v.x + v.y * v.y + v.z * v.z - 1.0f) < 0.001f;
+}
+
+// --------------------------------------------------------
+// Runs every suite, and returns the number of failed checks
+//
+// Usage: Tests [mesh folder]
+// - Without a folder, meshes are found the same way the game
+//   finds them: ../../assets/meshes from the executable
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+		Tests::SetMeshFolder(argv[1]);
+	else
+		Tests::SetMeshFolder((std::filesystem::absolute(argv[0]).parent_path() / "../../assets/meshes").string());
+
+	// Suites that only need DirectXMath and the standard library -
+	// these are all the Makefile builds
+	Tests::RunRangeAllocatorTests();
+	Tests::RunJobSystemTests();
+	Tests::RunTransformHierarchyTests();
+	Tests::RunTransformSystemTests();
+	Tests::RunTransformBasisTests();
+	Tests::RunTransformVersionTests();
+	Tests::RunObjectMatricesTests();
+	Tests::RunEntityWorldTests();
+	Tests::RunFrustumCullerTests();
+	Tests::RunAABBTreeTests();
+	Tests::RunOcclusionBufferTests();
+
+	// Suites that need Windows (file mapping) or Direct3D headers
+#if defined(_WIN32)
+	Tests::RunObjLoaderTests();
+	Tests::RunObjStreamTests();
+	Tests::RunMeshCacheTests();
+	Tests::RunMaterialGroupTests();
+	Tests::RunMaterialLibraryTests();
+	Tests::RunMeshLoaderTests();
+	Tests::RunMeshOptimizerTests();
+	Tests::RunMeshSimplifierTests();
+	Tests::RunTangentTests();
+	Tests::RunBoundsTests();
+	Tests::RunMeshletTests();
+	Tests::RunVertexPackingTests();
+	Tests::RunRenderQueueTests();
+	Tests::RunInstanceBatcherTests();
+#endif
+
+	printf("\n%d of %d checks failed\n", Tests::GetFailureCount(), Tests::GetCheckCount());
+	return Tests::GetFailureCount();
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Correctness checks for the engine's CPU-side systems
+//
+// - A console program of its own (Tests.vcxproj), with no
+//   window - timings stay in Benchmarks, inside the game
+// - Suites that don't need Windows or Direct3D headers also
+//   build anywhere else with the Makefile
+// - Each check prints one line ending in [PASS] or [FAIL],
+//   and main() returns how many failed, so a build step
+//   running it fails along with them
+// - Meshes come from assets/meshes, or from the folder given
+//   as the first command line argument
+// --------------------------------------------------------
+class Tests
+{
+private:
+	static int checkCount;
+	static int failureCount;
+	static std::string meshFolder;
+
+public:
+	// Prints the formatted description followed by [PASS] or [FAIL],
+	// counts the result and returns passed
+	static bool Check(bool passed, const char* format, ...);
+
+	static int GetCheckCount();
+	static int GetFailureCount();
+
+	// Full path to one of the meshes, and the ones every mesh test uses
+	static void SetMeshFolder(const std::string& folder);
+	static std::string GetMeshPath(const char* fileName);
+	static const std::vector<std::string>& GetMeshFileNames();
+
+	// Angle between two directions, in radians (stable for tiny angles)
+	static double AngleBetween(DirectX::XMFLOAT3 a, DirectX::XMFLOAT3 b);
+	static bool IsUnitLength(DirectX::XMFLOAT3 v);
+
+	// Compares ObjLoader::Load() against the original getline/sscanf
+	// parser, triangle for triangle, on every test mesh, then checks
+	// a big concave face is clipped the same way Stream() does it
+	static void RunObjLoaderTests();
+
+	// Streams a small OBJ full of n-gons, missing attributes and negative
+	// indices in tiny chunks, then streams every test mesh and checks it
+	// against Load()
+	static void RunObjStreamTests();
+
+	// Writes a cache for a copy of a mesh and reads it back, then checks
+	// a touched source still matches (and its new timestamp is stored),
+	// while an edited or resized one doesn't
+	static void RunMeshCacheTests();
+
+	// Splits a copy of a mesh between two interleaved materials, then
+	// checks the submesh ranges, the parsed MTL parameters, that every
+	// LOD keeps each submesh to its own vertices, and the cache round trip
+	static void RunMaterialGroupTests();
+
+	// Builds a MaterialLibrary on a WARP device from a mesh's MTL file,
+	// checking the tints, shared and fallback textures, and each
+	// submesh's material
+	static void RunMaterialLibraryTests();
+
+	// Queues the test meshes from several threads at once (each file
+	// should map to one mesh), then destroys the loader before anything
+	// is uploaded - every handle must end up holding nullptr, as must
+	// one for a file that doesn't exist
+	static void RunMeshLoaderTests();
+
+	// Optimizes every test mesh twice from the same input, checking the
+	// runs match byte for byte, keep every triangle and its winding, and
+	// don't make ACMR or ATVR worse
+	static void RunMeshOptimizerTests();
+
+	// Packs and unpacks every vertex of each test mesh, checking the
+	// round-trip error against the PackedVertex bounds
+	static void RunVertexPackingTests();
+
+	// Builds every test mesh's LOD chain, checking each level is smaller
+	// and coarser than the last and holds only well formed triangles
+	static void RunMeshSimplifierTests();
+
+	// Checks Mesh::CalculateTangents() (SIMD, multithreaded) against
+	// the one-triangle-at-a-time reference on tiled copies of each mesh
+	static void RunTangentTests();
+
+	// Checks each test mesh's SIMD bounds against a scalar pass, and
+	// that transformed bounds contain the transformed vertices
+	static void RunBoundsTests();
+
+	// Builds meshlets for each test mesh, checking the size limits,
+	// that every triangle lands in exactly one meshlet and that the
+	// spheres hold their vertices, then culls them from several views -
+	// a meshlet with any front-facing triangle must never be dropped
+	static void RunMeshletTests();
+
+	// Builds deep, wide and bushy hierarchies, moves the root or a few
+	// scattered nodes, and checks lazy and batched world matrices against
+	// a from-scratch composition
+	static void RunTransformHierarchyTests();
+
+	// Checks TransformSystem::Update()'s SIMD pass, on one thread and on
+	// several, against world matrices built one object at a time
+	static void RunTransformSystemTests();
+
+	// Checks the cached local axes and MoveRelative() against rotating
+	// by a quaternion built from the Euler angles, and that moves and
+	// Scale() leave the transform dirty
+	static void RunTransformBasisTests();
+
+	// A mostly static scene where uploads and bounds are only redone
+	// when a transform's version changes - checks they match redoing
+	// everything, and that only what moved (or its children) was redone
+	static void RunTransformVersionTests();
+
+	// Checks TransformSystem::ComputeObjectMatrices() against DirectXMath
+	// one object at a time, with non-uniform, mirrored and zero scales
+	static void RunObjectMatricesTests();
+
+	// Defers destroys and adds through an EntityCommandBuffer in the
+	// middle of a query, then checks what survived and that components
+	// moved between archetypes are never leaked or destroyed twice
+	static void RunEntityWorldTests();
+
+	// Checks the radix sort against std::stable_sort, then queues draws
+	// over a spread of shaders, materials and meshes in random order and
+	// checks the sorted order and that it cuts state changes
+	static void RunRenderQueueTests();
+
+	// Groups objects spread over a few meshes, materials and LODs,
+	// checking every instance lands in its group's slice with the right
+	// matrix and tint, and that the queued draws cover every object
+	static void RunInstanceBatcherTests();
+
+	// Culls random boxes with FrustumCuller on one thread and on several,
+	// checking every result against a box-at-a-time reference, plus
+	// partial groups of four and unbounded boxes
+	static void RunFrustumCullerTests();
+
+	// Inserts, moves and builds trees of random boxes, validating each,
+	// checks frustum, box, sphere and ray queries against testing every
+	// fat box, and that Rebuild() keeps every proxy
+	static void RunAABBTreeTests();
+
+	// Draws a city of box-shaped occluders into an OcclusionBuffer,
+	// checking its depths never come out nearer than a higher resolution
+	// depth buffer of the same triangles, that no box it culls is visible
+	// in that buffer, and that threading doesn't change either
+	static void RunOcclusionBufferTests();
+
+	// Checks ParallelFor(), tiny jobs, nested and dependent jobs and
+	// outside threads on several worker counts, races thieves against
+	// a queue's owner, and checks background jobs are left to workers
+	static void RunJobSystemTests();
+
+	// Random allocate/free churn against a RangeAllocator, checking that
+	// ranges never overlap, compaction keeps every allocation's contents
+	// and freeing everything coalesces back into one block
+	static void RunRangeAllocatorTests();
+};
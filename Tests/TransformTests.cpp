@@ -0,0 +1,415 @@
+#include "Tests.h"
+#include "../Bounds.h"
+#include "../BufferStructs.h"
+#include "../Transform.h"
+#include "../TransformSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Largest difference between two matrices, relative to the expected
+	// element (or 1, for small ones)
+	float RelativeError(const XMFLOAT4X4& got, const XMFLOAT4X4& expected)
+	{
+		float maxError = 0.0f;
+		for (int e = 0; e < 16; e++)
+		{
+			float value = (&expected._11)[e];
+			maxError = std::max(maxError, fabsf((&got._11)[e] - value) / std::max(1.0f, fabsf(value)));
+		}
+		return maxError;
+	}
+
+	// Every world matrix recomposed from scratch, parents first - returns
+	// how many nodes were reached from the root
+	int ComposeReference(const TransformSystem& system, int root, std::vector<XMFLOAT4X4>& reference)
+	{
+		reference.assign(system.GetCapacity(), XMFLOAT4X4());
+		std::vector<int> queue(1, root);
+		for (size_t n = 0; n < queue.size(); n++)
+		{
+			int h = queue[n];
+			XMFLOAT3 p = system.GetPosition(h);
+			XMFLOAT3 r = system.GetRotation(h);
+			XMFLOAT3 s = system.GetScale(h);
+			XMMATRIX local = XMMatrixScaling(s.x, s.y, s.z) * XMMatrixRotationRollPitchYaw(r.x, r.y, r.z) * XMMatrixTranslation(p.x, p.y, p.z);
+			if (system.GetParent(h) >= 0)
+				local = local * XMLoadFloat4x4(&reference[system.GetParent(h)]);
+			XMStoreFloat4x4(&reference[h], local);
+			for (int child = system.GetFirstChild(h); child >= 0; child = system.GetNextSibling(child))
+				queue.push_back(child);
+		}
+		return (int)queue.size();
+	}
+}
+
+void Tests::RunTransformHierarchyTests()
+{
+	printf("--- Transform hierarchy ---\n");
+
+	const int NodeCount = 2000;
+	const char* ShapeNames[] = { "deep", "wide", "bushy" };
+	for (int shape = 0; shape < 3; shape++)
+	{
+		// Allocated in one order, linked in a shuffled one, so tree
+		// order and memory order don't line up
+		TransformSystem system(NodeCount);
+		std::vector<Transform*> transforms(NodeCount);
+		for (int i = 0; i < NodeCount; i++)
+			transforms[i] = new Transform(&system);
+		std::vector<int> order(NodeCount);
+		for (int i = 0; i < NodeCount; i++)
+			order[i] = i;
+		std::mt19937 rng(1234 + shape);
+		std::shuffle(order.begin() + 1, order.end(), rng);
+
+		for (int i = 0; i < NodeCount; i++)
+		{
+			Transform* t = transforms[order[i]];
+			t->SetPosition(0.01f * (i % 7), 0.01f, 0.02f * (i % 3));
+			t->SetRotation(0.001f * (i % 5), 0.002f, 0.0f);
+			if (i == 0)
+				continue;
+
+			int parent = shape == 0 ? i - 1 : shape == 1 ? 0 : (i - 1) / 4;
+			t->SetParent(transforms[order[parent]]);
+		}
+		Transform* root = transforms[order[0]];
+		system.Update();
+
+		// Moving the root dirties everything, and both ways of rebuilding
+		// (node by node, or the system's single pass) must agree with a
+		// from-scratch composition
+		// - The SIMD sine/cosine rounds slightly differently from the
+		//   scalar one, and that compounds down the deep chain
+		std::vector<XMFLOAT4X4> reference;
+		root->Rotate(0.0f, 0.01f, 0.0f);
+		int reached = ComposeReference(system, root->GetHandle(), reference);
+		float lazyError = 0.0f;
+		for (Transform* t : transforms)
+			lazyError = std::max(lazyError, RelativeError(t->GetWorldMatrix(), reference[t->GetHandle()]));
+
+		root->Rotate(0.0f, 0.01f, 0.0f);
+		int rootDirty = system.Update();
+		ComposeReference(system, root->GetHandle(), reference);
+		float flatError = 0.0f;
+		for (Transform* t : transforms)
+			flatError = std::max(flatError, RelativeError(system.GetWorldMatrix(t->GetHandle()), reference[t->GetHandle()]));
+
+		Check(reached == NodeCount && rootDirty == NodeCount && lazyError < 1e-3f && flatError < 1e-3f,
+			"%s: root moved, %d of %d nodes rebuilt, error %g lazy, %g batched", ShapeNames[shape], rootDirty, NodeCount, lazyError, flatError);
+
+		// A few scattered nodes move - only their subtrees are rebuilt,
+		// and everything still matches
+		std::uniform_int_distribution<int> pick(0, NodeCount - 1);
+		for (int n = 0; n < NodeCount / 100; n++)
+			transforms[pick(rng)]->MoveAbsolute(0.0f, 0.001f, 0.0f);
+		int scatteredDirty = system.Update();
+		ComposeReference(system, root->GetHandle(), reference);
+		float scatteredError = 0.0f;
+		for (Transform* t : transforms)
+			scatteredError = std::max(scatteredError, RelativeError(system.GetWorldMatrix(t->GetHandle()), reference[t->GetHandle()]));
+
+		Check(scatteredDirty > 0 && scatteredDirty <= NodeCount && scatteredError < 1e-3f && system.Update() == 0,
+			"%s: 1%% moved, %d nodes rebuilt, error %g, nothing left dirty", ShapeNames[shape], scatteredDirty, scatteredError);
+
+		for (Transform* t : transforms)
+			delete t;
+	}
+}
+
+void Tests::RunTransformSystemTests()
+{
+	printf("--- TransformSystem ---\n");
+
+	// Random transforms, with a count that doesn't fill the last batch
+	const int Count = 10003;
+	TransformSystem system(Count);
+	std::vector<int> handles(Count);
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+	std::vector<XMFLOAT4X4> reference(Count);
+	for (int i = 0; i < Count; i++)
+	{
+		handles[i] = system.Create();
+		XMFLOAT3 p(position(rng), position(rng), position(rng));
+		XMFLOAT3 r(angle(rng), angle(rng), angle(rng));
+		XMFLOAT3 s(scale(rng), scale(rng), scale(rng));
+		system.SetPosition(handles[i], p.x, p.y, p.z);
+		system.SetRotation(handles[i], r.x, r.y, r.z);
+		system.SetScale(handles[i], s.x, s.y, s.z);
+
+		// One object at a time, the way Transform used to build them
+		XMStoreFloat4x4(&reference[i], XMMatrixScaling(s.x, s.y, s.z) * XMMatrixRotationRollPitchYaw(r.x, r.y, r.z) * XMMatrixTranslation(p.x, p.y, p.z));
+	}
+
+	// Every transform dirty each time, on one thread and then on several
+	int threadCounts[2] = { 1, 4 };
+	for (int threads : threadCounts)
+	{
+		for (int i = 0; i < Count; i++)
+			system.MarkDirty(handles[i]);
+		int rebuilt = system.Update(threads);
+
+		float maxError = 0.0f;
+		for (int i = 0; i < Count; i++)
+			maxError = std::max(maxError, RelativeError(system.GetWorldMatrix(handles[i]), reference[i]));
+		Check(rebuilt == Count && maxError < 1e-3f,
+			"%d thread(s): %d of %d rebuilt, max error vs. scalar %g", threads, rebuilt, Count, maxError);
+	}
+}
+
+void Tests::RunTransformBasisTests()
+{
+	printf("--- Transform basis ---\n");
+
+	const int TransformCount = 256;
+	TransformSystem system(TransformCount);
+	std::vector<Transform*> transforms(TransformCount);
+	std::vector<XMFLOAT3> angles(TransformCount);
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	for (int t = 0; t < TransformCount; t++)
+	{
+		transforms[t] = new Transform(&system);
+		angles[t] = XMFLOAT3(angle(rng), angle(rng), angle(rng));
+		transforms[t]->SetRotation(angles[t].x, angles[t].y, angles[t].z);
+	}
+	system.Update();
+
+	// The old way: a quaternion from the angles on every call
+	auto rotate = [](const XMFLOAT3& angles, float x, float y, float z)
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVector3Rotate(XMVectorSet(x, y, z, 0), XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z)));
+		return result;
+	};
+	auto distance = [](const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&a), XMLoadFloat3(&b))));
+	};
+
+	// The cached axes against rotating each unit vector
+	float basisError = 0.0f;
+	for (int t = 0; t < TransformCount; t++)
+	{
+		basisError = std::max(basisError, distance(transforms[t]->GetLocalRight(), rotate(angles[t], 1, 0, 0)));
+		basisError = std::max(basisError, distance(transforms[t]->GetLocalUp(), rotate(angles[t], 0, 1, 0)));
+		basisError = std::max(basisError, distance(transforms[t]->GetLocalForward(), rotate(angles[t], 0, 0, 1)));
+	}
+	Check(basisError < 1e-5f, "Cached right, up and forward match the rotation (max error %g)", basisError);
+
+	// Relative moves land where the rotated offset says, leave the world
+	// matrix to be rebuilt, and it then sits at the new position
+	const int MovesPerTransform = 10;
+	float moveError = 0.0f;
+	bool moveMarksDirty = true;
+	bool worldFollows = true;
+	for (int t = 0; t < TransformCount; t++)
+	{
+		XMFLOAT3 expected = transforms[t]->GetPosition();
+		XMFLOAT3 step = rotate(angles[t], 0.1f, 0.2f, 0.3f);
+		for (int m = 0; m < MovesPerTransform; m++)
+		{
+			transforms[t]->MoveRelative(0.1f, 0.2f, 0.3f);
+			expected.x += step.x;
+			expected.y += step.y;
+			expected.z += step.z;
+		}
+		XMFLOAT3 position = transforms[t]->GetPosition();
+		moveError = std::max(moveError, distance(position, expected));
+		moveMarksDirty = moveMarksDirty && system.IsDirty(transforms[t]->GetHandle());
+
+		XMFLOAT4X4 world = transforms[t]->GetWorldMatrix();
+		worldFollows = worldFollows && world._41 == position.x && world._42 == position.y && world._43 == position.z;
+	}
+	Check(moveError < 1e-4f && moveMarksDirty && worldFollows,
+		"MoveRelative() follows the rotation (max error %g), marks dirty and moves the world matrix", moveError);
+
+	Transform* first = transforms[0];
+	first->SetScale(1.0f, 2.0f, 3.0f);
+	system.Update();
+	first->Scale(2.0f, 2.0f, 2.0f);
+	XMFLOAT3 scale = first->GetScale();
+	Check(system.IsDirty(first->GetHandle()) && scale.x == 2.0f && scale.y == 4.0f && scale.z == 6.0f,
+		"Scale() multiplies (%g, %g, %g) and marks dirty", scale.x, scale.y, scale.z);
+
+	for (Transform* t : transforms)
+		delete t;
+}
+
+void Tests::RunTransformVersionTests()
+{
+	printf("--- Transform versions ---\n");
+
+	// One object in a hundred moves every frame, and carries four
+	// children that never move themselves
+	const int ObjectCount = 1000;
+	const int FrameCount = 20;
+	const int ChildrenPerMover = 4;
+	const int MoverCount = ObjectCount / 100;
+	TransformSystem system(ObjectCount);
+	std::vector<Transform*> transforms(ObjectCount);
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		transforms[i] = new Transform(&system);
+		transforms[i]->SetPosition((float)(i % 100), 0.0f, (float)(i / 100));
+	}
+	for (int m = 0; m < MoverCount; m++)
+		for (int c = 0; c < ChildrenPerMover; c++)
+			transforms[MoverCount + m * ChildrenPerMover + c]->SetParent(transforms[m]);
+	system.Update();
+
+	// Uploads and world bounds redone every frame, or only when the
+	// version changed - both must end up identical, and only the movers
+	// and their children should be redone after the first frame
+	AABB box = { XMFLOAT3(-1, -1, -1), XMFLOAT3(1, 1, 1) };
+	std::vector<VertexShaderPerObjectData> alwaysUploads(ObjectCount), versionedUploads(ObjectCount);
+	std::vector<AABB> alwaysBounds(ObjectCount), versionedBounds(ObjectCount);
+	std::vector<unsigned int> seenVersions(ObjectCount, 0);
+	int mismatchedFrames = 0;
+	int wrongUploadFrames = 0;
+	for (int f = 0; f < FrameCount; f++)
+	{
+		for (int m = 0; m < MoverCount; m++)
+			transforms[m]->Rotate(0.0f, 0.01f, 0.0f);
+		system.Update();
+
+		int uploads = 0;
+		for (int i = 0; i < ObjectCount; i++)
+		{
+			alwaysUploads[i].worldMatrix = transforms[i]->GetWorldMatrix();
+			alwaysBounds[i] = Bounds::TransformAABB(box, alwaysUploads[i].worldMatrix);
+
+			unsigned int version = transforms[i]->GetVersion();
+			if (version == seenVersions[i])
+				continue;
+			versionedUploads[i].worldMatrix = transforms[i]->GetWorldMatrix();
+			versionedBounds[i] = Bounds::TransformAABB(box, versionedUploads[i].worldMatrix);
+			seenVersions[i] = version;
+			uploads++;
+		}
+
+		if (memcmp(alwaysUploads.data(), versionedUploads.data(), ObjectCount * sizeof(VertexShaderPerObjectData)) != 0 ||
+			memcmp(alwaysBounds.data(), versionedBounds.data(), ObjectCount * sizeof(AABB)) != 0)
+			mismatchedFrames++;
+		if (uploads != (f == 0 ? ObjectCount : MoverCount * (1 + ChildrenPerMover)))
+			wrongUploadFrames++;
+	}
+	Check(mismatchedFrames == 0, "Versioned uploads and bounds match redoing everything (%d of %d frames don't)", mismatchedFrames, FrameCount);
+	Check(wrongUploadFrames == 0, "Only movers and their children are redone after the first frame (%d frames wrong)", wrongUploadFrames);
+
+	// Nothing moves - nothing changes
+	system.Update();
+	bool unchanged = true;
+	for (int i = 0; i < ObjectCount; i++)
+		unchanged = unchanged && transforms[i]->GetVersion() == seenVersions[i];
+	Check(unchanged, "An idle frame changes no versions");
+
+	// A reused slot never matches its previous owner's version
+	int slot = transforms.back()->GetHandle();
+	unsigned int oldVersion = transforms.back()->GetVersion();
+	delete transforms.back();
+	transforms.back() = new Transform(&system);
+	Check(transforms.back()->GetHandle() != slot || transforms.back()->GetVersion() != oldVersion,
+		"A new transform in a reused slot gets a new version (%u, was %u)", transforms.back()->GetVersion(), oldVersion);
+
+	for (Transform* t : transforms)
+		delete t;
+}
+
+void Tests::RunObjectMatricesTests()
+{
+	printf("--- Object matrices ---\n");
+
+	// Random placements, a quarter of them parented to an earlier one,
+	// with every 16th mirrored on one axis and the last one flattened
+	const int ObjectCount = 1001;
+	TransformSystem system(ObjectCount);
+	std::vector<Transform*> transforms(ObjectCount);
+	std::mt19937 rng(777);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(0.2f, 5.0f);
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		transforms[i] = new Transform(&system);
+		transforms[i]->SetPosition(position(rng), position(rng), position(rng));
+		transforms[i]->SetRotation(angle(rng), angle(rng), angle(rng));
+		transforms[i]->SetScale(scale(rng) * (i % 16 == 5 ? -1.0f : 1.0f), scale(rng), scale(rng));
+		if (i > 0 && i % 4 == 0)
+			transforms[i]->SetParent(transforms[std::uniform_int_distribution<int>(0, i - 1)(rng)]);
+	}
+	Transform* flattened = transforms[ObjectCount - 1];
+	flattened->SetScale(1.0f, 0.0f, 1.0f);
+	system.Update();
+
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(
+		XMMatrixLookToLH(XMVectorSet(0, 10, -100, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f)));
+
+	// Shuffled handles, in a count that isn't a multiple of four, with
+	// the flattened one first
+	std::vector<int> handles(ObjectCount);
+	for (int i = 0; i < ObjectCount; i++)
+		handles[i] = transforms[i]->GetHandle();
+	std::shuffle(handles.begin(), handles.end(), rng);
+	std::swap(*std::find(handles.begin(), handles.end(), flattened->GetHandle()), handles.front());
+
+	std::vector<VertexShaderPerObjectData> batched(ObjectCount);
+	system.ComputeObjectMatrices(handles.data(), ObjectCount, viewProj, batched.data());
+
+	// One object at a time, relative to each matrix's largest element
+	// since scales vary a lot
+	XMMATRIX viewProjMatrix = XMLoadFloat4x4(&viewProj);
+	float maxError[3] = { 0, 0, 0 };
+	bool singularZeroed = true;
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		VertexShaderPerObjectData reference;
+		XMMATRIX world = XMLoadFloat4x4(&system.GetWorldMatrix(handles[i]));
+		XMStoreFloat4x4(&reference.worldMatrix, world);
+		XMStoreFloat4x4(&reference.worldViewProjMatrix, XMMatrixMultiply(world, viewProjMatrix));
+		XMMATRIX normal = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+		normal.r[0] = XMVectorSetW(normal.r[0], 0.0f);
+		normal.r[1] = XMVectorSetW(normal.r[1], 0.0f);
+		normal.r[2] = XMVectorSetW(normal.r[2], 0.0f);
+		normal.r[3] = XMVectorSet(0, 0, 0, 1);
+		XMStoreFloat4x4(&reference.normalMatrix, normal);
+
+		const XMFLOAT4X4* got[3] = { &batched[i].worldMatrix, &batched[i].worldViewProjMatrix, &batched[i].normalMatrix };
+		const XMFLOAT4X4* expected[3] = { &reference.worldMatrix, &reference.worldViewProjMatrix, &reference.normalMatrix };
+		if (handles[i] == flattened->GetHandle())
+		{
+			for (int e = 0; e < 12; e++)
+				singularZeroed = singularZeroed && (&got[2]->_11)[e] == 0.0f;
+			continue;
+		}
+		for (int m = 0; m < 3; m++)
+		{
+			float largest = 0.0f;
+			for (int e = 0; e < 16; e++)
+				largest = std::max(largest, fabsf((&expected[m]->_11)[e]));
+			for (int e = 0; e < 16; e++)
+				maxError[m] = std::max(maxError[m], fabsf((&got[m]->_11)[e] - (&expected[m]->_11)[e]) / std::max(largest, 1e-6f));
+		}
+	}
+
+	Check(maxError[0] == 0.0f, "World matrices copied exactly");
+	Check(maxError[1] < 1e-5f, "World-view-projection matches (max relative error %g)", maxError[1]);
+	Check(maxError[2] < 1e-4f, "Normal matrix matches, mirrored ones included (max relative error %g)", maxError[2]);
+	Check(singularZeroed, "A flattened transform gets a zeroed normal matrix");
+
+	for (Transform* t : transforms)
+		delete t;
+}
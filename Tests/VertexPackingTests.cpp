@@ -0,0 +1,63 @@
+#include "Tests.h"
+#include "../Mesh.h"
+#include "../ObjLoader.h"
+#include "../VertexPacking.h"
+
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+void Tests::RunVertexPackingTests()
+{
+	printf("--- VertexPacking ---\n");
+
+	for (const std::string& name : GetMeshFileNames())
+	{
+		std::string path = GetMeshPath(name.c_str());
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Check(ObjLoader::Load(path.c_str(), verts, indices) && !verts.empty(), "%s: loaded", name.c_str()))
+			continue;
+		Mesh::CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+
+		std::vector<PackedVertex> packed(verts.size());
+		VertexPacking::PackVertices(&verts[0], (int)verts.size(), &packed[0]);
+
+		// Round trip every vertex and track the worst error of each attribute
+		double maxNormalError = 0.0;
+		double maxTangentError = 0.0;
+		double maxUVExcess = 0.0;
+		float maxPositionError = 0.0f;
+		for (size_t i = 0; i < verts.size(); i++)
+		{
+			const Vertex& v = verts[i];
+			Vertex u = VertexPacking::Unpack(packed[i]);
+
+			maxPositionError = fmaxf(maxPositionError, fabsf(u.Position.x - v.Position.x));
+			maxPositionError = fmaxf(maxPositionError, fabsf(u.Position.y - v.Position.y));
+			maxPositionError = fmaxf(maxPositionError, fabsf(u.Position.z - v.Position.z));
+
+			// Degenerate tangents (from zero-area UVs) can't round trip meaningfully
+			if (IsUnitLength(v.Normal))
+				maxNormalError = fmax(maxNormalError, AngleBetween(v.Normal, u.Normal));
+			if (IsUnitLength(v.Tangent))
+				maxTangentError = fmax(maxTangentError, AngleBetween(v.Tangent, u.Tangent));
+
+			// How far past the allowed half float error each UV lands (<= 0 is good)
+			float uvIn[2] = { v.UV.x, v.UV.y };
+			float uvOut[2] = { u.UV.x, u.UV.y };
+			for (int c = 0; c < 2; c++)
+			{
+				double allowed = fmax(fabs(uvIn[c]) * PackedUVRelativeError, PackedUVAbsoluteError);
+				maxUVExcess = fmax(maxUVExcess, fabs(uvOut[c] - uvIn[c]) - allowed);
+			}
+		}
+
+		Check(maxPositionError == 0.0f, "%s: positions exact", name.c_str());
+		Check(maxNormalError <= PackedDirectionMaxErrorRadians && maxTangentError <= PackedDirectionMaxErrorRadians,
+			"%s: max error - normal %.2e rad, tangent %.2e rad (limit %.2e)",
+			name.c_str(), maxNormalError, maxTangentError, PackedDirectionMaxErrorRadians);
+		Check(maxUVExcess <= 0.0, "%s: UVs within half float error (worst %.2e over)", name.c_str(), maxUVExcess);
+	}
+}
@@ -1,86 +1,135 @@
 #include "Transform.h"
 
 
+Transform::Transform()
+{
+	system = &TransformSystem::GetDefault();
+	handle = system->Create(this);
+}
+
+Transform::Transform(TransformSystem* system)
+{
+	this->system = system;
+	handle = system->Create(this);
+}
+
+Transform::Transform(const Transform& other)
+{
+	system = other.system;
+	handle = system->Create(this);
+	*this = other;
+}
+
+Transform& Transform::operator=(const Transform& other)
+{
+	DirectX::XMFLOAT3 p = other.system->GetPosition(other.handle);
+	DirectX::XMFLOAT3 r = other.system->GetRotation(other.handle);
+	DirectX::XMFLOAT3 s = other.system->GetScale(other.handle);
+	system->SetPosition(handle, p.x, p.y, p.z);
+	system->SetRotation(handle, r.x, r.y, r.z);
+	system->SetScale(handle, s.x, s.y, s.z);
+	return *this;
+}
+
+Transform::Transform(Transform&& other) noexcept
+{
+	system = other.system;
+	handle = other.handle;
+	system->SetOwner(handle, this);
+	other.handle = -1;
+}
+
+Transform& Transform::operator=(Transform&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	if (handle >= 0)
+		system->Destroy(handle);
+	system = other.system;
+	handle = other.handle;
+	system->SetOwner(handle, this);
+	other.handle = -1;
+	return *this;
+}
+
+Transform::~Transform()
+{
+	// Moved-from transforms have nothing left to destroy
+	if (handle >= 0)
+		system->Destroy(handle);
+}
+
 void Transform::SetPosition(float x, float y, float z)
 {
-	position = DirectX::XMFLOAT3(x, y, z);
-	isDirty = true;
+	system->SetPosition(handle, x, y, z);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-	scale = DirectX::XMFLOAT3(x, y, z);
-	isDirty = true;
+	system->SetScale(handle, x, y, z);
 }
 
 void Transform::SetRotation(float pitch, float yaw, float roll)
 {
-	rotation = DirectX::XMFLOAT3(pitch, yaw, roll);
-	isDirty = true;
+	system->SetRotation(handle, pitch, yaw, roll);
 }
 
 DirectX::XMFLOAT3 Transform::GetPosition()
 {
-	return position;
+	return system->GetPosition(handle);
 }
 
 DirectX::XMFLOAT3 Transform::GetRotation()
 {
-	return rotation;
+	return system->GetRotation(handle);
 }
 
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	return system->GetScale(handle);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	if (isDirty)
-	{
-		DirectX::XMMATRIX world = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z)
-			* DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) 
-			* DirectX::XMMatrixTranslation(position.x, position.y, position.z);
-		XMStoreFloat4x4(&worldMatrix, world);
-		isDirty = false;
-	}
-	return worldMatrix;
+	return system->GetWorldMatrix(handle);
+}
+
+unsigned int Transform::GetVersion() const
+{
+	return system->GetVersion(handle);
 }
 
 void Transform::MoveAbsolute(float x, float y, float z)
 {
-	position = DirectX::XMFLOAT3(position.x + x, position.y + y, position.z + z);
-	isDirty = true;
+	DirectX::XMFLOAT3 position = system->GetPosition(handle);
+	system->SetPosition(handle, position.x + x, position.y + y, position.z + z);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	DirectX::XMVECTOR moveVector = DirectX::XMVectorSet(x, y, z, 0);
-	DirectX::XMVECTOR rotationVector = DirectX::XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	moveVector = DirectX::XMVector3Rotate(moveVector, rotationVector);
-
-	DirectX::XMVECTOR posVector = DirectX::XMLoadFloat3(&position);
-	posVector = DirectX::XMVectorAdd(moveVector, posVector);
-	DirectX::XMStoreFloat3(&position, posVector);
+	DirectX::XMFLOAT3 move = LocalToWorld(x, y, z);
+	DirectX::XMFLOAT3 position = system->GetPosition(handle);
+	system->SetPosition(handle, position.x + move.x, position.y + move.y, position.z + move.z);
 }
 
 void Transform::Rotate(float pitch, float yaw, float roll)
 {
-	rotation = DirectX::XMFLOAT3(rotation.x + pitch, rotation.y + yaw, rotation.z + roll);
-	isDirty = true;
+	DirectX::XMFLOAT3 rotation = system->GetRotation(handle);
+	system->SetRotation(handle, rotation.x + pitch, rotation.y + yaw, rotation.z + roll);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
-	scale = DirectX::XMFLOAT3(scale.x, scale.y, scale.z);
-	isDirty = true;
+	DirectX::XMFLOAT3 scale = system->GetScale(handle);
+	system->SetScale(handle, scale.x * x, scale.y * y, scale.z * z);
 }
 
 DirectX::XMFLOAT3 Transform::LocalToWorld(float x, float y, float z) const
 {
+	DirectX::XMFLOAT4 rotation = system->GetRotationQuaternion(handle);
 	DirectX::XMVECTOR vec = DirectX::XMVectorSet(x, y, z, 0);
-	DirectX::XMVECTOR rotationVector = DirectX::XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	vec = DirectX::XMVector3Rotate(vec, rotationVector);
+	vec = DirectX::XMVector3Rotate(vec, DirectX::XMLoadFloat4(&rotation));
 	DirectX::XMFLOAT3 returnVal;
 	DirectX::XMStoreFloat3(&returnVal, vec);
 	return returnVal;
@@ -89,15 +138,54 @@ DirectX::XMFLOAT3 Transform::LocalToWorld(float x, float y, float z) const
 
 DirectX::XMFLOAT3 Transform::GetLocalForward() const
 {
-	return LocalToWorld(0.f, 0.f, 1.f);
+	return system->GetBasis(handle).forward;
 }
 
 DirectX::XMFLOAT3 Transform::GetLocalRight() const
 {
-	return LocalToWorld(1.f, 0.f, 0.f);
+	return system->GetBasis(handle).right;
 }
 
 DirectX::XMFLOAT3 Transform::GetLocalUp() const
 {
-	return LocalToWorld(0.f, 1.f, 0.f);
-}
\ No newline at end of file
+	return system->GetBasis(handle).up;
+}
+
+bool Transform::SetParent(Transform* newParent)
+{
+	if (newParent != nullptr && newParent->system != system)
+		return false;
+	return system->SetParent(handle, newParent != nullptr ? newParent->handle : -1);
+}
+
+Transform* Transform::GetParent() const
+{
+	int parent = system->GetParent(handle);
+	return parent >= 0 ? (Transform*)system->GetOwner(parent) : nullptr;
+}
+
+int Transform::GetChildCount() const
+{
+	int count = 0;
+	for (int child = system->GetFirstChild(handle); child >= 0; child = system->GetNextSibling(child))
+		count++;
+	return count;
+}
+
+Transform* Transform::GetChild(int index) const
+{
+	int child = system->GetFirstChild(handle);
+	for (int i = 0; i < index && child >= 0; i++)
+		child = system->GetNextSibling(child);
+	return child >= 0 ? (Transform*)system->GetOwner(child) : nullptr;
+}
+
+TransformSystem* Transform::GetSystem() const
+{
+	return system;
+}
+
+int Transform::GetHandle() const
+{
+	return handle;
+}
@@ -1,15 +1,41 @@
 #pragma once
 
+#include "TransformSystem.h"
 #include <DirectXMath.h>
 
+// --------------------------------------------------------
+// Position, rotation and scale of an object, optionally
+// relative to a parent Transform
+//
+// - The data itself lives in a TransformSystem (the default
+//   one unless another is given) - this is a view of one slot
+// - The world matrix is the local one composed with the
+//   parent's world matrix, rebuilt lazily when dirty (or for
+//   everything at once by TransformSystem::Update)
+// - Changing a transform marks its whole subtree dirty, so
+//   children follow their parents without any re-syncing
+// - Rotations are kept as quaternions, and the local axes are
+//   cached with the world matrix, so the GetLocal*() helpers
+//   don't rebuild a rotation on every call
+// - Copying a transform copies its local values only, never
+//   its place in a hierarchy; moving one hands over its slot,
+//   hierarchy and all (so transforms can live in containers
+//   that move their elements, like EntityWorld's chunks)
+// --------------------------------------------------------
 class Transform
 {
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 scale;
-	DirectX::XMFLOAT3 rotation;
-	bool isDirty;
+	TransformSystem* system;
+	int handle;
+
 public:
+	Transform();
+	Transform(TransformSystem* system);
+	Transform(const Transform& other);
+	Transform& operator=(const Transform& other);
+	Transform(Transform&& other) noexcept;
+	Transform& operator=(Transform&& other) noexcept;
+	~Transform();
+
 	void SetPosition(float x, float y, float z);
 	void SetRotation(float pitch, float yaw, float roll);
 	void SetScale(float x, float y, float z);
@@ -19,14 +45,31 @@ public:
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 
+	// Changes whenever the world matrix does (including when a parent
+	// moves) - compare against the value from the last time the matrix
+	// was used to tell whether it needs using again
+	unsigned int GetVersion() const;
+
 	void MoveAbsolute(float x, float y, float z);
 	void MoveRelative(float x, float y, float z);
 	void Rotate(float pitch, float yaw, float roll);
+	// Multiplies the current scale
 	void Scale(float x, float y, float z);
 
 	DirectX::XMFLOAT3 LocalToWorld(float x, float y, float z) const;
 	DirectX::XMFLOAT3 GetLocalForward() const;
 	DirectX::XMFLOAT3 GetLocalRight() const;
 	DirectX::XMFLOAT3 GetLocalUp() const;
-};
 
+	// Parent/child links - the local values are kept as they are, so
+	// a transform moves along with its new parent.  Returns false (and
+	// changes nothing) if that would make a cycle, or if the two live
+	// in different systems.  Null detaches.
+	bool SetParent(Transform* newParent);
+	Transform* GetParent() const;
+	int GetChildCount() const;
+	Transform* GetChild(int index) const;
+
+	TransformSystem* GetSystem() const;
+	int GetHandle() const;
+};
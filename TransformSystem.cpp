@@ -0,0 +1,506 @@
+#include "TransformSystem.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Below this, another job costs more than it saves
+	const int MinGroupsPerJob = 1024;
+}
+
+TransformSystem::TransformSystem(int initialCapacity)
+{
+	liveCount = 0;
+	hierarchyChanged = false;
+
+	// Hand out low slots first
+	int capacity = std::max(4, (initialCapacity + 3) / 4 * 4);
+	for (int i = capacity - 1; i >= 0; i--)
+		freeSlots.push_back(i);
+	Resize(capacity);
+}
+
+void TransformSystem::Resize(int capacity)
+{
+	positionX.resize(capacity); positionY.resize(capacity); positionZ.resize(capacity);
+	rotationX.resize(capacity); rotationY.resize(capacity); rotationZ.resize(capacity); rotationW.resize(capacity);
+	scaleX.resize(capacity); scaleY.resize(capacity); scaleZ.resize(capacity);
+	pitch.resize(capacity); yaw.resize(capacity); roll.resize(capacity);
+	worldMatrices.resize(capacity);
+	bases.resize(capacity);
+	dirty.resize(capacity, 0);
+	versions.resize(capacity, 0);
+	alive.resize(capacity, 0);
+	owners.resize(capacity, nullptr);
+	parents.resize(capacity, -1);
+	firstChild.resize(capacity, -1);
+	nextSibling.resize(capacity, -1);
+}
+
+void TransformSystem::Grow()
+{
+	// Double, keeping a multiple of four
+	int oldCapacity = GetCapacity();
+	int capacity = oldCapacity * 2;
+	for (int i = capacity - 1; i >= oldCapacity; i--)
+		freeSlots.push_back(i);
+	Resize(capacity);
+}
+
+int TransformSystem::Create(void* owner)
+{
+	if (freeSlots.empty())
+		Grow();
+
+	int handle = freeSlots.back();
+	freeSlots.pop_back();
+	liveCount++;
+
+	positionX[handle] = positionY[handle] = positionZ[handle] = 0.0f;
+	rotationX[handle] = rotationY[handle] = rotationZ[handle] = 0.0f;
+	rotationW[handle] = 1.0f;
+	scaleX[handle] = scaleY[handle] = scaleZ[handle] = 1.0f;
+	pitch[handle] = yaw[handle] = roll[handle] = 0.0f;
+	XMStoreFloat4x4(&worldMatrices[handle], XMMatrixIdentity());
+	dirty[handle] = 1;
+	versions[handle]++;
+	alive[handle] = 1;
+	owners[handle] = owner;
+	parents[handle] = -1;
+	firstChild[handle] = -1;
+	nextSibling[handle] = -1;
+	return handle;
+}
+
+void TransformSystem::Destroy(int handle)
+{
+	DetachFromParent(handle);
+
+	// Children become roots where they are
+	for (int child = firstChild[handle]; child >= 0; )
+	{
+		int next = nextSibling[child];
+		parents[child] = -1;
+		nextSibling[child] = -1;
+		MarkDirty(child);
+		child = next;
+		hierarchyChanged = true;
+	}
+
+	firstChild[handle] = -1;
+	dirty[handle] = 0;
+	alive[handle] = 0;
+	owners[handle] = nullptr;
+	freeSlots.push_back(handle);
+	liveCount--;
+}
+
+int TransformSystem::GetCount() const
+{
+	return liveCount;
+}
+
+int TransformSystem::GetCapacity() const
+{
+	return (int)alive.size();
+}
+
+void* TransformSystem::GetOwner(int handle) const
+{
+	return owners[handle];
+}
+
+void TransformSystem::SetOwner(int handle, void* owner)
+{
+	owners[handle] = owner;
+}
+
+void TransformSystem::SetPosition(int handle, float x, float y, float z)
+{
+	positionX[handle] = x;
+	positionY[handle] = y;
+	positionZ[handle] = z;
+	MarkDirty(handle);
+}
+
+void TransformSystem::SetRotation(int handle, float p, float y, float r)
+{
+	pitch[handle] = p;
+	yaw[handle] = y;
+	roll[handle] = r;
+
+	XMFLOAT4 q;
+	XMStoreFloat4(&q, XMQuaternionRotationRollPitchYaw(p, y, r));
+	rotationX[handle] = q.x;
+	rotationY[handle] = q.y;
+	rotationZ[handle] = q.z;
+	rotationW[handle] = q.w;
+	MarkDirty(handle);
+}
+
+void TransformSystem::SetScale(int handle, float x, float y, float z)
+{
+	scaleX[handle] = x;
+	scaleY[handle] = y;
+	scaleZ[handle] = z;
+	MarkDirty(handle);
+}
+
+XMFLOAT3 TransformSystem::GetPosition(int handle) const
+{
+	return XMFLOAT3(positionX[handle], positionY[handle], positionZ[handle]);
+}
+
+XMFLOAT3 TransformSystem::GetRotation(int handle) const
+{
+	return XMFLOAT3(pitch[handle], yaw[handle], roll[handle]);
+}
+
+XMFLOAT3 TransformSystem::GetScale(int handle) const
+{
+	return XMFLOAT3(scaleX[handle], scaleY[handle], scaleZ[handle]);
+}
+
+XMFLOAT4 TransformSystem::GetRotationQuaternion(int handle) const
+{
+	return XMFLOAT4(rotationX[handle], rotationY[handle], rotationZ[handle], rotationW[handle]);
+}
+
+void TransformSystem::MarkDirty(int handle)
+{
+	// Anything below a dirty slot is already dirty
+	if (dirty[handle])
+		return;
+	dirty[handle] = 1;
+	versions[handle]++;
+	if (firstChild[handle] < 0)
+		return;
+
+	// Iterative, since hierarchies can be very deep
+	std::vector<int> stack;
+	stack.push_back(firstChild[handle]);
+	while (!stack.empty())
+	{
+		int child = stack.back();
+		stack.pop_back();
+		for (; child >= 0; child = nextSibling[child])
+		{
+			if (dirty[child])
+				continue;
+			dirty[child] = 1;
+			versions[child]++;
+			if (firstChild[child] >= 0)
+				stack.push_back(firstChild[child]);
+		}
+	}
+}
+
+bool TransformSystem::IsDirty(int handle) const
+{
+	return dirty[handle] != 0;
+}
+
+unsigned int TransformSystem::GetVersion(int handle) const
+{
+	return versions[handle];
+}
+
+void TransformSystem::ComputeWorldMatrix(int handle)
+{
+	XMMATRIX rotation = XMMatrixRotationQuaternion(XMVectorSet(rotationX[handle], rotationY[handle], rotationZ[handle], rotationW[handle]));
+	XMStoreFloat3(&bases[handle].right, rotation.r[0]);
+	XMStoreFloat3(&bases[handle].up, rotation.r[1]);
+	XMStoreFloat3(&bases[handle].forward, rotation.r[2]);
+
+	XMMATRIX world = XMMatrixScaling(scaleX[handle], scaleY[handle], scaleZ[handle])
+		* rotation
+		* XMMatrixTranslation(positionX[handle], positionY[handle], positionZ[handle]);
+	if (parents[handle] >= 0)
+		world = world * XMLoadFloat4x4(&worldMatrices[parents[handle]]);
+	XMStoreFloat4x4(&worldMatrices[handle], world);
+	dirty[handle] = 0;
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldMatrix(int handle)
+{
+	if (dirty[handle])
+	{
+		// Dirty ancestors form an unbroken chain up from here, and have
+		// to be rebuilt top down (without recursion - chains can be long)
+		int parent = parents[handle];
+		if (parent >= 0 && dirty[parent])
+		{
+			std::vector<int> chain;
+			for (int p = parent; p >= 0 && dirty[p]; p = parents[p])
+				chain.push_back(p);
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+				ComputeWorldMatrix(*it);
+		}
+		ComputeWorldMatrix(handle);
+	}
+	return worldMatrices[handle];
+}
+
+const TransformBasis& TransformSystem::GetBasis(int handle)
+{
+	if (dirty[handle])
+		GetWorldMatrix(handle);
+	return bases[handle];
+}
+
+void TransformSystem::DetachFromParent(int handle)
+{
+	int parent = parents[handle];
+	if (parent < 0)
+		return;
+
+	int* link = &firstChild[parent];
+	while (*link != handle)
+		link = &nextSibling[*link];
+	*link = nextSibling[handle];
+
+	parents[handle] = -1;
+	nextSibling[handle] = -1;
+	hierarchyChanged = true;
+}
+
+bool TransformSystem::SetParent(int handle, int parent)
+{
+	if (parent == parents[handle])
+		return true;
+
+	// Can't be parented to itself or to anything below it (nothing is
+	// below a leaf, which saves walking up long chains as they're built)
+	if (parent == handle)
+		return false;
+	for (int p = parent; p >= 0 && firstChild[handle] >= 0; p = parents[p])
+	{
+		if (p == handle)
+			return false;
+	}
+
+	DetachFromParent(handle);
+	if (parent >= 0)
+	{
+		// Appended, so children keep the order they were added in
+		int* link = &firstChild[parent];
+		while (*link >= 0)
+			link = &nextSibling[*link];
+		*link = handle;
+		parents[handle] = parent;
+		hierarchyChanged = true;
+	}
+
+	// Force the subtree dirty, even if this slot already was
+	dirty[handle] = 0;
+	MarkDirty(handle);
+	return true;
+}
+
+int TransformSystem::GetParent(int handle) const
+{
+	return parents[handle];
+}
+
+int TransformSystem::GetFirstChild(int handle) const
+{
+	return firstChild[handle];
+}
+
+int TransformSystem::GetNextSibling(int handle) const
+{
+	return nextSibling[handle];
+}
+
+void TransformSystem::RebuildChildOrder()
+{
+	// One depth level at a time, starting from the children of the
+	// roots - each level is sorted so it walks memory forwards
+	childOrder.clear();
+	for (int i = 0; i < GetCapacity(); i++)
+	{
+		if (alive[i] && parents[i] < 0)
+		{
+			for (int child = firstChild[i]; child >= 0; child = nextSibling[child])
+				childOrder.push_back(child);
+		}
+	}
+
+	size_t levelStart = 0;
+	while (levelStart < childOrder.size())
+	{
+		size_t levelEnd = childOrder.size();
+		std::sort(childOrder.begin() + levelStart, childOrder.begin() + levelEnd);
+		for (size_t i = levelStart; i < levelEnd; i++)
+		{
+			for (int child = firstChild[childOrder[i]]; child >= 0; child = nextSibling[child])
+				childOrder.push_back(child);
+		}
+		levelStart = levelEnd;
+	}
+
+	hierarchyChanged = false;
+}
+
+int TransformSystem::ComputeLocalMatrices(int begin, int end)
+{
+	int rebuilt = 0;
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorReplicate(1.0f);
+	for (int i = begin; i < end; i += 4)
+	{
+		// Skip whole groups of four that are all clean
+		uint32_t flags;
+		memcpy(&flags, &dirty[i], sizeof(flags));
+		if (flags == 0)
+			continue;
+
+		XMVECTOR qx = XMLoadFloat4((const XMFLOAT4*)&rotationX[i]);
+		XMVECTOR qy = XMLoadFloat4((const XMFLOAT4*)&rotationY[i]);
+		XMVECTOR qz = XMLoadFloat4((const XMFLOAT4*)&rotationZ[i]);
+		XMVECTOR qw = XMLoadFloat4((const XMFLOAT4*)&rotationW[i]);
+
+		// The rows of XMMatrixRotationQuaternion, four slots per vector
+		XMVECTOR x2 = XMVectorAdd(qx, qx);
+		XMVECTOR y2 = XMVectorAdd(qy, qy);
+		XMVECTOR z2 = XMVectorAdd(qz, qz);
+		XMVECTOR xx = XMVectorMultiply(qx, x2), yy = XMVectorMultiply(qy, y2), zz = XMVectorMultiply(qz, z2);
+		XMVECTOR xy = XMVectorMultiply(qx, y2), xz = XMVectorMultiply(qx, z2), yz = XMVectorMultiply(qy, z2);
+		XMVECTOR wx = XMVectorMultiply(qw, x2), wy = XMVectorMultiply(qw, y2), wz = XMVectorMultiply(qw, z2);
+		XMVECTOR r00 = XMVectorSubtract(one, XMVectorAdd(yy, zz));
+		XMVECTOR r01 = XMVectorAdd(xy, wz);
+		XMVECTOR r02 = XMVectorSubtract(xz, wy);
+		XMVECTOR r10 = XMVectorSubtract(xy, wz);
+		XMVECTOR r11 = XMVectorSubtract(one, XMVectorAdd(xx, zz));
+		XMVECTOR r12 = XMVectorAdd(yz, wx);
+		XMVECTOR r20 = XMVectorAdd(xz, wy);
+		XMVECTOR r21 = XMVectorSubtract(yz, wx);
+		XMVECTOR r22 = XMVectorSubtract(one, XMVectorAdd(xx, yy));
+
+		// Transposing each set of rows turns four slots' worth of one
+		// row into one row for each of four slots - the unscaled rows
+		// are the basis, and the scaled ones go into the matrix
+		XMMATRIX right = XMMatrixTranspose(XMMATRIX(r00, r01, r02, zero));
+		XMMATRIX up = XMMatrixTranspose(XMMATRIX(r10, r11, r12, zero));
+		XMMATRIX forward = XMMatrixTranspose(XMMATRIX(r20, r21, r22, zero));
+		XMMATRIX translation = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat4((const XMFLOAT4*)&positionX[i]),
+			XMLoadFloat4((const XMFLOAT4*)&positionY[i]),
+			XMLoadFloat4((const XMFLOAT4*)&positionZ[i]),
+			one));
+
+		// Only dirty slots are written - a clean child's matrix
+		// already has its parent applied
+		for (int k = 0; k < 4; k++)
+		{
+			if (!dirty[i + k])
+				continue;
+			TransformBasis& basis = bases[i + k];
+			XMStoreFloat3(&basis.right, right.r[k]);
+			XMStoreFloat3(&basis.up, up.r[k]);
+			XMStoreFloat3(&basis.forward, forward.r[k]);
+
+			XMFLOAT4X4& world = worldMatrices[i + k];
+			XMStoreFloat4((XMFLOAT4*)&world._11, XMVectorScale(right.r[k], scaleX[i + k]));
+			XMStoreFloat4((XMFLOAT4*)&world._21, XMVectorScale(up.r[k], scaleY[i + k]));
+			XMStoreFloat4((XMFLOAT4*)&world._31, XMVectorScale(forward.r[k], scaleZ[i + k]));
+			XMStoreFloat4((XMFLOAT4*)&world._41, translation.r[k]);
+			rebuilt++;
+		}
+	}
+	return rebuilt;
+}
+
+int TransformSystem::Update(int threadCount)
+{
+	if (hierarchyChanged)
+		RebuildChildOrder();
+
+	// Local matrices, as jobs over runs of whole groups of four (no
+	// more of them than threadCount)
+	int capacity = GetCapacity();
+	int groupCount = (capacity + 3) / 4;
+	int jobCount = std::max(1, threadCount);
+	int groupsPerJob = std::max(MinGroupsPerJob, (groupCount + jobCount - 1) / jobCount);
+	std::atomic<int> rebuilt(0);
+	JobSystem::GetDefault().ParallelFor(groupCount, groupsPerJob, [&](int firstGroup, int endGroup)
+	{
+		rebuilt.fetch_add(ComputeLocalMatrices(firstGroup * 4, std::min(capacity, endGroup * 4)), std::memory_order_relaxed);
+	});
+
+	// Then parents, shallowest first so each one is already final
+	for (int child : childOrder)
+	{
+		if (!dirty[child])
+			continue;
+		XMMATRIX world = XMLoadFloat4x4(&worldMatrices[child]) * XMLoadFloat4x4(&worldMatrices[parents[child]]);
+		XMStoreFloat4x4(&worldMatrices[child], world);
+	}
+
+	memset(dirty.data(), 0, dirty.size());
+	return rebuilt.load();
+}
+
+void TransformSystem::ComputeObjectMatrices(const int* handles, int count, const XMFLOAT4X4& viewProjection, VertexShaderPerObjectData* results)
+{
+	XMMATRIX viewProj = XMLoadFloat4x4(&viewProjection);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR identityRow3 = XMVectorSet(0, 0, 0, 1);
+	for (int i = 0; i < count; i += 4)
+	{
+		// World matrices (the last group padded with repeats) - the
+		// world-view-projections are one multiply each
+		int groupSize = std::min(4, count - i);
+		XMMATRIX worlds[4];
+		for (int k = 0; k < 4; k++)
+		{
+			const XMFLOAT4X4& world = GetWorldMatrix(handles[i + std::min(k, groupSize - 1)]);
+			worlds[k] = XMLoadFloat4x4(&world);
+			if (k < groupSize)
+			{
+				results[i + k].worldMatrix = world;
+				XMStoreFloat4x4(&results[i + k].worldViewProjMatrix, XMMatrixMultiply(worlds[k], viewProj));
+			}
+		}
+
+		// Each row of the upper 3x3, as x, y and z across four slots
+		XMMATRIX a = XMMatrixTranspose(XMMATRIX(worlds[0].r[0], worlds[1].r[0], worlds[2].r[0], worlds[3].r[0]));
+		XMMATRIX b = XMMatrixTranspose(XMMATRIX(worlds[0].r[1], worlds[1].r[1], worlds[2].r[1], worlds[3].r[1]));
+		XMMATRIX c = XMMatrixTranspose(XMMATRIX(worlds[0].r[2], worlds[1].r[2], worlds[2].r[2], worlds[3].r[2]));
+
+		// With rows a, b and c, the inverse transpose has rows
+		// b x c, c x a and a x b, over the determinant a . (b x c)
+		XMVECTOR bcX = XMVectorSubtract(XMVectorMultiply(b.r[1], c.r[2]), XMVectorMultiply(b.r[2], c.r[1]));
+		XMVECTOR bcY = XMVectorSubtract(XMVectorMultiply(b.r[2], c.r[0]), XMVectorMultiply(b.r[0], c.r[2]));
+		XMVECTOR bcZ = XMVectorSubtract(XMVectorMultiply(b.r[0], c.r[1]), XMVectorMultiply(b.r[1], c.r[0]));
+		XMVECTOR caX = XMVectorSubtract(XMVectorMultiply(c.r[1], a.r[2]), XMVectorMultiply(c.r[2], a.r[1]));
+		XMVECTOR caY = XMVectorSubtract(XMVectorMultiply(c.r[2], a.r[0]), XMVectorMultiply(c.r[0], a.r[2]));
+		XMVECTOR caZ = XMVectorSubtract(XMVectorMultiply(c.r[0], a.r[1]), XMVectorMultiply(c.r[1], a.r[0]));
+		XMVECTOR abX = XMVectorSubtract(XMVectorMultiply(a.r[1], b.r[2]), XMVectorMultiply(a.r[2], b.r[1]));
+		XMVECTOR abY = XMVectorSubtract(XMVectorMultiply(a.r[2], b.r[0]), XMVectorMultiply(a.r[0], b.r[2]));
+		XMVECTOR abZ = XMVectorSubtract(XMVectorMultiply(a.r[0], b.r[1]), XMVectorMultiply(a.r[1], b.r[0]));
+		XMVECTOR determinant = XMVectorAdd(XMVectorMultiply(a.r[0], bcX), XMVectorAdd(XMVectorMultiply(a.r[1], bcY), XMVectorMultiply(a.r[2], bcZ)));
+		XMVECTOR inverseDeterminant = XMVectorSelect(zero, XMVectorReciprocal(determinant), XMVectorNotEqual(determinant, zero));
+
+		XMMATRIX rows0 = XMMatrixTranspose(XMMATRIX(
+			XMVectorMultiply(bcX, inverseDeterminant), XMVectorMultiply(bcY, inverseDeterminant), XMVectorMultiply(bcZ, inverseDeterminant), zero));
+		XMMATRIX rows1 = XMMatrixTranspose(XMMATRIX(
+			XMVectorMultiply(caX, inverseDeterminant), XMVectorMultiply(caY, inverseDeterminant), XMVectorMultiply(caZ, inverseDeterminant), zero));
+		XMMATRIX rows2 = XMMatrixTranspose(XMMATRIX(
+			XMVectorMultiply(abX, inverseDeterminant), XMVectorMultiply(abY, inverseDeterminant), XMVectorMultiply(abZ, inverseDeterminant), zero));
+		for (int k = 0; k < groupSize; k++)
+			XMStoreFloat4x4(&results[i + k].normalMatrix, XMMATRIX(rows0.r[k], rows1.r[k], rows2.r[k], identityRow3));
+	}
+}
+
+TransformSystem& TransformSystem::GetDefault()
+{
+	static TransformSystem system;
+	return system;
+}
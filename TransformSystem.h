@@ -0,0 +1,139 @@
+#pragma once
+
+#include "BufferStructs.h"
+#include <DirectXMath.h>
+#include <vector>
+
+// A transform's own axes (its rotation only - no scale, no parent)
+struct TransformBasis
+{
+	DirectX::XMFLOAT3 right;
+	DirectX::XMFLOAT3 up;
+	DirectX::XMFLOAT3 forward;
+};
+
+// --------------------------------------------------------
+// Storage for transforms as structure-of-arrays
+//
+// - A transform is a handle: a slot index into parallel arrays
+//   of positions, rotations and scales, plus its world matrix,
+//   basis vectors, dirty flag and hierarchy links
+// - Rotations are stored as quaternions, converted once when
+//   they're set (from Euler angles, which are kept as given)
+// - Update() rebuilds every dirty world matrix in one pass:
+//   local matrices four slots at a time with SIMD (optionally
+//   split into jobs), then parents are applied in depth
+//   order, so a child always sees its parent's final matrix
+// - GetWorldMatrix() still works lazily between updates
+// - Every slot has a version that goes up whenever its world
+//   matrix is invalidated, so anything built from the matrix
+//   (uploads, bounds, spatial indices) can skip clean objects
+// - Transform is a thin view over one slot (of GetDefault(),
+//   unless it's given a system of its own)
+// --------------------------------------------------------
+class TransformSystem
+{
+private:
+	// Local values, one array per component, with room for a
+	// multiple of four slots so SIMD never runs off the end
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// The angles each rotation was set from, for GetRotation()
+	std::vector<float> pitch, yaw, roll;
+
+	// Rebuilt along with the world matrix when a slot is dirty
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<TransformBasis> bases;
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned int> versions;
+	std::vector<unsigned char> alive;
+	std::vector<void*> owners;
+
+	// Hierarchy links (-1 for none)
+	std::vector<int> parents;
+	std::vector<int> firstChild;
+	std::vector<int> nextSibling;
+
+	std::vector<int> freeSlots;
+	int liveCount;
+
+	// Every slot with a parent, shallowest first - rebuilt when
+	// the hierarchy changes shape
+	std::vector<int> childOrder;
+	bool hierarchyChanged;
+
+	void Resize(int capacity);
+	void Grow();
+	void RebuildChildOrder();
+	void DetachFromParent(int handle);
+	void ComputeWorldMatrix(int handle);
+
+	// Local matrices of the dirty slots in [begin, end) (both
+	// multiples of four) - returns how many were dirty
+	int ComputeLocalMatrices(int begin, int end);
+
+public:
+	TransformSystem(int initialCapacity = 1024);
+
+	TransformSystem(const TransformSystem&) = delete;
+	TransformSystem& operator=(const TransformSystem&) = delete;
+
+	// A new slot at the origin, unrotated, with unit scale
+	// - owner is whatever GetOwner() should hand back (usually
+	//   the Transform viewing the slot)
+	int Create(void* owner = nullptr);
+	void Destroy(int handle);
+
+	int GetCount() const;
+	int GetCapacity() const;
+	void* GetOwner(int handle) const;
+	void SetOwner(int handle, void* owner);
+
+	void SetPosition(int handle, float x, float y, float z);
+	void SetRotation(int handle, float pitch, float yaw, float roll);
+	void SetScale(int handle, float x, float y, float z);
+	DirectX::XMFLOAT3 GetPosition(int handle) const;
+	DirectX::XMFLOAT3 GetRotation(int handle) const;
+	DirectX::XMFLOAT3 GetScale(int handle) const;
+	DirectX::XMFLOAT4 GetRotationQuaternion(int handle) const;
+
+	// Marks the slot and everything below it as needing a new world matrix
+	void MarkDirty(int handle);
+	bool IsDirty(int handle) const;
+
+	// Never goes backwards, and differs from any earlier value once
+	// the world matrix has changed (slots keep counting when reused,
+	// so a new transform never matches an old one's version)
+	unsigned int GetVersion(int handle) const;
+
+	// Rebuilds this one (and any dirty ancestors) if needed
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(int handle);
+	const TransformBasis& GetBasis(int handle);
+
+	// Returns false (and changes nothing) if it would make a cycle;
+	// -1 detaches
+	bool SetParent(int handle, int parent);
+	int GetParent(int handle) const;
+	int GetFirstChild(int handle) const;
+	int GetNextSibling(int handle) const;
+
+	// Rebuilds every dirty world matrix, with the SIMD pass split into
+	// as many as threadCount jobs (see JobSystem) - returns how many
+	// were rebuilt
+	int Update(int threadCount = 1);
+
+	// Each slot's world, world-view-projection and normal matrices,
+	// ready to upload - the normal matrices (a 3x3 inverse transpose)
+	// are worked out four slots at a time with SIMD.  A slot whose
+	// world matrix can't be inverted gets a zero normal matrix.
+	void ComputeObjectMatrices(
+		const int* handles,
+		int count,
+		const DirectX::XMFLOAT4X4& viewProjection,
+		VertexShaderPerObjectData* results);
+
+	// The system plain Transforms live in
+	static TransformSystem& GetDefault();
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 // --------------------------------------------------------
 // A custom vertex definition
@@ -13,4 +14,20 @@ struct Vertex
 	DirectX::XMFLOAT3 Normal;
 	DirectX::XMFLOAT2 UV;
 	DirectX::XMFLOAT3 Tangent;
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// A compact version of the vertex above (24 bytes vs. 44)
+//
+// - Normal and Tangent are octahedral-encoded unit vectors,
+//   each stored as two 16-bit snorms
+// - UV is stored as two half floats
+// - See VertexPacking.h for the encode/decode routines
+// --------------------------------------------------------
+struct PackedVertex
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::PackedVector::XMSHORTN2 Normal;
+	DirectX::PackedVector::XMHALF2 UV;
+	DirectX::PackedVector::XMSHORTN2 Tangent;
+};
@@ -0,0 +1,106 @@
+#include "VertexPacking.h"
+
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	float SignNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	float SnormToFloat(short v)
+	{
+		return fmaxf(v / 32767.0f, -1.0f);
+	}
+
+	// Decodes an octahedral point in [-1, 1]^2 to a unit vector
+	XMVECTOR OctahedralToVector(float x, float y)
+	{
+		float z = 1.0f - fabsf(x) - fabsf(y);
+		float t = fmaxf(-z, 0.0f);
+		x += x >= 0.0f ? -t : t;
+		y += y >= 0.0f ? -t : t;
+		return XMVector3Normalize(XMVectorSet(x, y, z, 0.0f));
+	}
+}
+
+XMSHORTN2 VertexPacking::EncodeOctahedral(XMFLOAT3 direction)
+{
+	// Project onto the octahedron, then fold the lower half over
+	float sum = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+	if (sum <= 0.0f)
+		return XMSHORTN2(0, 0);
+
+	float x = direction.x / sum;
+	float y = direction.y / sum;
+	if (direction.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+		float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	// Plain rounding isn't always the closest encoding, so try the
+	// four snorm values around the point and keep the best one
+	XMVECTOR target = XMVector3Normalize(XMLoadFloat3(&direction));
+	float fx = floorf(x * 32767.0f);
+	float fy = floorf(y * 32767.0f);
+
+	// (Compare distances, not dot products - near 1.0 a float dot
+	//  product can't tell the candidates apart)
+	XMSHORTN2 best(0, 0);
+	float bestDistance = 5.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		float cx = fminf(fmaxf(fx + (i & 1), -32767.0f), 32767.0f);
+		float cy = fminf(fmaxf(fy + (i >> 1), -32767.0f), 32767.0f);
+		XMSHORTN2 candidate((short)cx, (short)cy);
+
+		XMVECTOR decoded = OctahedralToVector(SnormToFloat(candidate.x), SnormToFloat(candidate.y));
+		float distance = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(target, decoded)));
+		if (distance < bestDistance)
+		{
+			bestDistance = distance;
+			best = candidate;
+		}
+	}
+	return best;
+}
+
+XMFLOAT3 VertexPacking::DecodeOctahedral(XMSHORTN2 encoded)
+{
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, OctahedralToVector(SnormToFloat(encoded.x), SnormToFloat(encoded.y)));
+	return result;
+}
+
+PackedVertex VertexPacking::Pack(const Vertex& v)
+{
+	PackedVertex p;
+	p.Position = v.Position;
+	p.Normal = EncodeOctahedral(v.Normal);
+	p.UV = XMHALF2(XMConvertFloatToHalf(v.UV.x), XMConvertFloatToHalf(v.UV.y));
+	p.Tangent = EncodeOctahedral(v.Tangent);
+	return p;
+}
+
+Vertex VertexPacking::Unpack(const PackedVertex& p)
+{
+	Vertex v;
+	v.Position = p.Position;
+	v.Normal = DecodeOctahedral(p.Normal);
+	v.UV = XMFLOAT2(XMConvertHalfToFloat(p.UV.x), XMConvertHalfToFloat(p.UV.y));
+	v.Tangent = DecodeOctahedral(p.Tangent);
+	return v;
+}
+
+void VertexPacking::PackVertices(const Vertex* verts, int count, PackedVertex* out)
+{
+	for (int i = 0; i < count; i++)
+		out[i] = Pack(verts[i]);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Vertex.h"
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+// Worst-case round-trip errors of the PackedVertex encoding
+// - Positions are stored as full floats, so they're exact
+// - Normals/tangents: angle between the input and decoded unit vector
+// - UVs: half floats keep 11 significant bits, so the error is relative
+//   to the UV's magnitude (with a tiny absolute floor near zero)
+const float PackedDirectionMaxErrorRadians = 0.00005f;
+const float PackedUVRelativeError = 1.0f / 2048.0f;
+const float PackedUVAbsoluteError = 1.0f / 33554432.0f;
+
+// --------------------------------------------------------
+// Encode/decode routines between Vertex and PackedVertex
+//
+// - The decode path matches DecodeOctahedral() in
+//   ShaderIncludes.hlsli, which runs on the GPU
+// --------------------------------------------------------
+class VertexPacking
+{
+public:
+	static DirectX::PackedVector::XMSHORTN2 EncodeOctahedral(DirectX::XMFLOAT3 direction);
+	static DirectX::XMFLOAT3 DecodeOctahedral(DirectX::PackedVector::XMSHORTN2 encoded);
+
+	static PackedVertex Pack(const Vertex& v);
+	static Vertex Unpack(const PackedVertex& p);
+
+	static void PackVertices(const Vertex* verts, int count, PackedVertex* out);
+};
@@ -1,11 +1,18 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register(b0)
+// Everything per object is worked out on the CPU, once per object
+// rather than once per vertex (the engine binds each object's own
+// buffer to b0, and only re-uploads it when something moved)
+cbuffer PerObject : register(b0)
 {
-	float4 colorTint;
 	matrix world;
-	matrix view;
-	matrix proj;
+	matrix worldViewProj;
+	matrix normalMatrix;
+}
+
+cbuffer PerMaterial : register(b1)
+{
+	float4 colorTint;
 }
 
 // --------------------------------------------------------
@@ -29,8 +36,7 @@ VertexToPixel main( VertexShaderInput input )
 	//   which we're leaving at 1.0 for now (this is more useful when dealing with 
 	//   a perspective projection matrix, which we'll get to in the future).
 
-	matrix wvp = mul(proj, mul(view, world));
-	output.position = mul(wvp, float4(input.position, 1.0f));
+	output.position = mul(worldViewProj, float4(input.position, 1.0f));
 	//output.position = float4(input.position, 1.0f);
 	
 	// Pass the color through 
@@ -38,8 +44,9 @@ VertexToPixel main( VertexShaderInput input )
 	// - We don't need to alter it here, but we do need to send it to the pixel shader
 	output.color = colorTint;
 
-	//would need to multiply by the inverse transpose of the world matrix for non-uniform scales
-	output.normal = mul((float3x3)world, input.normal); 
+	// The normal matrix keeps normals perpendicular to the surface
+	// even under non-uniform scale
+	output.normal = normalize(mul((float3x3)normalMatrix, input.normal)); 
 
 	output.worldPos = mul( world, float4(input.position, 1.0f)).xyz;
 